@@ -0,0 +1,65 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BITS_H__
+#define BITS_H__
+
+#ifdef _MSC_VER
+#  include <intrin.h>
+#endif
+
+
+/**
+    \namespace Bits
+    \brief Namespace containing small bit-twiddling utilities
+*/
+namespace Bits
+{
+
+/**
+    \brief Count the bits set in a 64-bit word
+    \ingroup common
+    
+    Compiles to a single instruction where the processor has one.
+    
+    \param x The word
+    \returns Number of bits set
+*/
+inline unsigned int PopCount(wxUint64 x)
+{
+#if defined(__GNUC__)
+	return __builtin_popcountll(x);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	return (unsigned int)__popcnt64(x);
+#else
+	x = x - ((x >> 1) & 0x5555555555555555ULL);
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (unsigned int)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+};
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
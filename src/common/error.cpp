@@ -27,6 +27,8 @@
 #  include <wx/wx.h>
 #endif
 
+#include <wx/thread.h>
+
 #include "error.h"
 
 namespace Error
@@ -34,14 +36,21 @@ namespace Error
 
 static wxArrayString errorStack;
 
+// Errors may be set from worker threads (see Parallel::For)
+static wxCriticalSection errorLock;
+
 void Set(const wxString &str)
 {
+	wxCriticalSectionLocker locker(errorLock);
+	
 	// Add this to the beginning of the string array
 	errorStack.Insert(str, 0);
 }
 
 const wxString Get(void)
 {
+	wxCriticalSectionLocker locker(errorLock);
+	
 	// If no errors have been reported, let the calling function know
 	if (!errorStack.GetCount())
 		return wxString(_("No error"));
@@ -32,6 +32,8 @@ namespace Error
 /**
     \brief Set current error string
     \ingroup common
+    
+    This function (like Get()) may safely be called from any thread.
 
     \param str Current error string, override old error string
 */
@@ -0,0 +1,882 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define KERNELS_X86
+#  define KERNELS_TARGET(isa) __attribute__((target(isa)))
+#  include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#  define KERNELS_X86
+#  define KERNELS_TARGET(isa)
+#  include <immintrin.h>
+#  include <intrin.h>
+#endif
+
+#ifdef BUILD_TESTS
+#  include <TestHarness.h>
+#  include <math.h>
+#  include <vector>
+#  include "rng.h"
+#endif
+
+#include "parallel.h"
+#include "kernels.h"
+
+
+namespace Kernels
+{
+
+// Columns handled per pass over the matrix.  A block of the vector
+// (16 KB) then stays in the L1 cache while the rows stream past it.
+static const size_t blockSize = 2048;
+
+// Columns of the output handed to a thread at a time by MatTVec()
+static const size_t stripSize = 512;
+
+// MatMatT() works on a tile of this many vectors at a time, taking
+// this many columns per pass.  Four rows of the matrix (16 KB) stay in
+// the L1 cache while the tile of vectors (128 KB) is read from L2.
+static const size_t tileSize = 32;
+static const size_t tileBlockSize = 512;
+
+
+// Each instruction set has these four inner loops: the dot products of
+// four rows with the same vector (so each value of the vector is loaded
+// once for four multiplies), the same with two vectors at once (so each
+// value of the rows is also used twice), four scaled rows added to a
+// vector, and a single dot product.  The two-vector loop adds up each
+// product in the same order as the one-vector loop.
+typedef void (*Dot4Function)(const double *a0, const double *a1, const double *a2, const double *a3,
+                             const double *x, size_t n, double *sums);
+typedef void (*Dot4x2Function)(const double *a0, const double *a1, const double *a2, const double *a3,
+                               const double *x0, const double *x1, size_t n, double *sums);
+typedef void (*Axpy4Function)(double c0, const double *a0, double c1, const double *a1,
+                              double c2, const double *a2, double c3, const double *a3,
+                              double *y, size_t n);
+typedef double (*DotFunction)(const double *a, const double *b, size_t n);
+
+struct KernelSet
+{
+	Dot4Function dot4;
+	Dot4x2Function dot4x2;
+	Axpy4Function axpy4;
+	DotFunction dot;
+};
+
+
+static void Dot4Scalar(const double *a0, const double *a1, const double *a2, const double *a3,
+                       const double *x, size_t n, double *sums)
+{
+	double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+	
+	for (size_t j = 0 ; j < n ; j++)
+	{
+		s0 += a0[j] * x[j];
+		s1 += a1[j] * x[j];
+		s2 += a2[j] * x[j];
+		s3 += a3[j] * x[j];
+	}
+	
+	sums[0] = s0;
+	sums[1] = s1;
+	sums[2] = s2;
+	sums[3] = s3;
+}
+
+static void Dot4x2Scalar(const double *a0, const double *a1, const double *a2, const double *a3,
+                         const double *x0, const double *x1, size_t n, double *sums)
+{
+	Dot4Scalar(a0, a1, a2, a3, x0, n, sums);
+	Dot4Scalar(a0, a1, a2, a3, x1, n, sums + 4);
+}
+
+static void Axpy4Scalar(double c0, const double *a0, double c1, const double *a1,
+                        double c2, const double *a2, double c3, const double *a3,
+                        double *y, size_t n)
+{
+	for (size_t j = 0 ; j < n ; j++)
+		y[j] += a0[j] * c0 + a1[j] * c1 + a2[j] * c2 + a3[j] * c3;
+}
+
+static double DotScalar(const double *a, const double *b, size_t n)
+{
+	double sum = 0.0;
+	for (size_t j = 0 ; j < n ; j++)
+		sum += a[j] * b[j];
+	return sum;
+}
+
+
+#ifdef KERNELS_X86
+
+static KERNELS_TARGET("sse2") double Sum128(__m128d v)
+{
+	return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+}
+
+static KERNELS_TARGET("sse2") void Dot4SSE2(const double *a0, const double *a1, const double *a2, const double *a3,
+                                            const double *x, size_t n, double *sums)
+{
+	__m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+	__m128d s2 = _mm_setzero_pd(), s3 = _mm_setzero_pd();
+	size_t j = 0;
+	
+	for ( ; j + 2 <= n ; j += 2)
+	{
+		__m128d v = _mm_loadu_pd(x + j);
+		s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(a0 + j), v));
+		s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(a1 + j), v));
+		s2 = _mm_add_pd(s2, _mm_mul_pd(_mm_loadu_pd(a2 + j), v));
+		s3 = _mm_add_pd(s3, _mm_mul_pd(_mm_loadu_pd(a3 + j), v));
+	}
+	
+	Dot4Scalar(a0 + j, a1 + j, a2 + j, a3 + j, x + j, n - j, sums);
+	sums[0] += Sum128(s0);
+	sums[1] += Sum128(s1);
+	sums[2] += Sum128(s2);
+	sums[3] += Sum128(s3);
+}
+
+static KERNELS_TARGET("sse2") void Dot4x2SSE2(const double *a0, const double *a1, const double *a2, const double *a3,
+                                              const double *x0, const double *x1, size_t n, double *sums)
+{
+	__m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+	__m128d s2 = _mm_setzero_pd(), s3 = _mm_setzero_pd();
+	__m128d t0 = _mm_setzero_pd(), t1 = _mm_setzero_pd();
+	__m128d t2 = _mm_setzero_pd(), t3 = _mm_setzero_pd();
+	size_t j = 0;
+	
+	for ( ; j + 2 <= n ; j += 2)
+	{
+		__m128d v = _mm_loadu_pd(x0 + j), w = _mm_loadu_pd(x1 + j);
+		__m128d r0 = _mm_loadu_pd(a0 + j), r1 = _mm_loadu_pd(a1 + j);
+		__m128d r2 = _mm_loadu_pd(a2 + j), r3 = _mm_loadu_pd(a3 + j);
+		s0 = _mm_add_pd(s0, _mm_mul_pd(r0, v));
+		s1 = _mm_add_pd(s1, _mm_mul_pd(r1, v));
+		s2 = _mm_add_pd(s2, _mm_mul_pd(r2, v));
+		s3 = _mm_add_pd(s3, _mm_mul_pd(r3, v));
+		t0 = _mm_add_pd(t0, _mm_mul_pd(r0, w));
+		t1 = _mm_add_pd(t1, _mm_mul_pd(r1, w));
+		t2 = _mm_add_pd(t2, _mm_mul_pd(r2, w));
+		t3 = _mm_add_pd(t3, _mm_mul_pd(r3, w));
+	}
+	
+	Dot4x2Scalar(a0 + j, a1 + j, a2 + j, a3 + j, x0 + j, x1 + j, n - j, sums);
+	sums[0] += Sum128(s0);
+	sums[1] += Sum128(s1);
+	sums[2] += Sum128(s2);
+	sums[3] += Sum128(s3);
+	sums[4] += Sum128(t0);
+	sums[5] += Sum128(t1);
+	sums[6] += Sum128(t2);
+	sums[7] += Sum128(t3);
+}
+
+static KERNELS_TARGET("sse2") void Axpy4SSE2(double c0, const double *a0, double c1, const double *a1,
+                                             double c2, const double *a2, double c3, const double *a3,
+                                             double *y, size_t n)
+{
+	__m128d v0 = _mm_set1_pd(c0), v1 = _mm_set1_pd(c1);
+	__m128d v2 = _mm_set1_pd(c2), v3 = _mm_set1_pd(c3);
+	size_t j = 0;
+	
+	for ( ; j + 2 <= n ; j += 2)
+	{
+		__m128d s = _mm_loadu_pd(y + j);
+		s = _mm_add_pd(s, _mm_mul_pd(_mm_loadu_pd(a0 + j), v0));
+		s = _mm_add_pd(s, _mm_mul_pd(_mm_loadu_pd(a1 + j), v1));
+		s = _mm_add_pd(s, _mm_mul_pd(_mm_loadu_pd(a2 + j), v2));
+		s = _mm_add_pd(s, _mm_mul_pd(_mm_loadu_pd(a3 + j), v3));
+		_mm_storeu_pd(y + j, s);
+	}
+	
+	Axpy4Scalar(c0, a0 + j, c1, a1 + j, c2, a2 + j, c3, a3 + j, y + j, n - j);
+}
+
+static KERNELS_TARGET("sse2") double DotSSE2(const double *a, const double *b, size_t n)
+{
+	__m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+	size_t j = 0;
+	
+	for ( ; j + 4 <= n ; j += 4)
+	{
+		s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(a + j), _mm_loadu_pd(b + j)));
+		s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(a + j + 2), _mm_loadu_pd(b + j + 2)));
+	}
+	
+	return Sum128(_mm_add_pd(s0, s1)) + DotScalar(a + j, b + j, n - j);
+}
+
+
+static KERNELS_TARGET("avx2,fma") double Sum256(__m256d v)
+{
+	__m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+	return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+}
+
+static KERNELS_TARGET("avx2,fma") void Dot4AVX2(const double *a0, const double *a1, const double *a2, const double *a3,
+                                                const double *x, size_t n, double *sums)
+{
+	__m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+	__m256d s2 = _mm256_setzero_pd(), s3 = _mm256_setzero_pd();
+	size_t j = 0;
+	
+	for ( ; j + 4 <= n ; j += 4)
+	{
+		__m256d v = _mm256_loadu_pd(x + j);
+		s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a0 + j), v, s0);
+		s1 = _mm256_fmadd_pd(_mm256_loadu_pd(a1 + j), v, s1);
+		s2 = _mm256_fmadd_pd(_mm256_loadu_pd(a2 + j), v, s2);
+		s3 = _mm256_fmadd_pd(_mm256_loadu_pd(a3 + j), v, s3);
+	}
+	
+	Dot4Scalar(a0 + j, a1 + j, a2 + j, a3 + j, x + j, n - j, sums);
+	sums[0] += Sum256(s0);
+	sums[1] += Sum256(s1);
+	sums[2] += Sum256(s2);
+	sums[3] += Sum256(s3);
+}
+
+static KERNELS_TARGET("avx2,fma") void Dot4x2AVX2(const double *a0, const double *a1, const double *a2, const double *a3,
+                                                  const double *x0, const double *x1, size_t n, double *sums)
+{
+	__m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+	__m256d s2 = _mm256_setzero_pd(), s3 = _mm256_setzero_pd();
+	__m256d t0 = _mm256_setzero_pd(), t1 = _mm256_setzero_pd();
+	__m256d t2 = _mm256_setzero_pd(), t3 = _mm256_setzero_pd();
+	size_t j = 0;
+	
+	for ( ; j + 4 <= n ; j += 4)
+	{
+		__m256d v = _mm256_loadu_pd(x0 + j), w = _mm256_loadu_pd(x1 + j);
+		__m256d r0 = _mm256_loadu_pd(a0 + j), r1 = _mm256_loadu_pd(a1 + j);
+		__m256d r2 = _mm256_loadu_pd(a2 + j), r3 = _mm256_loadu_pd(a3 + j);
+		s0 = _mm256_fmadd_pd(r0, v, s0);
+		s1 = _mm256_fmadd_pd(r1, v, s1);
+		s2 = _mm256_fmadd_pd(r2, v, s2);
+		s3 = _mm256_fmadd_pd(r3, v, s3);
+		t0 = _mm256_fmadd_pd(r0, w, t0);
+		t1 = _mm256_fmadd_pd(r1, w, t1);
+		t2 = _mm256_fmadd_pd(r2, w, t2);
+		t3 = _mm256_fmadd_pd(r3, w, t3);
+	}
+	
+	Dot4x2Scalar(a0 + j, a1 + j, a2 + j, a3 + j, x0 + j, x1 + j, n - j, sums);
+	sums[0] += Sum256(s0);
+	sums[1] += Sum256(s1);
+	sums[2] += Sum256(s2);
+	sums[3] += Sum256(s3);
+	sums[4] += Sum256(t0);
+	sums[5] += Sum256(t1);
+	sums[6] += Sum256(t2);
+	sums[7] += Sum256(t3);
+}
+
+static KERNELS_TARGET("avx2,fma") void Axpy4AVX2(double c0, const double *a0, double c1, const double *a1,
+                                                 double c2, const double *a2, double c3, const double *a3,
+                                                 double *y, size_t n)
+{
+	__m256d v0 = _mm256_set1_pd(c0), v1 = _mm256_set1_pd(c1);
+	__m256d v2 = _mm256_set1_pd(c2), v3 = _mm256_set1_pd(c3);
+	size_t j = 0;
+	
+	for ( ; j + 4 <= n ; j += 4)
+	{
+		__m256d s = _mm256_loadu_pd(y + j);
+		s = _mm256_fmadd_pd(_mm256_loadu_pd(a0 + j), v0, s);
+		s = _mm256_fmadd_pd(_mm256_loadu_pd(a1 + j), v1, s);
+		s = _mm256_fmadd_pd(_mm256_loadu_pd(a2 + j), v2, s);
+		s = _mm256_fmadd_pd(_mm256_loadu_pd(a3 + j), v3, s);
+		_mm256_storeu_pd(y + j, s);
+	}
+	
+	Axpy4Scalar(c0, a0 + j, c1, a1 + j, c2, a2 + j, c3, a3 + j, y + j, n - j);
+}
+
+static KERNELS_TARGET("avx2,fma") double DotAVX2(const double *a, const double *b, size_t n)
+{
+	__m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+	size_t j = 0;
+	
+	for ( ; j + 8 <= n ; j += 8)
+	{
+		s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + j), _mm256_loadu_pd(b + j), s0);
+		s1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + j + 4), _mm256_loadu_pd(b + j + 4), s1);
+	}
+	
+	return Sum256(_mm256_add_pd(s0, s1)) + DotScalar(a + j, b + j, n - j);
+}
+
+
+static KERNELS_TARGET("avx512f") double Sum512(__m512d v)
+{
+	double t[8];
+	_mm512_storeu_pd(t, v);
+	return ((t[0] + t[4]) + (t[1] + t[5])) + ((t[2] + t[6]) + (t[3] + t[7]));
+}
+
+static KERNELS_TARGET("avx512f") void Dot4AVX512(const double *a0, const double *a1, const double *a2, const double *a3,
+                                                 const double *x, size_t n, double *sums)
+{
+	__m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd();
+	__m512d s2 = _mm512_setzero_pd(), s3 = _mm512_setzero_pd();
+	size_t j = 0;
+	
+	for ( ; j + 8 <= n ; j += 8)
+	{
+		__m512d v = _mm512_loadu_pd(x + j);
+		s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a0 + j), v, s0);
+		s1 = _mm512_fmadd_pd(_mm512_loadu_pd(a1 + j), v, s1);
+		s2 = _mm512_fmadd_pd(_mm512_loadu_pd(a2 + j), v, s2);
+		s3 = _mm512_fmadd_pd(_mm512_loadu_pd(a3 + j), v, s3);
+	}
+	
+	Dot4Scalar(a0 + j, a1 + j, a2 + j, a3 + j, x + j, n - j, sums);
+	sums[0] += Sum512(s0);
+	sums[1] += Sum512(s1);
+	sums[2] += Sum512(s2);
+	sums[3] += Sum512(s3);
+}
+
+static KERNELS_TARGET("avx512f") void Dot4x2AVX512(const double *a0, const double *a1, const double *a2, const double *a3,
+                                                   const double *x0, const double *x1, size_t n, double *sums)
+{
+	__m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd();
+	__m512d s2 = _mm512_setzero_pd(), s3 = _mm512_setzero_pd();
+	__m512d t0 = _mm512_setzero_pd(), t1 = _mm512_setzero_pd();
+	__m512d t2 = _mm512_setzero_pd(), t3 = _mm512_setzero_pd();
+	size_t j = 0;
+	
+	for ( ; j + 8 <= n ; j += 8)
+	{
+		__m512d v = _mm512_loadu_pd(x0 + j), w = _mm512_loadu_pd(x1 + j);
+		__m512d r0 = _mm512_loadu_pd(a0 + j), r1 = _mm512_loadu_pd(a1 + j);
+		__m512d r2 = _mm512_loadu_pd(a2 + j), r3 = _mm512_loadu_pd(a3 + j);
+		s0 = _mm512_fmadd_pd(r0, v, s0);
+		s1 = _mm512_fmadd_pd(r1, v, s1);
+		s2 = _mm512_fmadd_pd(r2, v, s2);
+		s3 = _mm512_fmadd_pd(r3, v, s3);
+		t0 = _mm512_fmadd_pd(r0, w, t0);
+		t1 = _mm512_fmadd_pd(r1, w, t1);
+		t2 = _mm512_fmadd_pd(r2, w, t2);
+		t3 = _mm512_fmadd_pd(r3, w, t3);
+	}
+	
+	Dot4x2Scalar(a0 + j, a1 + j, a2 + j, a3 + j, x0 + j, x1 + j, n - j, sums);
+	sums[0] += Sum512(s0);
+	sums[1] += Sum512(s1);
+	sums[2] += Sum512(s2);
+	sums[3] += Sum512(s3);
+	sums[4] += Sum512(t0);
+	sums[5] += Sum512(t1);
+	sums[6] += Sum512(t2);
+	sums[7] += Sum512(t3);
+}
+
+static KERNELS_TARGET("avx512f") void Axpy4AVX512(double c0, const double *a0, double c1, const double *a1,
+                                                  double c2, const double *a2, double c3, const double *a3,
+                                                  double *y, size_t n)
+{
+	__m512d v0 = _mm512_set1_pd(c0), v1 = _mm512_set1_pd(c1);
+	__m512d v2 = _mm512_set1_pd(c2), v3 = _mm512_set1_pd(c3);
+	size_t j = 0;
+	
+	for ( ; j + 8 <= n ; j += 8)
+	{
+		__m512d s = _mm512_loadu_pd(y + j);
+		s = _mm512_fmadd_pd(_mm512_loadu_pd(a0 + j), v0, s);
+		s = _mm512_fmadd_pd(_mm512_loadu_pd(a1 + j), v1, s);
+		s = _mm512_fmadd_pd(_mm512_loadu_pd(a2 + j), v2, s);
+		s = _mm512_fmadd_pd(_mm512_loadu_pd(a3 + j), v3, s);
+		_mm512_storeu_pd(y + j, s);
+	}
+	
+	Axpy4Scalar(c0, a0 + j, c1, a1 + j, c2, a2 + j, c3, a3 + j, y + j, n - j);
+}
+
+static KERNELS_TARGET("avx512f") double DotAVX512(const double *a, const double *b, size_t n)
+{
+	__m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd();
+	size_t j = 0;
+	
+	for ( ; j + 16 <= n ; j += 16)
+	{
+		s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + j), _mm512_loadu_pd(b + j), s0);
+		s1 = _mm512_fmadd_pd(_mm512_loadu_pd(a + j + 8), _mm512_loadu_pd(b + j + 8), s1);
+	}
+	
+	return Sum512(_mm512_add_pd(s0, s1)) + DotScalar(a + j, b + j, n - j);
+}
+
+#endif
+
+
+static const KernelSet kernelSets[] =
+{
+	{ Dot4Scalar, Dot4x2Scalar, Axpy4Scalar, DotScalar },
+#ifdef KERNELS_X86
+	{ Dot4SSE2, Dot4x2SSE2, Axpy4SSE2, DotSSE2 },
+	{ Dot4AVX2, Dot4x2AVX2, Axpy4AVX2, DotAVX2 },
+	{ Dot4AVX512, Dot4x2AVX512, Axpy4AVX512, DotAVX512 }
+#endif
+};
+
+
+static Level DetectLevel()
+{
+#if defined(KERNELS_X86) && defined(__GNUC__)
+	__builtin_cpu_init();
+	
+	if (__builtin_cpu_supports("avx512f"))
+		return AVX512;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return AVX2;
+	if (__builtin_cpu_supports("sse2"))
+		return SSE2;
+	return SCALAR;
+#elif defined(KERNELS_X86)
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+	
+	__cpuid(info, 1);
+	bool sse2 = (info[3] & (1 << 26)) != 0;
+	bool fma = (info[2] & (1 << 12)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	
+	// The operating system also has to save the wide registers
+	unsigned __int64 xcr0 = osxsave ? _xgetbv(0) : 0;
+	bool avx2 = false, avx512 = false;
+	if (maxLeaf >= 7)
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = fma && (info[1] & (1 << 5)) && (xcr0 & 0x06) == 0x06;
+		avx512 = (info[1] & (1 << 16)) && (xcr0 & 0xe6) == 0xe6;
+	}
+	
+	if (avx512)
+		return AVX512;
+	if (avx2)
+		return AVX2;
+	return sse2 ? SSE2 : SCALAR;
+#else
+	return SCALAR;
+#endif
+}
+
+// Worked out on first use
+static int bestLevel = -1;
+static int currentLevel = -1;
+
+Level GetBestLevel()
+{
+	if (bestLevel < 0)
+		bestLevel = DetectLevel();
+	return (Level)bestLevel;
+}
+
+Level GetLevel()
+{
+	if (currentLevel < 0)
+		currentLevel = GetBestLevel();
+	return (Level)currentLevel;
+}
+
+void SetLevel(Level level)
+{
+	currentLevel = (level < GetBestLevel()) ? level : GetBestLevel();
+}
+
+
+// Multiply rows [begin, end) of the matrix by a vector.  Rows are taken
+// in fours from \p begin, so as long as \p begin is a multiple of four,
+// each row's sum comes out the same however the rows are split up.
+static void MatVecRows(const KernelSet &kernels, const double *a, size_t begin, size_t end,
+                       size_t cols, const double *x, double *y)
+{
+	for (size_t i = begin ; i < end ; i++)
+		y[i] = 0.0;
+	
+	for (size_t start = 0 ; start < cols ; start += blockSize)
+	{
+		size_t n = (cols - start < blockSize) ? cols - start : blockSize;
+		size_t i = begin;
+		
+		for ( ; i + 4 <= end ; i += 4)
+		{
+			const double *row = a + i * cols + start;
+			double sums[4];
+			
+			kernels.dot4(row, row + cols, row + 2 * cols, row + 3 * cols, x + start, n, sums);
+			y[i] += sums[0];
+			y[i + 1] += sums[1];
+			y[i + 2] += sums[2];
+			y[i + 3] += sums[3];
+		}
+		
+		for ( ; i < end ; i++)
+			y[i] += kernels.dot(a + i * cols + start, x + start, n);
+	}
+}
+
+// Work out columns [begin, end) of the transpose of the matrix times a
+// vector
+static void MatTVecColumns(const KernelSet &kernels, const double *a, size_t rows, size_t cols,
+                           size_t begin, size_t end, const double *x, double *y)
+{
+	for (size_t j = begin ; j < end ; j++)
+		y[j] = 0.0;
+	
+	for (size_t start = begin ; start < end ; start += blockSize)
+	{
+		size_t n = (end - start < blockSize) ? end - start : blockSize;
+		size_t i = 0;
+		
+		for ( ; i + 4 <= rows ; i += 4)
+		{
+			const double *row = a + i * cols + start;
+			kernels.axpy4(x[i], row, x[i + 1], row + cols, x[i + 2], row + 2 * cols,
+			              x[i + 3], row + 3 * cols, y + start, n);
+		}
+		
+		for ( ; i < rows ; i++)
+		{
+			const double *row = a + i * cols + start;
+			for (size_t j = 0 ; j < n ; j++)
+				y[start + j] += row[j] * x[i];
+		}
+	}
+}
+
+
+// Work out rows [begin, end) of X A^T.  Every product is summed in the
+// same order, however the vectors are split up.
+static void MatMatTRows(const KernelSet &kernels, const double *a, size_t rows, size_t cols,
+                        const double *x, size_t begin, size_t end, double *y)
+{
+	for (size_t k = begin ; k < end ; k++)
+		for (size_t i = 0 ; i < rows ; i++)
+			y[k * rows + i] = 0.0;
+	
+	for (size_t start = 0 ; start < cols ; start += tileBlockSize)
+	{
+		size_t n = (cols - start < tileBlockSize) ? cols - start : tileBlockSize;
+		size_t i = 0;
+		
+		for ( ; i + 4 <= rows ; i += 4)
+		{
+			const double *row = a + i * cols + start;
+			size_t k = begin;
+			
+			for ( ; k + 2 <= end ; k += 2)
+			{
+				double sums[8];
+				double *out = y + k * rows + i;
+				
+				kernels.dot4x2(row, row + cols, row + 2 * cols, row + 3 * cols,
+				               x + k * cols + start, x + (k + 1) * cols + start, n, sums);
+				for (size_t s = 0 ; s < 4 ; s++)
+				{
+					out[s] += sums[s];
+					out[rows + s] += sums[4 + s];
+				}
+			}
+			
+			for ( ; k < end ; k++)
+			{
+				double sums[4];
+				double *out = y + k * rows + i;
+				
+				kernels.dot4(row, row + cols, row + 2 * cols, row + 3 * cols, x + k * cols + start, n, sums);
+				out[0] += sums[0];
+				out[1] += sums[1];
+				out[2] += sums[2];
+				out[3] += sums[3];
+			}
+		}
+		
+		for ( ; i < rows ; i++)
+			for (size_t k = begin ; k < end ; k++)
+				y[k * rows + i] += kernels.dot(a + i * cols + start, x + k * cols + start, n);
+	}
+}
+
+
+/**
+    \brief Splits MatVec() between threads, four rows at a time
+*/
+class MatVecTask : public ParallelTask
+{
+public:
+	MatVecTask(const double *a_, size_t rows_, size_t cols_, const double *x_, double *y_) :
+		kernels(kernelSets[GetLevel()]), a(a_), rows(rows_), cols(cols_), x(x_), y(y_)
+	{ }
+	
+	virtual bool Run(size_t begin, size_t end)
+	{
+		MatVecRows(kernels, a, begin * 4, (end * 4 < rows) ? end * 4 : rows, cols, x, y);
+		return true;
+	}
+	
+private:
+	const KernelSet &kernels;
+	const double *a;
+	size_t rows, cols;
+	const double *x;
+	double *y;
+};
+
+/**
+    \brief Splits MatTVec() between threads, in strips of columns
+*/
+class MatTVecTask : public ParallelTask
+{
+public:
+	MatTVecTask(const double *a_, size_t rows_, size_t cols_, const double *x_, double *y_) :
+		kernels(kernelSets[GetLevel()]), a(a_), rows(rows_), cols(cols_), x(x_), y(y_)
+	{ }
+	
+	virtual bool Run(size_t begin, size_t end)
+	{
+		size_t last = (end * stripSize < cols) ? end * stripSize : cols;
+		MatTVecColumns(kernels, a, rows, cols, begin * stripSize, last, x, y);
+		return true;
+	}
+	
+private:
+	const KernelSet &kernels;
+	const double *a;
+	size_t rows, cols;
+	const double *x;
+	double *y;
+};
+
+
+/**
+    \brief Splits MatMatT() between threads, a tile of vectors at a time
+*/
+class MatMatTTask : public ParallelTask
+{
+public:
+	MatMatTTask(const double *a_, size_t rows_, size_t cols_, const double *x_, size_t count_, double *y_) :
+		kernels(kernelSets[GetLevel()]), a(a_), rows(rows_), cols(cols_), x(x_), count(count_), y(y_)
+	{ }
+	
+	virtual bool Run(size_t begin, size_t end)
+	{
+		for (size_t tile = begin ; tile < end ; tile++)
+		{
+			size_t last = ((tile + 1) * tileSize < count) ? (tile + 1) * tileSize : count;
+			MatMatTRows(kernels, a, rows, cols, x, tile * tileSize, last, y);
+		}
+		return true;
+	}
+	
+private:
+	const KernelSet &kernels;
+	const double *a;
+	size_t rows, cols;
+	const double *x;
+	size_t count;
+	double *y;
+};
+
+
+void MatVec(const double *a, size_t rows, size_t cols, const double *x, double *y)
+{
+	MatVecTask task(a, rows, cols, x, y);
+	size_t numGroups = (rows + 3) / 4;
+	
+	if (rows * cols < parallelThreshold)
+		task.Run(0, numGroups);
+	else
+		Parallel::For(numGroups, &task);
+}
+
+void MatTVec(const double *a, size_t rows, size_t cols, const double *x, double *y)
+{
+	MatTVecTask task(a, rows, cols, x, y);
+	size_t numStrips = (cols + stripSize - 1) / stripSize;
+	
+	if (rows * cols < parallelThreshold)
+		task.Run(0, numStrips);
+	else
+		Parallel::For(numStrips, &task);
+}
+
+void MatMatT(const double *a, size_t rows, size_t cols, const double *x, size_t count, double *y)
+{
+	MatMatTTask task(a, rows, cols, x, count, y);
+	size_t numTiles = (count + tileSize - 1) / tileSize;
+	
+	if (rows * cols * count < parallelThreshold)
+		task.Run(0, numTiles);
+	else
+		Parallel::For(numTiles, &task, 1);
+}
+
+double Dot(const double *a, const double *b, size_t n)
+{
+	return kernelSets[GetLevel()].dot(a, b, n);
+}
+
+};
+
+
+
+/** \cond TEST */
+#ifdef BUILD_TESTS
+
+TEST(Kernels, MatVec)
+{
+	// Big enough to cross a block boundary, and with leftover rows and
+	// columns
+	const size_t rows = 7, cols = 2 * 2048 + 3;
+	std::vector<double> a(rows * cols), x(cols), xt(rows);
+	
+	Random::Seed(4);
+	for (size_t i = 0 ; i < a.size() ; i++)
+		a[i] = Random::GenerateFloat() - 0.5;
+	for (size_t j = 0 ; j < cols ; j++)
+		x[j] = Random::GenerateFloat();
+	for (size_t i = 0 ; i < rows ; i++)
+		xt[i] = Random::GenerateFloat();
+	
+	// Every instruction set gets the same answer
+	for (int level = Kernels::SCALAR ; level <= Kernels::GetBestLevel() ; level++)
+	{
+		Kernels::SetLevel((Kernels::Level)level);
+		CHECK_EQUAL(level, (int)Kernels::GetLevel());
+		
+		std::vector<double> y(rows), yt(cols);
+		Kernels::MatVec(&a[0], rows, cols, &x[0], &y[0]);
+		Kernels::MatTVec(&a[0], rows, cols, &xt[0], &yt[0]);
+		
+		for (size_t i = 0 ; i < rows ; i++)
+		{
+			double expected = 0.0;
+			for (size_t j = 0 ; j < cols ; j++)
+				expected += a[i * cols + j] * x[j];
+			CHECK(fabs(y[i] - expected) < 1e-9);
+			CHECK(fabs(Kernels::Dot(&a[i * cols], &x[0], cols) - expected) < 1e-9);
+		}
+		
+		for (size_t j = 0 ; j < cols ; j++)
+		{
+			double expected = 0.0;
+			for (size_t i = 0 ; i < rows ; i++)
+				expected += a[i * cols + j] * xt[i];
+			CHECK(fabs(yt[j] - expected) < 1e-12);
+		}
+	}
+	
+	Kernels::SetLevel(Kernels::GetBestLevel());
+}
+
+TEST(Kernels, MatMatT)
+{
+	// A tile and a bit of vectors, with leftover rows and columns
+	const size_t rows = 11, cols = 512 + 5, count = 35;
+	std::vector<double> a(rows * cols), x(count * cols);
+	
+	Random::Seed(6);
+	for (size_t i = 0 ; i < a.size() ; i++)
+		a[i] = Random::GenerateFloat() - 0.5;
+	for (size_t i = 0 ; i < x.size() ; i++)
+		x[i] = Random::GenerateFloat();
+	
+	for (int level = Kernels::SCALAR ; level <= Kernels::GetBestLevel() ; level++)
+	{
+		Kernels::SetLevel((Kernels::Level)level);
+		
+		std::vector<double> y(count * rows), single(rows);
+		Kernels::MatMatT(&a[0], rows, cols, &x[0], count, &y[0]);
+		
+		for (size_t k = 0 ; k < count ; k++)
+		{
+			Kernels::MatVec(&a[0], rows, cols, &x[k * cols], &single[0]);
+			for (size_t i = 0 ; i < rows ; i++)
+				CHECK(fabs(y[k * rows + i] - single[i]) < 1e-12);
+		}
+	}
+	
+	Kernels::SetLevel(Kernels::GetBestLevel());
+	
+	// Splitting it between threads doesn't change the answer
+	const size_t bigRows = 300, bigCount = 100;
+	std::vector<double> big(bigRows * bigRows), bigX(bigCount * bigRows);
+	for (size_t i = 0 ; i < big.size() ; i++)
+		big[i] = Random::GenerateFloat();
+	for (size_t i = 0 ; i < bigX.size() ; i++)
+		bigX[i] = Random::GenerateFloat();
+	CHECK(bigRows * bigRows * bigCount >= Kernels::parallelThreshold);
+	
+	std::vector<double> y1(bigCount * bigRows), y4(bigCount * bigRows);
+	Parallel::SetNumThreads(1);
+	Kernels::MatMatT(&big[0], bigRows, bigRows, &bigX[0], bigCount, &y1[0]);
+	Parallel::SetNumThreads(4);
+	Kernels::MatMatT(&big[0], bigRows, bigRows, &bigX[0], bigCount, &y4[0]);
+	Parallel::SetNumThreads(0);
+	
+	for (size_t i = 0 ; i < y1.size() ; i++)
+		CHECK_EQUAL(y1[i], y4[i]);
+}
+
+TEST(Kernels, Threads)
+{
+	// Big enough to be split up, which mustn't change the answer
+	const size_t rows = 1030, cols = 1027;
+	std::vector<double> a(rows * cols), x(cols), xt(rows);
+	CHECK(rows * cols >= Kernels::parallelThreshold);
+	
+	Random::Seed(5);
+	for (size_t i = 0 ; i < a.size() ; i++)
+		a[i] = Random::GenerateFloat();
+	for (size_t j = 0 ; j < cols ; j++)
+		x[j] = Random::GenerateFloat();
+	for (size_t i = 0 ; i < rows ; i++)
+		xt[i] = Random::GenerateFloat();
+	
+	std::vector<double> y1(rows), yt1(cols), y4(rows), yt4(cols);
+	Parallel::SetNumThreads(1);
+	Kernels::MatVec(&a[0], rows, cols, &x[0], &y1[0]);
+	Kernels::MatTVec(&a[0], rows, cols, &xt[0], &yt1[0]);
+	Parallel::SetNumThreads(4);
+	Kernels::MatVec(&a[0], rows, cols, &x[0], &y4[0]);
+	Kernels::MatTVec(&a[0], rows, cols, &xt[0], &yt4[0]);
+	Parallel::SetNumThreads(0);
+	
+	for (size_t i = 0 ; i < rows ; i++)
+		CHECK_EQUAL(y1[i], y4[i]);
+	for (size_t j = 0 ; j < cols ; j++)
+		CHECK_EQUAL(yt1[j], yt4[j]);
+}
+
+#endif
+/** \endcond */
@@ -0,0 +1,154 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef KERNELS_H__
+#define KERNELS_H__
+
+
+/**
+    \namespace Kernels
+    \brief Namespace containing dense linear algebra kernels
+    
+    These are the inner loops of the population models, which spend
+    nearly all of their time multiplying vectors by the payoff matrix.
+    Matrices are dense and stored row by row.  The loops are blocked so
+    that the vector being read stays in cache while the matrix streams
+    past.  Each kernel is compiled for several instruction sets, and the
+    widest one the processor supports is picked when the program runs
+    (see GetLevel()).  Large products are split between threads (see
+    \c Parallel::For), in a way which doesn't change the result.
+*/
+namespace Kernels
+{
+
+/**
+    \brief The instruction sets the kernels may use
+    \ingroup common
+*/
+enum Level
+{
+	SCALAR,		/**< \brief Plain C++ */
+	SSE2,		/**< \brief Two doubles at a time */
+	AVX2,		/**< \brief Four doubles at a time, with fused multiply-add */
+	AVX512		/**< \brief Eight doubles at a time (AVX-512F) */
+};
+
+/**
+    \brief Get the widest instruction set this processor supports
+    \ingroup common
+    
+    \returns The best level available
+*/
+Level GetBestLevel();
+
+/**
+    \brief Get the instruction set the kernels are using
+    \ingroup common
+    
+    This is GetBestLevel(), unless it has been changed with SetLevel().
+    
+    \returns The current level
+*/
+Level GetLevel();
+
+/**
+    \brief Choose the instruction set the kernels use
+    \ingroup common
+    
+    Mostly useful for testing and benchmarking.  Don't call this while
+    the kernels are running on another thread.
+    
+    \param level The level to use (no higher than GetBestLevel() will
+                 be used)
+*/
+void SetLevel(Level level);
+
+/**
+    \brief Smallest product (in multiply-adds) split between threads
+    \ingroup common
+*/
+const size_t parallelThreshold = 1 << 20;
+
+
+/**
+    \brief Multiply a matrix by a vector
+    \ingroup common
+    
+    Computes <tt>y = A x</tt>.
+    
+    \param a The matrix, \p rows by \p cols
+    \param rows Number of rows of \p a
+    \param cols Number of columns of \p a
+    \param x Vector of \p cols values
+    \param[out] y Vector of \p rows values
+*/
+void MatVec(const double *a, size_t rows, size_t cols, const double *x, double *y);
+
+/**
+    \brief Multiply the transpose of a matrix by a vector
+    \ingroup common
+    
+    Computes <tt>y = A<sup>T</sup> x</tt>, reading \p a row by row.
+    
+    \param a The matrix, \p rows by \p cols
+    \param rows Number of rows of \p a
+    \param cols Number of columns of \p a
+    \param x Vector of \p rows values
+    \param[out] y Vector of \p cols values
+*/
+void MatTVec(const double *a, size_t rows, size_t cols, const double *x, double *y);
+
+/**
+    \brief Multiply a matrix by many vectors at once
+    \ingroup common
+    
+    Computes <tt>Y = X A<sup>T</sup></tt>: that is, each row of \p y is
+    the matrix times the same row of \p x.  The work is tiled so that
+    each piece of the matrix is read from memory once for a whole group
+    of vectors, rather than once per vector, which is much faster than
+    calling MatVec() for each of them.
+    
+    \param a The matrix, \p rows by \p cols
+    \param rows Number of rows of \p a
+    \param cols Number of columns of \p a
+    \param x The vectors, \p count by \p cols
+    \param count Number of vectors
+    \param[out] y The products, \p count by \p rows
+*/
+void MatMatT(const double *a, size_t rows, size_t cols, const double *x, size_t count, double *y);
+
+/**
+    \brief Compute the dot product of two vectors
+    \ingroup common
+    
+    \param a First vector
+    \param b Second vector
+    \param n Length of the vectors
+    \returns Sum of <tt>a[i] * b[i]</tt>
+*/
+double Dot(const double *a, const double *b, size_t n);
+
+};
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,203 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#ifdef __WXMSW__
+#  include <windows.h>
+#else
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+#ifdef BUILD_TESTS
+#  include <TestHarness.h>
+#  include <wx/filename.h>
+#  include <wx/file.h>
+#endif
+
+#include "error.h"
+#include "mappedfile.h"
+
+
+MappedFile::MappedFile() :
+	data(NULL), size(0)
+#ifdef __WXMSW__
+	, mappingHandle(NULL)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef __WXMSW__
+
+bool MappedFile::Open(const wxString &newFileName)
+{
+	Close();
+	
+	HANDLE file = CreateFileW(newFileName.wc_str(), GENERIC_READ, FILE_SHARE_READ,
+	                          NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		Error::Set(wxString::Format(_("Could not open file %s"), newFileName.c_str()));
+		return false;
+	}
+	
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		Error::Set(wxString::Format(_("File %s is empty or unreadable"), newFileName.c_str()));
+		return false;
+	}
+	
+	HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	
+	if (!mapping)
+	{
+		Error::Set(wxString::Format(_("Could not map file %s into memory"), newFileName.c_str()));
+		return false;
+	}
+	
+	void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view)
+	{
+		CloseHandle(mapping);
+		Error::Set(wxString::Format(_("Could not map file %s into memory"), newFileName.c_str()));
+		return false;
+	}
+	
+	mappingHandle = mapping;
+	data = (const wxUint8 *)view;
+	size = (size_t)fileSize.QuadPart;
+	fileName = newFileName;
+	
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (data)
+		UnmapViewOfFile(data);
+	if (mappingHandle)
+		CloseHandle((HANDLE)mappingHandle);
+	
+	data = NULL;
+	size = 0;
+	mappingHandle = NULL;
+	fileName.Clear();
+}
+
+#else
+
+bool MappedFile::Open(const wxString &newFileName)
+{
+	Close();
+	
+	int fd = open(newFileName.fn_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		Error::Set(wxString::Format(_("Could not open file %s"), newFileName.c_str()));
+		return false;
+	}
+	
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		Error::Set(wxString::Format(_("File %s is empty or unreadable"), newFileName.c_str()));
+		return false;
+	}
+	
+	void *view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	
+	// The mapping holds its own reference to the file
+	close(fd);
+	
+	if (view == MAP_FAILED)
+	{
+		Error::Set(wxString::Format(_("Could not map file %s into memory"), newFileName.c_str()));
+		return false;
+	}
+	
+	data = (const wxUint8 *)view;
+	size = (size_t)st.st_size;
+	fileName = newFileName;
+	
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (data)
+		munmap((void *)data, size);
+	
+	data = NULL;
+	size = 0;
+	fileName.Clear();
+}
+
+#endif
+
+
+/** \cond TEST */
+#ifdef BUILD_TESTS
+
+TEST(MappedFile, MapAndClose)
+{
+	wxString tempName = wxFileName::CreateTempFileName(wxT("oyun"));
+	
+	wxFile file(tempName, wxFile::write);
+	CHECK(file.IsOpened());
+	CHECK(file.Write("oyun", 4) == 4);
+	file.Close();
+	
+	MappedFile mapped;
+	CHECK(mapped.Open(tempName));
+	CHECK_EQUAL(4, (int)mapped.GetSize());
+	CHECK(mapped.GetData() != NULL);
+	CHECK(memcmp(mapped.GetData(), "oyun", 4) == 0);
+	
+	mapped.Close();
+	CHECK(mapped.GetData() == NULL);
+	
+	wxRemoveFile(tempName);
+	
+	// Missing files should fail cleanly
+	CHECK(!mapped.Open(tempName));
+	Error::Get();
+}
+
+#endif
+/** \endcond */
@@ -0,0 +1,115 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MAPPEDFILE_H__
+#define MAPPEDFILE_H__
+
+
+/**
+    \class MappedFile
+    \ingroup common
+    
+    \brief A read-only, memory-mapped view of a file on disk
+    
+    The contents of the file are mapped into the address space of the
+    process, so that large binary files (such as player bundles) can be
+    used in place, without reading or copying them.  The mapping is
+    released when the object is closed or destroyed, so any pointers
+    obtained from \c GetData() must not outlive it.
+*/
+class MappedFile
+{
+public:
+	/**
+	    \brief Constructor
+	*/
+	MappedFile();
+	
+	/**
+	    \brief Destructor
+	    
+	    Unmaps the file, if one is open.
+	*/
+	~MappedFile();
+	
+	/**
+	    \brief Map a file into memory
+	    
+	    \param fileName The file to be mapped
+	    \returns True if the file was mapped, false otherwise
+	*/
+	bool Open(const wxString &fileName);
+	
+	/**
+	    \brief Unmap the current file, if any
+	*/
+	void Close();
+	
+	/**
+	    \brief Get a pointer to the beginning of the mapped file
+	    \returns Pointer to the file data, or NULL if no file is mapped
+	*/
+	const wxUint8 *GetData() const { return data; }
+	
+	/**
+	    \brief Get the size of the mapped file
+	    \returns Size of the mapped file, in bytes
+	*/
+	size_t GetSize() const { return size; }
+	
+	/**
+	    \brief Get the name of the mapped file
+	    \returns Name of the file passed to Open()
+	*/
+	const wxString &GetFileName() const { return fileName; }
+	
+private:
+	// Mappings can't be copied
+	MappedFile(const MappedFile &);
+	MappedFile &operator=(const MappedFile &);
+	
+	/**
+	    \brief Pointer to the mapped data
+	*/
+	const wxUint8 *data;
+	
+	/**
+	    \brief Size of the mapped data
+	*/
+	size_t size;
+	
+	/**
+	    \brief Name of the mapped file
+	*/
+	wxString fileName;
+	
+#ifdef __WXMSW__
+	/**
+	    \brief Win32 file-mapping object handle
+	*/
+	void *mappingHandle;
+#endif
+};
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,307 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef BUILD_TESTS
+#  include <TestHarness.h>
+#  include <math.h>
+#  include <string>
+#  include <wx/filename.h>
+#  include "mappedfile.h"
+#  include "rng.h"
+#endif
+
+#include "error.h"
+#include "outputfile.h"
+
+// Data is written to disk in blocks of this size
+static const size_t bufferSize = 64 * 1024;
+
+
+OutputFile::OutputFile() :
+	buffer(bufferSize), used(0), failed(false)
+{
+}
+
+OutputFile::~OutputFile()
+{
+	if (file.IsOpened())
+		Close();
+}
+
+bool OutputFile::Open(const wxString &newFileName, bool append)
+{
+	if (file.IsOpened())
+		Close();
+	
+	used = 0;
+	failed = false;
+	fileName = newFileName;
+	
+	if (!file.Open(fileName, append ? wxFile::write_append : wxFile::write))
+	{
+		Error::Set(wxString::Format(_("Could not open file %s for writing"), fileName.c_str()));
+		return false;
+	}
+	
+	return true;
+}
+
+bool OutputFile::Close()
+{
+	if (!file.IsOpened())
+		return !failed;
+	
+	Flush();
+	file.Close();
+	
+	if (failed)
+	{
+		Error::Set(wxString::Format(_("Could not write to file %s"), fileName.c_str()));
+		return false;
+	}
+	
+	return true;
+}
+
+void OutputFile::Flush()
+{
+	if (used && !failed && file.Write(&buffer[0], used) != used)
+		failed = true;
+	
+	used = 0;
+}
+
+void OutputFile::Write(const char *data, size_t length)
+{
+	// Big blocks go straight to the file
+	if (length >= buffer.size())
+	{
+		Flush();
+		if (!failed && file.Write(data, length) != length)
+			failed = true;
+		return;
+	}
+	
+	if (used + length > buffer.size())
+		Flush();
+	
+	memcpy(&buffer[used], data, length);
+	used += length;
+}
+
+void OutputFile::Write(const char *str)
+{
+	Write(str, strlen(str));
+}
+
+void OutputFile::Write(const wxString &str)
+{
+	const wxCharBuffer utf8 = str.utf8_str();
+	if (utf8.data())
+		Write(utf8.data());
+}
+
+void OutputFile::WriteInt(wxInt64 value)
+{
+	// Build the digits backwards from the end of a buffer
+	char digits[24];
+	char *p = digits + sizeof(digits);
+	
+	wxUint64 magnitude = (value < 0) ? (wxUint64)0 - (wxUint64)value : (wxUint64)value;
+	do
+	{
+		*--p = '0' + (char)(magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude);
+	
+	if (value < 0)
+		*--p = '-';
+	
+	Write(p, digits + sizeof(digits) - p);
+}
+
+void OutputFile::WriteExact(double value)
+{
+	// Seventeen significant digits always suffice; fewer usually do.
+	// The C library prints and reads in the same locale, so the check
+	// is sound before the separator is fixed up.
+	char str[64];
+	for (int precision = 15 ; precision <= 17 ; precision++)
+	{
+		snprintf(str, sizeof(str), "%.*g", precision, value);
+		if (strtod(str, NULL) == value)
+			break;
+	}
+	
+	for (char *c = str ; *c ; c++)
+		if (*c == ',')
+			*c = '.';
+	Write(str);
+}
+
+void OutputFile::WriteFloat(double value)
+{
+	// Anything that won't fit in 64 bits once scaled (including infinity
+	// and NaN) goes through the C library, with the separator fixed up
+	if (!(value > -1e12 && value < 1e12))
+	{
+		char str[512];
+		snprintf(str, sizeof(str), "%f", value);
+		for (char *c = str ; *c ; c++)
+			if (*c == ',')
+				*c = '.';
+		Write(str);
+		return;
+	}
+	
+	bool negative = (value < 0.0);
+	if (negative)
+		value = -value;
+	
+	// Round to six places, and build the digits backwards
+	wxUint64 scaled = (wxUint64)(value * 1e6 + 0.5);
+	wxUint64 integer = scaled / 1000000, fraction = scaled % 1000000;
+	
+	char digits[32];
+	char *p = digits + sizeof(digits);
+	
+	for (int i = 0 ; i < 6 ; i++)
+	{
+		*--p = '0' + (char)(fraction % 10);
+		fraction /= 10;
+	}
+	*--p = '.';
+	
+	do
+	{
+		*--p = '0' + (char)(integer % 10);
+		integer /= 10;
+	} while (integer);
+	
+	if (negative)
+		*--p = '-';
+	
+	Write(p, digits + sizeof(digits) - p);
+}
+
+
+/** \cond TEST */
+#ifdef BUILD_TESTS
+
+TEST(OutputFile, Formatting)
+{
+	wxString tempName = wxFileName::CreateTempFileName(wxT("oyun"));
+	
+	OutputFile out;
+	CHECK(out.Open(tempName));
+	
+	out.WriteInt(0);
+	out.Write(',');
+	out.WriteInt(-1234567890123LL);
+	out.Write(',');
+	out.WriteFloat(0.25);
+	out.Write(',');
+	out.WriteFloat(-3.0000004);
+	out.Write(',');
+	out.WriteFloat(0.9999996);
+	out.Write(',');
+	out.WriteExact(0.1);
+	out.Write(',');
+	out.WriteExact(0.1 + 0.2);
+	out.Write(',');
+	out.WriteExact(-1.5e-9);
+	out.Write(',');
+	out.WriteExact(3.0);
+	out.Write(',');
+	out.Write(wxT("\u00e7"));
+	
+	// Enough to go through the buffer a few times
+	for (int i = 0 ; i < 100000 ; i++)
+		out.Write("x");
+	
+	CHECK(out.Close());
+	
+	MappedFile mapped;
+	CHECK(mapped.Open(tempName));
+	
+	const char expected[] = "0,-1234567890123,0.250000,-3.000000,1.000000,"
+	                        "0.1,0.30000000000000004,-1.5e-09,3,\xc3\xa7";
+	size_t length = strlen(expected);
+	CHECK_EQUAL((int)(length + 100000), (int)mapped.GetSize());
+	CHECK(memcmp(mapped.GetData(), expected, length) == 0);
+	CHECK_EQUAL('x', (char)mapped.GetData()[mapped.GetSize() - 1]);
+	
+	mapped.Close();
+	wxRemoveFile(tempName);
+}
+
+TEST(OutputFile, WriteExact)
+{
+	wxString tempName = wxFileName::CreateTempFileName(wxT("oyun"));
+	
+	// Values of every size, from well below WriteFloat()'s last place
+	std::vector<double> values;
+	for (int i = 0 ; i < 1000 ; i++)
+	{
+		double mantissa = Random::HashToFloat(Random::Hash(i));
+		values.push_back(mantissa * pow(10.0, (double)(i % 60 - 40)));
+	}
+	
+	OutputFile out;
+	CHECK(out.Open(tempName));
+	for (size_t i = 0 ; i < values.size() ; i++)
+	{
+		out.WriteExact(values[i]);
+		out.Write('\n');
+	}
+	CHECK(out.Close());
+	
+	MappedFile mapped;
+	CHECK(mapped.Open(tempName));
+	std::string text((const char *)mapped.GetData(), mapped.GetSize());
+	mapped.Close();
+	
+	const char *p = text.c_str();
+	bool same = true;
+	for (size_t i = 0 ; i < values.size() ; i++)
+	{
+		char *end;
+		same = same && (strtod(p, &end) == values[i]);
+		p = end + 1;
+	}
+	CHECK(same);
+	
+	wxRemoveFile(tempName);
+}
+
+#endif
+/** \endcond */
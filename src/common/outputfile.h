@@ -0,0 +1,193 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OUTPUTFILE_H__
+#define OUTPUTFILE_H__
+
+#include <vector>
+#include <wx/file.h>
+
+
+/**
+    \class OutputFile
+    \ingroup common
+    
+    \brief A buffered file writer for large exports
+    
+    Text is gathered into a fixed-size buffer and written out in large
+    blocks, so that exports take constant memory however much data is
+    written.  Numbers are formatted by hand, which is much faster than
+    \c wxString::Printf and does not depend on the current locale (the
+    decimal separator is always a period).
+    
+    Write errors are remembered, and reported by Close().
+*/
+class OutputFile
+{
+public:
+	/**
+	    \brief Constructor
+	*/
+	OutputFile();
+	
+	/**
+	    \brief Destructor
+	    
+	    Flushes and closes the file, if one is open.
+	*/
+	~OutputFile();
+	
+	/**
+	    \brief Create (or truncate) a file for writing
+	    
+	    \param fileName The file to be written
+	    \param append If true, keep what's in the file already and
+	                  write after it
+	    \returns True if the file was opened, false otherwise
+	*/
+	bool Open(const wxString &fileName, bool append = false);
+	
+	/**
+	    \brief Flush and close the file
+	    \returns True if everything written since Open() reached the
+	             disk, false otherwise
+	*/
+	bool Close();
+	
+	/**
+	    \brief Write raw bytes
+	    \param data The bytes to be written
+	    \param length The number of bytes
+	*/
+	void Write(const char *data, size_t length);
+	
+	/**
+	    \brief Write a NUL-terminated string
+	    \param str The string to be written
+	*/
+	void Write(const char *str);
+	
+	/**
+	    \brief Write a string, encoded as UTF-8
+	    \param str The string to be written
+	*/
+	void Write(const wxString &str);
+	
+	/**
+	    \brief Write a single character
+	    \param c The character to be written
+	*/
+	void Write(char c)
+	{
+		if (used == buffer.size())
+			Flush();
+		buffer[used++] = c;
+	}
+	
+	/**
+	    \brief End a line, with the platform's line ending
+	*/
+	void EndLine()
+	{
+#ifdef __WXMSW__
+		Write("\r\n", 2);
+#else
+		Write('\n');
+#endif
+	}
+	
+	/**
+	    \brief Write a string, followed by a line ending
+	    \param str The string to be written
+	*/
+	void WriteLine(const wxString &str)
+	{
+		Write(str);
+		EndLine();
+	}
+	
+	/**
+	    \brief Write an integer in decimal
+	    \param value The value to be written
+	*/
+	void WriteInt(wxInt64 value);
+	
+	/**
+	    \brief Write a number with six decimal places
+	    
+	    The output is the same as <tt>printf("%f")</tt> in the C locale.
+	    
+	    \param value The value to be written
+	*/
+	void WriteFloat(double value);
+	
+	/**
+	    \brief Write a number with as many digits as it takes to read it
+	           back exactly
+	    
+	    The output is the shortest of <tt>printf("%.15g")</tt>,
+	    <tt>"%.16g"</tt> and <tt>"%.17g"</tt> in the C locale that reads
+	    back as the same \c double, so very small values (which
+	    WriteFloat() would write as zero) keep their precision.
+	    
+	    \param value The value to be written
+	*/
+	void WriteExact(double value);
+	
+private:
+	// Files can't be copied
+	OutputFile(const OutputFile &);
+	OutputFile &operator=(const OutputFile &);
+	
+	/**
+	    \brief Write the contents of the buffer to the file
+	*/
+	void Flush();
+	
+	/**
+	    \brief The file being written
+	*/
+	wxFile file;
+	
+	/**
+	    \brief Name of the file being written, for error messages
+	*/
+	wxString fileName;
+	
+	/**
+	    \brief Data waiting to be written
+	*/
+	std::vector<char> buffer;
+	
+	/**
+	    \brief Number of bytes of \c buffer in use
+	*/
+	size_t used;
+	
+	/**
+	    \brief True if a write has failed since Open()
+	*/
+	bool failed;
+};
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,235 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#include <wx/thread.h>
+
+#ifdef BUILD_TESTS
+#  include <TestHarness.h>
+#  include <vector>
+#endif
+
+#include "parallel.h"
+
+
+namespace Parallel
+{
+
+static unsigned int numThreadsSetting = 0;
+
+
+/**
+    \brief State shared between the threads running a single For()
+*/
+struct ParallelState
+{
+	ParallelTask *task;
+	size_t count;
+	size_t chunkSize;
+	size_t nextItem;
+	bool failed;
+	wxCriticalSection lock;
+	
+	// Run chunks until there are none left
+	void Work()
+	{
+		for (;;)
+		{
+			size_t begin, end;
+			
+			{
+				wxCriticalSectionLocker locker(lock);
+				
+				if (failed || nextItem >= count)
+					return;
+				
+				begin = nextItem;
+				end = (count - begin > chunkSize) ? begin + chunkSize : count;
+				nextItem = end;
+			}
+			
+			if (!task->Run(begin, end))
+			{
+				wxCriticalSectionLocker locker(lock);
+				failed = true;
+			}
+		}
+	}
+};
+
+
+/**
+    \brief A joinable worker thread for For()
+*/
+class ParallelThread : public wxThread
+{
+public:
+	ParallelThread(ParallelState *s) : wxThread(wxTHREAD_JOINABLE), state(s) { }
+	
+protected:
+	virtual ExitCode Entry()
+	{
+		state->Work();
+		return 0;
+	}
+	
+private:
+	ParallelState *state;
+};
+
+
+unsigned int GetNumThreads()
+{
+	if (numThreadsSetting)
+		return numThreadsSetting;
+	
+	int cpus = wxThread::GetCPUCount();
+	return (cpus > 0) ? cpus : 1;
+}
+
+void SetNumThreads(unsigned int numThreads)
+{
+	numThreadsSetting = numThreads;
+}
+
+bool For(size_t count, ParallelTask *task, size_t chunkSize)
+{
+	if (!count)
+		return true;
+	
+	unsigned int numThreads = GetNumThreads();
+	
+	// Aim for several chunks per thread, so that uneven chunks balance out
+	if (!chunkSize)
+	{
+		chunkSize = count / (numThreads * 8);
+		if (!chunkSize)
+			chunkSize = 1;
+	}
+	
+	size_t numChunks = (count + chunkSize - 1) / chunkSize;
+	if (numThreads > numChunks)
+		numThreads = numChunks;
+	
+	// Nothing to be gained from threads here
+	if (numThreads <= 1)
+		return task->Run(0, count);
+	
+	ParallelState state;
+	state.task = task;
+	state.count = count;
+	state.chunkSize = chunkSize;
+	state.nextItem = 0;
+	state.failed = false;
+	
+	// Start the helpers; if we can't get a thread, the others (and we)
+	// will simply pick up its share of the work
+	wxThread **threads = new wxThread *[numThreads - 1];
+	unsigned int numStarted = 0;
+	
+	for (unsigned int i = 0 ; i < numThreads - 1 ; i++)
+	{
+		wxThread *thread = new ParallelThread(&state);
+		
+		if (thread->Create() != wxTHREAD_NO_ERROR || thread->Run() != wxTHREAD_NO_ERROR)
+		{
+			delete thread;
+			break;
+		}
+		
+		threads[numStarted++] = thread;
+	}
+	
+	state.Work();
+	
+	for (unsigned int i = 0 ; i < numStarted ; i++)
+	{
+		threads[i]->Wait();
+		delete threads[i];
+	}
+	delete[] threads;
+	
+	return !state.failed;
+}
+
+};
+
+
+/** \cond TEST */
+#ifdef BUILD_TESTS
+
+class TestSquareTask : public ParallelTask
+{
+public:
+	TestSquareTask(size_t n) : results(n, 0) { }
+	
+	virtual bool Run(size_t begin, size_t end)
+	{
+		for (size_t i = begin ; i < end ; i++)
+			results[i] += i * i;
+		return true;
+	}
+	
+	std::vector<size_t> results;
+};
+
+class TestFailTask : public ParallelTask
+{
+public:
+	virtual bool Run(size_t begin, size_t WXUNUSED(end))
+	{
+		return (begin != 0);
+	}
+};
+
+TEST(Parallel, For)
+{
+	for (unsigned int threads = 1 ; threads <= 4 ; threads++)
+	{
+		Parallel::SetNumThreads(threads);
+		
+		TestSquareTask task(1000);
+		CHECK(Parallel::For(1000, &task, 7));
+		
+		// Every item should have been done exactly once
+		bool ok = true;
+		for (size_t i = 0 ; i < 1000 ; i++)
+			if (task.results[i] != i * i)
+				ok = false;
+		CHECK(ok);
+	}
+	
+	// Failures should be reported
+	TestFailTask failTask;
+	CHECK(!Parallel::For(100, &failTask, 10));
+	
+	Parallel::SetNumThreads(0);
+}
+
+#endif
+/** \endcond */
@@ -0,0 +1,103 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PARALLEL_H__
+#define PARALLEL_H__
+
+
+/**
+    \class ParallelTask
+    \ingroup common
+    
+    \brief A unit of work which may be split across several threads
+    
+    Derive from this class and implement Run() to process a range of
+    items.  Run() will be called from several threads at once (with
+    disjoint ranges), so it must only write to data belonging to its own
+    items, or protect anything shared with a lock.
+    
+    \see Parallel::For
+*/
+class ParallelTask
+{
+public:
+	virtual ~ParallelTask() { }
+	
+	/**
+	    \brief Process a range of items
+	    
+	    \param begin The first item to process
+	    \param end One past the last item to process
+	    \returns True on success, false on failure (after setting an error
+	             with \c Error::Set)
+	*/
+	virtual bool Run(size_t begin, size_t end) = 0;
+};
+
+
+/**
+    \namespace Parallel
+    \brief Namespace containing simple multithreading utilities
+*/
+namespace Parallel
+{
+
+/**
+    \brief Get the number of threads used by For()
+    \ingroup common
+    
+    \returns Number of threads (including the calling thread)
+*/
+unsigned int GetNumThreads();
+
+/**
+    \brief Set the number of threads used by For()
+    \ingroup common
+    
+    \param numThreads Number of threads to use (including the calling
+                      thread), or zero to use one per processor
+*/
+void SetNumThreads(unsigned int numThreads);
+
+/**
+    \brief Run a task over a range of items, in parallel
+    \ingroup common
+    
+    The items <tt>[0, count)</tt> are split into chunks of \p chunkSize,
+    which are handed out to a pool of threads (the calling thread among
+    them) as they become free.  This function returns once every item
+    has been processed.  If any chunk fails, the remaining chunks are
+    skipped.
+    
+    \param count Number of items to process
+    \param task The task to run
+    \param chunkSize Number of items handed to a thread at a time, or zero
+                     to pick a size automatically
+    \returns True if every chunk succeeded, false otherwise
+*/
+bool For(size_t count, ParallelTask *task, size_t chunkSize = 0);
+
+};
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
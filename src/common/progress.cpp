@@ -0,0 +1,113 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#ifdef BUILD_TESTS
+#  include <TestHarness.h>
+#  include "parallel.h"
+#endif
+
+#include "progress.h"
+
+
+void Progress::Start(size_t newTotal)
+{
+	wxCriticalSectionLocker locker(lock);
+	done = 0;
+	total = newTotal;
+}
+
+void Progress::Advance(size_t amount)
+{
+	wxCriticalSectionLocker locker(lock);
+	done += amount;
+}
+
+size_t Progress::GetDone() const
+{
+	wxCriticalSectionLocker locker(lock);
+	return done;
+}
+
+size_t Progress::GetTotal() const
+{
+	wxCriticalSectionLocker locker(lock);
+	return total;
+}
+
+void Progress::Cancel()
+{
+	wxCriticalSectionLocker locker(lock);
+	cancelled = true;
+}
+
+bool Progress::IsCancelled() const
+{
+	wxCriticalSectionLocker locker(lock);
+	return cancelled;
+}
+
+
+/** \cond TEST */
+#ifdef BUILD_TESTS
+
+class TestProgressTask : public ParallelTask
+{
+public:
+	TestProgressTask(Progress *p) : progress(p) { }
+	
+	virtual bool Run(size_t begin, size_t end)
+	{
+		for (size_t i = begin ; i < end ; i++)
+			progress->Advance();
+		return true;
+	}
+	
+	Progress *progress;
+};
+
+TEST(Progress, Counters)
+{
+	Progress progress;
+	progress.Start(10000);
+	
+	TestProgressTask task(&progress);
+	CHECK(Parallel::For(10000, &task, 7));
+	
+	CHECK_EQUAL(10000, (int)progress.GetDone());
+	CHECK_EQUAL(10000, (int)progress.GetTotal());
+	CHECK(!progress.IsCancelled());
+	
+	progress.Cancel();
+	progress.Start(5);
+	CHECK(progress.IsCancelled());
+	CHECK_EQUAL(0, (int)progress.GetDone());
+}
+
+#endif
+/** \endcond */
@@ -0,0 +1,98 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROGRESS_H__
+#define PROGRESS_H__
+
+#include <wx/thread.h>
+
+
+/**
+    \class Progress
+    \ingroup common
+    
+    \brief Thread-safe progress counters and cancellation flag for a
+           long-running job
+    
+    A job running on a worker thread calls Start() and Advance() as it
+    goes, and checks IsCancelled() between units of work; the user
+    interface thread reads the counters and may call Cancel() at any
+    time.  A job which notices that it has been cancelled should stop
+    at the next point where its results are consistent, and fail with
+    an error.
+*/
+class Progress
+{
+public:
+	/**
+	    \brief Constructor
+	*/
+	Progress() : done(0), total(0), cancelled(false) { }
+	
+	/**
+	    \brief Begin a new job
+	    
+	    Resets the count of completed work, but not the cancellation flag.
+	    
+	    \param newTotal The total amount of work to be done
+	*/
+	void Start(size_t newTotal);
+	
+	/**
+	    \brief Record that some work has been completed
+	    \param amount The amount of work completed
+	*/
+	void Advance(size_t amount = 1);
+	
+	/**
+	    \brief Get the amount of work completed
+	    \returns Work completed
+	*/
+	size_t GetDone() const;
+	
+	/**
+	    \brief Get the total amount of work
+	    \returns Total work
+	*/
+	size_t GetTotal() const;
+	
+	/**
+	    \brief Ask the job to stop
+	*/
+	void Cancel();
+	
+	/**
+	    \brief Has the job been asked to stop?
+	    \returns True if Cancel() has been called
+	*/
+	bool IsCancelled() const;
+	
+private:
+	size_t done;				/**< \brief Work completed */
+	size_t total;				/**< \brief Total work */
+	bool cancelled;				/**< \brief True once Cancel() has been called */
+	mutable wxCriticalSection lock;		/**< \brief Lock for all of the above */
+};
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
@@ -18,8 +18,23 @@
     along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#include <wx/thread.h>
+
+#include "rng.h"
+
 // The below code is the Mersenne Twister RNG, copied directly from
-// their source code, with functions renamed
+// their source code, with functions renamed.  The generator state is
+// shared, so the public functions take a lock (players such as
+// RandomPlayer may be run from worker threads).
 
 
 /* 
@@ -78,8 +93,10 @@ namespace Random
 static unsigned long mt[N]; /* the array for the state vector  */
 static int mti=N+1; /* mti==N+1 means mt[N] is not initialized */
 
+static wxCriticalSection mtLock;
+
 /* initializes mt[N] with a seed */
-void Seed(unsigned long s)
+static void SeedUnlocked(unsigned long s)
 {
     mt[0]= s & 0xffffffffUL;
     for (mti=1; mti<N; mti++) {
@@ -94,9 +111,17 @@ void Seed(unsigned long s)
     }
 }
 
+void Seed(unsigned long s)
+{
+    wxCriticalSectionLocker locker(mtLock);
+    SeedUnlocked(s);
+}
+
 /* generates a random number on [0,0xffffffff]-interval */
 unsigned long Generate(void)
 {
+    wxCriticalSectionLocker locker(mtLock);
+
     unsigned long y;
     static unsigned long mag01[2]={0x0UL, MATRIX_A};
     /* mag01[x] = x * MATRIX_A  for x=0,1 */
@@ -105,7 +130,7 @@ unsigned long Generate(void)
         int kk;
 
         if (mti == N+1)   /* if init_genrand() has not been called, */
-            Seed(5489UL); /* a default initial seed is used */
+            SeedUnlocked(5489UL); /* a default initial seed is used */
 
         for (kk=0;kk<N-M;kk++) {
             y = (mt[kk]&UPPER_MASK)|(mt[kk+1]&LOWER_MASK);
@@ -153,5 +178,19 @@ double GenerateFloatHigh(void)
 } 
 /* These real versions are due to Isaku Wada, 2002/01/09 added */
 
+
+wxUint64 Hash(wxUint64 key)
+{
+    key += wxULL(0x9E3779B97F4A7C15);
+    key = (key ^ (key >> 30)) * wxULL(0xBF58476D1CE4E5B9);
+    key = (key ^ (key >> 27)) * wxULL(0x94D049BB133111EB);
+    return key ^ (key >> 31);
+}
+
+double HashToFloat(wxUint64 hash)
+{
+    return (hash >> 11) * (1.0/9007199254740992.0);
+}
+
 };
 
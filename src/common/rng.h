@@ -79,6 +79,32 @@ double GenerateFloat(void);
 */
 double GenerateFloatHigh(void);
 
+
+/**
+    \brief Hash a counter into a random value
+    \ingroup common
+    
+    Unlike the other functions here, this keeps no state: the same key
+    always gives the same value.  Code running on several threads can
+    draw reproducible random numbers by hashing (for example) a seed, a
+    generation, and a cell index, no matter which thread gets to each
+    cell first.  This is the SplitMix64 finalizer.
+    
+    \param key Counter to be hashed
+    \returns A 64-bit random value
+*/
+wxUint64 Hash(wxUint64 key);
+
+
+/**
+    \brief Convert the result of Hash() to a floating-point value
+    \ingroup common
+    
+    \param hash Value returned by Hash()
+    \returns A double in [0, 1) with 53-bit resolution
+*/
+double HashToFloat(wxUint64 hash);
+
 };
 
 #endif
@@ -0,0 +1,166 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#ifdef BUILD_TESTS
+#  include <TestHarness.h>
+#  include "fsaplayer.h"
+#endif
+
+#include "../common/error.h"
+#include "bimatrix.h"
+#include "player.h"
+
+
+BimatrixGame::BimatrixGame() : rowPayoffs(4, 0), columnPayoffs(4, 0)
+{
+	gameMoves = wxT("CD");
+	columnMoves = wxT("CD");
+}
+
+bool BimatrixGame::SetMoves(const wxString &rowMoves, const wxString &newColumnMoves)
+{
+	size_t numMoves = rowMoves.Length();
+	if (!numMoves || newColumnMoves.Length() != numMoves)
+	{
+		Error::Set(_("Both players of a bimatrix game must have the same number of moves"));
+		return false;
+	}
+	
+	for (size_t i = 0 ; i < numMoves ; i++)
+	{
+		// Nobody may have the same move twice, and a move both players
+		// have must be in the same place for each
+		if (rowMoves.Find(rowMoves[i]) != (int)i || newColumnMoves.Find(newColumnMoves[i]) != (int)i)
+		{
+			Error::Set(wxString::Format(_("A player of a bimatrix game has the move %c twice"),
+			                            (wxChar)(rowMoves.Find(rowMoves[i]) != (int)i ? rowMoves[i] : newColumnMoves[i])));
+			return false;
+		}
+		
+		int other = newColumnMoves.Find(rowMoves[i]);
+		if (other != -1 && other != (int)i)
+		{
+			Error::Set(wxString::Format(_("The move %c must be in the same place for both players of a bimatrix game"),
+			                            (wxChar)rowMoves[i]));
+			return false;
+		}
+	}
+	
+	gameMoves = rowMoves;
+	columnMoves = newColumnMoves;
+	rowPayoffs.assign(numMoves * numMoves, 0);
+	columnPayoffs.assign(numMoves * numMoves, 0);
+	Reset();
+	
+	return true;
+}
+
+void BimatrixGame::GetGamePayoff(const Player *playerOne, int &playerOneScore,
+                                 const Player *playerTwo, int &playerTwoScore)
+{
+	// Game::Play() has already checked that these are valid
+	size_t row = gameMoves.Find(playerOne->nextMove);
+	size_t column = columnMoves.Find(playerTwo->nextMove);
+	
+	playerOneScore = GetRowPayoff(row, column);
+	playerTwoScore = GetColumnPayoff(row, column);
+}
+
+/** \cond TEST */
+#ifdef BUILD_TESTS
+
+TEST(BimatrixGame, Moves)
+{
+	BimatrixGame game;
+	
+	CHECK(!game.IsSymmetric());
+	CHECK(!game.SetMoves(wxT("TI"), wxT("HCX")));
+	CHECK(!game.SetMoves(wxT("TT"), wxT("HC")));
+	CHECK(!game.SetMoves(wxT("TI"), wxT("IT")));
+	Error::Get();
+	CHECK_EQUAL(wxT("CD"), game.GetRoleMoves(1));
+	
+	CHECK(game.SetMoves(wxT("TI"), wxT("HC")));
+	CHECK_EQUAL(wxT("TI"), game.GetGameMoves());
+	CHECK_EQUAL(wxT("TI"), game.GetRoleMoves(0));
+	CHECK_EQUAL(wxT("HC"), game.GetRoleMoves(1));
+	CHECK_EQUAL(1, game.FindMove(wxT('I')));
+	CHECK_EQUAL(1, game.FindMove(wxT('C')));
+	CHECK_EQUAL(-1, game.FindMove(wxT('D')));
+	
+	// Sharing a move in the same place is fine
+	CHECK(game.SetMoves(wxT("CD"), wxT("CE")));
+}
+
+TEST(BimatrixGame, Payoffs)
+{
+	BimatrixGame game;
+	MockPlayer buyer, seller;
+	
+	CHECK(game.SetMoves(wxT("TI"), wxT("HC")));
+	game.SetPayoff(0, 0, 3, 3);
+	game.SetPayoff(0, 1, 0, 4);
+	game.SetPayoff(1, 0, 2, 2);
+	game.SetPayoff(1, 1, 1, 0);
+	
+	buyer.nextMove = wxT('T');
+	seller.nextMove = wxT('C');
+	CHECK(game.Play(&buyer, &seller));
+	CHECK_EQUAL(0, buyer.GetScore());
+	CHECK_EQUAL(4, seller.GetScore());
+	
+	buyer.nextMove = wxT('I');
+	CHECK(game.Play(&buyer, &seller));
+	CHECK_EQUAL(1, buyer.GetScore());
+	CHECK_EQUAL(4, seller.GetScore());
+	
+	// Each player may only make the moves of their own role
+	buyer.nextMove = wxT('H');
+	CHECK(!game.Play(&buyer, &seller));
+	buyer.nextMove = wxT('T');
+	seller.nextMove = wxT('T');
+	CHECK(!game.Play(&buyer, &seller));
+	Error::Get();
+	
+	// Machines follow the other role's moves
+	FSAPlayer inspector;
+	CHECK(inspector.LoadFromString(&game, wxT("Charles Pence\nInspector\n2\nT, 0, 1\nI, 0, 1")));
+	seller.nextMove = wxT('H');
+	CHECK(inspector.Think(&game, &seller));
+	CHECK(game.Play(&inspector, &seller));
+	seller.nextMove = wxT('C');
+	CHECK(inspector.Think(&game, &seller));
+	CHECK_EQUAL(wxT('T'), inspector.nextMove);
+	CHECK(game.Play(&inspector, &seller));
+	CHECK(inspector.Think(&game, &seller));
+	CHECK_EQUAL(wxT('I'), inspector.nextMove);
+}
+
+#endif
+/** \endcond */
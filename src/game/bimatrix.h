@@ -0,0 +1,138 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BIMATRIX_H__
+#define BIMATRIX_H__
+
+#include <vector>
+
+#include "game.h"
+#include "player.h"
+
+/**
+    \class BimatrixGame
+    \ingroup game
+    
+    \brief A game between two different roles, each with its own moves
+    
+    Player one (the row player) and player two (the column player) may
+    have entirely different moves, and each has its own payoff matrix.
+    A buyer and seller game, for instance, might look like:
+    \code
+                 Honest  Cheat
+        Trust   [3, 3]  [0, 4]
+        Inspect [2, 2]  [1, 0]
+    \endcode
+    where the first number is the buyer's payoff and the second the
+    seller's.  Both roles must have the same number of moves, and a move
+    that both of them have must be in the same place in both (see
+    \c Game::columnMoves).
+    
+    Finite state machines for either role are loaded against this game
+    as usual, with their transitions following the other role's moves.
+    The built-in players assume a symmetric game, so
+    \c TwoPopulationTournament won't accept them.
+    
+    \see TwoPopulationTournament
+*/
+class BimatrixGame : public Game
+{
+public:
+	/**
+	    \brief Constructor
+	    
+	    Both roles start out with the moves C and D, and every payoff
+	    zero.
+	*/
+	BimatrixGame();
+	virtual ~BimatrixGame() { }
+	
+	virtual Game *Clone() const
+	{ return new BimatrixGame(*this); }
+	
+	/**
+	    \brief Set the moves of the two roles
+	    
+	    This resets every payoff to zero.
+	    
+	    \param rowMoves Moves of player one
+	    \param newColumnMoves Moves of player two
+	    \returns True if the moves were set, false if they can't be told
+	             apart (in which case the game is unchanged)
+	*/
+	bool SetMoves(const wxString &rowMoves, const wxString &newColumnMoves);
+	
+	/**
+	    \brief Set the payoffs for one pair of moves
+	    
+	    \param rowMove Index of player one's move
+	    \param columnMove Index of player two's move
+	    \param rowPayoff Payoff to player one
+	    \param columnPayoff Payoff to player two
+	*/
+	void SetPayoff(size_t rowMove, size_t columnMove, int rowPayoff, int columnPayoff)
+	{
+		rowPayoffs[rowMove * gameMoves.Length() + columnMove] = rowPayoff;
+		columnPayoffs[rowMove * gameMoves.Length() + columnMove] = columnPayoff;
+	}
+	
+	/**
+	    \brief Get the payoff to player one for a pair of moves
+	    
+	    \param rowMove Index of player one's move
+	    \param columnMove Index of player two's move
+	    \returns Payoff to player one
+	*/
+	int GetRowPayoff(size_t rowMove, size_t columnMove) const
+	{ return rowPayoffs[rowMove * gameMoves.Length() + columnMove]; }
+	
+	/**
+	    \brief Get the payoff to player two for a pair of moves
+	    
+	    \param rowMove Index of player one's move
+	    \param columnMove Index of player two's move
+	    \returns Payoff to player two
+	*/
+	int GetColumnPayoff(size_t rowMove, size_t columnMove) const
+	{ return columnPayoffs[rowMove * gameMoves.Length() + columnMove]; }
+
+protected:
+	virtual void GetGamePayoff(const Player *playerOne, int &playerOneScore,
+	                           const Player *playerTwo, int &playerTwoScore);
+	
+private:
+	/**
+	    \brief Payoffs to player one, by row (player one's move) and
+	           column (player two's move)
+	*/
+	std::vector<int> rowPayoffs;
+	
+	/**
+	    \brief Payoffs to player two, laid out like \c rowPayoffs
+	*/
+	std::vector<int> columnPayoffs;
+};
+
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
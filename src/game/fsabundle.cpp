@@ -0,0 +1,406 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#include <wx/file.h>
+#include <wx/sharedptr.h>
+
+#include <string.h>
+#include <vector>
+
+#ifdef BUILD_TESTS
+#  include <TestHarness.h>
+#  include <wx/filename.h>
+#endif
+
+#include "../common/error.h"
+#include "../common/mappedfile.h"
+#include "fsabundle.h"
+#include "fsaplayer.h"
+#include "game.h"
+
+
+namespace FSABundle
+{
+
+/**
+    \brief The bundle file header, at offset zero
+*/
+struct BundleHeader
+{
+	char magic[8];
+	wxUint32 version;
+	wxUint32 byteOrder;
+	wxUint32 numPlayers;
+	wxUint32 gameMoves[2];
+	wxUint32 reserved;
+	wxUint64 indexOffset;
+	wxUint64 stringsOffset;
+	wxUint64 stringsSize;
+	wxUint64 tablesOffset;
+	wxUint64 tablesSize;
+};
+
+/**
+    \brief One index entry in a bundle file
+    
+    String offsets are relative to the start of the string pool, and
+    table offsets to the start of the table area.
+*/
+struct BundleEntry
+{
+	wxUint64 hash;
+	wxUint64 tableOffset;
+	wxUint32 numStates;
+	wxUint32 authorOffset;
+	wxUint32 authorLength;
+	wxUint32 nameOffset;
+	wxUint32 nameLength;
+	wxUint32 reserved;
+};
+
+static const char bundleMagic[8] = { 'O', 'Y', 'U', 'N', 'F', 'S', 'A', 'B' };
+static const wxUint32 bundleVersion = 1;
+static const wxUint32 bundleByteOrder = 0x01020304;
+
+
+static wxUint32 AddString(std::vector<char> &pool, const wxString &str, wxUint32 &length)
+{
+	const wxCharBuffer utf8 = str.utf8_str();
+	const char *data = utf8;
+	
+	wxUint32 offset = pool.size();
+	length = strlen(data);
+	pool.insert(pool.end(), data, data + length);
+	
+	return offset;
+}
+
+static wxUint64 Align8(wxUint64 offset)
+{
+	return (offset + 7) & ~(wxUint64)7;
+}
+
+bool Write(const wxString &fileName, const Game *game, const PlayerPtrArray &players)
+{
+	const wxString &moves = game->GetGameMoves();
+	if (moves.Length() != 2)
+	{
+		Error::Set(_("Player bundles can only be written for two-move games"));
+		return false;
+	}
+	
+	std::vector<BundleEntry> index(players.GetCount());
+	std::vector<char> strings;
+	wxUint64 tablesSize = 0;
+	
+	for (size_t i = 0 ; i < players.GetCount() ; i++)
+	{
+		const FSAPlayer *player = dynamic_cast<const FSAPlayer *>(players[i]);
+		if (!player)
+		{
+			Error::Set(wxString::Format(_("Player %s is not a finite state automaton and cannot be bundled"),
+			                            players[i]->GetPlayerName().c_str()));
+			return false;
+		}
+		
+		BundleEntry &entry = index[i];
+		memset(&entry, 0, sizeof(BundleEntry));
+		
+		entry.hash = player->GetCanonicalHash();
+		entry.tableOffset = tablesSize;
+		entry.numStates = player->GetNumLines();
+		entry.authorOffset = AddString(strings, player->GetPlayerAuthor(), entry.authorLength);
+		entry.nameOffset = AddString(strings, player->GetPlayerName(), entry.nameLength);
+		
+		tablesSize += (wxUint64)entry.numStates * sizeof(FSAState);
+	}
+	
+	BundleHeader header;
+	memset(&header, 0, sizeof(BundleHeader));
+	memcpy(header.magic, bundleMagic, sizeof(bundleMagic));
+	header.version = bundleVersion;
+	header.byteOrder = bundleByteOrder;
+	header.numPlayers = players.GetCount();
+	header.gameMoves[0] = moves[0];
+	header.gameMoves[1] = moves[1];
+	header.indexOffset = sizeof(BundleHeader);
+	header.stringsOffset = header.indexOffset + index.size() * sizeof(BundleEntry);
+	header.stringsSize = strings.size();
+	header.tablesOffset = Align8(header.stringsOffset + header.stringsSize);
+	header.tablesSize = tablesSize;
+	
+	wxFile file;
+	if (!file.Create(fileName, true))
+	{
+		Error::Set(wxString::Format(_("Could not create file %s"), fileName.c_str()));
+		return false;
+	}
+	
+	bool ok = (file.Write(&header, sizeof(BundleHeader)) == sizeof(BundleHeader));
+	if (ok && index.size())
+		ok = (file.Write(&index[0], index.size() * sizeof(BundleEntry)) == index.size() * sizeof(BundleEntry));
+	if (ok && strings.size())
+		ok = (file.Write(&strings[0], strings.size()) == strings.size());
+	
+	// Pad up to the start of the tables
+	static const char padding[8] = { 0 };
+	size_t padSize = header.tablesOffset - (header.stringsOffset + header.stringsSize);
+	if (ok && padSize)
+		ok = (file.Write(padding, padSize) == padSize);
+	
+	for (size_t i = 0 ; ok && i < players.GetCount() ; i++)
+	{
+		const FSAPlayer *player = static_cast<const FSAPlayer *>(players[i]);
+		size_t tableBytes = player->GetNumLines() * sizeof(FSAState);
+		
+		if (tableBytes)
+			ok = (file.Write(player->GetStates(), tableBytes) == tableBytes);
+	}
+	
+	file.Close();
+	
+	if (!ok)
+	{
+		Error::Set(wxString::Format(_("Could not write to file %s"), fileName.c_str()));
+		wxRemoveFile(fileName);
+		return false;
+	}
+	
+	return true;
+}
+
+static bool CheckRange(wxUint64 offset, wxUint64 length, wxUint64 size)
+{
+	return offset <= size && length <= size - offset;
+}
+
+bool Load(const wxString &fileName, const Game *game, PlayerPtrArray &players)
+{
+	wxSharedPtr<MappedFile> mapping(new MappedFile);
+	if (!mapping->Open(fileName))
+		return false;
+	
+	const wxUint8 *data = mapping->GetData();
+	wxUint64 size = mapping->GetSize();
+	
+	// Validate the header and the locations of each of the sections
+	if (size < sizeof(BundleHeader) || memcmp(data, bundleMagic, sizeof(bundleMagic)))
+	{
+		Error::Set(wxString::Format(_("File %s is not an Oyun player bundle"), fileName.c_str()));
+		return false;
+	}
+	
+	const BundleHeader *header = (const BundleHeader *)data;
+	if (header->version != bundleVersion)
+	{
+		Error::Set(wxString::Format(_("Player bundle %s has an unsupported version (%d)"), 
+		                            fileName.c_str(), header->version));
+		return false;
+	}
+	if (header->byteOrder != bundleByteOrder)
+	{
+		Error::Set(wxString::Format(_("Player bundle %s was created on a machine with a different byte order"), 
+		                            fileName.c_str()));
+		return false;
+	}
+	
+	const wxString &moves = game->GetGameMoves();
+	if (moves.Length() != 2 || 
+	    header->gameMoves[0] != (wxUint32)moves[0] || header->gameMoves[1] != (wxUint32)moves[1])
+	{
+		Error::Set(wxString::Format(_("Player bundle %s was not created for this game"), fileName.c_str()));
+		return false;
+	}
+	
+	if (!CheckRange(header->indexOffset, (wxUint64)header->numPlayers * sizeof(BundleEntry), size) ||
+	    !CheckRange(header->stringsOffset, header->stringsSize, size) ||
+	    !CheckRange(header->tablesOffset, header->tablesSize, size) ||
+	    header->indexOffset % 8 != 0 || header->tablesOffset % 8 != 0)
+	{
+		Error::Set(wxString::Format(_("Player bundle %s is truncated or corrupt"), fileName.c_str()));
+		return false;
+	}
+	
+	const BundleEntry *index = (const BundleEntry *)(data + header->indexOffset);
+	const char *strings = (const char *)(data + header->stringsOffset);
+	const wxUint8 *tables = data + header->tablesOffset;
+	
+	// Validate every entry before creating any players
+	for (wxUint32 i = 0 ; i < header->numPlayers ; i++)
+	{
+		const BundleEntry &entry = index[i];
+		
+		if (!entry.numStates ||
+		    entry.tableOffset % sizeof(wxUint32) != 0 ||
+		    !CheckRange(entry.tableOffset, (wxUint64)entry.numStates * sizeof(FSAState), header->tablesSize) ||
+		    !CheckRange(entry.authorOffset, entry.authorLength, header->stringsSize) ||
+		    !CheckRange(entry.nameOffset, entry.nameLength, header->stringsSize))
+		{
+			Error::Set(wxString::Format(_("Player bundle %s, player %d: index entry is corrupt"), 
+			                            fileName.c_str(), i));
+			return false;
+		}
+		
+		const FSAState *table = (const FSAState *)(tables + entry.tableOffset);
+		for (wxUint32 j = 0 ; j < entry.numStates ; j++)
+		{
+			if ((table[j].action != header->gameMoves[0] && table[j].action != header->gameMoves[1]) ||
+			    table[j].transitions[0] >= entry.numStates ||
+			    table[j].transitions[1] >= entry.numStates)
+			{
+				Error::Set(wxString::Format(_("Player bundle %s, player %d, state %d: state is invalid"), 
+				                            fileName.c_str(), i, j));
+				return false;
+			}
+		}
+	}
+	
+	players.Alloc(players.GetCount() + header->numPlayers);
+	
+	for (wxUint32 i = 0 ; i < header->numPlayers ; i++)
+	{
+		const BundleEntry &entry = index[i];
+		FSAPlayer *player = new FSAPlayer;
+		
+		player->LoadFromMapping(mapping, (const FSAState *)(tables + entry.tableOffset), entry.numStates,
+		                        wxString::FromUTF8(strings + entry.authorOffset, entry.authorLength),
+		                        wxString::FromUTF8(strings + entry.nameOffset, entry.nameLength),
+		                        entry.hash);
+		players.Add(player);
+	}
+	
+	return true;
+}
+
+bool IsBundleFileName(const wxString &fileName)
+{
+	return fileName.Lower().EndsWith(wxT(".oyb"));
+}
+
+};
+
+
+/** \cond TEST */
+#ifdef BUILD_TESTS
+
+static const wxString test_bundle_tft("Charles Pence\nTit-for-Tat\n2\nC, 0, 1\nD, 0, 1");
+static const wxString test_bundle_alld("Charles Pence\nAll-D\n1\nD, 0, 0");
+
+TEST(FSABundle, RoundTrip)
+{
+	MockGame game;
+	FSAPlayer tft, alld;
+	
+	CHECK(tft.LoadFromString(&game, test_bundle_tft));
+	CHECK(alld.LoadFromString(&game, test_bundle_alld));
+	
+	PlayerPtrArray original;
+	original.Add(&tft);
+	original.Add(&alld);
+	
+	wxString tempName = wxFileName::CreateTempFileName(wxT("oyun"));
+	CHECK(FSABundle::Write(tempName, &game, original));
+	
+	PlayerPtrArray loaded;
+	CHECK(FSABundle::Load(tempName, &game, loaded));
+	CHECK_EQUAL(2, (int)loaded.GetCount());
+	
+	FSAPlayer *loadedTFT = dynamic_cast<FSAPlayer *>(loaded[0]);
+	CHECK(loadedTFT != NULL);
+	CHECK(loadedTFT->GetPlayerName() == tft.GetPlayerName());
+	CHECK(loadedTFT->GetPlayerAuthor() == tft.GetPlayerAuthor());
+	CHECK_EQUAL(2, loadedTFT->GetNumLines());
+	CHECK(loadedTFT->GetCanonicalHash() == tft.GetCanonicalHash());
+	CHECK(loadedTFT->GetSource() == wxT("C, 0, 1\nD, 0, 1\n"));
+	
+	// Clones must keep the mapping alive after the originals are gone
+	Player *clone = loadedTFT->Clone();
+	for (size_t i = 0 ; i < loaded.GetCount() ; i++)
+		delete loaded[i];
+	
+	MockPlayer opp;
+	opp.nextMove = wxT('D');
+	CHECK(clone->Think(&game, &opp));
+	CHECK_EQUAL(wxT('C'), clone->nextMove);
+	CHECK(game.Play(clone, &opp));
+	CHECK(clone->Think(&game, &opp));
+	CHECK_EQUAL(wxT('D'), clone->nextMove);
+	delete clone;
+	
+	wxRemoveFile(tempName);
+}
+
+TEST(FSABundle, BadData)
+{
+	MockGame game;
+	PlayerPtrArray players;
+	
+	// Not a bundle at all
+	wxString tempName = wxFileName::CreateTempFileName(wxT("oyun"));
+	wxFile file(tempName, wxFile::write);
+	file.Write("not a bundle, not at all", 24);
+	file.Close();
+	
+	CHECK(!FSABundle::Load(tempName, &game, players));
+	Error::Get();
+	CHECK_EQUAL(0, (int)players.GetCount());
+	
+	// Only FSA players can be bundled
+	MockPlayer mock;
+	players.Add(&mock);
+	CHECK(!FSABundle::Write(tempName, &game, players));
+	Error::Get();
+	players.Clear();
+	
+	// A truncated bundle
+	FSAPlayer tft;
+	CHECK(tft.LoadFromString(&game, test_bundle_tft));
+	players.Add(&tft);
+	CHECK(FSABundle::Write(tempName, &game, players));
+	players.Clear();
+	
+	wxFile truncated(tempName, wxFile::read_write);
+	CHECK(truncated.IsOpened());
+	char buf[64];
+	CHECK(truncated.Read(buf, sizeof(buf)) == sizeof(buf));
+	truncated.Close();
+	
+	wxFile rewritten(tempName, wxFile::write);
+	rewritten.Write(buf, sizeof(buf));
+	rewritten.Close();
+	
+	CHECK(!FSABundle::Load(tempName, &game, players));
+	Error::Get();
+	CHECK_EQUAL(0, (int)players.GetCount());
+	
+	wxRemoveFile(tempName);
+}
+
+#endif
+/** \endcond */
@@ -0,0 +1,95 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FSABUNDLE_H__
+#define FSABUNDLE_H__
+
+#include "player.h"
+
+class Game;
+
+
+/**
+    \namespace FSABundle
+    \ingroup game
+    \brief Reading and writing of binary FSA player bundles (\c .oyb files)
+    
+    A bundle holds many compiled finite state machines in a single file,
+    so that very large rosters can be opened without parsing any text.
+    When a bundle is loaded, it is memory-mapped and the players execute
+    their state tables directly out of the mapping.
+    
+    A bundle consists of a fixed header, an index with one entry per
+    player, a pool of UTF-8 strings (player names and authors), and the
+    state tables themselves, each an array of \c FSAState records.  Every
+    entry in the index also records the canonical hash of its machine
+    (see \c FSAPlayer::CanonicalHash).  Bundles are written in the byte
+    order of the machine that creates them, and are rejected if opened on
+    a machine with a different byte order.
+    
+    Bundles are created with the \c fsa2oyb tool, or with Write().
+*/
+namespace FSABundle
+{
+
+/**
+    \brief Write a list of FSA players to a bundle file
+    
+    \param fileName The bundle file to create (overwritten if it exists)
+    \param game The game for which the players were loaded
+    \param players The players to save.  Every player must be an
+                   \c FSAPlayer.
+    \returns True if the bundle was written, false otherwise
+*/
+bool Write(const wxString &fileName, const Game *game, const PlayerPtrArray &players);
+
+/**
+    \brief Load all of the players in a bundle file
+    
+    The file is memory-mapped and validated, and one \c FSAPlayer is
+    created for every machine in the bundle.  The mapping is released
+    once the last of these players (or their clones) is deleted.
+    
+    \param fileName The bundle file to open
+    \param game The game against which to check the player moves
+    \param players Array to which the new players will be appended.  The
+                   caller takes ownership of the players.
+    \returns True if the bundle was loaded, false otherwise (in which case
+             no players will have been added)
+*/
+bool Load(const wxString &fileName, const Game *game, PlayerPtrArray &players);
+
+/**
+    \brief Check whether a file appears to be a player bundle
+    
+    Only the file extension is examined.
+    
+    \param fileName The file name to check
+    \returns True if \p fileName names a bundle, false otherwise
+*/
+bool IsBundleFileName(const wxString &fileName);
+
+};
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
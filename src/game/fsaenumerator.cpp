@@ -0,0 +1,282 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#include <wx/hashmap.h>
+
+#include <math.h>
+
+#ifdef BUILD_TESTS
+#  include <TestHarness.h>
+#  include "prisoner.h"
+#endif
+
+#include "../common/error.h"
+#include "../common/parallel.h"
+#include "../common/progress.h"
+#include "../common/rng.h"
+#include "fsaenumerator.h"
+#include "game.h"
+
+
+// Fill in a state table from its number, with each state a digit in
+// base 2 k^2 (the first state the lowest).  Sampled tables get a random
+// digit for each state instead.
+static void MakeTable(unsigned int numStates, wxUint64 number, bool random,
+                      const wxUint32 *moves, FSAState *table)
+{
+	wxUint64 base = 2 * numStates * numStates;
+	
+	for (unsigned int i = 0 ; i < numStates ; i++)
+	{
+		wxUint64 digit;
+		if (random)
+			digit = Random::Hash(number + i) % base;
+		else
+		{
+			digit = number % base;
+			number /= base;
+		}
+		
+		table[i].action = moves[digit % 2];
+		table[i].transitions[0] = (digit / 2) % numStates;
+		table[i].transitions[1] = (digit / 2) / numStates;
+	}
+}
+
+// The starting number of a sampled table
+static wxUint64 SampleKey(wxUint64 seed, unsigned int numStates, size_t sample)
+{
+	return Random::Hash(seed ^ Random::Hash(((wxUint64)numStates << 48) + sample));
+}
+
+
+/**
+    \brief Computes the canonical hash of every table of one size
+    
+    Each table depends only on its index, so the tables may be hashed
+    on any threads.
+*/
+class EnumerateTask : public ParallelTask
+{
+public:
+	EnumerateTask(unsigned int n, bool s, wxUint64 sd, const wxUint32 *m,
+	              std::vector<wxUint64> &h, Progress *p) :
+		numStates(n), sampled(s), seed(sd), moves(m), hashes(h), progress(p)
+	{ }
+	
+	virtual bool Run(size_t begin, size_t end)
+	{
+		if (progress && progress->IsCancelled())
+		{
+			Error::Set(_("The enumeration of the machines was cancelled"));
+			return false;
+		}
+		
+		std::vector<FSAState> table(numStates);
+		for (size_t i = begin ; i < end ; i++)
+		{
+			MakeTable(numStates, sampled ? SampleKey(seed, numStates, i) : i, sampled, moves, &table[0]);
+			hashes[i] = FSAPlayer::CanonicalHash(&table[0], numStates);
+		}
+		
+		if (progress)
+			progress->Advance(end - begin);
+		return true;
+	}
+	
+private:
+	unsigned int numStates;
+	bool sampled;
+	wxUint64 seed;
+	const wxUint32 *moves;
+	std::vector<wxUint64> &hashes;
+	Progress *progress;
+};
+
+
+double FSAEnumerator::CountTables(unsigned int numStates)
+{
+	return pow(2.0 * numStates * numStates, (double)numStates);
+}
+
+bool FSAEnumerator::Enumerate(const Game *game, PlayerPtrArray &players, Progress *progress)
+{
+	if (maxStates < 1 || maxStates > maxMaxStates)
+	{
+		Error::Set(wxString::Format(_("Machines may only be enumerated with 1 to %d states"), (int)maxMaxStates));
+		return false;
+	}
+	
+	const wxString &gameMoves = game->GetGameMoves();
+	if (gameMoves.Length() != 2)
+	{
+		Error::Set(_("Machines may only be enumerated for games with two moves"));
+		return false;
+	}
+	wxUint32 moves[2] = { (wxUint32)gameMoves[0], (wxUint32)gameMoves[1] };
+	
+	// Work out which sizes are sampled, and how much there is to do
+	uniqueCounts.assign(maxStates, 0);
+	sampled.assign(maxStates, false);
+	numExamined = 0;
+	
+	std::vector<size_t> numTables(maxStates);
+	for (unsigned int k = 1 ; k <= maxStates ; k++)
+	{
+		double count = CountTables(k);
+		sampled[k - 1] = (count > numSamples);
+		numTables[k - 1] = sampled[k - 1] ? numSamples : (size_t)count;
+		numExamined += numTables[k - 1];
+	}
+	
+	if (progress)
+		progress->Start(numExamined);
+	
+	WX_DECLARE_HASH_MAP(wxUint64, size_t, wxIntegerHash, wxIntegerEqual, HashSet);
+	HashSet seen;
+	PlayerPtrArray found;
+	std::vector<wxUint64> hashes;
+	
+	for (unsigned int k = 1 ; k <= maxStates ; k++)
+	{
+		hashes.resize(numTables[k - 1]);
+		EnumerateTask task(k, sampled[k - 1], seed, moves, hashes, progress);
+		if (!Parallel::For(hashes.size(), &task))
+		{
+			for (size_t i = 0 ; i < found.GetCount() ; i++)
+				delete found[i];
+			return false;
+		}
+		
+		// Keep the first table of each canonical form, in order
+		std::vector<FSAState> table(k);
+		for (size_t i = 0 ; i < hashes.size() ; i++)
+		{
+			if (seen.find(hashes[i]) != seen.end())
+				continue;
+			seen[hashes[i]] = found.GetCount();
+			
+			MakeTable(k, sampled[k - 1] ? SampleKey(seed, k, i) : i, sampled[k - 1], moves, &table[0]);
+			
+			wxString name;
+			for (unsigned int s = 0 ; s < k ; s++)
+			{
+				if (s)
+					name += wxT(' ');
+				name += wxString::Format(wxT("%c%u%u"), (wxChar)table[s].action,
+				                         table[s].transitions[0], table[s].transitions[1]);
+			}
+			
+			FSAPlayer *player = new FSAPlayer;
+			player->LoadFromTable(&table[0], k, _("Enumerated"), name);
+			found.Add(player);
+			uniqueCounts[k - 1]++;
+		}
+	}
+	
+	players.Alloc(players.GetCount() + found.GetCount());
+	for (size_t i = 0 ; i < found.GetCount() ; i++)
+		players.Add(found[i]);
+	
+	return true;
+}
+
+
+/** \cond TEST */
+#ifdef BUILD_TESTS
+
+TEST(FSAEnumerator, Counts)
+{
+	PrisonerDilemma game;
+	FSAEnumerator enumerator;
+	PlayerPtrArray players;
+	
+	CHECK_EQUAL(2.0, FSAEnumerator::CountTables(1));
+	CHECK_EQUAL(64.0, FSAEnumerator::CountTables(2));
+	CHECK_EQUAL(5832.0, FSAEnumerator::CountTables(3));
+	
+	enumerator.SetMaxStates(0);
+	CHECK(!enumerator.Enumerate(&game, players));
+	Error::Get();
+	
+	// Every machine of up to three states
+	enumerator.SetMaxStates(3);
+	CHECK(enumerator.Enumerate(&game, players));
+	CHECK_EQUAL(5898, (int)enumerator.GetNumExamined());
+	CHECK(!enumerator.IsSampled(3));
+	CHECK_EQUAL(2, (int)enumerator.GetNumUnique(1));
+	CHECK(players[0]->GetPlayerName() == wxT("C00"));
+	CHECK(players[1]->GetPlayerName() == wxT("D00"));
+	
+	// All distinct, and with all of their states
+	size_t total = 0;
+	WX_DECLARE_HASH_MAP(wxUint64, size_t, wxIntegerHash, wxIntegerEqual, HashSet);
+	HashSet hashes;
+	for (unsigned int k = 1 ; k <= 3 ; k++)
+		total += enumerator.GetNumUnique(k);
+	CHECK_EQUAL(total, players.GetCount());
+	
+	bool tft = false;
+	for (size_t i = 0 ; i < players.GetCount() ; i++)
+	{
+		const FSAPlayer *machine = static_cast<const FSAPlayer *>(players[i]);
+		hashes[machine->GetCanonicalHash()] = i;
+		tft = tft || (machine->GetPlayerName() == wxT("C01 D01"));
+		CHECK(i < 2 || machine->GetNumLines() > 1);
+		delete players[i];
+	}
+	CHECK_EQUAL(total, hashes.size());
+	CHECK(tft);
+	players.Clear();
+	
+	// Four states are sampled, the same way every time
+	enumerator.SetMaxStates(4);
+	enumerator.SetNumSamples(10000);
+	enumerator.SetSeed(42);
+	CHECK(enumerator.Enumerate(&game, players));
+	CHECK(enumerator.IsSampled(4));
+	CHECK(!enumerator.IsSampled(3));
+	CHECK_EQUAL(5898 + 10000, (int)enumerator.GetNumExamined());
+	CHECK_EQUAL(total, players.GetCount() - enumerator.GetNumUnique(4));
+	CHECK(enumerator.GetNumUnique(4) > 0);
+	
+	PlayerPtrArray again;
+	CHECK(enumerator.Enumerate(&game, again));
+	CHECK_EQUAL(players.GetCount(), again.GetCount());
+	CHECK(players.Last()->GetPlayerName() == again.Last()->GetPlayerName());
+	
+	for (size_t i = 0 ; i < players.GetCount() ; i++)
+	{
+		delete players[i];
+		delete again[i];
+	}
+}
+
+#endif
+/** \endcond */
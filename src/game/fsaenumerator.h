@@ -0,0 +1,196 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FSAENUMERATOR_H__
+#define FSAENUMERATOR_H__
+
+#include <vector>
+
+#include "fsaplayer.h"
+#include "player.h"
+class Game;
+class Progress;
+
+
+/**
+    \class FSAEnumerator
+    \ingroup game
+    
+    \brief Generates every distinct finite state machine with up to a
+           given number of states
+    
+    There are <tt>(2 k<sup>2</sup>)<sup>k</sup></tt> state tables with
+    \c k states (each state has one of two moves and two transitions),
+    but most of them play exactly like others: they differ only in the
+    numbering of their states, have states which can never be reached,
+    or have states which could be merged.  The enumerator generates the
+    tables for one, two, and so on up to GetMaxStates() states, and
+    keeps only the first machine of each canonical form (see
+    \c FSAPlayer::CanonicalHash), so that no two of the machines it
+    returns play alike.  Since every smaller size has already been
+    generated, a machine kept for \c k states needs all \c k of them
+    (unless the smaller sizes were sampled).
+    
+    Sizes with more tables than GetNumSamples() are sampled instead:
+    that many tables are drawn at random (depending only on the seed)
+    and the distinct ones kept.
+    
+    The machines are named after their state tables, each state
+    written as its move and its two transitions, so that tit-for-tat
+    is "C01 D01".
+*/
+class FSAEnumerator
+{
+public:
+	/**
+	    \brief Constructor
+	*/
+	FSAEnumerator() : maxStates(3), numSamples(100000), seed(0), numExamined(0) { }
+	
+	/**
+	    \brief Generate the machines
+	    
+	    \param game The game, whose two moves the machines make
+	    \param[out] players Receives the new machines, which the caller
+	                        must delete, in order of size
+	    \param progress If not \c NULL, counts the tables examined and
+	                    may be used to cancel the enumeration
+	    \returns True if successful, false otherwise (in which case no
+	             players are added)
+	*/
+	bool Enumerate(const Game *game, PlayerPtrArray &players, Progress *progress = NULL);
+	
+	
+	/**
+	    \brief Set the largest number of states
+	    \param newMaxStates Number of states, from 1 to \c maxMaxStates
+	*/
+	void SetMaxStates(unsigned int newMaxStates) { maxStates = newMaxStates; }
+	
+	/**
+	    \brief Get the largest number of states
+	    \returns Number of states
+	*/
+	unsigned int GetMaxStates() const { return maxStates; }
+	
+	/**
+	    \brief Set the number of tables drawn for sizes which are
+	           sampled
+	    
+	    Sizes with no more tables than this are generated in full.
+	    
+	    \param newNumSamples Number of tables to draw
+	*/
+	void SetNumSamples(size_t newNumSamples) { numSamples = newNumSamples; }
+	
+	/**
+	    \brief Get the number of tables drawn for sizes which are
+	           sampled
+	    \returns Number of tables
+	*/
+	size_t GetNumSamples() const { return numSamples; }
+	
+	/**
+	    \brief Set the seed for sampling
+	    \param newSeed The seed
+	*/
+	void SetSeed(wxUint64 newSeed) { seed = newSeed; }
+	
+	/**
+	    \brief Get the seed for sampling
+	    \returns The seed
+	*/
+	wxUint64 GetSeed() const { return seed; }
+	
+	
+	/**
+	    \brief Get the number of tables examined by the last enumeration
+	    \returns Number of tables
+	*/
+	size_t GetNumExamined() const { return numExamined; }
+	
+	/**
+	    \brief Get the number of distinct machines found of one size
+	    
+	    \param numStates Number of states, up to GetMaxStates()
+	    \returns Number of machines kept from the tables of that size
+	*/
+	size_t GetNumUnique(unsigned int numStates) const { return uniqueCounts[numStates - 1]; }
+	
+	/**
+	    \brief Was one size sampled, rather than generated in full?
+	    
+	    \param numStates Number of states, up to GetMaxStates()
+	    \returns True if the size was sampled
+	*/
+	bool IsSampled(unsigned int numStates) const { return sampled[numStates - 1]; }
+	
+	/**
+	    \brief Count the state tables of a given size
+	    
+	    \param numStates Number of states
+	    \returns <tt>(2 k<sup>2</sup>)<sup>k</sup></tt>, which may be
+	             too large for an integer
+	*/
+	static double CountTables(unsigned int numStates);
+	
+	/**
+	    \brief Largest number of states which may be asked for
+	*/
+	static const unsigned int maxMaxStates = 10;
+
+private:
+	/**
+	    \brief The largest number of states
+	*/
+	unsigned int maxStates;
+	
+	/**
+	    \brief The number of tables drawn for sampled sizes
+	*/
+	size_t numSamples;
+	
+	/**
+	    \brief The seed for sampling
+	*/
+	wxUint64 seed;
+	
+	/**
+	    \brief The number of tables examined by the last enumeration
+	*/
+	size_t numExamined;
+	
+	/**
+	    \brief The number of machines kept for each size
+	*/
+	std::vector<size_t> uniqueCounts;
+	
+	/**
+	    \brief Whether each size was sampled
+	*/
+	std::vector<bool> sampled;
+};
+
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
@@ -30,6 +30,8 @@
 #include <wx/textfile.h>
 #include <wx/tokenzr.h>
 
+#include <vector>
+
 #ifdef BUILD_TESTS
 #  include <TestHarness.h>
 #endif
@@ -38,9 +40,6 @@
 #include "fsaplayer.h"
 #include "game.h"
 
-#include <wx/arrimpl.cpp>
-WX_DEFINE_OBJARRAY(FSAStateArray);
-
 
 bool FSAPlayer::Load(const Game *game, const wxString &fileName)
 {
@@ -76,8 +75,45 @@ bool FSAPlayer::LoadFromString(const Game *game, const wxString &fsaScript)
 }
 
 
+void FSAPlayer::LoadFromTable(const FSAState *table, unsigned int tableSize,
+                              const wxString &author, const wxString &name)
+{
+	playerAuthor = author;
+	playerName = name;
+	playerSource.Clear();
+	
+	mapping.reset();
+	states.assign(table, table + tableSize);
+	machine = tableSize ? &states[0] : NULL;
+	numStates = tableSize;
+	canonicalHash = CanonicalHash(machine, numStates);
+}
+
+void FSAPlayer::LoadFromMapping(const wxSharedPtr<MappedFile> &file, 
+                                const FSAState *table, unsigned int tableSize,
+                                const wxString &author, const wxString &name,
+                                wxUint64 hash)
+{
+	playerAuthor = author;
+	playerName = name;
+	playerSource.Clear();
+	
+	states.clear();
+	mapping = file;
+	machine = table;
+	numStates = tableSize;
+	canonicalHash = hash;
+}
+
 bool FSAPlayer::DoLoad (const Game *game, const wxArrayString &fsaScript)
 {
+	// Throw away any machine we had before
+	states.clear();
+	mapping.reset();
+	machine = NULL;
+	numStates = 0;
+	playerSource.Clear();
+	
 	// We must have at least four lines, or something's wrong
 	if (fsaScript.Count() < 4)
 	{
@@ -147,31 +183,184 @@ bool FSAPlayer::DoLoad (const Game *game, const wxArrayString &fsaScript)
 			return false;
 		}
 		
-		if (transitions[0] >= numActions)
+		if (transitions[0] < 0 || transitions[0] >= numActions)
 		{
 			Error::Set(wxString::Format(_("FSM script, action %i: first transition is out of bounds"), i));
 			return false;
 		}
-		if (transitions[1] >= numActions)
+		if (transitions[1] < 0 || transitions[1] >= numActions)
 		{
 			Error::Set(wxString::Format(_("FSM script, action %i: second transition is out of bounds"), i));
 			return false;
 		}
 
 		// Check the validity of the move
-		int moveidx = game->GetGameMoves().Find(action);
+		int moveidx = game->FindMove(action);
 		if (moveidx == -1)
 		{
 			Error::Set(wxString::Format(_("FSM script, action %i: requested move is not valid for this game"), i));
 			return false;
 		}
 
-		machine.Add(FSAState(action, transitions));
+		FSAState state;
+		state.action = action;
+		state.transitions[0] = transitions[0];
+		state.transitions[1] = transitions[1];
+		states.push_back(state);
 	}
 	
+	if (states.size())
+		machine = &states[0];
+	numStates = states.size();
+	canonicalHash = CanonicalHash(machine, numStates);
+	
 	return true;
 }
 
+const wxString &FSAPlayer::GetSource()
+{
+	// Bundled players don't carry their source, so rebuild it on demand
+	if (playerSource.IsEmpty())
+	{
+		for (unsigned int i = 0 ; i < numStates ; i++)
+			playerSource += wxString::Format(wxT("%c, %u, %u\n"), (wxChar)machine[i].action,
+			                                 machine[i].transitions[0], machine[i].transitions[1]);
+	}
+	
+	return playerSource;
+}
+
+wxString FSAPlayer::GetScript() const
+{
+	wxString ret;
+	
+	ret << playerAuthor << wxT("\n") << playerName << wxT("\n") << numStates << wxT("\n");
+	for (unsigned int i = 0 ; i < numStates ; i++)
+		ret += wxString::Format(wxT("%c, %u, %u\n"), (wxChar)machine[i].action,
+		                        machine[i].transitions[0], machine[i].transitions[1]);
+	
+	return ret;
+}
+
+wxUint64 FSAPlayer::CanonicalHash(const FSAState *table, unsigned int tableSize)
+{
+	if (!tableSize)
+		return 0;
+	
+	// Find the states reachable from state 0, in breadth-first order
+	std::vector<int> reachIndex(tableSize, -1);
+	std::vector<unsigned int> reached;
+	
+	reachIndex[0] = 0;
+	reached.push_back(0);
+	for (size_t i = 0 ; i < reached.size() ; i++)
+	{
+		for (int t = 0 ; t < 2 ; t++)
+		{
+			wxUint32 next = table[reached[i]].transitions[t];
+			if (next < tableSize && reachIndex[next] == -1)
+			{
+				reachIndex[next] = reached.size();
+				reached.push_back(next);
+			}
+		}
+	}
+	
+	size_t n = reached.size();
+	
+	// Moore's algorithm: start by partitioning the states on their
+	// action, and refine until transitions agree within every block
+	std::vector<unsigned int> block(n), newBlock(n);
+	unsigned int numBlocks = 0;
+	
+	for (size_t i = 0 ; i < n ; i++)
+	{
+		size_t j;
+		for (j = 0 ; j < i ; j++)
+			if (table[reached[j]].action == table[reached[i]].action)
+				break;
+		block[i] = (j < i) ? block[j] : numBlocks++;
+	}
+	
+	for (;;)
+	{
+		// Signature of a state is (block, block of next on C, block of
+		// next on D); renumber blocks by first appearance of a signature
+		std::vector<size_t> representative;
+		
+		for (size_t i = 0 ; i < n ; i++)
+		{
+			const FSAState &s = table[reached[i]];
+			unsigned int b0 = block[reachIndex[s.transitions[0]]];
+			unsigned int b1 = block[reachIndex[s.transitions[1]]];
+			
+			size_t r;
+			for (r = 0 ; r < representative.size() ; r++)
+			{
+				size_t k = representative[r];
+				const FSAState &o = table[reached[k]];
+				if (block[k] == block[i] && 
+				    block[reachIndex[o.transitions[0]]] == b0 &&
+				    block[reachIndex[o.transitions[1]]] == b1)
+					break;
+			}
+			
+			if (r == representative.size())
+				representative.push_back(i);
+			newBlock[i] = r;
+		}
+		
+		bool stable = (representative.size() == numBlocks);
+		numBlocks = representative.size();
+		block.swap(newBlock);
+		
+		if (stable)
+			break;
+	}
+	
+	// Renumber the minimized machine in breadth-first order from the
+	// starting block, and hash it (64-bit FNV-1a)
+	std::vector<size_t> blockRep(numBlocks, n);
+	for (size_t i = 0 ; i < n ; i++)
+		if (blockRep[block[i]] == n)
+			blockRep[block[i]] = i;
+	
+	std::vector<int> order(numBlocks, -1);
+	std::vector<unsigned int> queue;
+	order[block[0]] = 0;
+	queue.push_back(block[0]);
+	
+	wxUint64 hash = wxULL(14695981039346656037);
+	for (size_t i = 0 ; i < queue.size() ; i++)
+	{
+		const FSAState &s = table[reached[blockRep[queue[i]]]];
+		wxUint32 words[3];
+		
+		words[0] = s.action;
+		for (int t = 0 ; t < 2 ; t++)
+		{
+			unsigned int b = block[reachIndex[s.transitions[t]]];
+			if (order[b] == -1)
+			{
+				order[b] = queue.size();
+				queue.push_back(b);
+			}
+			words[t + 1] = order[b];
+		}
+		
+		for (int w = 0 ; w < 3 ; w++)
+		{
+			for (int byte = 0 ; byte < 4 ; byte++)
+			{
+				hash ^= (words[w] >> (byte * 8)) & 0xFF;
+				hash *= wxULL(1099511628211);
+			}
+		}
+	}
+	
+	return hash;
+}
+
 bool FSAPlayer::Think(const Game *gamePlayed, const Player *nextOpponent)
 {
 	// Recall our history with this player
@@ -187,7 +376,7 @@ bool FSAPlayer::Think(const Game *gamePlayed, const Player *nextOpponent)
 	{
 		// What did they do to us last time?
 		wxChar lastMove = oldMoves[oldMoves.Length() - 1];
-		int state = gamePlayed->GetGameMoves().Find(lastMove);
+		int state = gamePlayed->FindMove(lastMove);
 		
 		if (state != 0 && state != 1)
 		{
@@ -199,14 +388,14 @@ bool FSAPlayer::Think(const Game *gamePlayed, const Player *nextOpponent)
 		eip = machine[eip].transitions[state];
 	}
 
-	if (eip >= machine.GetCount())
+	if (eip >= numStates)
 	{
 		Error::Set(wxString::Format(_("Player %s has an index which stepped out of bounds (%d >= %d)"), 
-		           playerAuthor.c_str(), eip, machine.GetCount()));
+		           playerAuthor.c_str(), eip, numStates));
 		return false;
 	}
 	
-	nextMove = machine[eip].action;
+	nextMove = (wxChar)machine[eip].action;
 	
 	return true;
 }
@@ -324,6 +513,39 @@ TEST(FSAPlayer, Strategy)
 	CHECK_EQUAL(wxT('D'), tft.nextMove);
 }
 
+TEST(FSAPlayer, CanonicalHash)
+{
+	MockGame game;
+	FSAPlayer tft, tftExtra, tftSpaces, alld, allc;
+	
+	// A TFT with a renumbered, duplicated start state and an unreachable
+	// extra state is still TFT
+	static const wxString test_tft_bloated("Charles Pence\nTFT\n4\nC, 2, 1\nD, 0, 1\nC, 2, 1\nD, 0, 3");
+	
+	CHECK(tft.LoadFromString(&game, test_tft));
+	CHECK(tftExtra.LoadFromString(&game, test_tft_bloated));
+	CHECK(tftSpaces.LoadFromString(&game, test_tft_spaces));
+	CHECK(allc.LoadFromString(&game, test_testc));
+	CHECK(alld.LoadFromString(&game, test_testd));
+	
+	CHECK(tft.GetCanonicalHash() == tftSpaces.GetCanonicalHash());
+	CHECK(tft.GetCanonicalHash() == tftExtra.GetCanonicalHash());
+	CHECK(tft.GetCanonicalHash() != allc.GetCanonicalHash());
+	CHECK(allc.GetCanonicalHash() != alld.GetCanonicalHash());
+}
+
+TEST(FSAPlayer, Script)
+{
+	MockGame game;
+	FSAPlayer tft, copy;
+	
+	CHECK(tft.LoadFromString(&game, test_tft_spaces));
+	CHECK(copy.LoadFromString(&game, tft.GetScript()));
+	CHECK_EQUAL(2, copy.GetNumLines());
+	CHECK(tft.GetCanonicalHash() == copy.GetCanonicalHash());
+	CHECK(tft.GetSource() == wxT("C, 0  , 1   \nD, 0   ,  1 \n"));
+}
+
 TEST(FSAPlayer, Clone)
 {
 	FSAPlayer playerOne;
@@ -18,6 +18,10 @@
     along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <wx/sharedptr.h>
+#include <vector>
+
+#include "../common/mappedfile.h"
 #include "player.h"
 
 #ifndef FSAPLAYER_H__
@@ -31,47 +35,27 @@
     \brief An individual state object in a finite state machine
     
     This class encapsulates an action as well as transitions to subsequent
-    states based on the move taken by an opponent.
+    states based on the move taken by an opponent.  It is a plain,
+    fixed-size record, so that a machine is simply a contiguous array of
+    states.  This is also exactly the layout in which machines are stored
+    in binary player bundles, which lets bundle tables be used in place.
     
-    \see FSAPlayer
+    \see FSAPlayer, FSABundle
 */
-class FSAState
+struct FSAState
 {
-public:
-	/**
-	    \brief Constructor
-	    
-	    Sets the \c action and \c transitions values.
-	    
-	    \param newAction Initial value of the \c action member
-	    \param newTransitions Initial values of the \c transitions member
-	*/
-	FSAState(wxChar newAction, const long *newTransitions) :
-		action (newAction)
-	{
-		transitions[0] = newTransitions[0];
-		transitions[1] = newTransitions[1];
-	}
-
 	/**
-	    \brief The action to take at this node
+	    \brief The action to take at this node (a character from the
+	           game's move list)
 	*/
-	wxChar action;
+	wxUint32 action;
 
 	/**
 	    \brief Array of transitions (where to go based on opponent move)
 	*/
-	long transitions[2];
+	wxUint32 transitions[2];
 };
 
-/**
-    \typedef FSAStateArray
-    \ingroup game
-    \brief A variable-length array of FSAState objects
-*/
-WX_DECLARE_OBJARRAY(FSAState, FSAStateArray);
-
-
 /**
     \class FSAPlayer
     \ingroup game
@@ -120,6 +104,9 @@ public:
 	*/
 	FSAPlayer() :
 	    Player(),
+	    machine(NULL),
+	    numStates(0),
+	    canonicalHash(0),
 	    eip(-1)
 	{ }
 
@@ -132,7 +119,11 @@ public:
 	    playerName(p.playerName),
 	    playerAuthor(p.playerAuthor),
 	    playerSource(p.playerSource),
-	    machine(p.machine),
+	    states(p.states),
+	    mapping(p.mapping),
+	    machine(p.mapping ? p.machine : (states.size() ? &states[0] : NULL)),
+	    numStates(p.numStates),
+	    canonicalHash(p.canonicalHash),
 	    eip(p.eip)
 	{ }
 	
@@ -159,6 +150,58 @@ public:
 	    \returns True if the file is successfully loaded, false otherwise
 	*/
 	bool LoadFromString(const Game *game, const wxString &fsaScript);
+	
+	/**
+	    \brief Load a machine from a compiled state table
+	    
+	    The table is copied into the player.  It must already be valid
+	    (every action a legal move, every transition in range), as it is
+	    not checked here.  This is used by code which generates machines
+	    directly, such as \c GeneticTournament.
+	    
+	    \param table Pointer to the first state of the machine
+	    \param tableSize Number of states in \p table
+	    \param author The author of the machine
+	    \param name The name of the machine
+	*/
+	void LoadFromTable(const FSAState *table, unsigned int tableSize,
+	                   const wxString &author, const wxString &name);
+	
+	/**
+	    \brief Use a compiled state table held in a memory-mapped file
+	    
+	    The player will execute the given table in place, without copying
+	    it, and will hold a reference to \p file so that the mapping
+	    outlives every player (and clone) that uses it.  The table must
+	    already have been validated by the caller.
+	    
+	    \param file The mapping which contains \p table
+	    \param table Pointer to the first state of the machine
+	    \param tableSize Number of states in \p table
+	    \param author The author of the machine
+	    \param name The name of the machine
+	    \param hash The canonical hash of the machine
+	    \see FSABundle
+	*/
+	void LoadFromMapping(const wxSharedPtr<MappedFile> &file, 
+	                     const FSAState *table, unsigned int tableSize,
+	                     const wxString &author, const wxString &name,
+	                     wxUint64 hash);
+	
+	/**
+	    \brief Compute the canonical hash of a state table
+	    
+	    Two machines which play identically against every opponent (that
+	    is, which differ only by unreachable states, redundant states, or
+	    the numbering of their states) receive the same hash.  The machine
+	    is trimmed to the states reachable from state zero, minimized, and
+	    renumbered in breadth-first order before hashing.
+	    
+	    \param table Pointer to the first state of the machine
+	    \param tableSize Number of states in \p table
+	    \returns 64-bit canonical hash of the machine
+	*/
+	static wxUint64 CanonicalHash(const FSAState *table, unsigned int tableSize);
 
 	
 	virtual Player *Clone() const
@@ -183,15 +226,41 @@ public:
 
 	/**
 	    \brief Get the source code for this player
+	    
+	    Players loaded from a bundle carry no source text, so for them it
+	    is regenerated from the state table on first request.
+	    
 	    \returns Source code for player
 	*/
-	const wxString &GetSource() { return playerSource; }
+	const wxString &GetSource();
+	
+	/**
+	    \brief Get the complete FSA script for this player
+	    
+	    This includes the author, name, and number of states, and so may
+	    be saved to a file and later read back with Load().
+	    
+	    \returns FSA script for player
+	*/
+	wxString GetScript() const;
 	
 	/**
 	    \brief Get the number of machine states
 	    \returns Number of machine states
 	*/
-	int GetNumLines() { return machine.size(); }
+	int GetNumLines() const { return numStates; }
+	
+	/**
+	    \brief Get the machine's state table
+	    \returns Pointer to the first of GetNumLines() states
+	*/
+	const FSAState *GetStates() const { return machine; }
+	
+	/**
+	    \brief Get the canonical hash of this player's machine
+	    \returns Canonical hash, as computed by CanonicalHash()
+	*/
+	wxUint64 GetCanonicalHash() const { return canonicalHash; }
 
 private:
 	/**
@@ -206,6 +275,9 @@ private:
 	*/
 	bool DoLoad (const Game *game, const wxArrayString &fsaScript);
 	
+	// Players are copied with Clone(), never assigned
+	FSAPlayer &operator=(const FSAPlayer &);
+	
 	
 	/**
 	    \brief Name of this player
@@ -224,9 +296,31 @@ private:
 
 
 	/**
-	    \brief List of machine states
+	    \brief Storage for machine states loaded from a script
+	*/
+	std::vector<FSAState> states;
+	
+	/**
+	    \brief The mapped bundle holding our states, if not loaded from
+	           a script
+	*/
+	wxSharedPtr<MappedFile> mapping;
+	
+	/**
+	    \brief List of machine states (points into either \c states or
+	           \c mapping)
+	*/
+	const FSAState *machine;
+	
+	/**
+	    \brief Number of machine states
+	*/
+	unsigned int numStates;
+	
+	/**
+	    \brief Canonical hash of the machine
 	*/
-	FSAStateArray machine;
+	wxUint64 canonicalHash;
 	
 	/**
 	    \brief The current state being executed in the finite state
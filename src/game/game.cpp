@@ -27,13 +27,61 @@
 #  include <wx/wx.h>
 #endif
 
+#include <string.h>
+
 #ifdef BUILD_TESTS
 #  include <TestHarness.h>
+#  include "prisoner.h"
 #endif
 
 #include "game.h"
 #include "player.h"
 
+
+wxUint64 HashGame(const Game *game)
+{
+	const wxString *moves[2] = { &game->GetRoleMoves(0), &game->GetRoleMoves(1) };
+	wxUint64 hash = Random::Hash(moves[0]->Length());
+	
+	for (int role = 0 ; role < 2 ; role++)
+	{
+		for (size_t i = 0 ; i < moves[role]->Length() ; i++)
+			hash = Random::Hash(hash ^ (wxUint32)(*moves[role])[i]);
+		hash = Random::Hash(~hash);
+	}
+	
+	// Play each pair of moves once, without noise getting in the way
+	Game *probe = game->Clone();
+	probe->SetNoise(0.0);
+	MockPlayer one, two;
+	
+	for (size_t i = 0 ; i < moves[0]->Length() ; i++)
+	{
+		for (size_t j = 0 ; j < moves[1]->Length() ; j++)
+		{
+			probe->Reset();
+			one.Reset();
+			two.Reset();
+			one.nextMove = (*moves[0])[i];
+			two.nextMove = (*moves[1])[j];
+			
+			// Every move is one of the game's own, so this can't fail
+			probe->Play(&one, &two);
+			hash = Random::Hash(hash ^ (wxUint32)one.GetScore());
+			hash = Random::Hash(hash ^ (wxUint32)two.GetScore());
+		}
+	}
+	
+	delete probe;
+	
+	double noise = game->GetNoise();
+	wxUint64 noiseBits;
+	memcpy(&noiseBits, &noise, sizeof(noiseBits));
+	
+	return Random::Hash(hash ^ noiseBits);
+}
+
+
 /** \cond TEST */
 #ifdef BUILD_TESTS
 
@@ -121,6 +169,21 @@ TEST(Game, Reset)
 	CHECK_EQUAL(0, game.GetGameHistory().GetCount());
 }
 
+TEST(Game, HashGame)
+{
+	PrisonerDilemma standard, same, stag(PayoffTable(3, 4, 1, 0)), noisy;
+	MockGame mock;
+	noisy.SetNoise(0.01);
+	
+	CHECK(HashGame(&standard) == HashGame(&same));
+	CHECK(HashGame(&standard) != HashGame(&stag));
+	CHECK(HashGame(&standard) != HashGame(&noisy));
+	CHECK(HashGame(&standard) != HashGame(&mock));
+	
+	// Probing the game doesn't touch its noise
+	CHECK_EQUAL(0.01, noisy.GetNoise());
+}
+
 #endif
 /** \endcond */
 
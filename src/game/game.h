@@ -24,8 +24,9 @@
     This group contains, roughly, games and players.  Players may either
     be written in C++ and hard-coded (called "built-in" in the user 
     interface), or specified by external finite state machines.
-    Currently there is only one game, \c PrisonerDilemma, and it is written
-    in C++.  A format for specifying normal-form games is forthcoming.
+    The symmetric \c PrisonerDilemma is the usual game; \c BimatrixGame
+    describes asymmetric games, whose two players each have their own
+    moves and payoffs.  Both are written in C++.
     
     All games derive from the \c Game class, and all players derive from
     the \c Player class.
@@ -34,7 +35,10 @@
 #ifndef GAME_H__
 #define GAME_H__
 
+#include <vector>
+
 #include "../common/error.h"
+#include "../common/rng.h"
 #include "player.h"
 
 /**
@@ -50,7 +54,20 @@
 class Game
 {
 public:
+	Game() : noise(0.0), randomStream(0), randomCount(0), hasRandomStream(false) { }
 	virtual ~Game() { }
+	
+	/**
+	    \brief Create a newly allocated copy of the current game
+	    
+	    A game stores the history of the turns being played, so code which
+	    plays several matches at once (on different threads) needs a
+	    separate copy of the game for each of them.  This method is
+	    implemented as <tt>return new [Type](*this);</tt>.
+	    
+	    \returns A copy of the current game
+	*/
+	virtual Game *Clone() const = 0;
 
 	/**
 	    \brief Play one round of this game between two players
@@ -66,20 +83,27 @@ public:
 	bool Play(Player *playerOne, Player *playerTwo)
 	{
 		// Check the incoming values to make sure we're legit
-		if (gameMoves.Find(playerOne->nextMove) == -1)
+		if (GetRoleMoves(0).Find(playerOne->nextMove) == -1)
 		{
 			Error::Set(wxString::Format(_("Player %s made an invalid move (move not in {%s})"),
-			           playerOne->GetPlayerName().c_str(), gameMoves.c_str()));
+			           playerOne->GetPlayerName().c_str(), GetRoleMoves(0).c_str()));
 			return false;
 		}
 		
-		if (gameMoves.Find(playerTwo->nextMove) == -1)
+		if (GetRoleMoves(1).Find(playerTwo->nextMove) == -1)
 		{
 			Error::Set(wxString::Format(_("Player %s made an invalid move (move not in {%s})"),
-			           playerTwo->GetPlayerName().c_str(), gameMoves.c_str()));
+			           playerTwo->GetPlayerName().c_str(), GetRoleMoves(1).c_str()));
 			return false;
 		}
 		
+		// Every so often, a move comes out wrong
+		if (noise > 0.0)
+		{
+			Tremble(playerOne, 0);
+			Tremble(playerTwo, 1);
+		}
+		
 		// Compute the score for this round
 		int playerOneScore, playerTwoScore;
 		GetGamePayoff(playerOne, playerOneScore, playerTwo, playerTwoScore);
@@ -90,6 +114,24 @@ public:
 		thisTurn.Append(playerTwo->nextMove);
 		gameHistory.Add(thisTurn);
 		
+		// Two-move games also keep a bit per turn for each player, set
+		// if the player made the second move
+		if (gameMoves.Length() == 2 && GetRoleMoves(1).Length() == 2)
+		{
+			size_t turn = gameHistory.GetCount() - 1;
+			if (turn % 64 == 0)
+			{
+				moveBits[0].push_back(0);
+				moveBits[1].push_back(0);
+			}
+			
+			wxUint64 bit = (wxUint64)1 << (turn % 64);
+			if (playerOne->nextMove != gameMoves[0])
+				moveBits[0].back() |= bit;
+			if (playerTwo->nextMove != GetRoleMoves(1)[0])
+				moveBits[1].back() |= bit;
+		}
+		
 		// Tell the players what just happened
 		playerOne->AddPayoff(playerTwo, playerTwo->nextMove, playerOneScore);
 		playerTwo->AddPayoff(playerOne, playerOne->nextMove, playerTwoScore);
@@ -103,7 +145,68 @@ public:
 	    This function clears the stored game history.
 	*/
 	virtual void Reset()
-	{ gameHistory.clear(); }
+	{
+		gameHistory.clear();
+		moveBits[0].clear();
+		moveBits[1].clear();
+	}
+	
+	/**
+	    \brief Make players draw their random numbers from a substream
+	    
+	    After this call, GenerateFloat() returns a sequence determined
+	    only by \p key, so a match between players which make random
+	    choices can be replayed exactly by setting the same key again.
+	    
+	    \param key Key for the random substream
+	*/
+	void SetRandomStream(wxUint64 key)
+	{
+		randomStream = key;
+		randomCount = 0;
+		hasRandomStream = true;
+	}
+	
+	/**
+	    \brief Go back to drawing random numbers from the shared generator
+	*/
+	void ClearRandomStream()
+	{ hasRandomStream = false; }
+	
+	/**
+	    \brief Set the chance that a player's move is carried out wrong
+	    
+	    With this probability, Play() replaces each player's chosen
+	    move with another move of the game, picked at random.  The
+	    players see (and are scored on) the moves actually played.
+	    
+	    \param probability Noise probability, in [0, 1]
+	*/
+	void SetNoise(double probability)
+	{ noise = probability; }
+	
+	/**
+	    \brief Get the chance that a player's move is carried out wrong
+	    \returns Noise probability
+	*/
+	double GetNoise() const
+	{ return noise; }
+	
+	/**
+	    \brief Generate a random number for a player of this game
+	    
+	    Players which make random choices should call this, rather than
+	    the functions in the \c Random namespace, so that their moves can
+	    be replayed (see SetRandomStream()).
+	    
+	    \returns A random double in [0, 1)
+	*/
+	double GenerateFloat() const
+	{
+		if (!hasRandomStream)
+			return Random::GenerateFloatHigh();
+		return Random::HashToFloat(Random::Hash(randomStream ^ Random::Hash(randomCount++)));
+	}
 
 protected:
 	/**
@@ -118,8 +221,21 @@ protected:
 	    that move must be \c gameMoves[0].  \c TitForTatPlayer will open with 
 	    \c gameMoves[0].  In other words, if there is a "cooperate" action,
 	    it must be listed first.
+	    
+	    In a game with two roles, these are the moves of player one.
 	*/
 	wxString gameMoves;
+	
+	/**
+	    \brief Moves of player two, in a game with two roles
+	    
+	    Empty for a symmetric game, in which both players choose from
+	    \c gameMoves.  Otherwise it must have as many moves as
+	    \c gameMoves, and a move that appears in both must be in the
+	    same place in both (so that FindMove() can tell where any move
+	    stands without knowing who made it).
+	*/
+	wxString columnMoves;
 
 	/**
 	    \brief The history of all turns that have been taken in this game
@@ -134,6 +250,35 @@ protected:
 	    to call \c Game::Reset before doing so.
 	*/
 	wxArrayString gameHistory;
+	
+	/**
+	    \brief The history of a two-move game, packed as bits
+	    
+	    Bit \c t of the array for each player (bit <tt>t % 64</tt> of
+	    word <tt>t / 64</tt>) is set if that player made the second move
+	    on turn \c t.  These are only kept for games with two moves.
+	*/
+	std::vector<wxUint64> moveBits[2];
+	
+	/**
+	    \brief The chance that a move is carried out wrong
+	*/
+	double noise;
+	
+	/**
+	    \brief Key of the current random substream
+	*/
+	wxUint64 randomStream;
+	
+	/**
+	    \brief Number of values drawn from the current random substream
+	*/
+	mutable wxUint64 randomCount;
+	
+	/**
+	    \brief True if random numbers come from \c randomStream
+	*/
+	bool hasRandomStream;
 
 	/**
 	    \brief Function determining game payoff
@@ -149,6 +294,30 @@ protected:
 	*/
 	virtual void GetGamePayoff(const Player *playerOne, int &playerOneScore,
 	                           const Player *playerTwo, int &playerTwoScore) = 0;
+	
+	/**
+	    \brief Possibly replace a player's move with a different one
+	    \param player The player whose move may be changed
+	    \param role Zero for player one, one for player two
+	*/
+	void Tremble(Player *player, int role) const
+	{
+		if (GenerateFloat() >= noise)
+			return;
+		
+		const wxString &moves = GetRoleMoves(role);
+		size_t numMoves = moves.Length();
+		if (numMoves < 2)
+			return;
+		
+		// Pick one of the other moves
+		size_t move = moves.Find(player->nextMove);
+		size_t other = (size_t)(GenerateFloat() * (numMoves - 1));
+		if (other >= numMoves - 1)
+			other = numMoves - 2;
+		
+		player->nextMove = moves[(move + 1 + other) % numMoves];
+	}
 
 public:
 	/**
@@ -157,6 +326,35 @@ public:
 	*/
 	const wxString &GetGameMoves() const
 	{ return gameMoves; }
+	
+	/**
+	    \brief Get the moves one of the players may make
+	    
+	    \param role Zero for player one, one for player two
+	    \returns Acceptable moves string for that player
+	*/
+	const wxString &GetRoleMoves(int role) const
+	{ return (role && !columnMoves.IsEmpty()) ? columnMoves : gameMoves; }
+	
+	/**
+	    \brief Do both players choose from the same moves?
+	    \returns True unless the game has two roles (see \c columnMoves)
+	*/
+	bool IsSymmetric() const
+	{ return columnMoves.IsEmpty(); }
+	
+	/**
+	    \brief Find a move made by either player
+	    
+	    \param move The move
+	    \returns Its index in the moves of whichever player may make it,
+	             or -1 if it isn't a move of this game
+	*/
+	int FindMove(wxChar move) const
+	{
+		int idx = gameMoves.Find(move);
+		return (idx == -1 && !columnMoves.IsEmpty()) ? columnMoves.Find(move) : idx;
+	}
 
 	/**
 	    \brief Get the move history for this game
@@ -164,9 +362,34 @@ public:
 	*/
 	const wxArrayString &GetGameHistory() const
 	{ return gameHistory; }
+	
+	/**
+	    \brief Get the packed move history of a two-move game
+	    
+	    \param player Zero for player one, one for player two
+	    \returns Bits set where the player made the second move (see
+	             \c moveBits)
+	*/
+	const std::vector<wxUint64> &GetMoveBits(int player) const
+	{ return moveBits[player]; }
 };
 
 
+/**
+    \brief Hash the moves, payoffs and noise of a game
+    \ingroup game
+    
+    Used, alongside \c HashPlayers, to check that scores saved to disk
+    (such as the tiles of a \c TiledPayoffMatrix) came from the same
+    game.  The payoffs are read by playing every pair of moves once on
+    a noiseless copy of the game.
+    
+    \param game The game
+    \returns Hash of the game
+*/
+wxUint64 HashGame(const Game *game);
+
+
 /** \cond TEST */
 
 // A mock game object for unit testing.  The allowable moves are C and D,
@@ -178,6 +401,9 @@ public:
 	MockGame()
 	{ gameMoves = wxT("CD"); }
 	virtual ~MockGame() { }
+	
+	virtual Game *Clone() const
+	{ return new MockGame(*this); }
 
 protected:
 	void GetGamePayoff(const Player * WXUNUSED(playerOne), int &playerOneScore,
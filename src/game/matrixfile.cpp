@@ -0,0 +1,688 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#include <wx/file.h>
+#include <wx/filename.h>
+#include <wx/sharedptr.h>
+
+#include <locale.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#ifdef BUILD_TESTS
+#  include <TestHarness.h>
+#endif
+
+#include "../common/error.h"
+#include "../common/mappedfile.h"
+#include "../common/outputfile.h"
+#include "matrixfile.h"
+#include "matrixplayer.h"
+
+
+namespace MatrixFile
+{
+
+/**
+    \brief The binary matrix file header, at offset zero
+*/
+struct MatrixHeader
+{
+	char magic[8];
+	wxUint32 version;
+	wxUint32 byteOrder;
+	wxUint32 size;
+	wxUint32 reserved;
+	wxUint64 stringsSize;
+	wxUint64 valuesOffset;
+};
+
+static const char matrixMagic[8] = { 'O', 'Y', 'U', 'N', 'P', 'M', 'T', 'X' };
+static const wxUint32 matrixVersion = 1;
+static const wxUint32 matrixByteOrder = 0x01020304;
+
+
+static wxUint64 Align8(wxUint64 offset)
+{
+	return (offset + 7) & ~(wxUint64)7;
+}
+
+static bool IsBinaryFileName(const wxString &fileName)
+{
+	return fileName.Lower().EndsWith(wxT(".oym"));
+}
+
+// Quote a spreadsheet label, if it needs it
+static wxString QuoteLabel(const wxString &label)
+{
+	if (!label.Length() || label.find_first_of(wxT(",\"\r\n")) != wxString::npos ||
+	    label[0] == wxT(' ') || label.Last() == wxT(' '))
+	{
+		wxString quoted(label);
+		quoted.Replace(wxT("\""), wxT("\"\""));
+		return wxT("\"") + quoted + wxT("\"");
+	}
+	
+	return label;
+}
+
+static bool WriteBinary(const wxString &fileName, const PlayerPtrArray &players, const double *values)
+{
+	std::vector<char> strings;
+	for (size_t i = 0 ; i < players.GetCount() ; i++)
+	{
+		const wxCharBuffer name = players[i]->GetPlayerName().utf8_str();
+		const wxCharBuffer author = players[i]->GetPlayerAuthor().utf8_str();
+		strings.insert(strings.end(), (const char *)name, (const char *)name + strlen(name) + 1);
+		strings.insert(strings.end(), (const char *)author, (const char *)author + strlen(author) + 1);
+	}
+	
+	size_t size = players.GetCount();
+	
+	MatrixHeader header;
+	memset(&header, 0, sizeof(MatrixHeader));
+	memcpy(header.magic, matrixMagic, sizeof(matrixMagic));
+	header.version = matrixVersion;
+	header.byteOrder = matrixByteOrder;
+	header.size = size;
+	header.stringsSize = strings.size();
+	header.valuesOffset = Align8(sizeof(MatrixHeader) + strings.size());
+	
+	wxFile file;
+	if (!file.Create(fileName, true))
+	{
+		Error::Set(wxString::Format(_("Could not create file %s"), fileName.c_str()));
+		return false;
+	}
+	
+	bool ok = (file.Write(&header, sizeof(MatrixHeader)) == sizeof(MatrixHeader));
+	if (ok && strings.size())
+		ok = (file.Write(&strings[0], strings.size()) == strings.size());
+	
+	// Pad up to the start of the scores
+	static const char padding[8] = { 0 };
+	size_t padSize = header.valuesOffset - (sizeof(MatrixHeader) + strings.size());
+	if (ok && padSize)
+		ok = (file.Write(padding, padSize) == padSize);
+	
+	size_t valuesBytes = size * size * sizeof(double);
+	if (ok && valuesBytes)
+		ok = (file.Write(values, valuesBytes) == valuesBytes);
+	
+	file.Close();
+	
+	if (!ok)
+	{
+		Error::Set(wxString::Format(_("Could not write to file %s"), fileName.c_str()));
+		wxRemoveFile(fileName);
+		return false;
+	}
+	
+	return true;
+}
+
+static bool WriteSpreadsheet(const wxString &fileName, const PlayerPtrArray &players, const double *values)
+{
+	OutputFile out;
+	if (!out.Open(fileName))
+		return false;
+	
+	size_t size = players.GetCount();
+	
+	out.Write(_("Player"));
+	for (size_t j = 0 ; j < size ; j++)
+	{
+		out.Write(',');
+		out.Write(QuoteLabel(players[j]->GetPlayerName()));
+	}
+	out.EndLine();
+	
+	for (size_t i = 0 ; i < size ; i++)
+	{
+		out.Write(QuoteLabel(players[i]->GetPlayerName()));
+		for (size_t j = 0 ; j < size ; j++)
+		{
+			out.Write(',');
+			out.WriteExact(values[i * size + j]);
+		}
+		out.EndLine();
+	}
+	
+	return out.Close();
+}
+
+bool Write(const wxString &fileName, const PlayerPtrArray &players, const double *values)
+{
+	if (IsBinaryFileName(fileName))
+		return WriteBinary(fileName, players, values);
+	return WriteSpreadsheet(fileName, players, values);
+}
+
+
+static bool LoadBinary(const wxString &fileName, PlayerPtrArray &players)
+{
+	wxSharedPtr<MappedFile> mapping(new MappedFile);
+	if (!mapping->Open(fileName))
+		return false;
+	
+	const wxUint8 *data = mapping->GetData();
+	wxUint64 fileSize = mapping->GetSize();
+	
+	if (fileSize < sizeof(MatrixHeader) || memcmp(data, matrixMagic, sizeof(matrixMagic)))
+	{
+		Error::Set(wxString::Format(_("File %s is not an Oyun payoff matrix"), fileName.c_str()));
+		return false;
+	}
+	
+	const MatrixHeader *header = (const MatrixHeader *)data;
+	if (header->version != matrixVersion)
+	{
+		Error::Set(wxString::Format(_("Payoff matrix %s has an unsupported version (%d)"),
+		                            fileName.c_str(), header->version));
+		return false;
+	}
+	if (header->byteOrder != matrixByteOrder)
+	{
+		Error::Set(wxString::Format(_("Payoff matrix %s was created on a machine with a different byte order"),
+		                            fileName.c_str()));
+		return false;
+	}
+	
+	wxUint64 size = header->size;
+	if (header->stringsSize > fileSize || header->valuesOffset % 8 != 0 ||
+	    header->valuesOffset < sizeof(MatrixHeader) + header->stringsSize ||
+	    header->valuesOffset > fileSize || fileSize - header->valuesOffset != size * size * sizeof(double))
+	{
+		Error::Set(wxString::Format(_("Payoff matrix %s is truncated or corrupt"), fileName.c_str()));
+		return false;
+	}
+	
+	// A name and an author for each strategy, each ending in a NUL
+	wxArrayString names, authors;
+	const char *strings = (const char *)(data + sizeof(MatrixHeader));
+	const char *stringsEnd = strings + header->stringsSize;
+	
+	for (wxUint64 i = 0 ; i < 2 * size ; i++)
+	{
+		const char *nul = (const char *)memchr(strings, 0, stringsEnd - strings);
+		if (!nul)
+		{
+			Error::Set(wxString::Format(_("Payoff matrix %s is truncated or corrupt"), fileName.c_str()));
+			return false;
+		}
+		
+		wxString str(wxString::FromUTF8(strings, nul - strings));
+		if (i % 2)
+			authors.Add(str);
+		else
+			names.Add(str);
+		strings = nul + 1;
+	}
+	
+	wxSharedPtr<ImportedMatrix> matrix(new ImportedMatrix(names, authors, mapping,
+	                                   (const double *)(data + header->valuesOffset)));
+	
+	players.Alloc(players.GetCount() + size);
+	for (size_t i = 0 ; i < size ; i++)
+		players.Add(new MatrixPlayer(matrix, i));
+	
+	return true;
+}
+
+
+/**
+    \brief A position in the text of a spreadsheet
+*/
+struct Cursor
+{
+	const char *p;
+	const char *end;
+	int line;
+};
+
+static void SkipSpaces(Cursor &c)
+{
+	while (c.p < c.end && (*c.p == ' ' || *c.p == '\t'))
+		c.p++;
+}
+
+static bool AtLineEnd(const Cursor &c)
+{
+	return c.p == c.end || *c.p == '\n' || *c.p == '\r';
+}
+
+static void NextLine(Cursor &c)
+{
+	if (c.p < c.end && *c.p == '\r')
+		c.p++;
+	if (c.p < c.end && *c.p == '\n')
+		c.p++;
+	c.line++;
+}
+
+// Move past the comma before the next field, if there is one
+static bool NextField(Cursor &c)
+{
+	SkipSpaces(c);
+	if (c.p < c.end && *c.p == ',')
+	{
+		c.p++;
+		return true;
+	}
+	return false;
+}
+
+static bool ReadLabel(Cursor &c, wxString &label)
+{
+	SkipSpaces(c);
+	std::string text;
+	
+	if (c.p < c.end && *c.p == '"')
+	{
+		// Quoted, with doubled quotes standing for one
+		for (c.p++ ; ; c.p++)
+		{
+			if (c.p == c.end)
+				return false;
+			if (*c.p == '"')
+			{
+				if (c.p + 1 < c.end && c.p[1] == '"')
+					c.p++;
+				else
+				{
+					c.p++;
+					break;
+				}
+			}
+			else if (*c.p == '\n')
+				c.line++;
+			text += *c.p;
+		}
+	}
+	else
+	{
+		const char *start = c.p;
+		while (!AtLineEnd(c) && *c.p != ',')
+			c.p++;
+		
+		const char *last = c.p;
+		while (last > start && (last[-1] == ' ' || last[-1] == '\t'))
+			last--;
+		text.assign(start, last);
+	}
+	
+	label = wxString::FromUTF8(text.c_str(), text.length());
+	return true;
+}
+
+// Read a decimal number, correctly rounded.  Numbers of up to 15
+// digits with small exponents (which covers almost every score) are
+// converted here; the rest are left to the C library.
+static bool ReadNumber(Cursor &c, double &value)
+{
+	static const double powers[23] =
+	{ 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+	  1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	
+	SkipSpaces(c);
+	const char *p = c.p;
+	bool negative = false;
+	if (p < c.end && (*p == '-' || *p == '+'))
+		negative = (*p++ == '-');
+	
+	const char *start = p;
+	wxUint64 mantissa = 0;
+	int exponent = 0, digits = 0;
+	bool any = false;
+	
+	for ( ; p < c.end && *p >= '0' && *p <= '9' ; p++)
+	{
+		any = true;
+		if (digits < 19)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa)
+				digits++;
+		}
+		else
+			exponent++;
+	}
+	
+	if (p < c.end && *p == '.')
+	{
+		for (p++ ; p < c.end && *p >= '0' && *p <= '9' ; p++)
+		{
+			any = true;
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa)
+					digits++;
+				exponent--;
+			}
+		}
+	}
+	
+	if (!any)
+		return false;
+	
+	if (p < c.end && (*p == 'e' || *p == 'E'))
+	{
+		p++;
+		bool negativeExponent = false;
+		if (p < c.end && (*p == '-' || *p == '+'))
+			negativeExponent = (*p++ == '-');
+		
+		int e = 0;
+		bool anyExponent = false;
+		for ( ; p < c.end && *p >= '0' && *p <= '9' ; p++)
+		{
+			anyExponent = true;
+			if (e < 10000)
+				e = e * 10 + (*p - '0');
+		}
+		
+		if (!anyExponent)
+			return false;
+		exponent += negativeExponent ? -e : e;
+	}
+	
+	double result = (double)mantissa;
+	if (!mantissa)
+		result = 0.0;
+	else if (mantissa < ((wxUint64)1 << 53) && exponent >= -22 && exponent <= 22)
+		result = (exponent < 0) ? result / powers[-exponent] : result * powers[exponent];
+	else
+	{
+		// strtod() reads the separator of the current locale
+		std::string text(start, p);
+		size_t point = text.find('.');
+		if (point != std::string::npos)
+			text.replace(point, 1, localeconv()->decimal_point);
+		result = strtod(text.c_str(), NULL);
+	}
+	
+	value = negative ? -result : result;
+	c.p = p;
+	return true;
+}
+
+static bool LoadSpreadsheet(const wxString &fileName, PlayerPtrArray &players)
+{
+	MappedFile file;
+	if (!file.Open(fileName))
+		return false;
+	
+	Cursor c;
+	c.p = (const char *)file.GetData();
+	c.end = c.p + file.GetSize();
+	c.line = 1;
+	
+	// Skip a UTF-8 byte order mark
+	if (c.end - c.p >= 3 && !memcmp(c.p, "\xEF\xBB\xBF", 3))
+		c.p += 3;
+	
+	// The first row labels the columns
+	wxArrayString names, authors;
+	wxString label;
+	
+	if (!ReadLabel(c, label))
+	{
+		Error::Set(wxString::Format(_("%s, line %d: a label is missing its closing quote"), fileName.c_str(), c.line));
+		return false;
+	}
+	
+	while (NextField(c))
+	{
+		if (!ReadLabel(c, label))
+		{
+			Error::Set(wxString::Format(_("%s, line %d: a label is missing its closing quote"), fileName.c_str(), c.line));
+			return false;
+		}
+		names.Add(label);
+	}
+	
+	size_t size = names.GetCount();
+	if (!size || !AtLineEnd(c))
+	{
+		Error::Set(wxString::Format(_("%s does not start with a row of labels for a payoff matrix"), fileName.c_str()));
+		return false;
+	}
+	
+	wxString author(wxFileName(fileName).GetName());
+	authors.Add(author, size);
+	
+	// Then each row, with its label and scores
+	std::vector<double> values(size * size);
+	for (size_t i = 0 ; i < size ; i++)
+	{
+		NextLine(c);
+		
+		if (c.p == c.end)
+		{
+			Error::Set(wxString::Format(_("%s has %d columns, but only %d rows"), fileName.c_str(), (int)size, (int)i));
+			return false;
+		}
+		
+		if (!ReadLabel(c, label) || label != names[i])
+		{
+			Error::Set(wxString::Format(_("%s, line %d: the row should be labeled %s, like column %d"),
+			                            fileName.c_str(), c.line, names[i].c_str(), (int)i + 1));
+			return false;
+		}
+		
+		double *row = &values[i * size];
+		for (size_t j = 0 ; j < size ; j++)
+		{
+			if (!NextField(c) || !ReadNumber(c, row[j]))
+			{
+				Error::Set(wxString::Format(_("%s, line %d: column %d should be a score"),
+				                            fileName.c_str(), c.line, (int)j + 1));
+				return false;
+			}
+		}
+		
+		SkipSpaces(c);
+		if (!AtLineEnd(c))
+		{
+			Error::Set(wxString::Format(_("%s, line %d: there are more scores than columns"), fileName.c_str(), c.line));
+			return false;
+		}
+	}
+	
+	// Nothing but blank lines may follow
+	for ( ; c.p < c.end ; c.p++)
+	{
+		if (*c.p == '\n')
+			c.line++;
+		else if (*c.p != '\r' && *c.p != ' ' && *c.p != '\t' && *c.p != ',')
+		{
+			Error::Set(wxString::Format(_("%s, line %d: there are more rows than columns"), fileName.c_str(), c.line));
+			return false;
+		}
+	}
+	
+	wxSharedPtr<ImportedMatrix> matrix(new ImportedMatrix(names, authors, values));
+	
+	players.Alloc(players.GetCount() + size);
+	for (size_t i = 0 ; i < size ; i++)
+		players.Add(new MatrixPlayer(matrix, i));
+	
+	return true;
+}
+
+bool Load(const wxString &fileName, PlayerPtrArray &players)
+{
+	if (IsBinaryFileName(fileName))
+		return LoadBinary(fileName, players);
+	return LoadSpreadsheet(fileName, players);
+}
+
+bool IsMatrixFileName(const wxString &fileName)
+{
+	return IsBinaryFileName(fileName) || fileName.Lower().EndsWith(wxT(".csv"));
+}
+
+};
+
+
+/** \cond TEST */
+#ifdef BUILD_TESTS
+
+#include "game.h"
+
+TEST(MatrixFile, Spreadsheet)
+{
+	wxString tempName = wxFileName::CreateTempFileName(wxT("oyun"));
+	wxString csvName = tempName + wxT(".csv");
+	
+	// Quoted labels, Windows line endings, and all sorts of numbers
+	const char text[] = "\xEF\xBB\xBF,Cooperate,\"Defect, \"\"always\"\"\", Tit for Tat \r\n"
+	                    "Cooperate,3,0,3\r\n"
+	                    "\"Defect, \"\"always\"\"\",5,1,1.04e1\r\n"
+	                    "Tit for Tat , 3 , -0.25,+2.5E-1\r\n"
+	                    "\r\n";
+	wxFile file(csvName, wxFile::write);
+	file.Write(text, sizeof(text) - 1);
+	file.Close();
+	
+	PlayerPtrArray players;
+	CHECK(MatrixFile::IsMatrixFileName(csvName));
+	CHECK(MatrixFile::Load(csvName, players));
+	CHECK_EQUAL(3, (int)players.GetCount());
+	CHECK(players[1]->GetPlayerName() == wxT("Defect, \"always\""));
+	CHECK(players[2]->GetPlayerName() == wxT("Tit for Tat"));
+	CHECK(players[0]->GetPlayerAuthor() == wxFileName(csvName).GetName());
+	
+	const MatrixPlayer *first = dynamic_cast<const MatrixPlayer *>(players[0]);
+	CHECK(first != NULL);
+	const ImportedMatrix *matrix = first->GetMatrix();
+	CHECK_EQUAL(10.4, matrix->Get(1, 2));
+	CHECK_EQUAL(-0.25, matrix->Get(2, 1));
+	CHECK_EQUAL(0.25, matrix->Get(2, 2));
+	
+	// Imported strategies can't play
+	MockGame game;
+	CHECK(!players[0]->Think(&game, players[1]));
+	CHECK(Error::Get().Length() > 0);
+	
+	// Written back out, in both formats, exactly (even scores that
+	// need every digit, or are far below the sixth decimal place)
+	wxString binaryName = tempName + wxT(".oym");
+	const ImportedMatrix *formats[2] = { NULL, NULL };
+	PlayerPtrArray reloaded[2];
+	std::vector<double> values(9);
+	for (size_t i = 0 ; i < 9 ; i++)
+		values[i] = matrix->Get(i / 3, i % 3);
+	values[4] = 0.1 + 0.2;
+	values[5] = 1.0 / 3.0e9;
+	values[7] = -2.0 / 3.0;
+	
+	CHECK(MatrixFile::Write(binaryName, players, &values[0]));
+	CHECK(MatrixFile::Write(csvName, players, &values[0]));
+	CHECK(MatrixFile::Load(binaryName, reloaded[0]));
+	CHECK(MatrixFile::Load(csvName, reloaded[1]));
+	
+	for (int f = 0 ; f < 2 ; f++)
+	{
+		CHECK_EQUAL(3, (int)reloaded[f].GetCount());
+		formats[f] = static_cast<const MatrixPlayer *>(reloaded[f][2])->GetMatrix();
+		for (size_t i = 0 ; i < 3 ; i++)
+		{
+			CHECK(reloaded[f][i]->GetPlayerName() == players[i]->GetPlayerName());
+			for (size_t j = 0 ; j < 3 ; j++)
+				CHECK_EQUAL(values[i * 3 + j], formats[f]->Get(i, j));
+		}
+	}
+	CHECK(reloaded[0][1]->GetPlayerAuthor() == players[1]->GetPlayerAuthor());
+	
+	// Clones keep the matrix alive
+	Player *clone = reloaded[0][1]->Clone();
+	for (int f = 0 ; f < 2 ; f++)
+		for (size_t i = 0 ; i < reloaded[f].GetCount() ; i++)
+			delete reloaded[f][i];
+	CHECK_EQUAL(values[4], static_cast<MatrixPlayer *>(clone)->GetMatrix()->Get(1, 1));
+	delete clone;
+	
+	for (size_t i = 0 ; i < players.GetCount() ; i++)
+		delete players[i];
+	
+	wxRemoveFile(binaryName);
+	wxRemoveFile(csvName);
+	wxRemoveFile(tempName);
+}
+
+TEST(MatrixFile, BadData)
+{
+	wxString tempName = wxFileName::CreateTempFileName(wxT("oyun"));
+	wxString csvName = tempName + wxT(".csv");
+	PlayerPtrArray players;
+	
+	const char *bad[] =
+	{
+		"",
+		",A,B\nA,1,2\n",
+		",A,B\nA,1,2\nC,3,4\n",
+		",A,B\nA,1\nB,3,4\n",
+		",A,B\nA,1,x\nB,3,4\n",
+		",A,B\nA,1,2,3\nB,3,4\n",
+		",A,B\nA,1,2\nB,3,4\nC,5,6\n",
+		",\"A,B\nA,1\n"
+	};
+	
+	for (size_t b = 0 ; b < sizeof(bad) / sizeof(bad[0]) ; b++)
+	{
+		wxFile file(csvName, wxFile::write);
+		file.Write(bad[b], strlen(bad[b]));
+		file.Close();
+		
+		CHECK(!MatrixFile::Load(csvName, players));
+		Error::Get();
+		CHECK_EQUAL(0, (int)players.GetCount());
+	}
+	
+	// A binary matrix cut short
+	wxString binaryName = tempName + wxT(".oym");
+	wxFile file(binaryName, wxFile::write);
+	file.Write("OYUNPMTX", 8);
+	file.Close();
+	CHECK(!MatrixFile::Load(binaryName, players));
+	Error::Get();
+	CHECK_EQUAL(0, (int)players.GetCount());
+	
+	wxRemoveFile(binaryName);
+	wxRemoveFile(csvName);
+	wxRemoveFile(tempName);
+}
+
+#endif
+/** \endcond */
@@ -0,0 +1,95 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MATRIXFILE_H__
+#define MATRIXFILE_H__
+
+#include "player.h"
+
+
+/**
+    \namespace MatrixFile
+    \ingroup game
+    \brief Reading and writing of labeled payoff matrices
+    
+    A payoff matrix may be stored either as a spreadsheet (\c .csv) or
+    as a binary matrix file (\c .oym).  In a spreadsheet, the first row
+    holds a label for each column (after one cell which is ignored), and
+    each of the following rows holds a label followed by that row of
+    scores.  The rows must be in the same order as the columns, with the
+    same labels, and fields may be quoted as usual.  The labels become
+    the names of the strategies, and the name of the file their author.
+    
+    A binary matrix file consists of a fixed header, the name and author
+    of each strategy (as UTF-8 strings, each followed by a NUL), and then
+    the scores as doubles, row by row.  Like player bundles (see
+    \c FSABundle), they are written in the byte order of the machine that
+    creates them, and the scores are used in place, out of a memory
+    mapping, when they are loaded.
+*/
+namespace MatrixFile
+{
+
+/**
+    \brief Write the payoff matrix of a list of players
+    
+    Files with the extension \c .oym are written in the binary format,
+    and all others as a spreadsheet.
+    
+    \param fileName The file to create (overwritten if it exists)
+    \param players The players, whose names and authors label the rows
+    \param values The scores, row by row, as a square matrix with a row
+                  for each player
+    \returns True if the file was written, false otherwise
+*/
+bool Write(const wxString &fileName, const PlayerPtrArray &players, const double *values);
+
+/**
+    \brief Load a payoff matrix, as a list of players
+    
+    One \c MatrixPlayer is created for every row of the matrix.  The
+    matrix is released once the last of these players (or their clones)
+    is deleted.
+    
+    \param fileName The file to open
+    \param players Array to which the new players will be appended.  The
+                   caller takes ownership of the players.
+    \returns True if the matrix was loaded, false otherwise (in which case
+             no players will have been added)
+*/
+bool Load(const wxString &fileName, PlayerPtrArray &players);
+
+/**
+    \brief Check whether a file appears to be a payoff matrix
+    
+    Only the file extension is examined.
+    
+    \param fileName The file name to check
+    \returns True if \p fileName names a payoff matrix, false otherwise
+*/
+bool IsMatrixFileName(const wxString &fileName);
+
+};
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
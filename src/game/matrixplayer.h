@@ -0,0 +1,223 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MATRIXPLAYER_H__
+#define MATRIXPLAYER_H__
+
+#include <wx/sharedptr.h>
+#include <vector>
+
+#include "../common/mappedfile.h"
+#include "player.h"
+
+
+/**
+    \class ImportedMatrix
+    \ingroup game
+    
+    \brief A labeled payoff matrix loaded from a file
+    
+    Entry <tt>(i, j)</tt> is the score that strategy \c i earns against
+    strategy \c j.  The scores are either held in memory (for matrices
+    read from a spreadsheet) or read in place from a memory-mapped file
+    (see \c MatrixFile).  The matrix is shared by all of the
+    \c MatrixPlayer objects made from it, and their clones.
+*/
+class ImportedMatrix
+{
+public:
+	/**
+	    \brief Constructor for a matrix held in memory
+	    
+	    \param newNames Name of each strategy
+	    \param newAuthors Author of each strategy
+	    \param newValues The scores, row by row (swapped into the
+	                     matrix, and so left empty)
+	*/
+	ImportedMatrix(const wxArrayString &newNames, const wxArrayString &newAuthors,
+	               std::vector<double> &newValues) :
+		names(newNames), authors(newAuthors), size(newNames.GetCount())
+	{
+		storage.swap(newValues);
+		values = storage.size() ? &storage[0] : NULL;
+	}
+	
+	/**
+	    \brief Constructor for a matrix read from a mapped file
+	    
+	    \param newNames Name of each strategy
+	    \param newAuthors Author of each strategy
+	    \param newMapping The mapping which contains \p newValues
+	    \param newValues The scores, row by row
+	*/
+	ImportedMatrix(const wxArrayString &newNames, const wxArrayString &newAuthors,
+	               const wxSharedPtr<MappedFile> &newMapping, const double *newValues) :
+		names(newNames), authors(newAuthors), mapping(newMapping), values(newValues),
+		size(newNames.GetCount())
+	{ }
+	
+	/**
+	    \brief Get the number of strategies
+	    \returns Number of rows (and columns) of the matrix
+	*/
+	size_t GetSize() const { return size; }
+	
+	/**
+	    \brief Get the score of one strategy against another
+	    \param i The strategy earning the score
+	    \param j Its opponent
+	    \returns Entry <tt>(i, j)</tt>
+	*/
+	double Get(size_t i, size_t j) const { return values[i * size + j]; }
+	
+	/**
+	    \brief Get the name of a strategy
+	    \param i Index of the strategy
+	    \returns Its name
+	*/
+	const wxString &GetName(size_t i) const { return names[i]; }
+	
+	/**
+	    \brief Get the author of a strategy
+	    \param i Index of the strategy
+	    \returns Its author
+	*/
+	const wxString &GetAuthor(size_t i) const { return authors[i]; }
+	
+private:
+	/**
+	    \brief Name of each strategy
+	*/
+	wxArrayString names;
+	
+	/**
+	    \brief Author of each strategy
+	*/
+	wxArrayString authors;
+	
+	/**
+	    \brief Storage for scores read from a spreadsheet
+	*/
+	std::vector<double> storage;
+	
+	/**
+	    \brief The mapped file holding our scores, if not read from a
+	           spreadsheet
+	*/
+	wxSharedPtr<MappedFile> mapping;
+	
+	/**
+	    \brief The scores, row by row (points into either \c storage or
+	           \c mapping)
+	*/
+	const double *values;
+	
+	/**
+	    \brief Number of strategies
+	*/
+	size_t size;
+};
+
+/**
+    \class MatrixPlayer
+    \ingroup game
+    
+    \brief A strategy known only by its row of an imported payoff matrix
+    
+    When the payoff matrix of a set of strategies is already known (from
+    another program, or an earlier run), it can be loaded with
+    \c MatrixFile::Load, which makes one of these players for each of
+    its rows.  They can't play matches, but \c PayoffMatrix copies their
+    scores straight out of the imported matrix, so they can take part in
+    any tournament which only needs the payoff matrix (such as
+    \c EvoTournament), so long as all of the players come from the same
+    matrix.
+*/
+class MatrixPlayer : public Player
+{
+public:
+	/**
+	    \brief Constructor
+	    
+	    \param newMatrix The imported matrix
+	    \param newIndex This player's row (and column) of the matrix
+	*/
+	MatrixPlayer(const wxSharedPtr<ImportedMatrix> &newMatrix, size_t newIndex) :
+	    Player(), matrix(newMatrix), index(newIndex)
+	{ }
+	
+	/**
+	    \brief Copy constructor
+	    \param p Player to be copied
+	*/
+	MatrixPlayer(const MatrixPlayer &p) :
+	    Player(p), matrix(p.matrix), index(p.index)
+	{ }
+	
+	virtual Player *Clone() const
+	{ return new MatrixPlayer(*this); }
+	
+	/**
+	    \brief Fail to choose a move
+	    
+	    Imported strategies have no moves, so this always fails.
+	    
+	    \returns False
+	*/
+	virtual bool Think(const Game *gamePlayed, const Player *nextOpponent);
+	
+	virtual const wxString &GetPlayerName() const
+	{ return matrix->GetName(index); }
+	
+	virtual const wxString &GetPlayerAuthor() const
+	{ return matrix->GetAuthor(index); }
+	
+	/**
+	    \brief Get the matrix this player was imported from
+	    \returns The imported matrix
+	*/
+	const ImportedMatrix *GetMatrix() const { return matrix.get(); }
+	
+	/**
+	    \brief Get this player's row of the imported matrix
+	    \returns Index of the row
+	*/
+	size_t GetIndex() const { return index; }
+	
+private:
+	// Players are copied with Clone(), never assigned
+	MatrixPlayer &operator=(const MatrixPlayer &);
+	
+	/**
+	    \brief The imported matrix
+	*/
+	wxSharedPtr<ImportedMatrix> matrix;
+	
+	/**
+	    \brief This player's row of the matrix
+	*/
+	size_t index;
+};
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
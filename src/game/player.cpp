@@ -31,9 +31,33 @@
 #  include <TestHarness.h>
 #endif
 
+#include "../common/rng.h"
 #include "player.h"
 #include "game.h"
 
+
+wxUint64 HashPlayers(const PlayerPtrArray &players)
+{
+	wxUint64 hash = Random::Hash(players.GetCount());
+	
+	for (size_t i = 0 ; i < players.GetCount() ; i++)
+	{
+		const wxString *strings[2] = { &players[i]->GetPlayerName(), &players[i]->GetPlayerAuthor() };
+		
+		for (int s = 0 ; s < 2 ; s++)
+		{
+			const wxCharBuffer utf8 = strings[s]->utf8_str();
+			for (const char *c = utf8.data() ; *c ; c++)
+				hash = Random::Hash(hash ^ (wxUint8)*c);
+			
+			// Separate the strings, so "ab" + "c" differs from "a" + "bc"
+			hash = Random::Hash(~hash);
+		}
+	}
+	
+	return hash;
+}
+
 /** \cond TEST */
 #ifdef BUILD_TESTS
 
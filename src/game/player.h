@@ -243,6 +243,18 @@ protected:
 */
 WX_DEFINE_ARRAY_PTR(Player *, PlayerPtrArray);
 
+/**
+    \brief Hash the names and authors of a list of players
+    \ingroup game
+    
+    Used to check that a file saved for a list of players (such as a
+    tournament checkpoint) is being loaded with the same players.
+    
+    \param players The players
+    \returns Hash of the player list
+*/
+wxUint64 HashPlayers(const PlayerPtrArray &players);
+
 
 /** \cond TEST */
 
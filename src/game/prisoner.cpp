@@ -40,18 +40,18 @@ void PrisonerDilemma::GetGamePayoff(const Player *playerOne, int &playerOneScore
 {
 	// Straightforwardly implement the payoff matrix.
 	if (playerOne->nextMove == 'C' && playerTwo->nextMove == 'C')
-		playerOneScore = playerTwoScore = 3;
+		playerOneScore = playerTwoScore = payoffs.reward;
 	else if (playerOne->nextMove == 'D' && playerTwo->nextMove == 'D')
-		playerOneScore = playerTwoScore = 1;
+		playerOneScore = playerTwoScore = payoffs.punishment;
 	else if (playerOne->nextMove == 'D')
 	{
-		playerOneScore = 5;
-		playerTwoScore = 0;
+		playerOneScore = payoffs.temptation;
+		playerTwoScore = payoffs.sucker;
 	}
 	else
 	{
-		playerOneScore = 0;
-		playerTwoScore = 5;
+		playerOneScore = payoffs.sucker;
+		playerTwoScore = payoffs.temptation;
 	}
 }
 
@@ -111,6 +111,27 @@ TEST(PrisonerDilemma, Payouts)
 	CHECK_EQUAL(1, p2.GetScore());
 }
 
+TEST(PrisonerDilemma, PayoffTable)
+{
+	// A game of chicken
+	PrisonerDilemma game(PayoffTable(4, 3, 0, 1));
+	MockPlayer p1, p2;
+	
+	p1.nextMove = wxT('D');
+	p2.nextMove = wxT('C');
+	CHECK(game.Play(&p1, &p2));
+	CHECK_EQUAL(4, p1.GetScore());
+	CHECK_EQUAL(1, p2.GetScore());
+	
+	p1.Reset();
+	p2.Reset();
+	
+	p2.nextMove = wxT('D');
+	CHECK(game.Play(&p1, &p2));
+	CHECK_EQUAL(0, p1.GetScore());
+	CHECK_EQUAL(0, p2.GetScore());
+}
+
 #endif
 /** \endcond */
 
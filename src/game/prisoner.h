@@ -24,6 +24,42 @@
 #include "game.h"
 #include "player.h"
 
+/**
+    \struct PayoffTable
+    \ingroup game
+    
+    \brief The payoffs of a symmetric two-move game
+    
+    The payoffs are named as for the prisoner's dilemma, with C the first
+    move and D the second, but any ordering of them is allowed (so the
+    same table describes the stag hunt, chicken, and so on).
+*/
+struct PayoffTable
+{
+	/**
+	    \brief Constructor, for the standard prisoner's dilemma
+	*/
+	PayoffTable() : temptation(5), reward(3), punishment(1), sucker(0)
+	{ }
+	
+	/**
+	    \brief Constructor
+	    
+	    \param t Payoff for playing D against C
+	    \param r Payoff for playing C against C
+	    \param p Payoff for playing D against D
+	    \param s Payoff for playing C against D
+	*/
+	PayoffTable(int t, int r, int p, int s) : temptation(t), reward(r), punishment(p), sucker(s)
+	{ }
+	
+	int temptation;		/**< \brief Payoff for playing D against C */
+	int reward;		/**< \brief Payoff for playing C against C */
+	int punishment;		/**< \brief Payoff for playing D against D */
+	int sucker;		/**< \brief Payoff for playing C against D */
+};
+
+
 /**
     \class PrisonerDilemma
     \ingroup game
@@ -36,17 +72,46 @@
      C [3, 0]
      D [5, 1]
     \endcode
+    
+    Other payoffs may be given with a \c PayoffTable.
 */
 class PrisonerDilemma : public Game
 {
 public:
-	PrisonerDilemma()
+	/**
+	    \brief Constructor
+	    \param newPayoffs The payoffs of the game
+	*/
+	PrisonerDilemma(const PayoffTable &newPayoffs = PayoffTable()) : payoffs(newPayoffs)
 	{ gameMoves = wxT("CD"); }
 	virtual ~PrisonerDilemma() { }
+	
+	virtual Game *Clone() const
+	{ return new PrisonerDilemma(*this); }
+	
+	/**
+	    \brief Get the payoffs of the game
+	    \returns The payoff table
+	*/
+	const PayoffTable &GetPayoffs() const
+	{ return payoffs; }
+	
+	/**
+	    \brief Set the payoffs of the game
+	    \param newPayoffs The payoff table
+	*/
+	void SetPayoffs(const PayoffTable &newPayoffs)
+	{ payoffs = newPayoffs; }
 
 protected:
 	virtual void GetGamePayoff(const Player *playerOne, int &playerOneScore,
 	                           const Player *playerTwo, int &playerTwoScore);
+	
+private:
+	/**
+	    \brief The payoffs of the game
+	*/
+	PayoffTable payoffs;
 };
 
 
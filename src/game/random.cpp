@@ -31,14 +31,13 @@
 #  include <TestHarness.h>
 #endif
 
-#include "../common/rng.h"
 #include "random.h"
 #include "game.h"
 
 
 bool RandomPlayer::Think(const Game *gamePlayed, const Player * WXUNUSED(nextOpponent))
 {
-	float randomNumber = Random::GenerateFloatHigh() * 
+	float randomNumber = gamePlayed->GenerateFloat() * 
 		(float)gamePlayed->GetGameMoves().Length();
 	int moveToChoose = (int)floor(randomNumber);
 	
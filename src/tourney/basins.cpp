@@ -0,0 +1,535 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#include <algorithm>
+#include <math.h>
+
+#ifdef BUILD_TESTS
+#  include <TestHarness.h>
+#endif
+
+#include "../common/error.h"
+#include "../common/kernels.h"
+#include "../common/outputfile.h"
+#include "../common/progress.h"
+#include "../common/rng.h"
+#include "basins.h"
+#include "mutation.h"
+#include "payoffmatrix.h"
+
+
+// Populations which settle down closer together than this (in every
+// type's fraction) are at the same attractor
+static const double attractorDistance = 1e-3;
+
+
+// Get the first count prime numbers, for the Halton sequence
+static void Primes(size_t count, std::vector<size_t> &primes)
+{
+	primes.clear();
+	for (size_t candidate = 2 ; primes.size() < count ; candidate++)
+	{
+		bool prime = true;
+		for (size_t i = 0 ; i < primes.size() && primes[i] * primes[i] <= candidate ; i++)
+		{
+			if (candidate % primes[i] == 0)
+			{
+				prime = false;
+				break;
+			}
+		}
+		
+		if (prime)
+			primes.push_back(candidate);
+	}
+}
+
+// Get element index of the van der Corput sequence in the given base
+static double Radical(size_t index, size_t base)
+{
+	double result = 0.0, scale = 1.0 / (double)base;
+	for ( ; index ; index /= base, scale /= (double)base)
+		result += (double)(index % base) * scale;
+	return result;
+}
+
+// Turn n - 1 numbers in [0, 1) into a point spread evenly over the
+// mixes of n players: the gaps between them, once they're sorted
+static void Spacings(std::vector<double> &cube, double *point, size_t n)
+{
+	std::sort(cube.begin(), cube.end());
+	
+	double last = 0.0;
+	for (size_t i = 0 ; i + 1 < n ; i++)
+	{
+		point[i] = cube[i] - last;
+		last = cube[i];
+	}
+	point[n - 1] = 1.0 - last;
+}
+
+// The number of ways to pick k things from n, as a double so that it
+// can't overflow
+static double Choose(size_t n, size_t k)
+{
+	double result = 1.0;
+	for (size_t i = 1 ; i <= k ; i++)
+		result = result * (double)(n - k + i) / (double)i;
+	return result;
+}
+
+
+void BasinMap::Sample()
+{
+	size_t n = numPlayers;
+	starts.clear();
+	
+	// With one player, there's only one mix
+	if (n == 1)
+	{
+		starts.assign(1, 1.0);
+		return;
+	}
+	
+	if (sampling == GRID)
+	{
+		// There are (R + n - 1 choose n - 1) mixes on a grid of spacing
+		// 1 / R
+		size_t r = 1;
+		while (Choose(r + n, n - 1) <= (double)numSamples)
+			r++;
+		
+		// Count through the ways of sharing R between the players,
+		// from everything on the first to everything on the last
+		std::vector<size_t> parts(n, 0);
+		parts[0] = r;
+		for (;;)
+		{
+			for (size_t i = 0 ; i < n ; i++)
+				starts.push_back((double)parts[i] / (double)r);
+			
+			if (parts[n - 1] == r)
+				break;
+			
+			size_t j = n - 2;
+			while (parts[j] == 0)
+				j--;
+			
+			parts[j]--;
+			size_t rest = parts[n - 1];
+			parts[n - 1] = 0;
+			parts[j + 1] += rest + 1;
+		}
+		
+		return;
+	}
+	
+	starts.resize(numSamples * n);
+	std::vector<double> cube(n - 1);
+	std::vector<size_t> primes;
+	if (sampling == QUASIRANDOM)
+		Primes(n - 1, primes);
+	
+	for (size_t p = 0 ; p < numSamples ; p++)
+	{
+		if (sampling == QUASIRANDOM)
+		{
+			// Skip the first point of the sequence, which is all zeros
+			for (size_t d = 0 ; d + 1 < n ; d++)
+				cube[d] = Radical(p + 1, primes[d]);
+		}
+		else
+		{
+			for (size_t d = 0 ; d + 1 < n ; d++)
+				cube[d] = Random::HashToFloat(Random::Hash(seed ^ Random::Hash(p * n + d)));
+		}
+		
+		Spacings(cube, &starts[p * n], n);
+	}
+}
+
+bool BasinMap::Compute(const PayoffMatrix &payoffs, const MutationMatrix &mutation, Progress *progress)
+{
+	numPlayers = 0;
+	starts.clear();
+	attractorOf.clear();
+	attractors.clear();
+	basinSizes.clear();
+	numUnconverged = 0;
+	
+	size_t n = payoffs.GetSize();
+	if (!n)
+	{
+		Error::Set(_("There are no players to map"));
+		return false;
+	}
+	if (!mutation.IsEmpty() && mutation.GetSize() != n)
+	{
+		Error::Set(_("The mutation matrix doesn't match the players in the tournament"));
+		return false;
+	}
+	if (!numSamples)
+	{
+		Error::Set(_("Ask for at least one starting point"));
+		return false;
+	}
+	
+	numPlayers = n;
+	Sample();
+	size_t numPoints = starts.size() / n;
+	
+	// Merge the players into types, unless mutation tells them apart
+	std::vector<size_t> typeOf(n);
+	size_t numTypes = n;
+	if (mutation.IsEmpty())
+		numTypes = payoffs.FindTypes(typeOf);
+	else
+	{
+		for (size_t i = 0 ; i < n ; i++)
+			typeOf[i] = i;
+	}
+	
+	std::vector<size_t> first(numTypes, n);
+	std::vector<double> typeCount(numTypes, 0.0);
+	for (size_t i = n ; i-- > 0 ; )
+	{
+		first[typeOf[i]] = i;
+		typeCount[typeOf[i]] += 1.0;
+	}
+	
+	std::vector<double> typePayoffs(numTypes * numTypes);
+	for (size_t t = 0 ; t < numTypes ; t++)
+		for (size_t u = 0 ; u < numTypes ; u++)
+			typePayoffs[t * numTypes + u] = payoffs.Get(first[t], first[u]);
+	
+	// The batch of points still evolving, one per row, and which
+	// starting point each row is
+	std::vector<double> x(numPoints * numTypes, 0.0), f(numPoints * numTypes);
+	std::vector<size_t> pointOf(numPoints);
+	for (size_t p = 0 ; p < numPoints ; p++)
+	{
+		for (size_t i = 0 ; i < n ; i++)
+			x[p * numTypes + typeOf[i]] += starts[p * n + i];
+		pointOf[p] = p;
+	}
+	
+	std::vector<double> finals(numPoints * numTypes);
+	std::vector<double> next(numTypes), parents(numTypes);
+	attractorOf.assign(numPoints, -1);
+	
+	if (progress)
+		progress->Start(maxGenerations);
+	
+	size_t numActive = numPoints;
+	for (int gen = 0 ; gen < maxGenerations && numActive ; gen++)
+	{
+		if (progress && progress->IsCancelled())
+		{
+			Error::Set(_("The basin mapping was cancelled"));
+			return false;
+		}
+		
+		// Everyone's fitness at every point at once
+		Kernels::MatMatT(&typePayoffs[0], numTypes, numTypes, &x[0], numActive, &f[0]);
+		
+		// Take a discrete step at each point (as in
+		// EvoTournament::DiscreteStep()), moving the points which
+		// haven't settled down yet to the front of the batch
+		size_t kept = 0;
+		for (size_t r = 0 ; r < numActive ; r++)
+		{
+			const double *row = &x[r * numTypes], *fit = &f[r * numTypes];
+			double mean = Kernels::Dot(row, fit, numTypes);
+			
+			if (mean <= 0.0)
+				next.assign(row, row + numTypes);
+			else if (mutation.IsEmpty())
+			{
+				for (size_t t = 0 ; t < numTypes ; t++)
+					next[t] = row[t] * fit[t] / mean;
+			}
+			else
+			{
+				for (size_t t = 0 ; t < numTypes ; t++)
+					parents[t] = row[t] * fit[t];
+				mutation.Apply(&parents[0], &next[0]);
+				for (size_t t = 0 ; t < numTypes ; t++)
+					next[t] /= mean;
+			}
+			
+			double distance = 0.0;
+			for (size_t t = 0 ; t < numTypes ; t++)
+				distance += (next[t] - row[t]) * (next[t] - row[t]) / typeCount[t];
+			
+			if (sqrt(distance) < tolerance)
+			{
+				std::copy(next.begin(), next.end(), finals.begin() + pointOf[r] * numTypes);
+				attractorOf[pointOf[r]] = 0;
+			}
+			else
+			{
+				std::copy(next.begin(), next.end(), x.begin() + kept * numTypes);
+				pointOf[kept++] = pointOf[r];
+			}
+		}
+		numActive = kept;
+		
+		if (progress)
+			progress->Advance();
+	}
+	
+	// Group the points which settled down by where they ended up
+	std::vector<size_t> representative, count;
+	std::vector<double> sums;
+	for (size_t p = 0 ; p < numPoints ; p++)
+	{
+		if (attractorOf[p] < 0)
+		{
+			numUnconverged++;
+			continue;
+		}
+		
+		const double *end = &finals[p * numTypes];
+		size_t a = 0;
+		for ( ; a < representative.size() ; a++)
+		{
+			const double *other = &finals[representative[a] * numTypes];
+			size_t t = 0;
+			while (t < numTypes && fabs(end[t] - other[t]) < attractorDistance)
+				t++;
+			if (t == numTypes)
+				break;
+		}
+		
+		if (a == representative.size())
+		{
+			representative.push_back(p);
+			count.push_back(0);
+			sums.resize(sums.size() + numTypes, 0.0);
+		}
+		
+		attractorOf[p] = (int)a;
+		count[a]++;
+		for (size_t t = 0 ; t < numTypes ; t++)
+			sums[a * numTypes + t] += end[t];
+	}
+	
+	// Put the biggest basins first, keeping ties in the order found
+	std::vector<std::pair<size_t, size_t> > order(count.size());
+	for (size_t a = 0 ; a < count.size() ; a++)
+		order[a] = std::make_pair(numPoints - count[a], a);
+	std::sort(order.begin(), order.end());
+	
+	std::vector<int> newIndex(count.size());
+	attractors.resize(count.size() * n);
+	basinSizes.resize(count.size());
+	for (size_t k = 0 ; k < order.size() ; k++)
+	{
+		size_t a = order[k].second;
+		newIndex[a] = (int)k;
+		basinSizes[k] = (double)count[a] / (double)numPoints;
+		
+		// Report the average of the points which ended up there
+		for (size_t i = 0 ; i < n ; i++)
+			attractors[k * n + i] = sums[a * numTypes + typeOf[i]] / (double)count[a] / typeCount[typeOf[i]];
+	}
+	
+	for (size_t p = 0 ; p < numPoints ; p++)
+		if (attractorOf[p] >= 0)
+			attractorOf[p] = newIndex[attractorOf[p]];
+	
+	return true;
+}
+
+bool BasinMap::Write(const wxString &fileName, const PlayerPtrArray &players) const
+{
+	if (!numPlayers || players.GetCount() != numPlayers)
+	{
+		Error::Set(_("The basins have not been mapped"));
+		return false;
+	}
+	
+	OutputFile out;
+	if (!out.Open(fileName))
+		return false;
+	
+	// The attractors, biggest first
+	out.Write(_("Attractor"));
+	out.Write(',');
+	out.Write(_("Basin Size"));
+	for (size_t i = 0 ; i < numPlayers ; i++)
+	{
+		out.Write(',');
+		out.Write(players[i]->GetPlayerName());
+	}
+	out.EndLine();
+	
+	for (size_t a = 0 ; a < GetNumAttractors() ; a++)
+	{
+		out.WriteInt(a + 1);
+		out.Write(',');
+		out.WriteFloat(basinSizes[a]);
+		
+		const double *mix = GetAttractor(a);
+		for (size_t i = 0 ; i < numPlayers ; i++)
+		{
+			out.Write(',');
+			out.WriteFloat(mix[i]);
+		}
+		out.EndLine();
+	}
+	out.EndLine();
+	
+	// Every starting point and where it went
+	out.Write(_("Point"));
+	out.Write(',');
+	out.Write(_("Attractor"));
+	for (size_t i = 0 ; i < numPlayers ; i++)
+	{
+		out.Write(',');
+		out.Write(players[i]->GetPlayerName());
+	}
+	out.EndLine();
+	
+	for (size_t p = 0 ; p < GetNumPoints() ; p++)
+	{
+		out.WriteInt(p + 1);
+		out.Write(',');
+		if (attractorOf[p] >= 0)
+			out.WriteInt(attractorOf[p] + 1);
+		
+		const double *start = GetStart(p);
+		for (size_t i = 0 ; i < numPlayers ; i++)
+		{
+			out.Write(',');
+			out.WriteFloat(start[i]);
+		}
+		out.EndLine();
+	}
+	
+	return out.Close();
+}
+
+
+/** \cond TEST */
+#ifdef BUILD_TESTS
+
+// Map the basins of the symmetric game with the given payoffs
+static bool TestMap(BasinMap &map, size_t size, const double *values)
+{
+	PayoffMatrix matrix;
+	MutationMatrix mutation;
+	matrix.Assign(size, values);
+	return map.Compute(matrix, mutation);
+}
+
+TEST(BasinMap, Sampling)
+{
+	const double zeros[9] = { 0 };
+	BasinMap map;
+	map.SetMaxGenerations(0);
+	
+	// A grid of spacing 1/3 on three players has ten points
+	map.SetSampling(BasinMap::GRID);
+	map.SetNumSamples(14);
+	CHECK(TestMap(map, 3, zeros));
+	CHECK_EQUAL(10, (int)map.GetNumPoints());
+	CHECK_EQUAL(1.0, map.GetStart(0)[0]);
+	CHECK_EQUAL(1.0, map.GetStart(9)[2]);
+	CHECK_EQUAL(10, (int)map.GetNumUnconverged());
+	
+	const BasinMap::Sampling methods[3] = { BasinMap::GRID, BasinMap::RANDOM, BasinMap::QUASIRANDOM };
+	map.SetNumSamples(500);
+	for (size_t m = 0 ; m < 3 ; m++)
+	{
+		map.SetSampling(methods[m]);
+		CHECK(TestMap(map, 3, zeros));
+		CHECK(map.GetNumPoints() <= 500);
+		
+		// Every point is a mix of the players, and they cover them
+		double mean = 0.0;
+		for (size_t p = 0 ; p < map.GetNumPoints() ; p++)
+		{
+			const double *start = map.GetStart(p);
+			CHECK(start[0] >= 0.0 && start[1] >= 0.0 && start[2] >= 0.0);
+			CHECK(fabs(start[0] + start[1] + start[2] - 1.0) < 1e-12);
+			mean += start[1];
+		}
+		mean /= map.GetNumPoints();
+		CHECK(fabs(mean - 1.0 / 3.0) < 0.05);
+	}
+}
+
+TEST(BasinMap, StagHunt)
+{
+	// Starting with more than two thirds stags, everyone hunts stags,
+	// and otherwise everyone hunts hares
+	const double stagHunt[4] = { 3, 0,
+	                             2, 2 };
+	BasinMap map;
+	map.SetSampling(BasinMap::GRID);
+	map.SetNumSamples(101);
+	CHECK(TestMap(map, 2, stagHunt));
+	
+	CHECK_EQUAL(101, (int)map.GetNumPoints());
+	CHECK_EQUAL(0, (int)map.GetNumUnconverged());
+	CHECK_EQUAL(2, (int)map.GetNumAttractors());
+	CHECK(fabs(map.GetAttractor(0)[1] - 1.0) < 1e-3);
+	CHECK(fabs(map.GetBasinSize(0) - 67.0 / 101.0) < 1e-12);
+	CHECK(fabs(map.GetAttractor(1)[0] - 1.0) < 1e-3);
+	CHECK(fabs(map.GetBasinSize(1) - 34.0 / 101.0) < 1e-12);
+	
+	for (size_t p = 0 ; p < map.GetNumPoints() ; p++)
+		CHECK_EQUAL(map.GetStart(p)[0] > 2.0 / 3.0 ? 1 : 0, map.GetAttractorOf(p));
+	
+	// Rock-paper-scissors slowly spirals out from inside the triangle,
+	// while the edges end up at the corners
+	const double rps[9] = { 10,  9, 11,
+	                        11, 10,  9,
+	                         9, 11, 10 };
+	map.SetNumSamples(15);
+	CHECK(TestMap(map, 3, rps));
+	CHECK_EQUAL(15, (int)map.GetNumPoints());
+	CHECK_EQUAL(3, (int)map.GetNumUnconverged());
+	CHECK_EQUAL(3, (int)map.GetNumAttractors());
+	CHECK(fabs(map.GetBasinSize(0) - 4.0 / 15.0) < 1e-12);
+	
+	// Equivalent players are mapped together
+	const double twice[9] = { 3, 3, 0,
+	                          3, 3, 0,
+	                          2, 2, 2 };
+	map.SetSampling(BasinMap::RANDOM);
+	map.SetNumSamples(300);
+	CHECK(TestMap(map, 3, twice));
+	CHECK_EQUAL(2, (int)map.GetNumAttractors());
+	CHECK(fabs(map.GetAttractor(0)[0] - map.GetAttractor(0)[1]) < 1e-12);
+}
+
+#endif
+/** \endcond */
@@ -0,0 +1,301 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TOURNEY_BASINS_H__
+#define TOURNEY_BASINS_H__
+
+#include <vector>
+#include "../game/player.h"
+class MutationMatrix;
+class PayoffMatrix;
+class Progress;
+
+
+/**
+    \class BasinMap
+    \ingroup tourney
+    
+    \brief Finds where populations starting from many different mixes
+           of players end up
+    
+    An evolutionary tournament starts with every player equally common,
+    but where it ends up can depend a great deal on where it starts.
+    This class picks a set of starting points spread over every possible
+    mix of the players (see \c Sampling), evolves them all in discrete
+    generations (see \c EvoTournament::DISCRETE), and groups them by the
+    population each one settles down to, its attractor.  The fraction
+    of the starting points which end up at each attractor estimates the
+    size of its basin of attraction.
+    
+    The starting points are evolved together, as the rows of a matrix,
+    so that each generation is one matrix product (see
+    \c Kernels::MatMatT) rather than a product for every point, and
+    points drop out of the batch as they settle down.  Players which do
+    exactly as well as each other against everyone are merged (see
+    \c PayoffMatrix::FindTypes), unless there is mutation.
+*/
+class BasinMap
+{
+public:
+	/**
+	    \brief How the starting points are picked
+	*/
+	enum Sampling
+	{
+		/**
+		    Every mix in which each player's fraction is a multiple of
+		    <tt>1 / R</tt>, with \c R as large as possible without making
+		    more points than GetNumSamples().
+		*/
+		GRID,
+		
+		/**
+		    Points picked at random, evenly over every possible mix
+		    (see SetSeed()).
+		*/
+		RANDOM,
+		
+		/**
+		    Points from the Halton sequence, which cover the mixes more
+		    evenly than random points, without the grid's jumps in the
+		    number of points.
+		*/
+		QUASIRANDOM
+	};
+	
+	/**
+	    \brief Constructor
+	*/
+	BasinMap() : sampling(RANDOM), numSamples(1000), maxGenerations(1000),
+	             tolerance(1e-8), seed(0), numPlayers(0), numUnconverged(0) { }
+	
+	/**
+	    \brief Evolve every starting point and group them by attractor
+	    
+	    \param payoffs The payoff matrix of the players
+	    \param mutation The mutation matrix, which may be empty
+	    \param progress If not \c NULL, counts the generations run and
+	                    may be used to cancel the mapping
+	    \returns True if successful, false otherwise
+	*/
+	bool Compute(const PayoffMatrix &payoffs, const MutationMatrix &mutation, Progress *progress = NULL);
+	
+	/**
+	    \brief Write the results as a CSV file
+	    
+	    The file holds the attractors, with their basin sizes and the
+	    fraction of each player at each of them, followed by every
+	    starting point, with the attractor it went to (left empty if
+	    it never settled down).  Attractors are numbered from one.
+	    
+	    \param fileName The file to be written
+	    \param players The players, for their names
+	    \returns True if the file was written, false otherwise
+	*/
+	bool Write(const wxString &fileName, const PlayerPtrArray &players) const;
+	
+	
+	/**
+	    \brief Set how the starting points are picked
+	    \param newSampling The sampling method
+	*/
+	void SetSampling(Sampling newSampling) { sampling = newSampling; }
+	
+	/**
+	    \brief Get how the starting points are picked
+	    \returns The sampling method
+	*/
+	Sampling GetSampling() const { return sampling; }
+	
+	/**
+	    \brief Set the number of starting points
+	    
+	    The \c GRID sampling may make fewer points than this.
+	    
+	    \param newNumSamples The number of starting points
+	*/
+	void SetNumSamples(size_t newNumSamples) { numSamples = newNumSamples; }
+	
+	/**
+	    \brief Get the number of starting points asked for
+	    \returns The number of starting points
+	*/
+	size_t GetNumSamples() const { return numSamples; }
+	
+	/**
+	    \brief Set the longest each point is evolved for
+	    
+	    Points which haven't settled down by then (such as those going
+	    round a cycle) aren't given an attractor.
+	    
+	    \param generations The number of generations
+	*/
+	void SetMaxGenerations(int generations) { maxGenerations = generations; }
+	
+	/**
+	    \brief Get the longest each point is evolved for
+	    \returns The number of generations
+	*/
+	int GetMaxGenerations() const { return maxGenerations; }
+	
+	/**
+	    \brief Set how little a point must move in a generation to have
+	           settled down
+	    
+	    This is measured as in \c EvoTournament::tolerance.
+	    
+	    \param newTolerance The convergence tolerance
+	*/
+	void SetTolerance(double newTolerance) { tolerance = newTolerance; }
+	
+	/**
+	    \brief Get the convergence tolerance
+	    \returns The convergence tolerance
+	*/
+	double GetTolerance() const { return tolerance; }
+	
+	/**
+	    \brief Set the seed for the \c RANDOM starting points
+	    \param newSeed The seed
+	*/
+	void SetSeed(wxUint64 newSeed) { seed = newSeed; }
+	
+	
+	/**
+	    \brief Get the number of starting points evolved
+	    \returns Number of starting points
+	*/
+	size_t GetNumPoints() const { return attractorOf.size(); }
+	
+	/**
+	    \brief Get a starting point
+	    \param point Index of the starting point
+	    \returns The fraction of each player at the start
+	*/
+	const double *GetStart(size_t point) const { return &starts[point * numPlayers]; }
+	
+	/**
+	    \brief Get the attractor a starting point ended up at
+	    \param point Index of the starting point
+	    \returns Index of the attractor, or -1 if the point never settled
+	             down
+	*/
+	int GetAttractorOf(size_t point) const { return attractorOf[point]; }
+	
+	/**
+	    \brief Get the number of points which never settled down
+	    \returns Number of starting points without an attractor
+	*/
+	size_t GetNumUnconverged() const { return numUnconverged; }
+	
+	/**
+	    \brief Get the number of attractors found
+	    \returns Number of attractors
+	*/
+	size_t GetNumAttractors() const { return basinSizes.size(); }
+	
+	/**
+	    \brief Get an attractor
+	    
+	    Attractors are sorted from the largest basin to the smallest.
+	    Players of the same type share their type's fraction equally,
+	    since how it is really split between them depends only on where
+	    the population started.
+	    
+	    \param attractor Index of the attractor
+	    \returns The fraction of each player at the attractor
+	*/
+	const double *GetAttractor(size_t attractor) const { return &attractors[attractor * numPlayers]; }
+	
+	/**
+	    \brief Get the size of an attractor's basin
+	    \param attractor Index of the attractor
+	    \returns The fraction of the starting points which ended up there
+	*/
+	double GetBasinSize(size_t attractor) const { return basinSizes[attractor]; }
+
+private:
+	/**
+	    \brief Pick the starting points into \c starts
+	*/
+	void Sample();
+	
+	/**
+	    \brief How the starting points are picked
+	*/
+	Sampling sampling;
+	
+	/**
+	    \brief Number of starting points asked for
+	*/
+	size_t numSamples;
+	
+	/**
+	    \brief Longest each point is evolved for
+	*/
+	int maxGenerations;
+	
+	/**
+	    \brief Convergence tolerance
+	*/
+	double tolerance;
+	
+	/**
+	    \brief Seed for the \c RANDOM starting points
+	*/
+	wxUint64 seed;
+	
+	/**
+	    \brief Number of players mapped
+	*/
+	size_t numPlayers;
+	
+	/**
+	    \brief The starting points, one row of player fractions each
+	*/
+	std::vector<double> starts;
+	
+	/**
+	    \brief The attractor of each starting point, or -1
+	*/
+	std::vector<int> attractorOf;
+	
+	/**
+	    \brief Number of points which never settled down
+	*/
+	size_t numUnconverged;
+	
+	/**
+	    \brief The attractors, one row of player fractions each
+	*/
+	std::vector<double> attractors;
+	
+	/**
+	    \brief Fraction of the starting points ending up at each
+	           attractor
+	*/
+	std::vector<double> basinSizes;
+};
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,795 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#include <wx/thread.h>
+
+#include <algorithm>
+#include <math.h>
+
+#ifdef BUILD_TESTS
+#  include <TestHarness.h>
+#endif
+
+#include "../common/error.h"
+#include "../common/parallel.h"
+#include "../common/progress.h"
+#include "equilibrium.h"
+#include "payoffmatrix.h"
+
+
+// How close two values must be to count as equal.  The game is
+// rescaled so that every payoff is between zero and one.
+static const double epsilon = 1e-9;
+
+// Pivots smaller than this make a linear system singular
+static const double pivotEpsilon = 1e-12;
+
+// Most best replies outside an equilibrium's support for which its
+// stability is worked out (each one doubles the work); equilibria with
+// more are reported as unstable
+static const size_t maxExtraReplies = 16;
+
+
+/**
+    \brief The game left after merging types and removing dominated
+           players, rescaled to payoffs between zero and one
+*/
+struct ReducedGame
+{
+	size_t size;
+	std::vector<double> a;
+	
+	double Get(size_t i, size_t j) const { return a[i * size + j]; }
+};
+
+/**
+    \brief An equilibrium of a \c ReducedGame
+*/
+struct Candidate
+{
+	std::vector<size_t> support;
+	std::vector<double> x;
+};
+
+static bool CandidateLess(const Candidate &a, const Candidate &b)
+{
+	if (a.support.size() != b.support.size())
+		return a.support.size() < b.support.size();
+	if (a.support != b.support)
+		return a.support < b.support;
+	return a.x < b.x;
+}
+
+
+// Solve the n-by-n system m x = b by Gaussian elimination with partial
+// pivoting, leaving x in b
+static bool SolveLinear(std::vector<double> &m, std::vector<double> &b, size_t n)
+{
+	for (size_t c = 0 ; c < n ; c++)
+	{
+		size_t p = c;
+		for (size_t r = c + 1 ; r < n ; r++)
+			if (fabs(m[r * n + c]) > fabs(m[p * n + c]))
+				p = r;
+		
+		if (fabs(m[p * n + c]) < pivotEpsilon)
+			return false;
+		
+		if (p != c)
+		{
+			for (size_t k = c ; k < n ; k++)
+				std::swap(m[p * n + k], m[c * n + k]);
+			std::swap(b[p], b[c]);
+		}
+		
+		for (size_t r = c + 1 ; r < n ; r++)
+		{
+			double f = m[r * n + c] / m[c * n + c];
+			if (f == 0.0)
+				continue;
+			
+			for (size_t k = c ; k < n ; k++)
+				m[r * n + k] -= f * m[c * n + k];
+			b[r] -= f * b[c];
+		}
+	}
+	
+	for (size_t c = n ; c-- > 0 ; )
+	{
+		double sum = b[c];
+		for (size_t k = c + 1 ; k < n ; k++)
+			sum -= m[c * n + k] * b[k];
+		b[c] = sum / m[c * n + c];
+	}
+	
+	return true;
+}
+
+// Is x a symmetric equilibrium of the game?  If so, set v to its payoff.
+static bool IsEquilibrium(const ReducedGame &game, const std::vector<double> &x, double &v)
+{
+	std::vector<double> ax(game.size, 0.0);
+	v = 0.0;
+	
+	for (size_t i = 0 ; i < game.size ; i++)
+	{
+		for (size_t j = 0 ; j < game.size ; j++)
+			ax[i] += game.Get(i, j) * x[j];
+		v += x[i] * ax[i];
+	}
+	
+	// Nobody does better than the mixture, and everyone in it does as
+	// well
+	for (size_t i = 0 ; i < game.size ; i++)
+		if (ax[i] > v + epsilon || (x[i] > epsilon && ax[i] < v - epsilon))
+			return false;
+	
+	return true;
+}
+
+// Is the (symmetric) matrix p strictly copositive, that is, is
+// a^T p a > 0 for every nonzero a >= 0?  The smallest value on the
+// simplex is found at a critical point in the interior of one of its
+// faces, so try each face.
+static bool IsCopositive(const std::vector<double> &p, size_t n)
+{
+	for (unsigned long mask = 1 ; mask < (1UL << n) ; mask++)
+	{
+		std::vector<size_t> face;
+		for (size_t i = 0 ; i < n ; i++)
+			if (mask & (1UL << i))
+				face.push_back(i);
+		
+		// p_KK a = lambda 1, sum a = 1, and then a^T p a = lambda
+		size_t k = face.size();
+		std::vector<double> m((k + 1) * (k + 1), 0.0), b(k + 1, 0.0);
+		for (size_t r = 0 ; r < k ; r++)
+		{
+			for (size_t c = 0 ; c < k ; c++)
+				m[r * (k + 1) + c] = p[face[r] * n + face[c]];
+			m[r * (k + 1) + k] = -1.0;
+			m[k * (k + 1) + r] = 1.0;
+		}
+		b[k] = 1.0;
+		
+		// Faces without a single critical point have their smallest
+		// value on a smaller face
+		if (!SolveLinear(m, b, k + 1))
+			continue;
+		
+		bool interior = true;
+		for (size_t r = 0 ; r < k && interior ; r++)
+			interior = (b[r] > epsilon);
+		
+		if (interior && b[k] <= epsilon)
+			return false;
+	}
+	
+	return true;
+}
+
+// Is the equilibrium x, with payoff v, evolutionarily stable?
+//
+// Mutants near x differ from it by some z with sum zero, which may be
+// negative only on the support S of x.  Those which also play only best
+// replies (S and the extra best replies J) do as well as x against x,
+// so x has to do better against them: z^T A z < 0.  Writing z as w in
+// the span of e_i - e_s (i in S) plus nonnegative multiples a_j of
+// e_j - e_s (j in J), the form has to be negative definite in w, and
+// then its largest value for each a, a^T C a, must be negative, where C
+// is a Schur complement.
+static bool IsStable(const ReducedGame &game, const std::vector<double> &x, double v)
+{
+	std::vector<size_t> directions, extra;
+	size_t s = game.size;
+	
+	for (size_t i = 0 ; i < game.size ; i++)
+	{
+		double ax = 0.0;
+		for (size_t j = 0 ; j < game.size ; j++)
+			ax += game.Get(i, j) * x[j];
+		
+		if (x[i] > epsilon)
+		{
+			if (s == game.size)
+				s = i;
+			else
+				directions.push_back(i);
+		}
+		else if (fabs(ax - v) <= epsilon)
+			extra.push_back(i);
+	}
+	
+	if (extra.size() > maxExtraReplies)
+		return false;
+	
+	size_t numSupport = directions.size(), numExtra = extra.size();
+	directions.insert(directions.end(), extra.begin(), extra.end());
+	size_t n = directions.size();
+	
+	// g = R^T M R, with M the symmetric part of A and the columns of R
+	// the directions above
+	std::vector<double> g(n * n);
+	for (size_t a = 0 ; a < n ; a++)
+	{
+		for (size_t b = 0 ; b < n ; b++)
+		{
+			size_t i = directions[a], j = directions[b];
+			g[a * n + b] = 0.5 * (game.Get(i, j) + game.Get(j, i)) - 0.5 * (game.Get(i, s) + game.Get(s, i)) -
+			               0.5 * (game.Get(s, j) + game.Get(j, s)) + game.Get(s, s);
+		}
+	}
+	
+	// Negative definite on the support (by Cholesky factorization)
+	std::vector<double> l(numSupport * numSupport, 0.0);
+	for (size_t i = 0 ; i < numSupport ; i++)
+	{
+		for (size_t j = 0 ; j <= i ; j++)
+		{
+			double sum = -g[i * n + j];
+			for (size_t k = 0 ; k < j ; k++)
+				sum -= l[i * numSupport + k] * l[j * numSupport + k];
+			
+			if (i == j)
+			{
+				if (sum <= epsilon)
+					return false;
+				l[i * numSupport + i] = sqrt(sum);
+			}
+			else
+				l[i * numSupport + j] = sum / l[j * numSupport + j];
+		}
+	}
+	
+	if (!numExtra)
+		return true;
+	
+	// -C = -(g_JJ - g_JS g_SS^-1 g_SJ) has to be strictly copositive
+	std::vector<double> p(numExtra * numExtra);
+	for (size_t b = 0 ; b < numExtra ; b++)
+	{
+		std::vector<double> y(numSupport);
+		if (numSupport)
+		{
+			std::vector<double> gss(numSupport * numSupport);
+			for (size_t i = 0 ; i < numSupport ; i++)
+			{
+				for (size_t j = 0 ; j < numSupport ; j++)
+					gss[i * numSupport + j] = g[i * n + j];
+				y[i] = g[i * n + numSupport + b];
+			}
+			
+			if (!SolveLinear(gss, y, numSupport))
+				return false;
+		}
+		
+		for (size_t a = 0 ; a < numExtra ; a++)
+		{
+			double c = g[(numSupport + a) * n + numSupport + b];
+			for (size_t k = 0 ; k < numSupport ; k++)
+				c -= g[(numSupport + a) * n + k] * y[k];
+			p[a * numExtra + b] = -c;
+		}
+	}
+	
+	return IsCopositive(p, numExtra);
+}
+
+// Follow the Lemke-Howson path from the artificial equilibrium, dropping
+// the given label.  The symmetric version works on the polytope
+// {x >= 0 : B x <= 1}, where B = A + 1 is positive; its completely
+// labeled vertices, scaled to sum to one, are the symmetric equilibria.
+static bool LemkeHowson(const ReducedGame &game, size_t label, std::vector<double> &x)
+{
+	size_t m = game.size, width = 2 * m + 1;
+	
+	// Row r reads B_r x + s_r = 1, with the slacks s basic to start
+	std::vector<double> t(m * width, 0.0);
+	std::vector<size_t> basis(m);
+	for (size_t r = 0 ; r < m ; r++)
+	{
+		for (size_t j = 0 ; j < m ; j++)
+			t[r * width + j] = game.Get(r, j) + 1.0;
+		t[r * width + m + r] = 1.0;
+		t[r * width + 2 * m] = 1.0;
+		basis[r] = m + r;
+	}
+	
+	size_t entering = label;
+	size_t maxPivots = 100 * m + 1000;
+	
+	for (size_t pivots = 0 ; ; pivots++)
+	{
+		if (pivots >= maxPivots)
+			return false;
+		
+		// Lexicographic minimum ratio test, which breaks ties the same
+		// way every time, so the path can't cycle in degenerate games
+		size_t row = m;
+		for (size_t r = 0 ; r < m ; r++)
+		{
+			double pivot = t[r * width + entering];
+			if (pivot <= pivotEpsilon)
+				continue;
+			
+			if (row == m)
+			{
+				row = r;
+				continue;
+			}
+			
+			double best = t[row * width + entering];
+			for (size_t k = 0 ; k <= m ; k++)
+			{
+				size_t col = k ? m + k - 1 : 2 * m;
+				double a = t[r * width + col] / pivot, b = t[row * width + col] / best;
+				
+				if (a < b - pivotEpsilon)
+				{
+					row = r;
+					break;
+				}
+				if (a > b + pivotEpsilon)
+					break;
+			}
+		}
+		
+		// The polytope is bounded, so this shouldn't happen
+		if (row == m)
+			return false;
+		
+		double pivot = t[row * width + entering];
+		for (size_t k = 0 ; k < width ; k++)
+			t[row * width + k] /= pivot;
+		
+		for (size_t r = 0 ; r < m ; r++)
+		{
+			double f = t[r * width + entering];
+			if (r == row || f == 0.0)
+				continue;
+			for (size_t k = 0 ; k < width ; k++)
+				t[r * width + k] -= f * t[row * width + k];
+		}
+		
+		size_t leaving = basis[row];
+		basis[row] = entering;
+		
+		// Once the dropped label comes back, every label is there
+		if (leaving == label || leaving == label + m)
+			break;
+		
+		entering = (leaving < m) ? leaving + m : leaving - m;
+	}
+	
+	x.assign(m, 0.0);
+	double total = 0.0;
+	for (size_t r = 0 ; r < m ; r++)
+	{
+		if (basis[r] < m)
+		{
+			x[basis[r]] = t[r * width + 2 * m];
+			total += x[basis[r]];
+		}
+	}
+	
+	if (total <= 0.0)
+		return false;
+	
+	for (size_t i = 0 ; i < m ; i++)
+		x[i] /= total;
+	
+	return true;
+}
+
+
+/**
+    \brief Tries every support of up to a given size, with the first
+           player of each support handed out to the threads
+*/
+class SupportTask : public ParallelTask
+{
+public:
+	SupportTask(const ReducedGame &g, size_t max, Progress *p, std::vector<Candidate> &f, wxCriticalSection &l) :
+		game(g), maxSize(max), progress(p), found(f), lock(l)
+	{ }
+	
+	virtual bool Run(size_t begin, size_t end)
+	{
+		size_t m = game.size;
+		
+		for (size_t first = begin ; first < end ; first++)
+		{
+			std::vector<size_t> support(1, first);
+			TrySupport(support);
+			
+			for (size_t k = 2 ; k <= maxSize && first + k <= m ; k++)
+			{
+				support.resize(k);
+				for (size_t s = 1 ; s < k ; s++)
+					support[s] = first + s;
+				
+				for (size_t tries = 1 ; ; tries++)
+				{
+					if (tries % 4096 == 0 && progress && progress->IsCancelled())
+					{
+						Error::Set(_("The search for equilibria was cancelled"));
+						return false;
+					}
+					
+					TrySupport(support);
+					
+					// Move on to the next combination
+					size_t s = k - 1;
+					while (s >= 1 && support[s] == m - k + s)
+						s--;
+					if (s == 0)
+						break;
+					
+					support[s]++;
+					for (size_t t = s + 1 ; t < k ; t++)
+						support[t] = support[t - 1] + 1;
+				}
+			}
+			
+			if (progress)
+				progress->Advance();
+		}
+		
+		return true;
+	}
+	
+private:
+	// Every player in the support has to score the same against the
+	// mixture, and nobody else can do better
+	void TrySupport(const std::vector<size_t> &support)
+	{
+		size_t k = support.size();
+		std::vector<double> m((k + 1) * (k + 1), 0.0), b(k + 1, 0.0);
+		
+		for (size_t r = 0 ; r < k ; r++)
+		{
+			for (size_t c = 0 ; c < k ; c++)
+				m[r * (k + 1) + c] = game.Get(support[r], support[c]);
+			m[r * (k + 1) + k] = -1.0;
+			m[k * (k + 1) + r] = 1.0;
+		}
+		b[k] = 1.0;
+		
+		if (!SolveLinear(m, b, k + 1))
+			return;
+		
+		for (size_t r = 0 ; r < k ; r++)
+			if (b[r] <= epsilon)
+				return;
+		
+		Candidate candidate;
+		candidate.support = support;
+		candidate.x.assign(game.size, 0.0);
+		for (size_t r = 0 ; r < k ; r++)
+			candidate.x[support[r]] = b[r];
+		
+		double v;
+		if (!IsEquilibrium(game, candidate.x, v))
+			return;
+		
+		wxCriticalSectionLocker locker(lock);
+		found.push_back(candidate);
+	}
+	
+	const ReducedGame &game;
+	size_t maxSize;
+	Progress *progress;
+	std::vector<Candidate> &found;
+	wxCriticalSection &lock;
+};
+
+/**
+    \brief Follows the Lemke-Howson path from each label
+*/
+class LemkeHowsonTask : public ParallelTask
+{
+public:
+	LemkeHowsonTask(const ReducedGame &g, Progress *p, std::vector<Candidate> &f, wxCriticalSection &l) :
+		game(g), progress(p), found(f), lock(l)
+	{ }
+	
+	virtual bool Run(size_t begin, size_t end)
+	{
+		for (size_t label = begin ; label < end ; label++)
+		{
+			if (progress && progress->IsCancelled())
+			{
+				Error::Set(_("The search for equilibria was cancelled"));
+				return false;
+			}
+			
+			Candidate candidate;
+			double v;
+			if (LemkeHowson(game, label, candidate.x) && IsEquilibrium(game, candidate.x, v))
+			{
+				for (size_t i = 0 ; i < game.size ; i++)
+					if (candidate.x[i] > epsilon)
+						candidate.support.push_back(i);
+				
+				wxCriticalSectionLocker locker(lock);
+				found.push_back(candidate);
+			}
+			
+			if (progress)
+				progress->Advance();
+		}
+		
+		return true;
+	}
+	
+private:
+	const ReducedGame &game;
+	Progress *progress;
+	std::vector<Candidate> &found;
+	wxCriticalSection &lock;
+};
+
+
+void EquilibriumSolver::Clear()
+{
+	equilibria.clear();
+	dominated.clear();
+}
+
+bool EquilibriumSolver::Solve(const PayoffMatrix &payoffs, Progress *progress)
+{
+	Clear();
+	
+	size_t numPlayers = payoffs.GetSize();
+	std::vector<size_t> typeOf;
+	size_t numTypes = payoffs.FindTypes(typeOf);
+	
+	std::vector<size_t> firstOfType(numTypes, numPlayers), typeCount(numTypes, 0);
+	for (size_t i = numPlayers ; i-- > 0 ; )
+	{
+		firstOfType[typeOf[i]] = i;
+		typeCount[typeOf[i]]++;
+	}
+	
+	// Rescale the payoffs to [0, 1], which changes none of the answers
+	double low = 0.0, high = 0.0;
+	for (size_t t = 0 ; t < numTypes ; t++)
+	{
+		for (size_t u = 0 ; u < numTypes ; u++)
+		{
+			double value = payoffs.Get(firstOfType[t], firstOfType[u]);
+			if ((t == 0 && u == 0) || value < low)
+				low = value;
+			if ((t == 0 && u == 0) || value > high)
+				high = value;
+		}
+	}
+	double scale = (high > low) ? high - low : 1.0;
+	
+	// Nobody plays a strategy which does worse than another against
+	// everyone, so remove those until there are none left
+	std::vector<bool> alive(numTypes, true);
+	for (bool changed = true ; changed ; )
+	{
+		changed = false;
+		
+		for (size_t t = 0 ; t < numTypes ; t++)
+		{
+			for (size_t u = 0 ; u < numTypes && alive[t] ; u++)
+			{
+				if (u == t || !alive[u])
+					continue;
+				
+				bool better = true;
+				for (size_t k = 0 ; k < numTypes && better ; k++)
+					if (alive[k])
+						better = (payoffs.Get(firstOfType[u], firstOfType[k]) - 
+						          payoffs.Get(firstOfType[t], firstOfType[k]) > epsilon * scale);
+				
+				if (better)
+				{
+					alive[t] = false;
+					changed = true;
+				}
+			}
+		}
+	}
+	
+	std::vector<size_t> strategies;
+	for (size_t t = 0 ; t < numTypes ; t++)
+		if (alive[t])
+			strategies.push_back(t);
+	
+	dominated.resize(numPlayers);
+	for (size_t i = 0 ; i < numPlayers ; i++)
+		dominated[i] = !alive[typeOf[i]];
+	
+	ReducedGame game;
+	game.size = strategies.size();
+	game.a.resize(game.size * game.size);
+	for (size_t i = 0 ; i < game.size ; i++)
+		for (size_t j = 0 ; j < game.size ; j++)
+			game.a[i * game.size + j] = (payoffs.Get(firstOfType[strategies[i]], firstOfType[strategies[j]]) - low) / scale;
+	
+	if (progress)
+		progress->Start(2 * game.size);
+	
+	// Find the equilibria both ways
+	std::vector<Candidate> found;
+	wxCriticalSection lock;
+	SupportTask supportTask(game, maxSupport, progress, found, lock);
+	LemkeHowsonTask lemkeHowsonTask(game, progress, found, lock);
+	
+	if (!Parallel::For(game.size, &supportTask, 1) || !Parallel::For(game.size, &lemkeHowsonTask, 1))
+	{
+		Clear();
+		return false;
+	}
+	
+	// Put them in order, and throw out the ones found twice
+	std::sort(found.begin(), found.end(), CandidateLess);
+	
+	for (size_t c = 0 ; c < found.size() ; c++)
+	{
+		const Candidate &candidate = found[c];
+		
+		bool repeat = false;
+		for (size_t d = 0 ; d < c && !repeat ; d++)
+		{
+			if (found[d].support != candidate.support)
+				continue;
+			
+			repeat = true;
+			for (size_t i = 0 ; i < game.size && repeat ; i++)
+				repeat = (fabs(found[d].x[i] - candidate.x[i]) < 1e-6);
+		}
+		if (repeat)
+			continue;
+		
+		double v;
+		IsEquilibrium(game, candidate.x, v);
+		
+		Equilibrium equilibrium;
+		equilibrium.payoff = v * scale + low;
+		equilibrium.stable = IsStable(game, candidate.x, v);
+		equilibrium.mixture.assign(numPlayers, 0.0);
+		
+		for (size_t i = 0 ; i < game.size ; i++)
+		{
+			size_t t = strategies[i];
+			for (size_t p = 0 ; p < numPlayers ; p++)
+				if (typeOf[p] == t)
+					equilibrium.mixture[p] = candidate.x[i] / (double)typeCount[t];
+		}
+		
+		equilibria.push_back(equilibrium);
+	}
+	
+	return true;
+}
+
+
+
+/** \cond TEST */
+#ifdef BUILD_TESTS
+
+// Solve the symmetric game with the given payoffs
+static void TestSolve(EquilibriumSolver &solver, size_t size, const double *values)
+{
+	PayoffMatrix matrix;
+	matrix.Assign(size, values);
+	solver.Solve(matrix);
+}
+
+TEST(EquilibriumSolver, HawkDove)
+{
+	// Hawks beat doves, but fight each other; the only equilibrium is
+	// half of each, and it's stable
+	const double hawkDove[4] = { 0, 3,
+	                             1, 2 };
+	EquilibriumSolver solver;
+	TestSolve(solver, 2, hawkDove);
+	
+	CHECK_EQUAL(1, (int)solver.GetNumEquilibria());
+	const Equilibrium &mixed = solver.GetEquilibrium(0);
+	CHECK(fabs(mixed.mixture[0] - 0.5) < 1e-9);
+	CHECK(fabs(mixed.payoff - 1.5) < 1e-9);
+	CHECK(mixed.stable);
+	
+	// Lemke-Howson finds it even if the supports tried are too small
+	solver.SetMaxSupport(1);
+	TestSolve(solver, 2, hawkDove);
+	CHECK_EQUAL(1, (int)solver.GetNumEquilibria());
+	CHECK(fabs(solver.GetEquilibrium(0).mixture[1] - 0.5) < 1e-9);
+}
+
+TEST(EquilibriumSolver, Stability)
+{
+	// The stag hunt has two stable pure equilibria, with an unstable
+	// mixture between them
+	const double stagHunt[4] = { 3, 0,
+	                             2, 2 };
+	EquilibriumSolver solver;
+	TestSolve(solver, 2, stagHunt);
+	
+	CHECK_EQUAL(3, (int)solver.GetNumEquilibria());
+	CHECK_EQUAL(1.0, solver.GetEquilibrium(0).mixture[0]);
+	CHECK(solver.GetEquilibrium(0).stable);
+	CHECK_EQUAL(1.0, solver.GetEquilibrium(1).mixture[1]);
+	CHECK(solver.GetEquilibrium(1).stable);
+	CHECK(fabs(solver.GetEquilibrium(2).mixture[0] - 2.0 / 3.0) < 1e-9);
+	CHECK(!solver.GetEquilibrium(2).stable);
+	
+	// Rock-paper-scissors cycles around its equilibrium forever
+	const double rps[9] = {  0, -1,  1,
+	                         1,  0, -1,
+	                        -1,  1,  0 };
+	TestSolve(solver, 3, rps);
+	CHECK_EQUAL(1, (int)solver.GetNumEquilibria());
+	CHECK(fabs(solver.GetEquilibrium(0).mixture[2] - 1.0 / 3.0) < 1e-9);
+	CHECK(!solver.GetEquilibrium(0).stable);
+	
+	// Pure strategies with an equally good reply: stable only if the
+	// reply does worse against itself
+	const double better[4] = { 1, 1,
+	                           1, 0 };
+	TestSolve(solver, 2, better);
+	CHECK_EQUAL(1, (int)solver.GetNumEquilibria());
+	CHECK_EQUAL(1.0, solver.GetEquilibrium(0).mixture[0]);
+	CHECK(solver.GetEquilibrium(0).stable);
+	
+	const double worse[4] = { 1, 1,
+	                          1, 2 };
+	TestSolve(solver, 2, worse);
+	CHECK_EQUAL(2, (int)solver.GetNumEquilibria());
+	CHECK(!solver.GetEquilibrium(0).stable);
+	CHECK(solver.GetEquilibrium(1).stable);
+}
+
+TEST(EquilibriumSolver, Pruning)
+{
+	// In the prisoner's dilemma cooperation is dominated, and the two
+	// copies of defection share the equilibrium
+	const double dilemma[9] = { 3, 0, 0,
+	                            5, 1, 1,
+	                            5, 1, 1 };
+	EquilibriumSolver solver;
+	TestSolve(solver, 3, dilemma);
+	
+	CHECK(solver.IsDominated(0));
+	CHECK(!solver.IsDominated(1));
+	CHECK_EQUAL(1, (int)solver.GetNumEquilibria());
+	CHECK_EQUAL(0.0, solver.GetEquilibrium(0).mixture[0]);
+	CHECK_EQUAL(0.5, solver.GetEquilibrium(0).mixture[1]);
+	CHECK_EQUAL(1.0, solver.GetEquilibrium(0).payoff);
+	CHECK(solver.GetEquilibrium(0).stable);
+}
+
+#endif
+/** \endcond */
@@ -0,0 +1,174 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TOURNEY_EQUILIBRIUM_H__
+#define TOURNEY_EQUILIBRIUM_H__
+
+#include <vector>
+class PayoffMatrix;
+class Progress;
+
+
+/**
+    \struct Equilibrium
+    \ingroup tourney
+    
+    \brief A symmetric Nash equilibrium of the game between a list of
+           players
+*/
+struct Equilibrium
+{
+	/**
+	    \brief The fraction of the population playing each player
+	*/
+	std::vector<double> mixture;
+	
+	/**
+	    \brief The score of every player in the mixture against the
+	           mixture
+	*/
+	double payoff;
+	
+	/**
+	    \brief True if the mixture is an evolutionarily stable strategy
+	    
+	    That is, a population playing it can't be invaded by a small
+	    number of mutants playing any other mixture.
+	*/
+	bool stable;
+};
+
+
+/**
+    \class EquilibriumSolver
+    \ingroup tourney
+    
+    \brief Finds the stable mixtures of a list of players without
+           simulating them
+    
+    Treating the payoff matrix of a list of players as a symmetric
+    game, this finds its symmetric Nash equilibria, the mixtures of
+    players in which nobody can do better by switching, and checks
+    which of them are evolutionarily stable.  Those are where a
+    population evolving under the replicator equation may settle down.
+    
+    Players which always do equally well are first merged into one
+    (see \c PayoffMatrix::FindTypes), and players which do worse than
+    some other player against everyone are removed, repeatedly, since
+    they can't be part of any equilibrium.  The equilibria are then
+    found in two ways:
+    
+    - Every support (set of players with a share of the population) of
+      up to GetMaxSupport() players is tried in turn, split between
+      threads (see \c Parallel::For).  This finds every equilibrium
+      that uses that many players or fewer, other than those which
+      come in continuous families.
+    - The Lemke-Howson algorithm is followed from each player, which
+      always finds an equilibrium, however large its support.
+    
+    An equilibrium of merged players gives each of them an equal share
+    of their type's fraction.
+*/
+class EquilibriumSolver
+{
+public:
+	/**
+	    \brief Constructor
+	*/
+	EquilibriumSolver() : maxSupport(6) { }
+	
+	/**
+	    \brief Find the equilibria of a game
+	    
+	    \param payoffs The payoff matrix of the players
+	    \param progress If not \c NULL, counts the work done and may be
+	                    used to cancel the search
+	    \returns True if successful, false if cancelled
+	*/
+	bool Solve(const PayoffMatrix &payoffs, Progress *progress = NULL);
+	
+	/**
+	    \brief Throw away the equilibria found
+	*/
+	void Clear();
+	
+	
+	/**
+	    \brief Set the largest support tried by support enumeration
+	    
+	    The number of supports grows very quickly with this, and the
+	    number of players that remain after removing dominated ones.
+	    
+	    \param size Largest number of players in a support
+	*/
+	void SetMaxSupport(size_t size) { maxSupport = size; }
+	
+	/**
+	    \brief Get the largest support tried by support enumeration
+	    \returns Largest number of players in a support
+	*/
+	size_t GetMaxSupport() const { return maxSupport; }
+	
+	/**
+	    \brief Get the number of equilibria found
+	    \returns Number of equilibria
+	*/
+	size_t GetNumEquilibria() const { return equilibria.size(); }
+	
+	/**
+	    \brief Get one of the equilibria found
+	    
+	    Equilibria are sorted by the number of players they use.
+	    
+	    \param idx Index of the equilibrium
+	    \returns The equilibrium
+	*/
+	const Equilibrium &GetEquilibrium(size_t idx) const { return equilibria[idx]; }
+	
+	/**
+	    \brief Was a player removed for being dominated?
+	    
+	    \param player Index of the player
+	    \returns True if some other player always does better
+	*/
+	bool IsDominated(size_t player) const { return dominated[player]; }
+
+private:
+	/**
+	    \brief Largest support tried by support enumeration
+	*/
+	size_t maxSupport;
+	
+	/**
+	    \brief The equilibria found
+	*/
+	std::vector<Equilibrium> equilibria;
+	
+	/**
+	    \brief Whether each player was removed as dominated
+	*/
+	std::vector<bool> dominated;
+};
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
@@ -27,16 +27,68 @@
 #  include <wx/wx.h>
 #endif
 
-#include <wx/progdlg.h>
+#include <wx/sharedptr.h>
 
+#include <math.h>
+#include <string.h>
+
+#ifdef BUILD_TESTS
+#  include <TestHarness.h>
+#  include "../game/fsaplayer.h"
+#  include "../game/matrixplayer.h"
+#  include <wx/file.h>
+#  include <wx/filename.h>
+#endif
+
+#include "../common/error.h"
+#include "../common/kernels.h"
+#include "../common/mappedfile.h"
+#include "../common/outputfile.h"
+#include "../common/progress.h"
+#include "../common/rng.h"
+#include "../game/matrixfile.h"
+#include "../game/prisoner.h"
+#include "basins.h"
+#include "equilibrium.h"
 #include "evotournament.h"
-#include "match.h"
+#include "invasion.h"
+
 
-#include <wx/arrimpl.cpp>
-WX_DEFINE_OBJARRAY(GenerationWeightArray)
+// The header of a checkpoint file, followed by the payoff matrix, the
+// mutation matrix, and then one or more records
+struct CheckpointHeader
+{
+	char magic[8];
+	wxUint32 version;
+	wxUint32 byteOrder;
+	wxUint32 numPlayers;
+	wxUint32 dynamics;
+	wxUint32 numTypes;
+	wxUint32 reserved;
+	wxUint64 playersHash;
+};
+
+// Each record is followed by the population of each type and the rows
+// of the trajectory added since the record before.  A run appends a
+// record every time it saves a checkpoint, and the last complete one
+// is the one that counts.
+struct CheckpointRecord
+{
+	wxInt32 convergedAt;
+	wxUint32 reserved;
+	double stepSize;
+};
 
+static const char checkpointMagic[8] = { 'O', 'Y', 'U', 'N', 'E', 'V', 'O', 'C' };
+static const wxUint32 checkpointVersion = 4;
+static const wxUint32 checkpointByteOrder = 0x01020304;
 
-EvoTournament::EvoTournament(Game *gm) : played(false), game(gm)
+
+EvoTournament::EvoTournament(Game *gm) :
+	dynamics(DISCRETE), tolerance(1e-8), stepTolerance(1e-8), extinctionThreshold(0.0),
+	pruneDominated(false), stepSize(0.1),
+	checkpointInterval(0), checkpointDelay(0), checkpointStarted(false), convergedAt(-1),
+	played(false), game(gm)
 { }
 
 EvoTournament::~EvoTournament()
@@ -50,6 +102,16 @@ EvoTournament::~EvoTournament()
 void EvoTournament::AddPlayer(const Player *player)
 {
 	players.Add(player->Clone());
+	payoffs.Clear();
+}
+
+void EvoTournament::AddPlayers(const PlayerPtrArray &newPlayers)
+{
+	players.Alloc(players.GetCount() + newPlayers.GetCount());
+	for (size_t i = 0 ; i < newPlayers.GetCount() ; i++)
+		players.Add(newPlayers[i]->Clone());
+	
+	payoffs.Clear();
 }
 
 void EvoTournament::RemovePlayer(const Player *player)
@@ -61,110 +123,1344 @@ void EvoTournament::RemovePlayer(const Player *player)
 		if (player->GetID() == t->GetID())
 		{
 			players.RemoveAt(i);
+			payoffs.Clear();
 			return;
 		}
 	}
 }
 
 
-bool EvoTournament::Run(int numGenerations)
+bool EvoTournament::Run(int numGenerations, Progress *progress)
 {
-	wxBeginBusyCursor();
-
-	// If we've already played, reset
-	if (played)
+	runTime.Start();
+	
+	// If we've already played (or been cancelled part-way), reset
+	if (played || data.GetNumRows())
 		Reset();
+	
+	size_t numPlayers = players.GetCount();
+	if (!numPlayers)
+	{
+		Error::Set(_("Add at least one player to the evolutionary tournament"));
+		return false;
+	}
 
-	// Create some variables we'll need later: the number of players,
-	// a temporary weight object that will get pushed back onto data,
-	// and the same indexed by integer not name.
+	// Games are deterministic, so every match only needs to be played
+	// once.  (Error already set in Match::Play())
+	if (payoffs.GetSize() != numPlayers && !payoffs.Compute(game, players, progress))
+		return false;
+	
+	// Seed the population weights, with every player starting out
+	// equal
+	FindTypes(payoffs, mutation.IsEmpty(), typeOf, typeCount, typePayoffs);
+	population.resize(typeCount.size());
+	for (size_t t = 0 ; t < typeCount.size() ; t++)
+		population[t] = typeCount[t] / (double)numPlayers;
+	stepSize = 0.1;
+	
+	std::vector<double> fractions;
+	SplitTypes(population, fractions);
+	{
+		wxCriticalSectionLocker locker(lock);
+		data.SetNumPlayers(numPlayers);
+		data.Add(fractions);
+	}
+	
+	return Evolve(numGenerations, progress);
+}
+
+bool EvoTournament::Continue(int numGenerations, Progress *progress)
+{
+	runTime.Start();
+	
+	// Start over if there's nothing to pick up from
 	size_t numPlayers = players.GetCount();
-	GenerationWeights weights;
-	double *intWeights = new double[numPlayers];
+	if (!numPlayers || typeOf.size() != numPlayers || population.size() != typeCount.size() ||
+	    payoffs.GetSize() != numPlayers || !data.GetNumRows())
+		return Run(numGenerations, progress);
 	
-	// Seed the population weights
-	for (size_t i = 0 ; i < numPlayers ; i++)
+	// Mutation breaks up the types, so go back to one per player
+	if (!mutation.IsEmpty() && typeCount.size() != numPlayers)
 	{
-		intWeights[i] = 1.0 / (double)numPlayers;
-		weights[players[i]->GetID()] = intWeights[i];
+		std::vector<double> fractions;
+		SplitTypes(population, fractions);
+		population = fractions;
+		FindTypes(payoffs, false, typeOf, typeCount, typePayoffs);
 	}
-	data.push_back(weights);
+	
+	played = false;
+	return Evolve(numGenerations, progress);
+}
 
+bool EvoTournament::Evolve(int numGenerations, Progress *progress)
+{
+	size_t numTypes = population.size();
+	int start = GetNumGenerationsRun();
+	
+	// A population which has settled down stays that way
+	if (HasConverged())
+		start = numGenerations;
+	
+	if (!mutation.IsEmpty() && mutation.GetSize() != numTypes)
+	{
+		Error::Set(_("The mutation matrix doesn't match the players in the tournament"));
+		return false;
+	}
+	
+	if (progress)
+		progress->Start(start < numGenerations ? numGenerations - start : 0);
+	
+	// Each run starts a new checkpoint file
+	checkpointStarted = false;
+	
+	// Every type starts out active
+	activeTypes.resize(numTypes);
+	for (size_t t = 0 ; t < numTypes ; t++)
+		activeTypes[t] = t;
+	activePayoffs.Clear();
+	
 	// Run it!
-	for (int gen = 0 ; gen < numGenerations ; gen++)
-	{
-		// So, let's leverage the fact that games are deterministic.  A player's
-		// score is:
-		//
-		// Score vs. himself * chance he'll meet himself
-		// Score vs. A * chance he'll met A
-		// etc.
-		//
-		// So calculate those weights and use that method to accurately arrive at
-		// the evolutionary solution--WITHOUT introducing any roundoff bugs!
-		double *newIntWeights = new double[numPlayers];
-
-		for (size_t i = 0 ; i < numPlayers ; i++)
+	std::vector<double> &x = population;
+	std::vector<double> fractions, active;
+	for (int gen = start ; gen < numGenerations ; gen++)
+	{
+		if (progress && progress->IsCancelled())
+		{
+			// Keep what we have, for resuming later
+			WriteCheckpoint();
+			
+			Error::Set(_("The tournament was cancelled"));
+			return false;
+		}
+		
+		std::vector<double> last(x);
+		
+		// Mutation can bring any type back, so only prune without it
+		if (mutation.IsEmpty())
+			UpdateActiveTypes(x, gen == start);
+		
+		// Step only the active types, if some have been pruned
+		std::vector<double> &y = activePayoffs.GetSize() ? active : x;
+		if (activePayoffs.GetSize())
+		{
+			active.resize(activeTypes.size());
+			for (size_t a = 0 ; a < activeTypes.size() ; a++)
+				active[a] = x[activeTypes[a]];
+		}
+		
+		if (dynamics == DISCRETE)
+			DiscreteStep(y);
+		else if (!ContinuousStep(y, stepSize))
+			return false;
+		
+		if (activePayoffs.GetSize())
 		{
-			double roundScore = 0; 
+			for (size_t a = 0 ; a < activeTypes.size() ; a++)
+				x[activeTypes[a]] = active[a];
+		}
+		
+		SplitTypes(x, fractions);
+		{
+			wxCriticalSectionLocker locker(lock);
+			data.Add(fractions);
+		}
+		
+		if (progress)
+			progress->Advance();
+		
+		// Stop once the population has settled down (measuring the
+		// distance between the fractions of the players, not the types)
+		double distance = 0.0;
+		for (size_t t = 0 ; t < numTypes ; t++)
+			distance += (x[t] - last[t]) * (x[t] - last[t]) / typeCount[t];
+		
+		if (sqrt(distance) < tolerance)
+		{
+			convergedAt = gen + 1;
+			break;
+		}
+		
+		if (checkpointInterval > 0 && (gen + 1) % checkpointInterval == 0 && !WriteCheckpoint())
+			return false;
+	}
+	
+	if (!WriteCheckpoint())
+		return false;
 
-			for (size_t j = 0 ; j < numPlayers ; j++)
-			{
-				// What's the odds that players i and j will meet?
-				double odds = intWeights[i] * intWeights[j];
+	// Set the played variable
+	played = true;
+
+	return true;
+}
 
-				// What's the score for this game?
-				Player *p1Copy = players[i]->Clone();
-				Player *p2Copy = players[j]->Clone();
-				Match match(p1Copy, p2Copy);
-				
-				// Error already set in Match::Play()
-				if (!match.Play(game, true))
-					return false;
 
-				// What's that mean for our intrepid warrior?
-				double floatScore = odds * match.playerOneScore;
+bool EvoTournament::Rescore(const PayoffTable &table)
+{
+	size_t numPlayers = players.GetCount();
+	if (!numPlayers)
+	{
+		Error::Set(_("Add at least one player to the evolutionary tournament"));
+		return false;
+	}
+	
+	// (Error already set in Match::Play())
+	if ((payoffs.GetSize() != numPlayers || !payoffs.HasOutcomes()) && !payoffs.Compute(game, players))
+		return false;
+	
+	// Error already set in PayoffMatrix::Rescore()
+	if (!payoffs.Rescore(table))
+		return false;
+	
+	Reset();
+	return true;
+}
 
-				// Clean up
-				delete p1Copy;
-				delete p2Copy;
+bool EvoTournament::FindEquilibria(EquilibriumSolver &solver, Progress *progress)
+{
+	size_t numPlayers = players.GetCount();
+	if (!numPlayers)
+	{
+		Error::Set(_("Add at least one player to the evolutionary tournament"));
+		return false;
+	}
+	
+	// (Error already set in Match::Play())
+	if (payoffs.GetSize() != numPlayers && !payoffs.Compute(game, players, progress))
+		return false;
+	
+	// Error already set in EquilibriumSolver::Solve()
+	return solver.Solve(payoffs, progress);
+}
 
-				// Add this on
-				roundScore += floatScore;
-			}
+bool EvoTournament::AnalyzeInvasion(InvasionAnalysis &analysis, Progress *progress)
+{
+	size_t numPlayers = players.GetCount();
+	if (!numPlayers)
+	{
+		Error::Set(_("Add at least one player to the evolutionary tournament"));
+		return false;
+	}
+	
+	// (Error already set in Match::Play())
+	if (payoffs.GetSize() != numPlayers && !payoffs.Compute(game, players, progress))
+		return false;
+	
+	// Error already set in InvasionAnalysis::Compute()
+	return analysis.Compute(payoffs, progress);
+}
 
-			// We've looped through every player, so this is our guy's score for this round
-			newIntWeights[i] = roundScore;
-		}
+bool EvoTournament::MapBasins(BasinMap &map, Progress *progress)
+{
+	size_t numPlayers = players.GetCount();
+	if (!numPlayers)
+	{
+		Error::Set(_("Add at least one player to the evolutionary tournament"));
+		return false;
+	}
+	
+	// (Error already set in Match::Play())
+	if (payoffs.GetSize() != numPlayers && !payoffs.Compute(game, players, progress))
+		return false;
+	
+	// Error already set in BasinMap::Compute()
+	return map.Compute(payoffs, mutation, progress);
+}
 
-		// Turn intWeights back into weights
-		double sum = 0;
-		for (size_t i = 0 ; i < numPlayers ; i++)
-			sum += newIntWeights[i];
+bool EvoTournament::SavePayoffs(const wxString &fileName, Progress *progress)
+{
+	size_t numPlayers = players.GetCount();
+	if (!numPlayers)
+	{
+		Error::Set(_("Add at least one player to the evolutionary tournament"));
+		return false;
+	}
+	
+	// (Error already set in Match::Play())
+	if (payoffs.GetSize() != numPlayers && !payoffs.Compute(game, players, progress))
+		return false;
+	
+	// Error already set in MatrixFile::Write()
+	return MatrixFile::Write(fileName, players, payoffs.GetRow(0));
+}
+
+
+void EvoTournament::SetCheckpoint(const wxString &fileName, int interval, long delay)
+{
+	checkpointFile = fileName;
+	checkpointInterval = interval;
+	checkpointDelay = delay;
+	checkpointStarted = false;
+}
+
+bool EvoTournament::WriteCheckpoint()
+{
+	if (checkpointFile.IsEmpty() || runTime.Time() < checkpointDelay)
+		return true;
+	
+	// The first checkpoint of a run has everything, and the rest just
+	// have what's changed
+	if (!checkpointStarted)
+	{
+		checkpointMark = TrajectoryMark();
+		if (!SaveCheckpoint(checkpointFile, checkpointMark))
+			return false;
+		
+		checkpointStarted = true;
+		return true;
+	}
+	
+	// Error already set in OutputFile
+	OutputFile out;
+	if (!out.Open(checkpointFile, true))
+		return false;
+	
+	SaveCheckpointRecord(out, checkpointMark);
+	return out.Close();
+}
+
+void EvoTournament::FindTypes(const PayoffMatrix &matrix, bool merge, std::vector<size_t> &newTypeOf,
+                              std::vector<double> &newTypeCount, PayoffMatrix &newTypePayoffs)
+{
+	size_t numPlayers = matrix.GetSize(), numTypes = numPlayers;
+	
+	if (merge)
+		numTypes = matrix.FindTypes(newTypeOf);
+	else
+	{
+		newTypeOf.resize(numPlayers);
 		for (size_t i = 0 ; i < numPlayers ; i++)
-		{
-			intWeights[i] = newIntWeights[i] / sum;
-			weights[players[i]->GetID()] = intWeights[i];
-		}
+			newTypeOf[i] = i;
+	}
+	
+	newTypeCount.assign(numTypes, 0.0);
+	for (size_t i = 0 ; i < numPlayers ; i++)
+		newTypeCount[newTypeOf[i]] += 1.0;
+	
+	if (numTypes == numPlayers)
+	{
+		newTypePayoffs.Clear();
+		return;
+	}
+	
+	// Take the scores from the first player of each type.  Since every
+	// player of a type scores the same against each player of another,
+	// the type as a whole scores that against the other type.
+	std::vector<size_t> first(numTypes, numPlayers);
+	for (size_t i = numPlayers ; i-- > 0 ; )
+		first[newTypeOf[i]] = i;
+	
+	std::vector<double> values(numTypes * numTypes);
+	for (size_t t = 0 ; t < numTypes ; t++)
+		for (size_t u = 0 ; u < numTypes ; u++)
+			values[t * numTypes + u] = matrix.Get(first[t], first[u]);
+	
+	newTypePayoffs.Assign(numTypes, &values[0]);
+}
+
+void EvoTournament::SplitTypes(const std::vector<double> &x, std::vector<double> &fractions) const
+{
+	fractions.resize(typeOf.size());
+	for (size_t i = 0 ; i < typeOf.size() ; i++)
+		fractions[i] = x[typeOf[i]] / typeCount[typeOf[i]];
+}
 
-		// Add it to the data
-		delete[] newIntWeights;
-		data.push_back(weights);
+bool EvoTournament::SaveCheckpoint(const wxString &fileName) const
+{
+	TrajectoryMark mark;
+	return SaveCheckpoint(fileName, mark);
+}
+
+bool EvoTournament::SaveCheckpoint(const wxString &fileName, TrajectoryMark &mark) const
+{
+	size_t numPlayers = typeOf.size(), numTypes = population.size();
+	if (!numPlayers || payoffs.GetSize() != numPlayers || typeCount.size() != numTypes)
+	{
+		Error::Set(_("There is no evolutionary tournament to save"));
+		return false;
+	}
+	
+	CheckpointHeader header;
+	memset(&header, 0, sizeof(CheckpointHeader));
+	memcpy(header.magic, checkpointMagic, sizeof(checkpointMagic));
+	header.version = checkpointVersion;
+	header.byteOrder = checkpointByteOrder;
+	header.numPlayers = numPlayers;
+	header.dynamics = dynamics;
+	header.numTypes = numTypes;
+	header.playersHash = HashPlayers(players);
+	
+	// Write to a temporary file, so a crash part-way leaves the last
+	// checkpoint alone
+	wxString tempName = fileName + wxT(".tmp");
+	OutputFile out;
+	if (!out.Open(tempName))
+		return false;
+	
+	out.Write((const char *)&header, sizeof(CheckpointHeader));
+	for (size_t i = 0 ; i < numPlayers ; i++)
+		out.Write((const char *)payoffs.GetRow(i), numPlayers * sizeof(double));
+	mutation.Save(out);
+	SaveCheckpointRecord(out, mark);
+	
+	if (!out.Close())
+	{
+		wxRemoveFile(tempName);
+		return false;
+	}
+	
+	if (!wxRenameFile(tempName, fileName, true))
+	{
+		wxRemoveFile(tempName);
+		Error::Set(wxString::Format(_("Could not write to file %s"), fileName.c_str()));
+		return false;
 	}
+	
+	return true;
+}
 
-	delete[] intWeights;
+void EvoTournament::SaveCheckpointRecord(OutputFile &out, TrajectoryMark &mark) const
+{
+	CheckpointRecord record;
+	memset(&record, 0, sizeof(CheckpointRecord));
+	record.convergedAt = convergedAt;
+	record.stepSize = stepSize;
+	
+	out.Write((const char *)&record, sizeof(CheckpointRecord));
+	out.Write((const char *)&population[0], population.size() * sizeof(double));
+	data.Save(out, mark);
+}
 
-	// Set the played variable
+bool EvoTournament::LoadCheckpoint(const wxString &fileName)
+{
+	wxSharedPtr<MappedFile> mapping(new MappedFile);
+	if (!mapping->Open(fileName))
+		return false;
+	
+	const wxUint8 *pos = mapping->GetData();
+	const wxUint8 *end = pos + mapping->GetSize();
+	
+	if (mapping->GetSize() < sizeof(CheckpointHeader) || memcmp(pos, checkpointMagic, sizeof(checkpointMagic)))
+	{
+		Error::Set(wxString::Format(_("File %s is not an evolutionary tournament checkpoint"), fileName.c_str()));
+		return false;
+	}
+	
+	CheckpointHeader header;
+	memcpy(&header, pos, sizeof(CheckpointHeader));
+	pos += sizeof(CheckpointHeader);
+	
+	if (header.version != checkpointVersion)
+	{
+		Error::Set(wxString::Format(_("Checkpoint %s has an unsupported version (%d)"), 
+		                            fileName.c_str(), header.version));
+		return false;
+	}
+	if (header.byteOrder != checkpointByteOrder)
+	{
+		Error::Set(wxString::Format(_("Checkpoint %s was created on a machine with a different byte order"), 
+		                            fileName.c_str()));
+		return false;
+	}
+	if (header.numPlayers != players.GetCount() || header.playersHash != HashPlayers(players))
+	{
+		Error::Set(wxString::Format(_("Checkpoint %s was not saved with these players"), fileName.c_str()));
+		return false;
+	}
+	
+	// Read everything before changing anything
+	size_t numPlayers = header.numPlayers;
+	size_t numTypes = (header.numTypes <= numPlayers) ? header.numTypes : 0;
+	std::vector<double> matrix(numPlayers * numPlayers), newPopulation;
+	CheckpointRecord record;
+	Trajectory trajectory;
+	MutationMatrix newMutation;
+	PayoffMatrix newPayoffs, newTypePayoffs;
+	std::vector<size_t> newTypeOf;
+	std::vector<double> newTypeCount;
+	memset(&record, 0, sizeof(CheckpointRecord));
+	
+	bool ok = (header.dynamics <= CONTINUOUS && numTypes && 
+	           (size_t)(end - pos) >= matrix.size() * sizeof(double));
+	if (ok)
+	{
+		memcpy(&matrix[0], pos, matrix.size() * sizeof(double));
+		pos += matrix.size() * sizeof(double);
+		
+		ok = newMutation.Load(pos, end) && (newMutation.IsEmpty() || newMutation.GetSize() == numPlayers);
+	}
+	
+	// Then take the records in turn, up to the last complete one (the
+	// run may have been interrupted while appending another)
+	size_t numRecords = 0;
+	while (ok && (size_t)(end - pos) >= sizeof(CheckpointRecord) + numTypes * sizeof(double))
+	{
+		CheckpointRecord next;
+		memcpy(&next, pos, sizeof(CheckpointRecord));
+		
+		const wxUint8 *recordPos = pos + sizeof(CheckpointRecord);
+		std::vector<double> nextPopulation(numTypes);
+		memcpy(&nextPopulation[0], recordPos, numTypes * sizeof(double));
+		recordPos += numTypes * sizeof(double);
+		
+		if (!trajectory.Load(recordPos, end))
+			break;
+		
+		pos = recordPos;
+		record = next;
+		newPopulation = nextPopulation;
+		numRecords++;
+	}
+	
+	ok = ok && numRecords && trajectory.GetNumPlayers() == numPlayers &&
+	     trajectory.GetNumRows() && trajectory.GetNumGenerations() &&
+	     (record.convergedAt < 0 || record.convergedAt == (int)trajectory.GetNumGenerations() - 1);
+	
+	// The players have to sort into the same types as before
+	if (ok)
+	{
+		newPayoffs.Assign(numPlayers, &matrix[0]);
+		FindTypes(newPayoffs, numTypes < numPlayers, newTypeOf, newTypeCount, newTypePayoffs);
+		ok = (newTypeCount.size() == numTypes);
+	}
+	
+	if (!ok)
+	{
+		Error::Set(wxString::Format(_("Checkpoint %s is truncated or corrupt"), fileName.c_str()));
+		return false;
+	}
+	
+	population = newPopulation;
+	payoffs = newPayoffs;
+	typeOf = newTypeOf;
+	typeCount = newTypeCount;
+	typePayoffs = newTypePayoffs;
+	dynamics = (Dynamics)header.dynamics;
+	mutation = newMutation;
+	convergedAt = record.convergedAt;
+	stepSize = record.stepSize;
 	played = true;
+	
+	wxCriticalSectionLocker locker(lock);
+	data = trajectory;
+	
+	return true;
+}
 
-	wxEndBusyCursor();
+void EvoTournament::UpdateActiveTypes(std::vector<double> &x, bool checkDominated)
+{
+	const PayoffMatrix &matrix = GetTypePayoffs();
+	std::vector<size_t> keep;
+	keep.reserve(activeTypes.size());
+	
+	size_t largest = activeTypes[0];
+	double largestValue = x[largest];
+	for (size_t a = 0 ; a < activeTypes.size() ; a++)
+	{
+		size_t t = activeTypes[a];
+		if (x[t] > largestValue)
+		{
+			largest = t;
+			largestValue = x[t];
+		}
+		
+		if (x[t] > extinctionThreshold)
+			keep.push_back(t);
+		else
+			x[t] = 0.0;
+	}
+	
+	// Someone has to survive, even if the threshold is above everyone
+	if (keep.empty())
+	{
+		x[largest] = largestValue;
+		keep.push_back(largest);
+	}
+	
+	// Dominance only changes when the set of types does.  Since it's
+	// transitive, every type dominated by the current set can go at
+	// once, and then the smaller set is checked again.
+	if (pruneDominated && (checkDominated || keep.size() < activeTypes.size()))
+	{
+		size_t numBefore = 0;
+		while (keep.size() != numBefore && keep.size() > 1)
+		{
+			numBefore = keep.size();
+			std::vector<size_t> undominated;
+			
+			for (size_t a = 0 ; a < keep.size() ; a++)
+			{
+				const double *row = matrix.GetRow(keep[a]);
+				bool dominated = false;
+				
+				for (size_t b = 0 ; b < keep.size() && !dominated ; b++)
+				{
+					const double *other = matrix.GetRow(keep[b]);
+					size_t c = 0;
+					while (c < keep.size() && row[keep[c]] < other[keep[c]])
+						c++;
+					dominated = (c == keep.size());
+				}
+				
+				if (dominated)
+					x[keep[a]] = 0.0;
+				else
+					undominated.push_back(keep[a]);
+			}
+			
+			keep.swap(undominated);
+		}
+	}
+	
+	if (keep.size() == activeTypes.size())
+		return;
+	
+	// Scale the survivors back up to the whole population
+	double sum = 0.0;
+	for (size_t a = 0 ; a < keep.size() ; a++)
+		sum += x[keep[a]];
+	if (sum > 0.0 && sum != 1.0)
+	{
+		for (size_t a = 0 ; a < keep.size() ; a++)
+			x[keep[a]] /= sum;
+	}
+	
+	activeTypes.swap(keep);
+	
+	// Pack the scores of the active types together
+	size_t numActive = activeTypes.size();
+	if (numActive == x.size())
+	{
+		activePayoffs.Clear();
+		return;
+	}
+	
+	std::vector<double> values(numActive * numActive);
+	for (size_t a = 0 ; a < numActive ; a++)
+	{
+		const double *row = matrix.GetRow(activeTypes[a]);
+		for (size_t b = 0 ; b < numActive ; b++)
+			values[a * numActive + b] = row[activeTypes[b]];
+	}
+	
+	activePayoffs.Assign(numActive, &values[0]);
+}
+
+double EvoTournament::Fitness(const std::vector<double> &x, std::vector<double> &f) const
+{
+	// A player's score is:
+	//
+	// Score vs. himself * chance he'll meet himself
+	// Score vs. A * chance he'll met A
+	// etc.
+	//
+	// which, for everyone at once, is the payoff matrix times the
+	// population.
+	size_t numTypes = x.size();
+	
+	f.resize(numTypes);
+	Kernels::MatVec(GetActivePayoffs().GetRow(0), numTypes, numTypes, &x[0], &f[0]);
+	
+	return Kernels::Dot(&x[0], &f[0], numTypes);
+}
+
+void EvoTournament::Offspring(const std::vector<double> &x, const std::vector<double> &f,
+                              std::vector<double> &born) const
+{
+	std::vector<double> parents(x.size());
+	for (size_t i = 0 ; i < x.size() ; i++)
+		parents[i] = x[i] * f[i];
+	
+	born.resize(x.size());
+	mutation.Apply(&parents[0], &born[0]);
+}
+
+void EvoTournament::DiscreteStep(std::vector<double> &x) const
+{
+	std::vector<double> f;
+	double mean = Fitness(x, f);
+	
+	// If nobody scored at all, nothing changes
+	if (mean <= 0.0)
+		return;
+	
+	if (mutation.IsEmpty())
+	{
+		for (size_t i = 0 ; i < x.size() ; i++)
+			x[i] = x[i] * f[i] / mean;
+		return;
+	}
+	
+	std::vector<double> born;
+	Offspring(x, f, born);
+	for (size_t i = 0 ; i < x.size() ; i++)
+		x[i] = born[i] / mean;
+}
 
+void EvoTournament::Derivative(const std::vector<double> &x, std::vector<double> &dx) const
+{
+	std::vector<double> f;
+	double mean = Fitness(x, f);
+	
+	dx.assign(x.size(), 0.0);
+	if (mean <= 0.0)
+		return;
+	
+	if (mutation.IsEmpty())
+	{
+		for (size_t i = 0 ; i < x.size() ; i++)
+			dx[i] = x[i] * (f[i] - mean) / mean;
+		return;
+	}
+	
+	std::vector<double> born;
+	Offspring(x, f, born);
+	for (size_t i = 0 ; i < x.size() ; i++)
+		dx[i] = (born[i] - x[i] * mean) / mean;
+}
+
+bool EvoTournament::ContinuousStep(std::vector<double> &x, double &h) const
+{
+	// The Dormand-Prince 5(4) tableau
+	static const double a21 = 1.0 / 5.0;
+	static const double a31 = 3.0 / 40.0, a32 = 9.0 / 40.0;
+	static const double a41 = 44.0 / 45.0, a42 = -56.0 / 15.0, a43 = 32.0 / 9.0;
+	static const double a51 = 19372.0 / 6561.0, a52 = -25360.0 / 2187.0,
+	                    a53 = 64448.0 / 6561.0, a54 = -212.0 / 729.0;
+	static const double a61 = 9017.0 / 3168.0, a62 = -355.0 / 33.0, a63 = 46732.0 / 5247.0,
+	                    a64 = 49.0 / 176.0, a65 = -5103.0 / 18656.0;
+	static const double b1 = 35.0 / 384.0, b3 = 500.0 / 1113.0, b4 = 125.0 / 192.0,
+	                    b5 = -2187.0 / 6784.0, b6 = 11.0 / 84.0;
+	static const double e1 = 71.0 / 57600.0, e3 = -71.0 / 16695.0, e4 = 71.0 / 1920.0,
+	                    e5 = -17253.0 / 339200.0, e6 = 22.0 / 525.0, e7 = -1.0 / 40.0;
+	
+	size_t n = x.size();
+	std::vector<double> k1, k2, k3, k4, k5, k6, k7, y(n), next(n);
+	double remaining = 1.0;
+	
+	Derivative(x, k1);
+	
+	while (remaining > 0.0)
+	{
+		double step = (h < remaining) ? h : remaining;
+		if (step < 1e-12)
+		{
+			Error::Set(_("The replicator equation could not be solved to the requested accuracy"));
+			return false;
+		}
+		
+		for (size_t i = 0 ; i < n ; i++)
+			y[i] = x[i] + step * a21 * k1[i];
+		Derivative(y, k2);
+		for (size_t i = 0 ; i < n ; i++)
+			y[i] = x[i] + step * (a31 * k1[i] + a32 * k2[i]);
+		Derivative(y, k3);
+		for (size_t i = 0 ; i < n ; i++)
+			y[i] = x[i] + step * (a41 * k1[i] + a42 * k2[i] + a43 * k3[i]);
+		Derivative(y, k4);
+		for (size_t i = 0 ; i < n ; i++)
+			y[i] = x[i] + step * (a51 * k1[i] + a52 * k2[i] + a53 * k3[i] + a54 * k4[i]);
+		Derivative(y, k5);
+		for (size_t i = 0 ; i < n ; i++)
+			y[i] = x[i] + step * (a61 * k1[i] + a62 * k2[i] + a63 * k3[i] + a64 * k4[i] + a65 * k5[i]);
+		Derivative(y, k6);
+		for (size_t i = 0 ; i < n ; i++)
+			next[i] = x[i] + step * (b1 * k1[i] + b3 * k3[i] + b4 * k4[i] + b5 * k5[i] + b6 * k6[i]);
+		Derivative(next, k7);
+		
+		// Compare the fifth- and fourth-order solutions
+		double error = 0.0;
+		for (size_t i = 0 ; i < n ; i++)
+		{
+			double e = step * (e1 * k1[i] + e3 * k3[i] + e4 * k4[i] + e5 * k5[i] + e6 * k6[i] + e7 * k7[i]);
+			double scale = stepTolerance * wxMax(1.0, wxMax(fabs(x[i]), fabs(next[i])));
+			
+			e = fabs(e) / scale;
+			if (e > error)
+				error = e;
+		}
+		
+		// Grow or shrink the step, within limits
+		double factor = (error > 0.0) ? 0.9 * pow(error, -0.2) : 5.0;
+		factor = wxMax(0.2, wxMin(5.0, factor));
+		
+		if (error <= 1.0)
+		{
+			// Stay on the simplex despite roundoff
+			double sum = 0.0;
+			for (size_t i = 0 ; i < n ; i++)
+			{
+				if (next[i] < 0.0)
+					next[i] = 0.0;
+				sum += next[i];
+			}
+			for (size_t i = 0 ; i < n ; i++)
+				x[i] = next[i] / sum;
+			
+			remaining -= step;
+			
+			// The last stage is the first of the next step
+			k1.swap(k7);
+			
+			// Don't let a short final step shrink the next one
+			if (step == h)
+				h = step * factor;
+		}
+		else
+			h = step * factor;
+	}
+	
 	return true;
 }
 
 void EvoTournament::Reset()
 {
 	played = false;
+	convergedAt = -1;
+	population.clear();
+	typeOf.clear();
+	typeCount.clear();
+	typePayoffs.Clear();
+	activeTypes.clear();
+	activePayoffs.Clear();
+	
+	wxCriticalSectionLocker locker(lock);
 	data.Clear();
 }
 
+
+
+/** \cond TEST */
+#ifdef BUILD_TESTS
+
+static const wxString test_evo_allc("Charles Pence\nAll-C\n1\nC, 0, 0");
+static const wxString test_evo_alld("Charles Pence\nAll-D\n1\nD, 0, 0");
+
+TEST(EvoTournament, Convergence)
+{
+	PrisonerDilemma game;
+	FSAPlayer allc, alld;
+	EvoTournament tourney(&game);
+	
+	CHECK(allc.LoadFromString(&game, test_evo_allc));
+	CHECK(alld.LoadFromString(&game, test_evo_alld));
+	tourney.AddPlayer(&allc);
+	tourney.AddPlayer(&alld);
+	
+	// Defectors take over, long before the budget runs out
+	for (int mode = 0 ; mode < 2 ; mode++)
+	{
+		tourney.dynamics = mode ? EvoTournament::CONTINUOUS : EvoTournament::DISCRETE;
+		CHECK(tourney.Run(10000));
+		
+		CHECK(tourney.HasConverged());
+		CHECK(tourney.GetConvergenceTime() < 1000);
+		CHECK_EQUAL(tourney.GetConvergenceTime() + 1, (int)tourney.data.GetNumRows());
+		
+		const float *last = tourney.data.GetRow(tourney.data.GetNumRows() - 1);
+		CHECK(last[1] > 0.999f);
+		CHECK(fabs(last[0] + last[1] - 1.0f) < 1e-6f);
+	}
+	
+	// Without a tolerance, every generation is run
+	tourney.tolerance = 0.0;
+	CHECK(tourney.Run(50));
+	CHECK(!tourney.HasConverged());
+	CHECK_EQUAL(51, (int)tourney.data.GetNumRows());
+	
+	// After one unit of time, the continuous model lags the discrete one
+	tourney.tolerance = 1e-8;
+	tourney.dynamics = EvoTournament::DISCRETE;
+	CHECK(tourney.Run(1));
+	float discrete = tourney.data.Get(1, 1);
+	tourney.dynamics = EvoTournament::CONTINUOUS;
+	CHECK(tourney.Run(1));
+	float continuous = tourney.data.Get(1, 1);
+	CHECK(continuous > 0.5f && continuous < discrete);
+}
+
+TEST(EvoTournament, FixedPoint)
+{
+	// Two copies of the same player always score the same, so nothing
+	// ever changes
+	PrisonerDilemma game;
+	FSAPlayer first, second;
+	EvoTournament tourney(&game);
+	
+	CHECK(first.LoadFromString(&game, test_evo_allc));
+	CHECK(second.LoadFromString(&game, test_evo_allc));
+	tourney.AddPlayer(&first);
+	tourney.AddPlayer(&second);
+	
+	CHECK(tourney.Run(200));
+	CHECK_EQUAL(1, tourney.GetConvergenceTime());
+	CHECK_EQUAL(0.5f, tourney.data.Get(1, 1));
+}
+
+TEST(EvoTournament, Cancel)
+{
+	PrisonerDilemma game;
+	FSAPlayer allc, alld;
+	EvoTournament tourney(&game);
+	Progress progress;
+	
+	CHECK(allc.LoadFromString(&game, test_evo_allc));
+	CHECK(alld.LoadFromString(&game, test_evo_alld));
+	tourney.AddPlayer(&allc);
+	tourney.AddPlayer(&alld);
+	
+	tourney.tolerance = 0.0;
+	CHECK(tourney.Run(20, &progress));
+	CHECK_EQUAL(20, (int)progress.GetDone());
+	
+	// Cancelling keeps the starting population, but nothing else
+	progress.Cancel();
+	CHECK(!tourney.Run(20, &progress));
+	CHECK(!tourney.IsPlayed());
+	CHECK_EQUAL(1, (int)tourney.data.GetNumRows());
+}
+
+TEST(EvoTournament, Extend)
+{
+	PrisonerDilemma game;
+	FSAPlayer allc, alld;
+	EvoTournament tourney(&game), whole(&game);
+	
+	CHECK(allc.LoadFromString(&game, test_evo_allc));
+	CHECK(alld.LoadFromString(&game, test_evo_alld));
+	tourney.AddPlayer(&allc);
+	tourney.AddPlayer(&alld);
+	whole.AddPlayer(&allc);
+	whole.AddPlayer(&alld);
+	
+	// Fifty generations and fifty more are the same as a hundred
+	for (int mode = 0 ; mode < 2 ; mode++)
+	{
+		tourney.dynamics = whole.dynamics = mode ? EvoTournament::CONTINUOUS : EvoTournament::DISCRETE;
+		tourney.tolerance = whole.tolerance = 0.0;
+		
+		CHECK(whole.Run(100));
+		CHECK(tourney.Run(50));
+		CHECK_EQUAL(50, tourney.GetNumGenerationsRun());
+		CHECK(tourney.Continue(100));
+		CHECK_EQUAL(100, tourney.GetNumGenerationsRun());
+		CHECK_EQUAL(whole.data.GetNumRows(), tourney.data.GetNumRows());
+		
+		for (size_t row = 0 ; row < whole.data.GetNumRows() ; row++)
+		{
+			CHECK_EQUAL(whole.data.Get(row, 0), tourney.data.Get(row, 0));
+			CHECK_EQUAL(whole.data.Get(row, 1), tourney.data.Get(row, 1));
+		}
+	}
+	
+	// A converged population isn't extended
+	tourney.tolerance = 1e-8;
+	CHECK(tourney.Run(10000));
+	int converged = tourney.GetConvergenceTime();
+	CHECK(tourney.Continue(20000));
+	CHECK_EQUAL(converged, tourney.GetNumGenerationsRun());
+}
+
+TEST(EvoTournament, Checkpoint)
+{
+	PrisonerDilemma game;
+	FSAPlayer allc, alld;
+	EvoTournament tourney(&game), resumed(&game), whole(&game);
+	
+	CHECK(allc.LoadFromString(&game, test_evo_allc));
+	CHECK(alld.LoadFromString(&game, test_evo_alld));
+	tourney.AddPlayer(&allc);
+	tourney.AddPlayer(&alld);
+	resumed.AddPlayer(&allc);
+	resumed.AddPlayer(&alld);
+	whole.AddPlayer(&allc);
+	whole.AddPlayer(&alld);
+	
+	tourney.dynamics = whole.dynamics = EvoTournament::CONTINUOUS;
+	tourney.tolerance = resumed.tolerance = whole.tolerance = 0.0;
+	tourney.data.SetCompressed(true);
+	whole.data.SetCompressed(true);
+	
+	// Checkpoints are saved as we go, and when cancelled
+	wxString tempName = wxFileName::CreateTempFileName(wxT("oyun"));
+	Progress progress;
+	tourney.SetCheckpoint(tempName, 10);
+	CHECK(tourney.Run(30));
+	
+	// Which appends to the file after the first one, and the last one
+	// written is what's loaded
+	CHECK(resumed.LoadCheckpoint(tempName));
+	CHECK_EQUAL(30, resumed.GetNumGenerationsRun());
+	CHECK_EQUAL(tourney.data.Get(25, 0), resumed.data.Get(25, 0));
+	
+	progress.Cancel();
+	CHECK(!tourney.Continue(60, &progress));
+	
+	// Picking up from the checkpoint gives the same answer as never
+	// stopping
+	CHECK(resumed.LoadCheckpoint(tempName));
+	CHECK(resumed.dynamics == EvoTournament::CONTINUOUS);
+	CHECK_EQUAL(30, resumed.GetNumGenerationsRun());
+	CHECK(resumed.Continue(60));
+	CHECK(whole.Run(60));
+	CHECK_EQUAL(whole.data.GetNumRows(), resumed.data.GetNumRows());
+	
+	for (size_t row = 0 ; row < whole.data.GetNumRows() ; row++)
+		CHECK_EQUAL(whole.data.Get(row, 1), resumed.data.Get(row, 1));
+	
+	// Checkpoints only load into the same tournament
+	EvoTournament other(&game);
+	other.AddPlayer(&alld);
+	other.AddPlayer(&allc);
+	CHECK(!other.LoadCheckpoint(tempName));
+	CHECK(!Error::Get().IsEmpty());
+	
+	// Truncated checkpoints are refused
+	wxFile file(tempName, wxFile::read_write);
+	CHECK(file.IsOpened());
+	CHECK(file.Length() > 100);
+	wxFileOffset length = file.Length();
+	file.Close();
+	
+	MappedFile mapping;
+	CHECK(mapping.Open(tempName));
+	std::vector<wxUint8> contents(mapping.GetData(), mapping.GetData() + length - 8);
+	mapping.Close();
+	
+	wxFile rewritten(tempName, wxFile::write);
+	rewritten.Write(&contents[0], contents.size());
+	rewritten.Close();
+	CHECK(!resumed.LoadCheckpoint(tempName));
+	CHECK_EQUAL(60, resumed.GetNumGenerationsRun());
+	
+	// Short runs aren't saved at all
+	wxRemoveFile(tempName);
+	whole.SetCheckpoint(tempName, 10, 3600 * 1000);
+	CHECK(whole.Run(30));
+	CHECK(!wxFileExists(tempName));
+	
+	wxRemoveFile(tempName);
+}
+
+TEST(EvoTournament, Rescore)
+{
+	PrisonerDilemma game, stagHunt(PayoffTable(3, 5, 1, 0));
+	FSAPlayer allc, alld;
+	EvoTournament tourney(&game), direct(&stagHunt);
+	
+	CHECK(allc.LoadFromString(&game, test_evo_allc));
+	CHECK(alld.LoadFromString(&game, test_evo_alld));
+	tourney.AddPlayer(&allc);
+	tourney.AddPlayer(&alld);
+	direct.AddPlayer(&allc);
+	direct.AddPlayer(&alld);
+	
+	// Defectors take over the prisoner's dilemma, but in this stag
+	// hunt, cooperators do better when half the population cooperates
+	CHECK(tourney.Run(100));
+	CHECK(tourney.data.Get(tourney.data.GetNumRows() - 1, 1) > 0.99f);
+	CHECK(tourney.Rescore(PayoffTable(3, 5, 1, 0)));
+	CHECK(!tourney.IsPlayed());
+	CHECK(tourney.Run(100));
+	CHECK(direct.Run(100));
+	
+	CHECK_EQUAL(direct.data.GetNumRows(), tourney.data.GetNumRows());
+	for (size_t row = 0 ; row < direct.data.GetNumRows() ; row++)
+		CHECK_EQUAL(direct.data.Get(row, 0), tourney.data.Get(row, 0));
+	CHECK(tourney.data.Get(tourney.data.GetNumRows() - 1, 0) > 0.99f);
+}
+
+TEST(EvoTournament, Mutation)
+{
+	PrisonerDilemma game;
+	FSAPlayer allc, alld;
+	EvoTournament tourney(&game), plain(&game);
+	
+	CHECK(allc.LoadFromString(&game, test_evo_allc));
+	CHECK(alld.LoadFromString(&game, test_evo_alld));
+	tourney.AddPlayer(&allc);
+	tourney.AddPlayer(&alld);
+	plain.AddPlayer(&allc);
+	plain.AddPlayer(&alld);
+	
+	// A matrix without any mutations changes nothing
+	for (int mode = 0 ; mode < 2 ; mode++)
+	{
+		tourney.dynamics = plain.dynamics = mode ? EvoTournament::CONTINUOUS : EvoTournament::DISCRETE;
+		CHECK(tourney.mutation.SetSparse(2, std::vector<MutationEntry>()));
+		CHECK(tourney.Run(100));
+		CHECK(plain.Run(100));
+		
+		CHECK_EQUAL(plain.data.GetNumRows(), tourney.data.GetNumRows());
+		for (size_t row = 0 ; row < plain.data.GetNumRows() ; row++)
+			CHECK(fabs(plain.data.Get(row, 0) - tourney.data.Get(row, 0)) < 1e-6f);
+	}
+	
+	// With mutation, cooperators never die out
+	tourney.dynamics = EvoTournament::DISCRETE;
+	CHECK(tourney.mutation.SetUniform(2, 0.01));
+	CHECK(tourney.Run(10000));
+	CHECK(tourney.HasConverged());
+	
+	const float *last = tourney.data.GetRow(tourney.data.GetNumRows() - 1);
+	CHECK(last[0] > 0.001f && last[0] < 0.1f);
+	CHECK(fabs(last[0] + last[1] - 1.0f) < 1e-6f);
+	
+	// The matrix is saved with checkpoints
+	wxString tempName = wxFileName::CreateTempFileName(wxT("oyun"));
+	CHECK(tourney.SaveCheckpoint(tempName));
+	CHECK(plain.LoadCheckpoint(tempName));
+	CHECK_EQUAL(0.01, plain.mutation.Get(0, 1));
+	wxRemoveFile(tempName);
+	
+	// And it has to match the players
+	CHECK(tourney.mutation.SetUniform(3, 0.01));
+	CHECK(!tourney.Run(10));
+}
+
+TEST(EvoTournament, Types)
+{
+	PrisonerDilemma game;
+	FSAPlayer tft, copy, allc, alld;
+	EvoTournament tourney(&game), separate(&game);
+	
+	// The copy of TFT has an extra state it never gets to
+	CHECK(tft.LoadFromString(&game, wxT("Charles Pence\nTFT\n2\nC, 0, 1\nD, 0, 1")));
+	CHECK(copy.LoadFromString(&game, wxT("Charles Pence\nTFT Copy\n3\nC, 0, 1\nD, 0, 1\nD, 2, 2")));
+	CHECK(allc.LoadFromString(&game, test_evo_allc));
+	CHECK(alld.LoadFromString(&game, test_evo_alld));
+	
+	const FSAPlayer *roster[4] = { &tft, &alld, &copy, &allc };
+	for (int i = 0 ; i < 4 ; i++)
+	{
+		tourney.AddPlayer(roster[i]);
+		separate.AddPlayer(roster[i]);
+	}
+	
+	// Mutation (even none at all) keeps every player separate
+	CHECK(separate.mutation.SetSparse(4, std::vector<MutationEntry>()));
+	
+	for (int mode = 0 ; mode < 2 ; mode++)
+	{
+		tourney.dynamics = separate.dynamics = mode ? EvoTournament::CONTINUOUS : EvoTournament::DISCRETE;
+		CHECK(tourney.Run(200));
+		CHECK(separate.Run(200));
+		CHECK_EQUAL(3, (int)tourney.GetNumTypes());
+		CHECK_EQUAL(4, (int)separate.GetNumTypes());
+		
+		// The two TFTs share their type's fraction
+		CHECK_EQUAL(separate.data.GetNumRows(), tourney.data.GetNumRows());
+		for (size_t row = 0 ; row < separate.data.GetNumRows() ; row++)
+		{
+			CHECK_EQUAL(tourney.data.Get(row, 0), tourney.data.Get(row, 2));
+			for (size_t col = 0 ; col < 4 ; col++)
+				CHECK(fabs(separate.data.Get(row, col) - tourney.data.Get(row, col)) < 1e-6f);
+		}
+	}
+	
+	// Types survive a checkpoint
+	wxString tempName = wxFileName::CreateTempFileName(wxT("oyun"));
+	tourney.tolerance = 0.0;
+	CHECK(tourney.Run(20));
+	CHECK(tourney.SaveCheckpoint(tempName));
+	CHECK(separate.LoadCheckpoint(tempName));
+	CHECK_EQUAL(3, (int)separate.GetNumTypes());
+	CHECK(tourney.Continue(40));
+	CHECK(separate.Continue(40));
+	CHECK_EQUAL(tourney.data.Get(40, 1), separate.data.Get(40, 1));
+	wxRemoveFile(tempName);
+}
+
+TEST(EvoTournament, Pruning)
+{
+	PrisonerDilemma game;
+	FSAPlayer tft, allc, alld;
+	EvoTournament tourney(&game), full(&game);
+	
+	CHECK(tft.LoadFromString(&game, wxT("Charles Pence\nTFT\n2\nC, 0, 1\nD, 0, 1")));
+	CHECK(allc.LoadFromString(&game, test_evo_allc));
+	CHECK(alld.LoadFromString(&game, test_evo_alld));
+	
+	const FSAPlayer *roster[3] = { &tft, &allc, &alld };
+	for (int i = 0 ; i < 3 ; i++)
+	{
+		tourney.AddPlayer(roster[i]);
+		full.AddPlayer(roster[i]);
+	}
+	
+	// Types which die out are dropped, and everyone else carries on
+	// much as before
+	tourney.tolerance = full.tolerance = 0.0;
+	tourney.extinctionThreshold = 1e-4;
+	for (int mode = 0 ; mode < 2 ; mode++)
+	{
+		tourney.dynamics = full.dynamics = mode ? EvoTournament::CONTINUOUS : EvoTournament::DISCRETE;
+		CHECK(tourney.Run(300));
+		CHECK(full.Run(300));
+		CHECK_EQUAL(3, (int)full.GetNumActiveTypes());
+		CHECK_EQUAL(2, (int)tourney.GetNumActiveTypes());
+		CHECK_EQUAL(0.0f, tourney.data.Get(300, 2));
+		
+		for (size_t col = 0 ; col < 3 ; col++)
+			CHECK(fabs(tourney.data.Get(300, col) - full.data.Get(300, col)) < 1e-3f);
+	}
+	
+	// All-D does better than All-C against everyone
+	EvoTournament dominated(&game);
+	dominated.AddPlayer(&allc);
+	dominated.AddPlayer(&alld);
+	dominated.pruneDominated = true;
+	CHECK(dominated.Run(100));
+	CHECK_EQUAL(1, (int)dominated.GetNumActiveTypes());
+	CHECK_EQUAL(0.0f, dominated.data.Get(1, 0));
+	CHECK_EQUAL(1.0f, dominated.data.Get(1, 1));
+	CHECK(dominated.HasConverged());
+	
+	// A threshold above every fraction still leaves the largest type
+	EvoTournament extinct(&game);
+	extinct.AddPlayer(&alld);
+	extinct.AddPlayer(&allc);
+	extinct.AddPlayer(&tft);
+	extinct.extinctionThreshold = 0.9;
+	CHECK(extinct.Run(10));
+	CHECK_EQUAL(1, (int)extinct.GetNumActiveTypes());
+	CHECK_EQUAL(1.0f, extinct.data.Get(1, 0));
+	CHECK_EQUAL(0.0f, extinct.data.Get(1, 1));
+	CHECK(extinct.HasConverged());
+	
+	// Mutation can bring anyone back, so nothing is pruned
+	CHECK(dominated.mutation.SetSparse(2, std::vector<MutationEntry>()));
+	CHECK(dominated.Run(100));
+	CHECK_EQUAL(2, (int)dominated.GetNumActiveTypes());
+}
+
+TEST(EvoTournament, Equilibria)
+{
+	PrisonerDilemma game;
+	FSAPlayer allc, alld;
+	EvoTournament tourney(&game);
+	EquilibriumSolver solver;
+	
+	CHECK(!tourney.FindEquilibria(solver));
+	
+	CHECK(allc.LoadFromString(&game, test_evo_allc));
+	CHECK(alld.LoadFromString(&game, test_evo_alld));
+	tourney.AddPlayer(&allc);
+	tourney.AddPlayer(&alld);
+	
+	// Where the simulation ends up, with no simulation
+	CHECK(tourney.FindEquilibria(solver));
+	CHECK(solver.IsDominated(0));
+	CHECK_EQUAL(1, (int)solver.GetNumEquilibria());
+	CHECK_EQUAL(1.0, solver.GetEquilibrium(0).mixture[1]);
+	CHECK(solver.GetEquilibrium(0).stable);
+}
+
+TEST(EvoTournament, Invasion)
+{
+	PrisonerDilemma game;
+	FSAPlayer allc, alld;
+	EvoTournament tourney(&game);
+	InvasionAnalysis analysis;
+	
+	CHECK(!tourney.AnalyzeInvasion(analysis));
+	
+	CHECK(allc.LoadFromString(&game, test_evo_allc));
+	CHECK(alld.LoadFromString(&game, test_evo_alld));
+	tourney.AddPlayer(&allc);
+	tourney.AddPlayer(&alld);
+	
+	// Defectors take over cooperators, and not the reverse
+	CHECK(tourney.AnalyzeInvasion(analysis));
+	CHECK_EQUAL(2, (int)analysis.GetSize());
+	CHECK(analysis.CanInvade(0, 1));
+	CHECK(!analysis.CanInvade(1, 0));
+	CHECK(analysis.GetFixation(0, 1) > 1.0 / analysis.GetPopulationSize());
+	CHECK(analysis.GetFixation(1, 0) < 1.0 / analysis.GetPopulationSize());
+	
+	wxString tempName = wxFileName::CreateTempFileName(wxT("oyun"));
+	CHECK(analysis.Write(tempName, tourney.players));
+	wxRemoveFile(tempName);
+}
+
+TEST(EvoTournament, Basins)
+{
+	PrisonerDilemma game;
+	FSAPlayer allc, alld;
+	EvoTournament tourney(&game);
+	BasinMap map;
+	
+	CHECK(!tourney.MapBasins(map));
+	
+	CHECK(allc.LoadFromString(&game, test_evo_allc));
+	CHECK(alld.LoadFromString(&game, test_evo_alld));
+	tourney.AddPlayer(&allc);
+	tourney.AddPlayer(&alld);
+	
+	// Defectors take over from anywhere but all cooperators
+	map.SetSampling(BasinMap::GRID);
+	map.SetNumSamples(11);
+	CHECK(tourney.MapBasins(map));
+	CHECK_EQUAL(11, (int)map.GetNumPoints());
+	CHECK_EQUAL(2, (int)map.GetNumAttractors());
+	CHECK(fabs(map.GetBasinSize(0) - 10.0 / 11.0) < 1e-12);
+	CHECK(map.GetAttractor(0)[1] > 0.999);
+	CHECK_EQUAL(1.0, map.GetAttractor(1)[0]);
+	CHECK_EQUAL(1, map.GetAttractorOf(0));
+	
+	// Mutation keeps a few cooperators around
+	tourney.mutation.SetUniform(2, 0.01);
+	CHECK(tourney.MapBasins(map));
+	CHECK_EQUAL(1, (int)map.GetNumAttractors());
+	CHECK(map.GetAttractor(0)[0] > 0.0);
+	
+	wxString tempName = wxFileName::CreateTempFileName(wxT("oyun"));
+	CHECK(map.Write(tempName, tourney.players));
+	wxRemoveFile(tempName);
+}
+
+TEST(EvoTournament, ImportedMatrix)
+{
+	PrisonerDilemma game;
+	FSAPlayer tft, allc, alld;
+	EvoTournament tourney(&game), imported(&game);
+	
+	CHECK(tft.LoadFromString(&game, wxT("Charles Pence\nTFT\n2\nC, 0, 1\nD, 0, 1")));
+	CHECK(allc.LoadFromString(&game, test_evo_allc));
+	CHECK(alld.LoadFromString(&game, test_evo_alld));
+	tourney.AddPlayer(&tft);
+	tourney.AddPlayer(&allc);
+	tourney.AddPlayer(&alld);
+	
+	// Save the matrix, and evolve the same players again without them
+	// playing a single match
+	wxString tempName = wxFileName::CreateTempFileName(wxT("oyun"));
+	wxString matrixName = tempName + wxT(".oym");
+	CHECK(tourney.SavePayoffs(matrixName));
+	
+	PlayerPtrArray players;
+	CHECK(MatrixFile::Load(matrixName, players));
+	CHECK_EQUAL(3, (int)players.GetCount());
+	for (size_t i = 0 ; i < players.GetCount() ; i++)
+	{
+		CHECK(players[i]->GetPlayerName() == tourney.players[i]->GetPlayerName());
+		imported.AddPlayer(players[i]);
+	}
+	
+	CHECK(tourney.Run(100));
+	CHECK(imported.Run(100));
+	for (size_t col = 0 ; col < 3 ; col++)
+		CHECK_EQUAL(tourney.data.Get(100, col), imported.data.Get(100, col));
+	
+	// Imported players can't be mixed with ones that play
+	imported.AddPlayer(&tft);
+	CHECK(!imported.Run(10));
+	CHECK(Error::Get().Length() > 0);
+	
+	for (size_t i = 0 ; i < players.GetCount() ; i++)
+		delete players[i];
+	wxRemoveFile(matrixName);
+	wxRemoveFile(tempName);
+}
+
+#endif
+/** \endcond */
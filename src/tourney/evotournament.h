@@ -21,28 +21,20 @@
 #ifndef TOURNEY_EVOTOURNAMENT_H__
 #define TOURNEY_EVOTOURNAMENT_H__
 
+class BasinMap;
+class EquilibriumSolver;
 class Game;
+class InvasionAnalysis;
+class OutputFile;
+class Progress;
+struct PayoffTable;
+#include <vector>
+#include <wx/thread.h>
+#include <wx/stopwatch.h>
 #include "../game/player.h"
-
-/**
-    \typedef GenerationWeights
-    \ingroup tourney
-    \brief A map which associates player names (<tt>wxString</tt> values)
-           with population fraction
-    
-    These population-fraction values are always between \c 0.0 and \c 1.0,
-    and the contents of any \c GenerationWeights map always sum to \c 1.0
-    (100% of the population).
-*/
-WX_DECLARE_HASH_MAP(int, float, wxIntegerHash, wxIntegerEqual, GenerationWeights);
-
-/**
-    \typedef GenerationWeightArray
-    \ingroup tourney
-    \brief A variable-length array of GenerationWeights
-*/
-WX_DECLARE_OBJARRAY(GenerationWeights, GenerationWeightArray);
-
+#include "mutation.h"
+#include "payoffmatrix.h"
+#include "trajectory.h"
 
 
 /**
@@ -59,10 +51,61 @@ WX_DECLARE_OBJARRAY(GenerationWeights, GenerationWeightArray);
     
     The players' fractions at each generation are stored in the \c data
     member for later use or graphing.
+    
+    The population may evolve either in discrete generations, or under the
+    continuous-time replicator equation (see \c Dynamics), which is solved
+    with an adaptive Dormand-Prince (RK45) integrator.  In either case, the
+    tournament stops early once the population stops moving (see
+    \c tolerance), and the generation at which it did so is available from
+    GetConvergenceTime().
+    
+    Offspring may also mutate into other strategies (see \c mutation),
+    in which case the population follows the replicator-mutator
+    equation.
+    
+    Players which do exactly as well as each other against everyone
+    (see \c PayoffMatrix::FindTypes) stay in the same proportion to
+    each other forever.  So without mutation, the population is evolved
+    as a smaller set of types, each weighted by its number of players,
+    and split back up into players for \c data.
+    
+    Without mutation, types which have died out no longer affect
+    anyone's score, so they are dropped from the payoff matrix as the
+    run goes on, and only the remaining (active) types are evolved (see
+    \c extinctionThreshold and \c pruneDominated).
+    
+    A run may be extended with Continue(), and long runs may be saved
+    to a checkpoint file as they go (see SetCheckpoint()) and picked up
+    again later with LoadCheckpoint().
 */
 class EvoTournament
 {
 public:
+	/**
+	    \brief How the population evolves from one generation to the next
+	*/
+	enum Dynamics
+	{
+		/**
+		    Discrete generations: each player's new fraction is its old
+		    fraction times its score, divided by the mean score.  With
+		    mutation, that is the fraction of the offspring born to
+		    each player, and they are then shared out by the mutation
+		    matrix: <tt>x' = Q<sup>T</sup> (x f) / f</tt>.
+		*/
+		DISCRETE,
+		
+		/**
+		    The continuous-time replicator equation,
+		    <tt>dx_i/dt = x_i (f_i - f) / f</tt>, where \c f is the mean
+		    score.  Dividing by the mean score keeps one unit of time
+		    about as long as one discrete generation, and \c data holds
+		    the population at every whole unit of time.  With
+		    mutation, this is <tt>dx/dt = (Q<sup>T</sup> (x f) - x f) / f</tt>.
+		*/
+		CONTINUOUS
+	};
+	
 	/**
 	    \brief Constructor
 	    
@@ -88,6 +131,15 @@ public:
 	*/
 	void AddPlayer(const Player *player);
 	
+	/**
+	    \brief Add a number of players to the internal list
+	    
+	    Like AddPlayer(), for a whole set of players at once.
+	    
+	    \param newPlayers Players to be cloned and added to the tournament
+	*/
+	void AddPlayers(const PlayerPtrArray &newPlayers);
+	
 	/**
 	    \brief Remove this player from the internal list
 	    
@@ -106,12 +158,228 @@ public:
 	    
 	    Computes the population fractions, beginning at equal fractions
 	    and evolving proportional to player scores over time.  The results
-	    are accumulated in the \c data member.
+	    are accumulated in the \c data member.  The tournament stops
+	    before \p numGenerations if the population converges.
+	    
+	    This may be called on a worker thread, in which case hold
+	    GetLock() while reading \c data.  If \p progress is cancelled,
+	    the tournament stops after the current generation and fails; the
+	    generations already run are left in \c data, but the tournament
+	    is not marked as played.
+	    
+	    If the matches haven't been played yet, \p progress first
+	    counts those (see \c PayoffMatrix::Compute), and is then
+	    started over to count the generations.
 
-	    \param numGenerations Number of evolutionary generations to compute	    
+	    \param numGenerations Largest number of evolutionary generations
+	                          to compute (or units of time, for
+	                          \c CONTINUOUS dynamics)
+	    \param progress If not \c NULL, counts the matches and the
+	                    generations run, and may be used to cancel the
+	                    tournament
 	    \returns True if the tournament ran successfully, false otherwise
 	*/
-	bool Run(int numGenerations);
+	bool Run(int numGenerations, Progress *progress = NULL);
+	
+	/**
+	    \brief Extend the last run to a larger number of generations
+	    
+	    Picks up the population where the last run (or the last
+	    checkpoint loaded) left off, and evolves it until a total of
+	    \p numGenerations generations have been run, giving exactly the
+	    same results as one uninterrupted run.  If there is no run to
+	    extend, this is the same as Run().  A run which has already
+	    converged is not extended.
+	    
+	    \param numGenerations Total number of generations to reach
+	    \param progress If not \c NULL, counts the generations run and
+	                    may be used to cancel the tournament
+	    \returns True if the tournament ran successfully, false otherwise
+	*/
+	bool Continue(int numGenerations, Progress *progress = NULL);
+	
+	/**
+	    \brief Rebuild the payoff matrix for different payoffs
+	    
+	    Fills in the scores of every pair of players as if their matches
+	    had been played with a prisoner's dilemma with the given payoffs
+	    (see \c PayoffMatrix::Rescore), playing the matches first only
+	    if they haven't been played yet.  The game itself isn't changed.
+	    Any results are thrown away, and the next Run() uses the new
+	    payoffs.
+	    
+	    \param payoffs The new payoffs
+	    \returns True if successful, false otherwise
+	*/
+	bool Rescore(const PayoffTable &payoffs);
+	
+	/**
+	    \brief Find where the population may end up, without running
+	           the tournament
+	    
+	    Finds the equilibria of the payoff matrix of the players, and
+	    which of them are stable (see \c EquilibriumSolver), playing
+	    the matches first if they haven't been played yet.
+	    
+	    \param solver The solver, which receives the equilibria
+	    \param progress If not \c NULL, counts the work done and may be
+	                    used to cancel the search
+	    \returns True if successful, false otherwise
+	*/
+	bool FindEquilibria(EquilibriumSolver &solver, Progress *progress = NULL);
+	
+	/**
+	    \brief Work out which players can invade which others
+	    
+	    Analyzes every pair of players, as a resident population and a
+	    single mutant (see \c InvasionAnalysis), playing the matches
+	    first if they haven't been played yet.
+	    
+	    \param analysis The analysis, which receives the results
+	    \param progress If not \c NULL, counts the work done and may be
+	                    used to cancel the analysis
+	    \returns True if successful, false otherwise
+	*/
+	bool AnalyzeInvasion(InvasionAnalysis &analysis, Progress *progress = NULL);
+	
+	/**
+	    \brief Find where the population ends up from many different
+	           starting mixes
+	    
+	    Evolves many starting populations at once, with the tournament's
+	    mutation, and groups them by where they settle down (see
+	    \c BasinMap), playing the matches first if they haven't been
+	    played yet.
+	    
+	    \param map The map, which receives the results
+	    \param progress If not \c NULL, counts the generations run and
+	                    may be used to cancel the mapping
+	    \returns True if successful, false otherwise
+	*/
+	bool MapBasins(BasinMap &map, Progress *progress = NULL);
+	
+	/**
+	    \brief Save the payoff matrix between the players
+	    
+	    Plays the matches first if they haven't been played yet.  The
+	    matrix is saved as a spreadsheet, or in binary if the file name
+	    ends in \c .oym (see \c MatrixFile), and can be loaded again to
+	    run more tournaments without playing any matches.
+	    
+	    \param fileName The file to be written
+	    \param progress If not \c NULL, counts the matches played and
+	                    may be used to cancel them
+	    \returns True if successful, false otherwise
+	*/
+	bool SavePayoffs(const wxString &fileName, Progress *progress = NULL);
+	
+	/**
+	    \brief Get the number of generations which have been run
+	    
+	    Hold GetLock() while calling this if the tournament may be
+	    running on another thread.
+	    
+	    \returns Number of generations run so far
+	*/
+	int GetNumGenerationsRun() const
+	{ return data.GetNumGenerations() ? (int)data.GetNumGenerations() - 1 : 0; }
+	
+	/**
+	    \brief Get the number of types the players were sorted into
+	    
+	    This is the number of players, unless the last run found some
+	    which always do equally well (see \c PayoffMatrix::FindTypes).
+	    
+	    \returns Number of types in the last run
+	*/
+	size_t GetNumTypes() const { return typeCount.size(); }
+	
+	
+	/**
+	    \brief Save checkpoints while the tournament runs
+	    
+	    Every \p interval generations, and whenever a run finishes or
+	    is cancelled, the state of the tournament is saved to
+	    \p fileName.  The first checkpoint of each run is written with
+	    SaveCheckpoint(); after that, only the population and the rows
+	    of the trajectory added since the last checkpoint are appended
+	    to the file, so the payoff matrix is only written once.
+	    
+	    Runs which take less than \p delay milliseconds (counting the
+	    matches played before the first generation) aren't saved at
+	    all.
+	    
+	    \param fileName The checkpoint file, or an empty string to stop
+	                    saving checkpoints
+	    \param interval Generations between checkpoints, or zero to save
+	                    only at the end of a run
+	    \param delay How long a run must have been going before it is
+	                 saved, in milliseconds
+	*/
+	void SetCheckpoint(const wxString &fileName, int interval, long delay = 0);
+	
+	/**
+	    \brief Save the state of the tournament
+	    
+	    Saves the payoff matrix, the mutation matrix, the current
+	    population and the trajectory so far.  The file is written
+	    under a temporary name and then renamed, so an interrupted save
+	    leaves the last checkpoint intact.  Call this either from the
+	    thread running the tournament or while it is not running.
+	    
+	    \param fileName The checkpoint file
+	    \returns True if the checkpoint was saved, false otherwise
+	*/
+	bool SaveCheckpoint(const wxString &fileName) const;
+	
+	/**
+	    \brief Restore the state of the tournament from a checkpoint
+	    
+	    The checkpoint must have been saved with the same players, in
+	    the same order.  Afterwards, Continue() goes on from where the
+	    checkpoint was saved.  The dynamics, mutation matrix, sampling
+	    and compression are restored along with the data.
+	    
+	    \param fileName The checkpoint file
+	    \returns True if the checkpoint was loaded, false otherwise
+	              (with the tournament left unchanged)
+	*/
+	bool LoadCheckpoint(const wxString &fileName);
+	
+	/**
+	    \brief Get the lock which protects \c data while the tournament
+	           is running
+	    \returns The lock
+	*/
+	wxCriticalSection &GetLock() { return lock; }
+	
+	/**
+	    \brief Did the last run stop because the population converged?
+	    \returns True if the population converged, false otherwise
+	*/
+	bool HasConverged() const { return convergedAt >= 0; }
+	
+	/**
+	    \brief Get the generation at which the population converged
+	    
+	    This is the first generation (or, for \c CONTINUOUS dynamics,
+	    unit of time) whose population differed from the one before by
+	    less than \c tolerance.
+	    
+	    \returns Generation of convergence, or -1 if the population did
+	             not converge
+	*/
+	int GetConvergenceTime() const { return convergedAt; }
+	
+	/**
+	    \brief Get the number of types still being evolved
+	    
+	    Types which have been pruned (see \c extinctionThreshold and
+	    \c pruneDominated) are left out of the fitness computation.
+	    
+	    \returns Number of active types in the last generation run
+	*/
+	size_t GetNumActiveTypes() const { return activeTypes.size(); }
 	
 	
 	/**
@@ -137,13 +405,293 @@ public:
 	/**
 	    \brief The player fractions at every generation of the tournament
 	    
-	    This array has as many elements as generations in the tournament,
-	    and each element specifies the fractional weight of the players
-	    in the tournament at that generation.
+	    This trajectory has a row for (at least) every sampled generation
+	    of the tournament, and a column for each player, in the same
+	    order as \c players.  Its sampling and compression may be set
+	    before running the tournament.
+	*/
+	Trajectory data;
+	
+	/**
+	    \brief How the population evolves
+	*/
+	Dynamics dynamics;
+	
+	/**
+	    \brief The chance that each player's offspring are born as each
+	           other player
+	    
+	    Leave this empty for no mutation.  Otherwise, it must be the
+	    same size as \c players when the tournament is run.
+	*/
+	MutationMatrix mutation;
+	
+	/**
+	    \brief Convergence tolerance
+	    
+	    The tournament stops once the Euclidean distance between the
+	    population fractions of two successive generations falls below
+	    this value.  Set to zero to always run every generation.
+	*/
+	double tolerance;
+	
+	/**
+	    \brief Error tolerance for each step of the \c CONTINUOUS
+	           integrator
+	    
+	    Each step's estimated error in every population fraction must be
+	    below this value, relative to the fraction (or absolute, for
+	    fractions smaller than one).
 	*/
-	GenerationWeightArray data;
+	double stepTolerance;
+	
+	/**
+	    \brief Population fraction below which a type dies out
+	    
+	    Without mutation, a type whose fraction is at or below this
+	    value is set to zero, the rest of the population is scaled back
+	    up to one, and the type is dropped from the fitness computation.
+	    The largest type is never dropped, however high this is.  At
+	    zero (the default), only types whose fraction is exactly zero
+	    are dropped, which never changes the result, since such types
+	    can't come back.
+	*/
+	double extinctionThreshold;
+	
+	/**
+	    \brief Should strictly dominated types be pruned?
+	    
+	    Without mutation, a type which scores less than some other
+	    active type against every active type dies out in the long run,
+	    so if this is true it is set to zero and dropped at once (this
+	    is repeated, since dropping one type can leave others
+	    dominated).  This changes the path the population takes on
+	    the way, but not where it ends up.  False by default.
+	*/
+	bool pruneDominated;
 
 private:
+	/**
+	    \brief Evolve \c population until \p numGenerations have been run
+	    
+	    \param numGenerations Total number of generations to reach
+	    \param progress If not \c NULL, counts the generations run and
+	                    may be used to cancel the tournament
+	    \returns True if successful, false otherwise
+	*/
+	bool Evolve(int numGenerations, Progress *progress);
+	
+	/**
+	    \brief Write a checkpoint to \c checkpointFile, if one is set
+	    
+	    The first call in a run starts the file over; later calls
+	    append to it.
+	    
+	    \returns True if successful (or there was nothing to do), false
+	              otherwise
+	*/
+	bool WriteCheckpoint();
+	
+	/**
+	    \brief Save the state of the tournament to a new checkpoint file
+	    
+	    \param fileName The checkpoint file
+	    \param[in,out] mark How much of \c data has been saved, which
+	                        should be empty to begin with
+	    \returns True if the checkpoint was saved, false otherwise
+	*/
+	bool SaveCheckpoint(const wxString &fileName, TrajectoryMark &mark) const;
+	
+	/**
+	    \brief Write the part of a checkpoint which changes as the
+	           tournament runs
+	    
+	    \param out The checkpoint file
+	    \param[in,out] mark How much of \c data has already been saved
+	*/
+	void SaveCheckpointRecord(OutputFile &out, TrajectoryMark &mark) const;
+	
+	/**
+	    \brief Sort the players into types, and build \c typePayoffs
+	    
+	    Players are only merged into types when there is no mutation.
+	    
+	    \param matrix The payoff matrix of the players
+	    \param merge If false, every player is its own type
+	    \param[out] newTypeOf The type of each player
+	    \param[out] newTypeCount The number of players of each type
+	    \param[out] newTypePayoffs The payoff matrix between types, or
+	                               an empty matrix if there are as many
+	                               types as players
+	*/
+	static void FindTypes(const PayoffMatrix &matrix, bool merge, std::vector<size_t> &newTypeOf,
+	                      std::vector<double> &newTypeCount, PayoffMatrix &newTypePayoffs);
+	
+	/**
+	    \brief Get the payoff matrix the population evolves under
+	    \returns \c typePayoffs, or \c payoffs if each player is its
+	             own type
+	*/
+	const PayoffMatrix &GetTypePayoffs() const
+	{ return typePayoffs.GetSize() ? typePayoffs : payoffs; }
+	
+	/**
+	    \brief Split the population of each type between its players
+	    
+	    \param x Population fraction of each type
+	    \param[out] fractions Population fraction of each player
+	*/
+	void SplitTypes(const std::vector<double> &x, std::vector<double> &fractions) const;
+	
+	/**
+	    \brief Drop types which have died out (or are dominated) from
+	           the fitness computation
+	    
+	    Sets the fraction of each type pruned to zero, updates
+	    \c activeTypes, and packs \c activePayoffs if the set changed.
+	    
+	    \param x Population fraction of each type, updated in place
+	    \param checkDominated If true, look for dominated types even if
+	                          none have died out since the last call
+	*/
+	void UpdateActiveTypes(std::vector<double> &x, bool checkDominated);
+	
+	/**
+	    \brief Get the payoff matrix the steps are computed with
+	    \returns \c activePayoffs, or GetTypePayoffs() if every type is
+	             active
+	*/
+	const PayoffMatrix &GetActivePayoffs() const
+	{ return activePayoffs.GetSize() ? activePayoffs : GetTypePayoffs(); }
+	
+	/**
+	    \brief Compute the score of each player against the population
+	    
+	    \param x Population fractions
+	    \param[out] f Expected score of each player
+	    \returns Mean score of the population
+	*/
+	double Fitness(const std::vector<double> &x, std::vector<double> &f) const;
+	
+	/**
+	    \brief Work out the offspring born to each player
+	    
+	    \param x Population fractions
+	    \param f Score of each player
+	    \param[out] born Each player's share of the offspring, after
+	                     mutation, times the mean score
+	*/
+	void Offspring(const std::vector<double> &x, const std::vector<double> &f,
+	               std::vector<double> &born) const;
+	
+	/**
+	    \brief Advance the population by one discrete generation
+	    \param x Population fractions, updated in place
+	*/
+	void DiscreteStep(std::vector<double> &x) const;
+	
+	/**
+	    \brief Compute the time derivative of the replicator equation
+	    
+	    \param x Population fractions
+	    \param[out] dx Derivative of each fraction
+	*/
+	void Derivative(const std::vector<double> &x, std::vector<double> &dx) const;
+	
+	/**
+	    \brief Advance the population by one unit of time under the
+	           replicator equation
+	    
+	    \param x Population fractions, updated in place
+	    \param h Step size to try first, updated to the size to try next
+	    \returns True if successful, false if the step size underflowed
+	*/
+	bool ContinuousStep(std::vector<double> &x, double &h) const;
+	
+	
+	/**
+	    \brief Scores of every pair of players
+	*/
+	PayoffMatrix payoffs;
+	
+	/**
+	    \brief The type of each player
+	*/
+	std::vector<size_t> typeOf;
+	
+	/**
+	    \brief The number of players of each type
+	*/
+	std::vector<double> typeCount;
+	
+	/**
+	    \brief Scores of every pair of types, if there are fewer types
+	           than players
+	*/
+	PayoffMatrix typePayoffs;
+	
+	/**
+	    \brief The types still being evolved, in order
+	*/
+	std::vector<size_t> activeTypes;
+	
+	/**
+	    \brief Scores of every pair of active types, if some types have
+	           been pruned
+	*/
+	PayoffMatrix activePayoffs;
+	
+	/**
+	    \brief The current population fraction of each type, at full
+	           precision
+	*/
+	std::vector<double> population;
+	
+	/**
+	    \brief The step size for the next \c CONTINUOUS step
+	*/
+	double stepSize;
+	
+	/**
+	    \brief The file to save checkpoints to, if any
+	*/
+	wxString checkpointFile;
+	
+	/**
+	    \brief Generations between checkpoints
+	*/
+	int checkpointInterval;
+	
+	/**
+	    \brief Milliseconds a run must take before it is checkpointed
+	*/
+	long checkpointDelay;
+	
+	/**
+	    \brief Times the current run, for \c checkpointDelay
+	*/
+	wxStopWatch runTime;
+	
+	/**
+	    \brief True once the current run has written to \c checkpointFile
+	*/
+	bool checkpointStarted;
+	
+	/**
+	    \brief How much of \c data has been written to \c checkpointFile
+	*/
+	TrajectoryMark checkpointMark;
+	
+	/**
+	    \brief The generation at which the last run converged, or -1
+	*/
+	int convergedAt;
+	
+	/**
+	    \brief Lock protecting \c data
+	*/
+	wxCriticalSection lock;
+	
 	/**
 	    \brief True when the tournament has been played
 	*/
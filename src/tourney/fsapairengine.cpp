@@ -0,0 +1,237 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#ifdef BUILD_TESTS
+#  include <TestHarness.h>
+#  include "../common/rng.h"
+#  include "../game/prisoner.h"
+#endif
+
+#include "../game/game.h"
+#include "fsapairengine.h"
+#include "match.h"
+
+
+// A player which makes whatever move it's told to, for reading the
+// payoffs of a game
+class ProbePlayer : public Player
+{
+public:
+	virtual Player *Clone() const
+	{ return new ProbePlayer(*this); }
+	virtual bool Think(const Game * WXUNUSED(gamePlayed), const Player * WXUNUSED(nextOpponent))
+	{ return true; }
+};
+
+
+bool FSAPairEngine::SetGame(const Game *game)
+{
+	ready = false;
+	
+	const wxString &gameMoves = game->GetGameMoves();
+	if (gameMoves.Length() != 2 || !game->IsSymmetric() || game->GetNoise() > 0.0)
+		return false;
+	
+	Game *probe = game->Clone();
+	ProbePlayer one, two;
+	
+	for (int o = 0 ; o < 4 ; o++)
+	{
+		probe->Reset();
+		one.Reset();
+		two.Reset();
+		one.nextMove = gameMoves[o / 2];
+		two.nextMove = gameMoves[o % 2];
+		
+		if (!probe->Play(&one, &two))
+		{
+			// Error set in Game::Play(), but we don't report it
+			Error::Get();
+			delete probe;
+			return false;
+		}
+		
+		payoffs[0][o] = one.GetScore();
+		payoffs[1][o] = two.GetScore();
+	}
+	
+	delete probe;
+	
+	moves[0] = gameMoves[0];
+	moves[1] = gameMoves[1];
+	ready = true;
+	
+	return true;
+}
+
+bool FSAPairEngine::CanPlay(const FSAPlayer *player) const
+{
+	if (!ready || !player->GetNumLines())
+		return false;
+	
+	const FSAState *states = player->GetStates();
+	for (int i = 0 ; i < player->GetNumLines() ; i++)
+	{
+		if (states[i].action != moves[0] && states[i].action != moves[1])
+			return false;
+	}
+	
+	return true;
+}
+
+void FSAPairEngine::Play(const FSAPlayer *one, const FSAPlayer *two, int &oneScore, int &twoScore,
+                         wxUint32 *outcomes) const
+{
+	const FSAState *a = one->GetStates(), *b = two->GetStates();
+	size_t numB = two->GetNumLines();
+	size_t numPairs = one->GetNumLines() * numB;
+	wxUint32 counts[4] = { 0, 0, 0, 0 };
+	wxUint32 s = 0, t = 0;
+	
+	if (numPairs > (size_t)Match::quickGameLength)
+	{
+		// The match can't repeat itself in time to save anything
+		for (int turn = 0 ; turn < Match::quickGameLength ; turn++)
+		{
+			int moveOne = (a[s].action != moves[0]), moveTwo = (b[t].action != moves[0]);
+			counts[moveOne * 2 + moveTwo]++;
+			s = a[s].transitions[moveTwo];
+			t = b[t].transitions[moveOne];
+		}
+	}
+	else
+	{
+		// Play until a pair of states comes up again
+		int seen[Match::quickGameLength], outcome[Match::quickGameLength];
+		for (size_t p = 0 ; p < numPairs ; p++)
+			seen[p] = -1;
+		
+		int turn = 0;
+		while (turn < Match::quickGameLength && seen[s * numB + t] == -1)
+		{
+			int moveOne = (a[s].action != moves[0]), moveTwo = (b[t].action != moves[0]);
+			seen[s * numB + t] = turn;
+			outcome[turn++] = moveOne * 2 + moveTwo;
+			s = a[s].transitions[moveTwo];
+			t = b[t].transitions[moveOne];
+		}
+		
+		for (int i = 0 ; i < turn ; i++)
+			counts[outcome[i]]++;
+		
+		// The turns from the first time we were in this pair of states
+		// repeat for the rest of the game
+		if (turn < Match::quickGameLength)
+		{
+			int start = seen[s * numB + t], period = turn - start;
+			int repeats = (Match::quickGameLength - turn) / period, rest = (Match::quickGameLength - turn) % period;
+			
+			for (int i = start ; i < turn ; i++)
+				counts[outcome[i]] += repeats;
+			for (int i = start ; i < start + rest ; i++)
+				counts[outcome[i]]++;
+		}
+	}
+	
+	oneScore = twoScore = 0;
+	for (int o = 0 ; o < 4 ; o++)
+	{
+		oneScore += counts[o] * payoffs[0][o];
+		twoScore += counts[o] * payoffs[1][o];
+		if (outcomes)
+			outcomes[o] = counts[o];
+	}
+}
+
+
+/** \cond TEST */
+#ifdef BUILD_TESTS
+
+TEST(FSAPairEngine, MatchesMatch)
+{
+	// A game of chicken, so that every outcome pays differently
+	PrisonerDilemma game(PayoffTable(7, 3, 0, 1));
+	FSAPairEngine engine;
+	CHECK(engine.SetGame(&game));
+	
+	// Random machines of all sizes, including some too large to repeat
+	// before the end of the game
+	const int numMachines = 40;
+	FSAPlayer machines[numMachines];
+	for (int m = 0 ; m < numMachines ; m++)
+	{
+		unsigned int numStates = 1 + m % 20;
+		std::vector<FSAState> table(numStates);
+		for (unsigned int i = 0 ; i < numStates ; i++)
+		{
+			wxUint64 bits = Random::Hash(m * 1000 + i);
+			table[i].action = (bits & 1) ? wxT('D') : wxT('C');
+			table[i].transitions[0] = (bits >> 8) % numStates;
+			table[i].transitions[1] = (bits >> 32) % numStates;
+		}
+		machines[m].LoadFromTable(&table[0], numStates, wxT("Test"), wxT("Random"));
+		CHECK(engine.CanPlay(&machines[m]));
+	}
+	
+	for (int i = 0 ; i < numMachines ; i++)
+	{
+		for (int j = 0 ; j < numMachines ; j++)
+		{
+			Player *one = machines[i].Clone(), *two = machines[j].Clone();
+			Match match(one, two);
+			match.SetHistoryPolicy(Match::HISTORY_SUMMARY);
+			CHECK(match.Play(&game, true));
+			
+			int oneScore, twoScore;
+			wxUint32 outcomes[4];
+			engine.Play(&machines[i], &machines[j], oneScore, twoScore, outcomes);
+			CHECK_EQUAL(match.playerOneScore, oneScore);
+			CHECK_EQUAL(match.playerTwoScore, twoScore);
+			for (int o = 0 ; o < 4 ; o++)
+				CHECK_EQUAL(match.GetOutcomeCount(0, o / 2, o % 2), (int)outcomes[o]);
+			
+			delete one;
+			delete two;
+		}
+	}
+	
+	// Noise makes matches unpredictable, and machines must only use
+	// the game's moves
+	FSAPlayer other;
+	FSAState bad = { wxT('X'), { 0, 0 } };
+	other.LoadFromTable(&bad, 1, wxT("Test"), wxT("Bad"));
+	CHECK(!engine.CanPlay(&other));
+	
+	game.SetNoise(0.01);
+	CHECK(!engine.SetGame(&game));
+	CHECK(!engine.CanPlay(&machines[0]));
+}
+
+#endif
+/** \endcond */
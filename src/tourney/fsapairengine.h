@@ -0,0 +1,117 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TOURNEY_FSAPAIRENGINE_H__
+#define TOURNEY_FSAPAIRENGINE_H__
+
+#include "../game/fsaplayer.h"
+class Game;
+
+
+/**
+    \class FSAPairEngine
+    \ingroup tourney
+    
+    \brief Plays quick matches between finite state machines straight
+           from their state tables
+    
+    Without noise, two machines playing each other are deterministic:
+    the pair of states they are in decides both moves and the next pair
+    of states.  So once a pair of states comes up again, the match
+    repeats itself from there on, and the rest of it can be counted
+    rather than played.  A match between machines with \c m and \c n
+    states takes at most <tt>m n</tt> steps, with no players, games or
+    histories involved, and gives exactly the scores and outcome counts
+    of a quick \c Match (one game of \c Match::quickGameLength turns).
+    
+    This only works for noiseless, symmetric games with two moves, and
+    for machines whose every action is one of those moves; anything
+    else has to be played as a \c Match.  \c PayoffMatrix and
+    \c TiledPayoffMatrix use the engine whenever they can.
+*/
+class FSAPairEngine
+{
+public:
+	/**
+	    \brief Constructor
+	    
+	    The engine can't play anything until SetGame() succeeds.
+	*/
+	FSAPairEngine() : ready(false) { }
+	
+	/**
+	    \brief Set the game to be played
+	    
+	    The payoffs are read by playing one turn of each pair of moves
+	    on a copy of \p game.
+	    
+	    \param game The game
+	    \returns True if matches of this game can be played by the
+	             engine, false otherwise (no error is set)
+	*/
+	bool SetGame(const Game *game);
+	
+	/**
+	    \brief Can this machine be played by the engine?
+	    \param player The machine
+	    \returns True if SetGame() succeeded and every action of
+	             \p player is a move of the game
+	*/
+	bool CanPlay(const FSAPlayer *player) const;
+	
+	/**
+	    \brief Play a quick match between two machines
+	    
+	    Both machines must pass CanPlay().
+	    
+	    \param one The first machine
+	    \param two The second machine
+	    \param[out] oneScore Score of the first machine
+	    \param[out] twoScore Score of the second machine
+	    \param[out] outcomes If not \c NULL, receives the number of
+	                         turns of CC, CD, DC and DD, from the first
+	                         machine's side
+	*/
+	void Play(const FSAPlayer *one, const FSAPlayer *two, int &oneScore, int &twoScore,
+	          wxUint32 *outcomes = NULL) const;
+
+private:
+	/**
+	    \brief The moves of the game, as stored in \c FSAState::action
+	*/
+	wxUint32 moves[2];
+	
+	/**
+	    \brief Payoff to each player for each outcome (the first
+	           player's move times two, plus the second player's)
+	*/
+	int payoffs[2][4];
+	
+	/**
+	    \brief True once SetGame() has succeeded
+	*/
+	bool ready;
+};
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,703 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#include <wx/file.h>
+
+#include <algorithm>
+
+#ifdef BUILD_TESTS
+#  include <TestHarness.h>
+#  include <wx/filename.h>
+#  include "../game/prisoner.h"
+#  include "../game/titfortat.h"
+#endif
+
+#include "../common/error.h"
+#include "../common/parallel.h"
+#include "../common/rng.h"
+#include "../game/game.h"
+#include "genetic.h"
+#include "match.h"
+
+
+// Random helpers for the genetic operators
+static unsigned int RandomIndex(unsigned int n)
+{
+	return Random::Generate() % n;
+}
+
+static bool RandomChance(double p)
+{
+	return Random::GenerateFloat() < p;
+}
+
+
+/**
+    \brief Plays every machine in a list against the roster
+*/
+class RosterFitnessTask : public ParallelTask
+{
+public:
+	RosterFitnessTask(const Game *g, const PlayerPtrArray &r, 
+	                  const std::vector<const FSAPlayer *> &m) :
+		game(g), roster(r), machines(m), results(m.size(), 0.0)
+	{ }
+	
+	virtual bool Run(size_t begin, size_t end)
+	{
+		// Each thread needs its own game, and its own copies of the players
+		Game *localGame = game->Clone();
+		
+		for (size_t i = begin ; i < end ; i++)
+		{
+			double total = 0.0;
+			
+			for (size_t j = 0 ; j < roster.GetCount() ; j++)
+			{
+				Player *one = machines[i]->Clone();
+				Player *two = roster[j]->Clone();
+				Match match(one, two);
+				match.SetHistoryPolicy(Match::HISTORY_NONE);
+				
+				bool ok = match.Play(localGame, true);
+				
+				delete one;
+				delete two;
+				
+				// Error already set in Match::Play()
+				if (!ok)
+				{
+					delete localGame;
+					return false;
+				}
+				
+				total += match.playerOneScore;
+			}
+			
+			results[i] = total / roster.GetCount();
+		}
+		
+		delete localGame;
+		return true;
+	}
+	
+	const Game *game;
+	const PlayerPtrArray &roster;
+	const std::vector<const FSAPlayer *> &machines;
+	std::vector<double> results;
+};
+
+/**
+    \brief Plays a list of pairs of machines against one another
+*/
+class PairFitnessTask : public ParallelTask
+{
+public:
+	PairFitnessTask(const Game *g, const std::vector<const FSAPlayer *> &o,
+	                const std::vector<const FSAPlayer *> &t) :
+		game(g), ones(o), twos(t), oneScores(o.size(), 0), twoScores(o.size(), 0)
+	{ }
+	
+	virtual bool Run(size_t begin, size_t end)
+	{
+		Game *localGame = game->Clone();
+		
+		for (size_t i = begin ; i < end ; i++)
+		{
+			Player *one = ones[i]->Clone();
+			Player *two = twos[i]->Clone();
+			Match match(one, two);
+			match.SetHistoryPolicy(Match::HISTORY_NONE);
+			
+			bool ok = match.Play(localGame, true);
+			
+			delete one;
+			delete two;
+			
+			// Error already set in Match::Play()
+			if (!ok)
+			{
+				delete localGame;
+				return false;
+			}
+			
+			oneScores[i] = match.playerOneScore;
+			twoScores[i] = match.playerTwoScore;
+		}
+		
+		delete localGame;
+		return true;
+	}
+	
+	const Game *game;
+	const std::vector<const FSAPlayer *> &ones;
+	const std::vector<const FSAPlayer *> &twos;
+	std::vector<int> oneScores;
+	std::vector<int> twoScores;
+};
+
+/**
+    \brief Sorts population indices by decreasing fitness
+*/
+class FitnessCompare
+{
+public:
+	FitnessCompare(const std::vector<double> &f) : fitness(f) { }
+	
+	bool operator()(size_t a, size_t b) const
+	{
+		return fitness[a] > fitness[b];
+	}
+	
+	const std::vector<double> &fitness;
+};
+
+
+GeneticTournament::GeneticTournament(Game *gm) :
+	populationSize(50), minStates(1), maxStates(16), mutationRate(0.02),
+	crossoverRate(0.7), selectionSize(3), eliteCount(2), fitnessMode(FITNESS_ROSTER),
+	generation(0), numMatchesPlayed(0), game(gm)
+{ }
+
+GeneticTournament::~GeneticTournament()
+{
+	Reset();
+	
+	for (size_t i = 0 ; i < roster.GetCount() ; i++)
+		delete roster[i];
+	roster.Clear();
+}
+
+
+void GeneticTournament::AddPlayer(const Player *player)
+{
+	roster.Add(player->Clone());
+	
+	// Cached roster scores are no longer right
+	rosterCache.clear();
+}
+
+void GeneticTournament::RemovePlayer(const Player *player)
+{
+	for (size_t i = 0 ; i < roster.GetCount() ; i++)
+	{
+		Player *t = roster[i];
+		
+		if (player->GetID() == t->GetID())
+		{
+			delete t;
+			roster.RemoveAt(i);
+			rosterCache.clear();
+			return;
+		}
+	}
+}
+
+
+bool GeneticTournament::Run(int numGenerations)
+{
+	if (game->GetGameMoves().Length() != 2)
+	{
+		Error::Set(_("Finite state machines can only be bred for two-move games"));
+		return false;
+	}
+	if (!minStates || minStates > maxStates || populationSize < 2 ||
+	    !(fitnessMode & FITNESS_BOTH))
+	{
+		Error::Set(_("The genetic algorithm parameters are invalid"));
+		return false;
+	}
+	if (fitnessMode == FITNESS_ROSTER && !roster.GetCount())
+	{
+		Error::Set(_("Add at least one player to measure fitness against"));
+		return false;
+	}
+	
+	// Start with a random population
+	if (!population.GetCount())
+	{
+		for (size_t i = 0 ; i < populationSize ; i++)
+		{
+			unsigned int numStates = minStates + RandomIndex(maxStates - minStates + 1);
+			std::vector<FSAState> machine;
+			
+			for (unsigned int j = 0 ; j < numStates ; j++)
+				machine.push_back(RandomState(numStates));
+			
+			population.Add(MakePlayer(machine, i));
+		}
+		
+		if (!Evaluate())
+			return false;
+	}
+	
+	for (int gen = 0 ; gen < numGenerations ; gen++)
+	{
+		generation++;
+		Breed();
+		
+		if (!Evaluate())
+			return false;
+	}
+	
+	return true;
+}
+
+void GeneticTournament::Reset()
+{
+	for (size_t i = 0 ; i < population.GetCount() ; i++)
+		delete population[i];
+	population.Clear();
+	
+	fitness.clear();
+	bestFitness.clear();
+	meanFitness.clear();
+	generation = 0;
+}
+
+
+const FSAPlayer *GeneticTournament::GetChampion() const
+{
+	if (!fitness.size())
+		return NULL;
+	
+	size_t best = std::max_element(fitness.begin(), fitness.end()) - fitness.begin();
+	return static_cast<const FSAPlayer *>(population[best]);
+}
+
+bool GeneticTournament::SaveChampion(const wxString &fileName) const
+{
+	const FSAPlayer *champion = GetChampion();
+	if (!champion)
+	{
+		Error::Set(_("There is no evolved player to save"));
+		return false;
+	}
+	
+	wxFile file;
+	if (!file.Create(fileName, true) || !file.Write(champion->GetScript()))
+	{
+		Error::Set(wxString::Format(_("Could not write to file %s"), fileName.c_str()));
+		return false;
+	}
+	
+	return true;
+}
+
+
+bool GeneticTournament::Evaluate()
+{
+	size_t numPlayers = population.GetCount();
+	
+	// Find the distinct machines in this generation
+	WX_DECLARE_HASH_MAP(wxUint64, size_t, wxIntegerHash, wxIntegerEqual, HashIndex);
+	HashIndex uniqueIndex;
+	std::vector<const FSAPlayer *> unique;
+	std::vector<size_t> uniqueCount;
+	std::vector<size_t> playerUnique(numPlayers);
+	
+	for (size_t i = 0 ; i < numPlayers ; i++)
+	{
+		const FSAPlayer *player = static_cast<const FSAPlayer *>(population[i]);
+		HashIndex::iterator it = uniqueIndex.find(player->GetCanonicalHash());
+		
+		if (it == uniqueIndex.end())
+		{
+			playerUnique[i] = unique.size();
+			uniqueIndex[player->GetCanonicalHash()] = unique.size();
+			unique.push_back(player);
+			uniqueCount.push_back(1);
+		}
+		else
+		{
+			playerUnique[i] = it->second;
+			uniqueCount[it->second]++;
+		}
+	}
+	
+	size_t numUnique = unique.size();
+	bool useRoster = (fitnessMode & FITNESS_ROSTER) && roster.GetCount();
+	bool useGeneration = (fitnessMode & FITNESS_GENERATION) != 0;
+	
+	// Score new machines against the roster
+	if (useRoster)
+	{
+		std::vector<const FSAPlayer *> toPlay;
+		for (size_t u = 0 ; u < numUnique ; u++)
+			if (rosterCache.find(unique[u]->GetCanonicalHash()) == rosterCache.end())
+				toPlay.push_back(unique[u]);
+		
+		RosterFitnessTask task(game, roster, toPlay);
+		if (!Parallel::For(toPlay.size(), &task))
+			return false;
+		
+		for (size_t i = 0 ; i < toPlay.size() ; i++)
+			rosterCache[toPlay[i]->GetCanonicalHash()] = task.results[i];
+		numMatchesPlayed += toPlay.size() * roster.GetCount();
+	}
+	
+	// Score new pairs of machines against one another
+	if (useGeneration)
+	{
+		// Don't let the cache grow without bound over a long run
+		if (pairCache.size() > (1 << 20))
+			pairCache.clear();
+		
+		std::vector<const FSAPlayer *> ones, twos;
+		for (size_t u = 0 ; u < numUnique ; u++)
+		{
+			for (size_t v = u ; v < numUnique ; v++)
+			{
+				// A machine only meets itself if it's there twice
+				if (u == v && uniqueCount[u] < 2)
+					continue;
+				
+				wxUint64 key = PairKey(unique[u]->GetCanonicalHash(), unique[v]->GetCanonicalHash());
+				if (pairCache.find(key) == pairCache.end())
+				{
+					ones.push_back(unique[u]);
+					twos.push_back(unique[v]);
+				}
+			}
+		}
+		
+		PairFitnessTask task(game, ones, twos);
+		if (!Parallel::For(ones.size(), &task))
+			return false;
+		
+		for (size_t i = 0 ; i < ones.size() ; i++)
+		{
+			wxUint64 hashOne = ones[i]->GetCanonicalHash(), hashTwo = twos[i]->GetCanonicalHash();
+			
+			pairCache[PairKey(hashOne, hashTwo)] = task.oneScores[i];
+			pairCache[PairKey(hashTwo, hashOne)] = task.twoScores[i];
+		}
+		numMatchesPlayed += ones.size();
+	}
+	
+	// Fitness is the mean score per match, over every opponent faced
+	fitness.assign(numPlayers, 0.0);
+	
+	for (size_t i = 0 ; i < numPlayers ; i++)
+	{
+		size_t u = playerUnique[i];
+		wxUint64 hash = unique[u]->GetCanonicalHash();
+		double total = 0.0;
+		size_t matches = 0;
+		
+		if (useRoster)
+		{
+			total += rosterCache[hash] * roster.GetCount();
+			matches += roster.GetCount();
+		}
+		
+		if (useGeneration)
+		{
+			for (size_t v = 0 ; v < numUnique ; v++)
+			{
+				size_t count = uniqueCount[v] - (u == v ? 1 : 0);
+				if (!count)
+					continue;
+				
+				total += (double)count * pairCache[PairKey(hash, unique[v]->GetCanonicalHash())];
+				matches += count;
+			}
+		}
+		
+		if (matches)
+			fitness[i] = total / matches;
+	}
+	
+	double sum = 0.0;
+	for (size_t i = 0 ; i < numPlayers ; i++)
+		sum += fitness[i];
+	
+	bestFitness.push_back(*std::max_element(fitness.begin(), fitness.end()));
+	meanFitness.push_back(sum / numPlayers);
+	
+	return true;
+}
+
+void GeneticTournament::Breed()
+{
+	size_t numPlayers = population.GetCount();
+	PlayerPtrArray next;
+	next.Alloc(populationSize);
+	
+	// Keep the elite unchanged
+	std::vector<size_t> order(numPlayers);
+	for (size_t i = 0 ; i < numPlayers ; i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), FitnessCompare(fitness));
+	
+	for (size_t i = 0 ; i < eliteCount && i < numPlayers && next.GetCount() < populationSize ; i++)
+		next.Add(population[order[i]]->Clone());
+	
+	// Breed the rest
+	while (next.GetCount() < populationSize)
+	{
+		const FSAPlayer *one = static_cast<const FSAPlayer *>(population[Select()]);
+		std::vector<FSAState> child;
+		
+		if (RandomChance(crossoverRate))
+		{
+			const FSAPlayer *two = static_cast<const FSAPlayer *>(population[Select()]);
+			child = Crossover(one, two);
+		}
+		else
+			child.assign(one->GetStates(), one->GetStates() + one->GetNumLines());
+		
+		Mutate(child);
+		next.Add(MakePlayer(child, next.GetCount()));
+	}
+	
+	for (size_t i = 0 ; i < numPlayers ; i++)
+		delete population[i];
+	population = next;
+}
+
+size_t GeneticTournament::Select() const
+{
+	size_t best = RandomIndex(population.GetCount());
+	
+	for (unsigned int i = 1 ; i < selectionSize ; i++)
+	{
+		size_t challenger = RandomIndex(population.GetCount());
+		if (fitness[challenger] > fitness[best])
+			best = challenger;
+	}
+	
+	return best;
+}
+
+FSAState GeneticTournament::RandomState(unsigned int numStates) const
+{
+	const wxString &moves = game->GetGameMoves();
+	FSAState state;
+	
+	state.action = moves[RandomIndex(moves.Length())];
+	state.transitions[0] = RandomIndex(numStates);
+	state.transitions[1] = RandomIndex(numStates);
+	
+	return state;
+}
+
+void GeneticTournament::Mutate(std::vector<FSAState> &machine) const
+{
+	const wxString &moves = game->GetGameMoves();
+	
+	// Point mutations of actions and transitions
+	for (size_t i = 0 ; i < machine.size() ; i++)
+	{
+		if (RandomChance(mutationRate))
+		{
+			int move = moves.Find((wxChar)machine[i].action);
+			machine[i].action = moves[(move + 1 + RandomIndex(moves.Length() - 1)) % moves.Length()];
+		}
+		
+		for (int t = 0 ; t < 2 ; t++)
+			if (RandomChance(mutationRate))
+				machine[i].transitions[t] = RandomIndex(machine.size());
+	}
+	
+	// Add a state, and make sure something leads to it
+	if (machine.size() < maxStates && RandomChance(mutationRate))
+	{
+		unsigned int newState = machine.size();
+		machine.push_back(RandomState(newState + 1));
+		machine[RandomIndex(newState)].transitions[RandomIndex(2)] = newState;
+	}
+	
+	// Remove a state, redirecting anything which led to it
+	if (machine.size() > minStates && machine.size() > 1 && RandomChance(mutationRate))
+	{
+		unsigned int removed = RandomIndex(machine.size());
+		machine.erase(machine.begin() + removed);
+		
+		for (size_t i = 0 ; i < machine.size() ; i++)
+		{
+			for (int t = 0 ; t < 2 ; t++)
+			{
+				wxUint32 &trans = machine[i].transitions[t];
+				
+				if (trans == removed)
+					trans = RandomIndex(machine.size());
+				else if (trans > removed)
+					trans--;
+			}
+		}
+	}
+}
+
+std::vector<FSAState> GeneticTournament::Crossover(const FSAPlayer *one, const FSAPlayer *two) const
+{
+	const FSAState *first = one->GetStates(), *second = two->GetStates();
+	unsigned int firstSize = one->GetNumLines(), secondSize = two->GetNumLines();
+	
+	// The child takes its size from either parent, and its states from the
+	// first parent up to the cut point, the second parent after it
+	unsigned int childSize = RandomChance(0.5) ? firstSize : secondSize;
+	unsigned int cut = RandomIndex(childSize + 1);
+	
+	std::vector<FSAState> child(childSize);
+	for (unsigned int i = 0 ; i < childSize ; i++)
+	{
+		if ((i < cut && i < firstSize) || i >= secondSize)
+			child[i] = first[i];
+		else
+			child[i] = second[i];
+		
+		for (int t = 0 ; t < 2 ; t++)
+			if (child[i].transitions[t] >= childSize)
+				child[i].transitions[t] = RandomIndex(childSize);
+	}
+	
+	return child;
+}
+
+FSAPlayer *GeneticTournament::MakePlayer(const std::vector<FSAState> &machine, size_t index) const
+{
+	FSAPlayer *player = new FSAPlayer;
+	player->LoadFromTable(&machine[0], machine.size(), _("Genetic algorithm"),
+	                      wxString::Format(_("Evolved %d-%d"), generation, (int)index));
+	return player;
+}
+
+wxUint64 GeneticTournament::PairKey(wxUint64 one, wxUint64 two)
+{
+	return one ^ (two + wxULL(0x9E3779B97F4A7C15) + (one << 6) + (one >> 2));
+}
+
+
+/** \cond TEST */
+#ifdef BUILD_TESTS
+
+static const wxString test_ga_alld("Charles Pence\nAll-D\n1\nD, 0, 0");
+
+TEST(GeneticTournament, Limits)
+{
+	PrisonerDilemma game;
+	TitForTatPlayer tft;
+	GeneticTournament ga(&game);
+	
+	Random::Seed(1234);
+	
+	ga.AddPlayer(&tft);
+	ga.populationSize = 20;
+	ga.minStates = 2;
+	ga.maxStates = 5;
+	ga.mutationRate = 0.5;
+	
+	CHECK(ga.Run(10));
+	CHECK_EQUAL(20, (int)ga.population.GetCount());
+	CHECK_EQUAL(11, (int)ga.bestFitness.size());
+	
+	// Every machine must still be within the limits, and valid
+	bool ok = true;
+	for (size_t i = 0 ; i < ga.population.GetCount() ; i++)
+	{
+		const FSAPlayer *p = dynamic_cast<const FSAPlayer *>(ga.population[i]);
+		if (!p || p->GetNumLines() < 2 || p->GetNumLines() > 5)
+		{
+			ok = false;
+			continue;
+		}
+		
+		for (int j = 0 ; j < p->GetNumLines() ; j++)
+		{
+			const FSAState &s = p->GetStates()[j];
+			if ((s.action != 'C' && s.action != 'D') || 
+			    s.transitions[0] >= (wxUint32)p->GetNumLines() || 
+			    s.transitions[1] >= (wxUint32)p->GetNumLines())
+				ok = false;
+		}
+	}
+	CHECK(ok);
+}
+
+TEST(GeneticTournament, Evolution)
+{
+	PrisonerDilemma game;
+	TitForTatPlayer tft;
+	FSAPlayer alld;
+	GeneticTournament ga(&game);
+	
+	Random::Seed(5678);
+	
+	CHECK(alld.LoadFromString(&game, test_ga_alld));
+	ga.AddPlayer(&tft);
+	ga.AddPlayer(&alld);
+	ga.populationSize = 30;
+	
+	CHECK(ga.Run(15));
+	
+	// With elitism, deterministic players, and a fixed roster, the best
+	// never gets worse
+	bool ok = true;
+	for (size_t i = 1 ; i < ga.bestFitness.size() ; i++)
+		if (ga.bestFitness[i] < ga.bestFitness[i - 1])
+			ok = false;
+	CHECK(ok);
+	
+	// The champion can be saved and read back
+	wxString tempName = wxFileName::CreateTempFileName(wxT("oyun"));
+	CHECK(ga.SaveChampion(tempName));
+	
+	FSAPlayer loaded;
+	CHECK(loaded.Load(&game, tempName));
+	CHECK(loaded.GetCanonicalHash() == ga.GetChampion()->GetCanonicalHash());
+	
+	wxRemoveFile(tempName);
+}
+
+TEST(GeneticTournament, Cache)
+{
+	PrisonerDilemma game;
+	TitForTatPlayer tft;
+	GeneticTournament ga(&game);
+	
+	Random::Seed(42);
+	
+	ga.AddPlayer(&tft);
+	ga.populationSize = 10;
+	
+	CHECK(ga.Run(0));
+	size_t played = ga.GetNumMatchesPlayed();
+	CHECK(played > 0);
+	
+	// With no mutation or crossover, the next generation is made only of
+	// machines we've seen before, so nothing new should be played
+	ga.mutationRate = 0.0;
+	ga.crossoverRate = 0.0;
+	CHECK(ga.Run(3));
+	CHECK_EQUAL(played, ga.GetNumMatchesPlayed());
+}
+
+#endif
+/** \endcond */
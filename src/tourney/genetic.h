@@ -0,0 +1,289 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TOURNEY_GENETIC_H__
+#define TOURNEY_GENETIC_H__
+
+#include <vector>
+
+#include "../game/fsaplayer.h"
+class Game;
+
+
+/**
+    \class GeneticTournament
+    \ingroup tourney
+    
+    \brief Breeds finite state machines with a genetic algorithm
+    
+    Rather than evaluating a fixed set of strategies, this class evolves a
+    population of \c FSAPlayer machines.  Each generation, every machine is
+    scored, and the next generation is built from the best of them by
+    elitism, tournament selection, crossover, and mutation (of actions, of
+    transitions, and by adding or removing states, within the limits
+    \c minStates and \c maxStates).
+    
+    A machine's fitness is its mean score per match against a fixed roster
+    of opponents (see AddPlayer()), against the other members of its
+    generation, or both (see \c fitnessMode).  Matches are played in
+    parallel (see \c Parallel::For).  Since FSA matches are deterministic,
+    match scores are cached by canonical machine hash (see
+    \c FSAPlayer::CanonicalHash), so that only new machines are ever
+    evaluated.  (If the roster contains a non-deterministic player, such as
+    \c RandomPlayer, each machine's score against it is thus sampled only
+    once.)
+*/
+class GeneticTournament
+{
+public:
+	/**
+	    \brief Opponents against which fitness is measured
+	*/
+	enum FitnessMode
+	{
+		FITNESS_ROSTER = 1,       /**< Score against the roster */
+		FITNESS_GENERATION = 2,   /**< Score against the rest of the generation */
+		FITNESS_BOTH = 3          /**< Score against both */
+	};
+	
+	/**
+	    \brief Constructor
+	    
+	    Sets the \c game value, and sets default parameters.
+	    
+	    \param gm Initial value of the \c game member.
+	*/
+	GeneticTournament(Game *gm);
+	
+	virtual ~GeneticTournament();
+	
+	
+	/**
+	    \brief Add a player to the fixed roster of opponents
+	    
+	    The player passed will be cloned, and its pointer not stored.
+	    
+	    \param player Player to be cloned and added to the roster
+	*/
+	void AddPlayer(const Player *player);
+	
+	/**
+	    \brief Remove a player from the fixed roster of opponents
+	    
+	    \param player Player of the same ID as that to be removed
+	*/
+	void RemovePlayer(const Player *player);
+	
+	
+	/**
+	    \brief Breed the population for a number of generations
+	    
+	    If there is no population yet, a random one is created and
+	    evaluated first.  Otherwise, evolution continues from the current
+	    population, so that this function may be called repeatedly.
+	    
+	    \param numGenerations Number of generations to breed
+	    \returns True if the run succeeded, false otherwise
+	*/
+	bool Run(int numGenerations);
+	
+	/**
+	    \brief Throw away the population and its history
+	*/
+	void Reset();
+	
+	/**
+	    \brief Get the fittest machine of the current generation
+	    \returns The best machine, or NULL if nothing has been run
+	*/
+	const FSAPlayer *GetChampion() const;
+	
+	/**
+	    \brief Save the fittest machine as an FSA script
+	    
+	    The script is in the usual text format, and may be loaded with
+	    \c FSAPlayer::Load.
+	    
+	    \param fileName The file to write
+	    \returns True if the script was saved, false otherwise
+	*/
+	bool SaveChampion(const wxString &fileName) const;
+	
+	/**
+	    \brief Get the number of matches played so far
+	    
+	    Matches whose results were found in the cache are not counted.
+	    
+	    \returns Number of matches actually played
+	*/
+	size_t GetNumMatchesPlayed() const { return numMatchesPlayed; }
+	
+	
+	/**
+	    \brief Number of machines in each generation
+	*/
+	size_t populationSize;
+	
+	/**
+	    \brief Smallest number of states a machine may have
+	*/
+	unsigned int minStates;
+	
+	/**
+	    \brief Largest number of states a machine may have
+	*/
+	unsigned int maxStates;
+	
+	/**
+	    \brief Probability of each individual mutation
+	    
+	    This is the chance that any given action or transition is changed,
+	    and also the chance of adding (or removing) a state.
+	*/
+	double mutationRate;
+	
+	/**
+	    \brief Probability that a child is bred from two parents rather
+	           than one
+	*/
+	double crossoverRate;
+	
+	/**
+	    \brief Number of machines competing in each selection tournament
+	*/
+	unsigned int selectionSize;
+	
+	/**
+	    \brief Number of best machines copied unchanged to the next
+	           generation
+	*/
+	unsigned int eliteCount;
+	
+	/**
+	    \brief Opponents used to compute fitness (a \c FitnessMode value)
+	*/
+	int fitnessMode;
+	
+	
+	/**
+	    \brief The fixed roster of opponents
+	*/
+	PlayerPtrArray roster;
+	
+	/**
+	    \brief The current generation (all \c FSAPlayer objects)
+	*/
+	PlayerPtrArray population;
+	
+	/**
+	    \brief Fitness of each member of \c population
+	*/
+	std::vector<double> fitness;
+	
+	/**
+	    \brief Best fitness at every generation so far
+	*/
+	std::vector<double> bestFitness;
+	
+	/**
+	    \brief Mean fitness at every generation so far
+	*/
+	std::vector<double> meanFitness;
+
+private:
+	/**
+	    \brief Score the current population
+	    \returns True if successful, false otherwise
+	*/
+	bool Evaluate();
+	
+	/**
+	    \brief Replace the current population with the next generation
+	*/
+	void Breed();
+	
+	/**
+	    \brief Choose a parent by tournament selection
+	    \returns Index into \c population
+	*/
+	size_t Select() const;
+	
+	/**
+	    \brief Make a random state, with transitions into a machine of
+	           \p numStates states
+	*/
+	FSAState RandomState(unsigned int numStates) const;
+	
+	/**
+	    \brief Apply every kind of mutation (each with \c mutationRate)
+	*/
+	void Mutate(std::vector<FSAState> &machine) const;
+	
+	/**
+	    \brief One-point crossover of two machines
+	*/
+	std::vector<FSAState> Crossover(const FSAPlayer *one, const FSAPlayer *two) const;
+	
+	/**
+	    \brief Make a new player from a machine
+	*/
+	FSAPlayer *MakePlayer(const std::vector<FSAState> &machine, size_t index) const;
+	
+	
+	WX_DECLARE_HASH_MAP(wxUint64, double, wxIntegerHash, wxIntegerEqual, RosterCache);
+	WX_DECLARE_HASH_MAP(wxUint64, int, wxIntegerHash, wxIntegerEqual, PairCache);
+	
+	/**
+	    \brief Cache of mean roster score, by canonical hash
+	*/
+	RosterCache rosterCache;
+	
+	/**
+	    \brief Cache of match score, by combined canonical hashes of the
+	           two machines (see PairKey())
+	*/
+	PairCache pairCache;
+	
+	/**
+	    \brief Combine two canonical hashes into a \c pairCache key
+	*/
+	static wxUint64 PairKey(wxUint64 one, wxUint64 two);
+	
+	/**
+	    \brief Number of generations bred so far
+	*/
+	int generation;
+	
+	/**
+	    \brief Number of matches actually played so far
+	*/
+	size_t numMatchesPlayed;
+	
+	/**
+	    \brief Game to be played
+	*/
+	Game *game;
+};
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,334 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#include <math.h>
+
+#ifdef BUILD_TESTS
+#  include <TestHarness.h>
+#endif
+
+#include "../common/error.h"
+#include "../common/outputfile.h"
+#include "../common/parallel.h"
+#include "../common/progress.h"
+#include "invasion.h"
+#include "payoffmatrix.h"
+
+
+// How close two (rescaled) payoffs must be to count as equal
+static const double epsilon = 1e-9;
+
+
+/**
+    \brief Analyzes the pairs with each of a range of residents
+*/
+class InvasionTask : public ParallelTask
+{
+public:
+	InvasionTask(const std::vector<double> &a, size_t n, size_t z, double w,
+	             Progress *p, std::vector<double> &f, std::vector<wxUint8> &i) :
+		payoffs(a), size(n), populationSize(z), selection(w), progress(p),
+		fixation(f), invades(i)
+	{ }
+	
+	virtual bool Run(size_t begin, size_t end)
+	{
+		std::vector<double> logs(populationSize);
+		
+		for (size_t r = begin ; r < end ; r++)
+		{
+			if (progress && progress->IsCancelled())
+			{
+				Error::Set(_("The invasion analysis was cancelled"));
+				return false;
+			}
+			
+			for (size_t m = 0 ; m < size ; m++)
+			{
+				double a = payoffs[r * size + r], b = payoffs[r * size + m];
+				double c = payoffs[m * size + r], d = payoffs[m * size + m];
+				
+				invades[r * size + m] = (c - a > epsilon || (fabs(c - a) <= epsilon && d - b > epsilon));
+				fixation[r * size + m] = Fixation(a, b, c, d, logs);
+			}
+			
+			if (progress)
+				progress->Advance();
+		}
+		
+		return true;
+	}
+	
+private:
+	// The chance that one mutant takes over the residents, given the
+	// resident's payoffs against residents (a) and mutants (b), and the
+	// mutant's against residents (c) and mutants (d), using logs as
+	// scratch space
+	double Fixation(double a, double b, double c, double d, std::vector<double> &logs) const
+	{
+		// With k mutants, the residents score (b k + a (Z - k - 1)) and
+		// the mutants (c (Z - k) + d (k - 1)), over Z - 1.  The chance
+		// of losing a mutant over gaining one is then exp(-w) raised to
+		// the difference, which is alpha + beta k.
+		double z = (double)populationSize;
+		double alpha = (a * (z - 1.0) + d - c * z) / (z - 1.0);
+		double beta = (b - a - d + c) / (z - 1.0);
+		
+		// The fixation probability is one over the sum, for k from zero
+		// to Z - 1, of the products of these ratios up to k.  Sum the
+		// logarithms, and add them up from the largest, so that the
+		// exponentials can't overflow.
+		logs[0] = 0.0;
+		double largest = 0.0;
+		for (size_t k = 1 ; k < populationSize ; k++)
+		{
+			logs[k] = logs[k - 1] + selection * (alpha + beta * (double)k);
+			if (logs[k] > largest)
+				largest = logs[k];
+		}
+		
+		double sum = 0.0;
+		for (size_t k = 0 ; k < populationSize ; k++)
+			sum += exp(logs[k] - largest);
+		
+		return exp(-largest) / sum;
+	}
+	
+	const std::vector<double> &payoffs;
+	size_t size, populationSize;
+	double selection;
+	Progress *progress;
+	std::vector<double> &fixation;
+	std::vector<wxUint8> &invades;
+};
+
+
+bool InvasionAnalysis::Compute(const PayoffMatrix &payoffs, Progress *progress)
+{
+	if (populationSize < 2)
+	{
+		Error::Set(_("The population must have at least two members"));
+		return false;
+	}
+	
+	size = 0;
+	fixation.clear();
+	invades.clear();
+	
+	size_t n = payoffs.GetSize();
+	if (!n)
+	{
+		Error::Set(_("There are no players to analyze"));
+		return false;
+	}
+	
+	// Rescale the payoffs to [0, 1], so that the selection intensity
+	// means the same thing in every game
+	double low = payoffs.Get(0, 0), high = low;
+	for (size_t i = 0 ; i < n ; i++)
+	{
+		for (size_t j = 0 ; j < n ; j++)
+		{
+			double value = payoffs.Get(i, j);
+			if (value < low)
+				low = value;
+			if (value > high)
+				high = value;
+		}
+	}
+	double scale = (high > low) ? high - low : 1.0;
+	
+	std::vector<double> rescaled(n * n);
+	for (size_t i = 0 ; i < n ; i++)
+		for (size_t j = 0 ; j < n ; j++)
+			rescaled[i * n + j] = (payoffs.Get(i, j) - low) / scale;
+	
+	std::vector<double> newFixation(n * n);
+	std::vector<wxUint8> newInvades(n * n);
+	
+	if (progress)
+		progress->Start(n);
+	
+	InvasionTask task(rescaled, n, populationSize, selection, progress, newFixation, newInvades);
+	
+	// Error already set in InvasionTask::Run()
+	if (!Parallel::For(n, &task, 1))
+		return false;
+	
+	size = n;
+	fixation.swap(newFixation);
+	invades.swap(newInvades);
+	return true;
+}
+
+bool InvasionAnalysis::Write(const wxString &fileName, const PlayerPtrArray &players) const
+{
+	if (!size || players.GetCount() != size)
+	{
+		Error::Set(_("The invasion analysis has not been run"));
+		return false;
+	}
+	
+	OutputFile out;
+	if (!out.Open(fileName))
+		return false;
+	
+	const wxString titles[] = { _("Fixation Probability"), _("Can Invade") };
+	
+	for (size_t block = 0 ; block < 2 ; block++)
+	{
+		if (block)
+			out.EndLine();
+		
+		out.Write(titles[block]);
+		out.EndLine();
+		
+		// Mutants across the top, residents down the side
+		out.Write(_("Resident \\ Mutant"));
+		for (size_t m = 0 ; m < size ; m++)
+		{
+			out.Write(',');
+			out.Write(players[m]->GetPlayerName());
+		}
+		out.EndLine();
+		
+		for (size_t r = 0 ; r < size ; r++)
+		{
+			out.Write(players[r]->GetPlayerName());
+			for (size_t m = 0 ; m < size ; m++)
+			{
+				out.Write(',');
+				if (block == 0)
+					out.WriteExact(GetFixation(r, m));
+				else
+					out.WriteInt(CanInvade(r, m) ? 1 : 0);
+			}
+			out.EndLine();
+		}
+	}
+	
+	return out.Close();
+}
+
+
+/** \cond TEST */
+#ifdef BUILD_TESTS
+
+// Analyze the symmetric game with the given payoffs
+static bool TestAnalyze(InvasionAnalysis &analysis, size_t size, const double *values)
+{
+	PayoffMatrix matrix;
+	matrix.Assign(size, values);
+	return analysis.Compute(matrix);
+}
+
+TEST(InvasionAnalysis, Fixation)
+{
+	InvasionAnalysis analysis;
+	analysis.SetPopulationSize(10);
+	
+	// Nobody is favored in a game where everyone scores the same
+	const double neutral[4] = { 2, 2,
+	                            2, 2 };
+	CHECK(TestAnalyze(analysis, 2, neutral));
+	CHECK(!analysis.CanInvade(0, 1));
+	CHECK(fabs(analysis.GetFixation(0, 1) - 0.1) < 1e-12);
+	
+	// Constant fitness: one mutant with relative fitness r takes over
+	// with chance (1 - 1/r) / (1 - 1/r^Z)
+	const double constant[4] = { 0, 0,
+	                             1, 1 };
+	analysis.SetSelection(0.5);
+	CHECK(TestAnalyze(analysis, 2, constant));
+	double r = exp(0.5);
+	double expected = (1.0 - 1.0 / r) / (1.0 - pow(r, -10.0));
+	CHECK(analysis.CanInvade(0, 1));
+	CHECK(!analysis.CanInvade(1, 0));
+	CHECK(fabs(analysis.GetFixation(0, 1) - expected) < 1e-12);
+	CHECK(fabs(analysis.GetFixation(1, 0) - (r - 1.0) / (pow(r, 10.0) - 1.0)) < 1e-12);
+	
+	// In the prisoner's dilemma, defectors invade cooperators and are
+	// favored to take over, and not the other way around
+	const double pd[4] = { 3, 0,
+	                       5, 1 };
+	analysis.SetSelection(1.0);
+	analysis.SetPopulationSize(100);
+	CHECK(TestAnalyze(analysis, 2, pd));
+	CHECK(analysis.CanInvade(0, 1));
+	CHECK(!analysis.CanInvade(1, 0));
+	CHECK(analysis.GetFixation(0, 1) > 0.01);
+	CHECK(analysis.GetFixation(1, 0) < 0.01);
+	
+	// Strong selection can't overflow
+	analysis.SetSelection(1000.0);
+	CHECK(TestAnalyze(analysis, 2, pd));
+	CHECK(analysis.GetFixation(0, 1) > 0.5);
+	CHECK(analysis.GetFixation(1, 0) >= 0.0);
+	CHECK(analysis.GetFixation(1, 0) < 1e-100);
+	
+	// The tie-breaker: equal against residents, better against mutants
+	const double tie[4] = { 1, 0,
+	                        1, 2 };
+	CHECK(TestAnalyze(analysis, 2, tie));
+	CHECK(analysis.CanInvade(0, 1));
+	CHECK(!analysis.CanInvade(1, 0));
+	
+	analysis.SetPopulationSize(1);
+	CHECK(!TestAnalyze(analysis, 2, tie));
+}
+
+TEST(InvasionAnalysis, Threads)
+{
+	// The answers don't depend on the number of threads
+	const size_t size = 37;
+	std::vector<double> values(size * size);
+	for (size_t i = 0 ; i < values.size() ; i++)
+		values[i] = (double)((i * 7919) % 101);
+	
+	InvasionAnalysis one, many;
+	Parallel::SetNumThreads(1);
+	CHECK(TestAnalyze(one, size, &values[0]));
+	Parallel::SetNumThreads(4);
+	CHECK(TestAnalyze(many, size, &values[0]));
+	Parallel::SetNumThreads(0);
+	
+	CHECK_EQUAL(size, many.GetSize());
+	for (size_t r = 0 ; r < size ; r++)
+	{
+		CHECK(fabs(one.GetFixation(r, r) - 0.01) < 1e-12);
+		for (size_t m = 0 ; m < size ; m++)
+		{
+			CHECK_EQUAL(one.GetFixation(r, m), many.GetFixation(r, m));
+			CHECK_EQUAL(one.CanInvade(r, m), many.CanInvade(r, m));
+		}
+	}
+}
+
+#endif
+/** \endcond */
@@ -0,0 +1,183 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TOURNEY_INVASION_H__
+#define TOURNEY_INVASION_H__
+
+#include <vector>
+#include "../game/player.h"
+class PayoffMatrix;
+class Progress;
+
+
+/**
+    \class InvasionAnalysis
+    \ingroup tourney
+    
+    \brief Works out which players can invade populations of which
+           others
+    
+    For every ordered pair of players (a resident and a mutant), this
+    looks at the two-player game between them, taken from the payoff
+    matrix, and works out:
+    
+    - Whether the mutant can invade an infinite population of
+      residents: that is, whether a rare mutant does better than the
+      residents around it (or, if it does just as well against
+      residents, better against other mutants).
+    - The chance that a single mutant takes over a population of
+      GetPopulationSize() residents under the Moran process, in which
+      each step an individual chosen in proportion to its fitness
+      reproduces, replacing one chosen at random.  Fitness is
+      <tt>exp(w p)</tt>, with \c p the average score against the rest of
+      the population, rescaled so that the payoff matrix runs from zero
+      to one, and \c w the selection intensity.  This is worked out
+      exactly from the birth-death ratios, without simulation, in time
+      proportional to the population size.
+    
+    A neutral mutant takes over with probability <tt>1 / Z</tt>, for
+    population size \c Z, so mutants with a higher chance are favored by
+    selection.  The pairs are split between threads (see
+    \c Parallel::For).
+*/
+class InvasionAnalysis
+{
+public:
+	/**
+	    \brief Constructor
+	*/
+	InvasionAnalysis() : populationSize(100), selection(1.0), size(0) { }
+	
+	/**
+	    \brief Analyze every pair of players
+	    
+	    \param payoffs The payoff matrix of the players
+	    \param progress If not \c NULL, counts the residents analyzed
+	                    and may be used to cancel the analysis
+	    \returns True if successful, false otherwise
+	*/
+	bool Compute(const PayoffMatrix &payoffs, Progress *progress = NULL);
+	
+	/**
+	    \brief Write the results as a CSV file
+	    
+	    The file holds two matrices, one after the other, with a row
+	    for each resident and a column for each mutant: the fixation
+	    probabilities, and then whether the mutant can invade (1 or 0).
+	    The probabilities are written in full (see
+	    \c OutputFile::WriteExact), since under strong selection they
+	    may be far smaller than a millionth.
+	    
+	    \param fileName The file to be written
+	    \param players The players, for their names
+	    \returns True if the file was written, false otherwise
+	*/
+	bool Write(const wxString &fileName, const PlayerPtrArray &players) const;
+	
+	
+	/**
+	    \brief Set the population size for the fixation probabilities
+	    \param newSize Number of individuals (at least two)
+	*/
+	void SetPopulationSize(size_t newSize) { populationSize = newSize; }
+	
+	/**
+	    \brief Get the population size for the fixation probabilities
+	    \returns Number of individuals
+	*/
+	size_t GetPopulationSize() const { return populationSize; }
+	
+	/**
+	    \brief Set the intensity of selection
+	    
+	    At zero, every mutant is neutral, and the higher the intensity,
+	    the more fitness depends on score.
+	    
+	    \param intensity Selection intensity
+	*/
+	void SetSelection(double intensity) { selection = intensity; }
+	
+	/**
+	    \brief Get the intensity of selection
+	    \returns Selection intensity
+	*/
+	double GetSelection() const { return selection; }
+	
+	
+	/**
+	    \brief Get the number of players analyzed
+	    \returns Number of rows (and columns) of the results
+	*/
+	size_t GetSize() const { return size; }
+	
+	/**
+	    \brief Can a mutant invade a population of residents?
+	    
+	    \param resident Index of the resident player
+	    \param mutant Index of the mutant player
+	    \returns True if a rare mutant does better than the residents
+	*/
+	bool CanInvade(size_t resident, size_t mutant) const
+	{ return invades[resident * size + mutant] != 0; }
+	
+	/**
+	    \brief Get the chance that a single mutant takes over
+	    
+	    \param resident Index of the resident player
+	    \param mutant Index of the mutant player
+	    \returns Fixation probability of the mutant
+	*/
+	double GetFixation(size_t resident, size_t mutant) const
+	{ return fixation[resident * size + mutant]; }
+
+private:
+	/**
+	    \brief Population size for the fixation probabilities
+	*/
+	size_t populationSize;
+	
+	/**
+	    \brief Selection intensity
+	*/
+	double selection;
+	
+	/**
+	    \brief The number of players analyzed
+	*/
+	size_t size;
+	
+	/**
+	    \brief Fixation probability of each mutant in each resident
+	           population, row by row
+	*/
+	std::vector<double> fixation;
+	
+	/**
+	    \brief One if each mutant can invade each resident population,
+	           row by row
+	*/
+	std::vector<wxUint8> invades;
+};
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
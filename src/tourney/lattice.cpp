@@ -0,0 +1,564 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#include <wx/file.h>
+
+#include <math.h>
+
+#ifdef BUILD_TESTS
+#  include <TestHarness.h>
+#  include <wx/filename.h>
+#  include "../game/prisoner.h"
+#  include "../game/fsaplayer.h"
+#endif
+
+#include "../common/error.h"
+#include "../common/parallel.h"
+#include "../common/rng.h"
+#include "lattice.h"
+
+
+// Cells are processed in square tiles of this size, so that the rows
+// above and below a cell are still in cache when we get to it
+static const unsigned int tileSize = 64;
+
+// Neighbor offsets; the first four are the von Neumann neighborhood
+static const int neighborX[8] = { 0, -1, 1, 0, -1, 1, -1, 1 };
+static const int neighborY[8] = { -1, 0, 0, 1, -1, -1, 1, 1 };
+
+static const char frameMagic[8] = { 'O', 'Y', 'U', 'N', 'L', 'A', 'T', 'T' };
+
+
+/**
+    \brief Base for the two per-generation passes over the lattice
+    
+    Each item is one tile of the lattice.
+*/
+class LatticeTileTask : public ParallelTask
+{
+public:
+	LatticeTileTask(LatticeTournament *t) : 
+		tourney(t),
+		width(t->width), height(t->height),
+		tilesAcross((t->width + tileSize - 1) / tileSize),
+		numNeighbors(t->neighborhood == LatticeTournament::MOORE ? 8 : 4)
+	{ }
+	
+	size_t GetNumTiles() const
+	{ return tilesAcross * ((height + tileSize - 1) / tileSize); }
+	
+	virtual bool Run(size_t begin, size_t end)
+	{
+		for (size_t tile = begin ; tile < end ; tile++)
+		{
+			unsigned int x0 = (tile % tilesAcross) * tileSize;
+			unsigned int y0 = (tile / tilesAcross) * tileSize;
+			unsigned int x1 = (x0 + tileSize < width) ? x0 + tileSize : width;
+			unsigned int y1 = (y0 + tileSize < height) ? y0 + tileSize : height;
+			
+			for (unsigned int y = y0 ; y < y1 ; y++)
+				for (unsigned int x = x0 ; x < x1 ; x++)
+					DoCell(x, y);
+		}
+		
+		return true;
+	}
+	
+protected:
+	// Index of neighbor n of cell (x, y), wrapping around the torus
+	size_t Neighbor(unsigned int x, unsigned int y, int n) const
+	{
+		unsigned int nx = (x + width + neighborX[n]) % width;
+		unsigned int ny = (y + height + neighborY[n]) % height;
+		return (size_t)ny * width + nx;
+	}
+	
+	virtual void DoCell(unsigned int x, unsigned int y) = 0;
+	
+	LatticeTournament *tourney;
+	unsigned int width, height, tilesAcross;
+	int numNeighbors;
+};
+
+/**
+    \brief Computes the score of every cell against its neighbors
+*/
+class LatticeScoreTask : public LatticeTileTask
+{
+public:
+	LatticeScoreTask(LatticeTournament *t) : LatticeTileTask(t) { }
+	
+protected:
+	virtual void DoCell(unsigned int x, unsigned int y)
+	{
+		const std::vector<wxUint16> &grid = tourney->grid;
+		size_t cell = (size_t)y * width + x;
+		const double *row = tourney->payoffs.GetRow(grid[cell]);
+		double score = 0.0;
+		
+		for (int n = 0 ; n < numNeighbors ; n++)
+			score += row[grid[Neighbor(x, y, n)]];
+		
+		tourney->cellScores[cell] = score;
+	}
+};
+
+/**
+    \brief Chooses the strategy of every cell in the next generation
+*/
+class LatticeUpdateTask : public LatticeTileTask
+{
+public:
+	LatticeUpdateTask(LatticeTournament *t) : LatticeTileTask(t) { }
+	
+protected:
+	virtual void DoCell(unsigned int x, unsigned int y)
+	{
+		const std::vector<wxUint16> &grid = tourney->grid;
+		const std::vector<float> &scores = tourney->cellScores;
+		size_t cell = (size_t)y * width + x;
+		wxUint16 strategy = grid[cell];
+		
+		if (tourney->updateRule == LatticeTournament::BEST_TAKES_OVER)
+		{
+			float best = scores[cell];
+			
+			for (int n = 0 ; n < numNeighbors ; n++)
+			{
+				size_t neighbor = Neighbor(x, y, n);
+				if (scores[neighbor] > best)
+				{
+					best = scores[neighbor];
+					strategy = grid[neighbor];
+				}
+			}
+		}
+		else
+		{
+			wxUint64 key = ((wxUint64)tourney->generation << 32) ^ cell;
+			wxUint64 r = Random::Hash(tourney->seed ^ Random::Hash(key));
+			size_t neighbor = Neighbor(x, y, r % numNeighbors);
+			
+			double diff = scores[cell] - scores[neighbor];
+			double p = 1.0 / (1.0 + exp(diff / tourney->fermiTemperature));
+			
+			if (Random::HashToFloat(Random::Hash(r)) < p)
+				strategy = grid[neighbor];
+		}
+		
+		tourney->nextGrid[cell] = strategy;
+	}
+};
+
+
+LatticeTournament::LatticeTournament(Game *gm) :
+	neighborhood(VON_NEUMANN), updateRule(BEST_TAKES_OVER), fermiTemperature(10.0),
+	seed(0), generation(0), width(0), height(0), played(false), game(gm)
+{
+	SetSize(64, 64);
+}
+
+LatticeTournament::~LatticeTournament()
+{
+	for (size_t i = 0 ; i < players.GetCount() ; i++)
+		delete players[i];
+	players.Clear();
+}
+
+
+void LatticeTournament::AddPlayer(const Player *player)
+{
+	players.Add(player->Clone());
+	
+	payoffs.Clear();
+	Reset();
+}
+
+void LatticeTournament::RemovePlayer(const Player *player)
+{
+	for (size_t i = 0 ; i < players.GetCount() ; i++)
+	{
+		Player *t = players[i];
+		
+		if (player->GetID() == t->GetID())
+		{
+			delete t;
+			players.RemoveAt(i);
+			
+			// Cells with this strategy go to the first player, and the
+			// others shift down to keep their strategy
+			for (size_t c = 0 ; c < grid.size() ; c++)
+			{
+				if (grid[c] == i)
+					grid[c] = 0;
+				else if (grid[c] > i)
+					grid[c]--;
+			}
+			
+			payoffs.Clear();
+			Reset();
+			return;
+		}
+	}
+}
+
+
+bool LatticeTournament::SetSize(unsigned int newWidth, unsigned int newHeight)
+{
+	if (!newWidth || !newHeight || newWidth > MAX_SIZE || newHeight > MAX_SIZE)
+	{
+		Error::Set(wxString::Format(_("The lattice must be between 1 and %d cells on a side"), MAX_SIZE));
+		return false;
+	}
+	
+	width = newWidth;
+	height = newHeight;
+	
+	grid.assign((size_t)width * height, 0);
+	nextGrid.assign(grid.size(), 0);
+	cellScores.assign(grid.size(), 0.0f);
+	
+	Reset();
+	return true;
+}
+
+void LatticeTournament::Randomize()
+{
+	if (!players.GetCount())
+		return;
+	
+	for (size_t c = 0 ; c < grid.size() ; c++)
+		grid[c] = Random::Hash(seed ^ Random::Hash(c)) % players.GetCount();
+	
+	Reset();
+}
+
+
+bool LatticeTournament::Run(int numGenerations)
+{
+	if (!players.GetCount())
+	{
+		Error::Set(_("Add at least one player to the lattice tournament"));
+		return false;
+	}
+	if (players.GetCount() > 65536)
+	{
+		Error::Set(_("A lattice tournament may have at most 65536 players"));
+		return false;
+	}
+	
+	// Compute the payoffs once, and never play another match
+	if (payoffs.GetSize() != players.GetCount())
+	{
+		if (!payoffs.Compute(game, players))
+			return false;
+	}
+	
+	// Record the starting state
+	if (!played)
+	{
+		data.SetNumPlayers(players.GetCount());
+		if (!Record())
+			return false;
+		played = true;
+	}
+	
+	for (int gen = 0 ; gen < numGenerations ; gen++)
+	{
+		if (!Step())
+			return false;
+		
+		generation++;
+		
+		if (!Record())
+			return false;
+	}
+	
+	return true;
+}
+
+void LatticeTournament::Reset()
+{
+	played = false;
+	generation = 0;
+	data.Clear();
+}
+
+std::vector<wxUint32> LatticeTournament::GetCounts() const
+{
+	std::vector<wxUint32> counts(players.GetCount(), 0);
+	
+	for (size_t c = 0 ; c < grid.size() ; c++)
+		counts[grid[c]]++;
+	
+	return counts;
+}
+
+
+bool LatticeTournament::Step()
+{
+	LatticeScoreTask scoreTask(this);
+	if (!Parallel::For(scoreTask.GetNumTiles(), &scoreTask))
+		return false;
+	
+	LatticeUpdateTask updateTask(this);
+	if (!Parallel::For(updateTask.GetNumTiles(), &updateTask))
+		return false;
+	
+	grid.swap(nextGrid);
+	return true;
+}
+
+bool LatticeTournament::Record()
+{
+	std::vector<wxUint32> counts = GetCounts();
+	std::vector<double> fractions(counts.size());
+	
+	for (size_t i = 0 ; i < counts.size() ; i++)
+		fractions[i] = (double)counts[i] / grid.size();
+	data.Add(fractions);
+	
+	if (frameFile.IsOpened() && !WriteFrame())
+		return false;
+	
+	if (!imagePrefix.IsEmpty())
+	{
+		if (!SaveImage(imagePrefix + wxString::Format(wxT("%05d.ppm"), generation)))
+			return false;
+	}
+	
+	return true;
+}
+
+
+bool LatticeTournament::OpenFrameDump(const wxString &fileName)
+{
+	CloseFrameDump();
+	
+	if (!frameFile.Create(fileName, true))
+	{
+		Error::Set(wxString::Format(_("Could not create file %s"), fileName.c_str()));
+		return false;
+	}
+	
+	wxUint32 header[3] = { width, height, (wxUint32)players.GetCount() };
+	if (frameFile.Write(frameMagic, sizeof(frameMagic)) != sizeof(frameMagic) ||
+	    frameFile.Write(header, sizeof(header)) != sizeof(header))
+	{
+		Error::Set(wxString::Format(_("Could not write to file %s"), fileName.c_str()));
+		CloseFrameDump();
+		return false;
+	}
+	
+	// An unplayed lattice is written by the first Record() of Run()
+	return played ? WriteFrame() : true;
+}
+
+void LatticeTournament::CloseFrameDump()
+{
+	if (frameFile.IsOpened())
+		frameFile.Close();
+}
+
+bool LatticeTournament::WriteFrame()
+{
+	wxUint32 gen = generation;
+	size_t gridBytes = grid.size() * sizeof(wxUint16);
+	
+	if (frameFile.Write(&gen, sizeof(gen)) != sizeof(gen) ||
+	    frameFile.Write(&grid[0], gridBytes) != gridBytes)
+	{
+		Error::Set(_("Could not write a frame of the lattice"));
+		CloseFrameDump();
+		return false;
+	}
+	
+	return true;
+}
+
+bool LatticeTournament::SaveImage(const wxString &fileName) const
+{
+	// Spread the strategy colors around the color wheel by the golden
+	// ratio, so that neighboring indices are easy to tell apart
+	size_t numPlayers = players.GetCount() ? players.GetCount() : 1;
+	std::vector<unsigned char> palette(numPlayers * 3);
+	
+	for (size_t i = 0 ; i < numPlayers ; i++)
+	{
+		double hue = fmod(i * 0.618033988749895, 1.0) * 6.0;
+		int sector = (int)hue;
+		double f = hue - sector;
+		double v = 0.95, p = v * 0.25, q = v * (1.0 - 0.75 * f), t = v * (1.0 - 0.75 * (1.0 - f));
+		double rgb[6][3] = { { v, t, p }, { q, v, p }, { p, v, t }, { p, q, v }, { t, p, v }, { v, p, q } };
+		
+		for (int k = 0 ; k < 3 ; k++)
+			palette[i * 3 + k] = (unsigned char)(rgb[sector % 6][k] * 255.0);
+	}
+	
+	std::vector<unsigned char> pixels(grid.size() * 3);
+	for (size_t c = 0 ; c < grid.size() ; c++)
+	{
+		pixels[c * 3] = palette[grid[c] * 3];
+		pixels[c * 3 + 1] = palette[grid[c] * 3 + 1];
+		pixels[c * 3 + 2] = palette[grid[c] * 3 + 2];
+	}
+	
+	wxFile file;
+	if (!file.Create(fileName, true))
+	{
+		Error::Set(wxString::Format(_("Could not create file %s"), fileName.c_str()));
+		return false;
+	}
+	
+	wxString header = wxString::Format(wxT("P6\n%d %d\n255\n"), width, height);
+	if (!file.Write(header) || file.Write(&pixels[0], pixels.size()) != pixels.size())
+	{
+		Error::Set(wxString::Format(_("Could not write to file %s"), fileName.c_str()));
+		return false;
+	}
+	
+	return true;
+}
+
+
+/** \cond TEST */
+#ifdef BUILD_TESTS
+
+static const wxString test_lattice_allc("Charles Pence\nAll-C\n1\nC, 0, 0");
+static const wxString test_lattice_alld("Charles Pence\nAll-D\n1\nD, 0, 0");
+
+TEST(LatticeTournament, BestTakesOver)
+{
+	PrisonerDilemma game;
+	FSAPlayer allc, alld;
+	LatticeTournament tourney(&game);
+	
+	CHECK(allc.LoadFromString(&game, test_lattice_allc));
+	CHECK(alld.LoadFromString(&game, test_lattice_alld));
+	tourney.AddPlayer(&allc);
+	tourney.AddPlayer(&alld);
+	
+	// A single defector in a sea of cooperators
+	CHECK(tourney.SetSize(16, 16));
+	tourney.SetCell(8, 8, 1);
+	
+	CHECK(tourney.Run(1));
+	
+	// The defector out-scores each of its four neighbors, and nobody else
+	std::vector<wxUint32> counts = tourney.GetCounts();
+	CHECK_EQUAL(251, (int)counts[0]);
+	CHECK_EQUAL(5, (int)counts[1]);
+	CHECK_EQUAL(1, tourney.GetCell(8, 7));
+	CHECK_EQUAL(0, tourney.GetCell(7, 7));
+	
+	CHECK_EQUAL(2, (int)tourney.data.GetNumRows());
+	CHECK_EQUAL(5.0f / 256.0f, tourney.data.Get(1, 1));
+	
+	// The lattice wraps around at the edges
+	CHECK(tourney.SetSize(16, 16));
+	tourney.SetCell(0, 0, 1);
+	CHECK(tourney.Run(1));
+	CHECK_EQUAL(1, tourney.GetCell(15, 0));
+	CHECK_EQUAL(1, tourney.GetCell(0, 15));
+}
+
+TEST(LatticeTournament, Deterministic)
+{
+	PrisonerDilemma game;
+	FSAPlayer allc, alld;
+	
+	CHECK(allc.LoadFromString(&game, test_lattice_allc));
+	CHECK(alld.LoadFromString(&game, test_lattice_alld));
+	
+	// The same seed should give the same lattice, however many threads run it
+	std::vector<wxUint16> results[2];
+	for (int run = 0 ; run < 2 ; run++)
+	{
+		Parallel::SetNumThreads(run ? 4 : 1);
+		
+		LatticeTournament tourney(&game);
+		tourney.AddPlayer(&allc);
+		tourney.AddPlayer(&alld);
+		tourney.updateRule = LatticeTournament::FERMI;
+		tourney.neighborhood = LatticeTournament::MOORE;
+		tourney.fermiTemperature = 500.0;
+		tourney.seed = 99;
+		
+		CHECK(tourney.SetSize(100, 70));
+		tourney.Randomize();
+		CHECK(tourney.Run(5));
+		
+		for (unsigned int y = 0 ; y < 70 ; y++)
+			for (unsigned int x = 0 ; x < 100 ; x++)
+				results[run].push_back(tourney.GetCell(x, y));
+	}
+	Parallel::SetNumThreads(0);
+	
+	CHECK(results[0] == results[1]);
+}
+
+TEST(LatticeTournament, FrameDump)
+{
+	PrisonerDilemma game;
+	FSAPlayer allc;
+	LatticeTournament tourney(&game);
+	
+	CHECK(allc.LoadFromString(&game, test_lattice_allc));
+	tourney.AddPlayer(&allc);
+	CHECK(tourney.SetSize(10, 6));
+	
+	wxString tempName = wxFileName::CreateTempFileName(wxT("oyun"));
+	CHECK(tourney.OpenFrameDump(tempName));
+	CHECK(tourney.Run(3));
+	tourney.CloseFrameDump();
+	
+	// Header, then the starting frame and one per generation
+	wxFile file(tempName);
+	CHECK(file.IsOpened());
+	CHECK_EQUAL((int)(8 + 12 + 4 * (4 + 10 * 6 * 2)), (int)file.Length());
+	file.Close();
+	
+	// A played lattice is written once on open, then once per generation
+	CHECK(tourney.OpenFrameDump(tempName));
+	CHECK(tourney.Run(1));
+	tourney.CloseFrameDump();
+	CHECK(file.Open(tempName));
+	CHECK_EQUAL((int)(8 + 12 + 2 * (4 + 10 * 6 * 2)), (int)file.Length());
+	file.Close();
+	
+	CHECK(tourney.SaveImage(tempName));
+	wxFile image(tempName);
+	CHECK_EQUAL((int)(12 + 10 * 6 * 3), (int)image.Length());
+	image.Close();
+	
+	wxRemoveFile(tempName);
+}
+
+#endif
+/** \endcond */
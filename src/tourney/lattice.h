@@ -0,0 +1,375 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TOURNEY_LATTICE_H__
+#define TOURNEY_LATTICE_H__
+
+#include <wx/file.h>
+
+#include <vector>
+
+#include "../game/player.h"
+#include "payoffmatrix.h"
+#include "trajectory.h"
+class Game;
+
+
+/**
+    \class LatticeTournament
+    \ingroup tourney
+    
+    \brief Runs a spatial evolutionary tournament on a 2D lattice
+    
+    Where \c EvoTournament models a well-mixed, infinite population, this
+    class places individual players on the cells of a toroidal lattice
+    (of up to 4096 by 4096 cells).  Each generation, every cell plays
+    each of its neighbors (see \c Neighborhood), and then adopts the
+    strategy of one of its neighbors according to an update rule (see
+    \c UpdateRule).  All updates happen simultaneously.
+    
+    Since players are deterministic, every match score is taken from a
+    \c PayoffMatrix computed before the first generation.  The lattice
+    itself is just an array of strategy indices, double-buffered, and
+    each generation is computed in parallel over square tiles of cells.
+    Random choices are drawn from \c Random::Hash of the seed, the
+    generation, and the cell, so that a run gives the same results no
+    matter how many threads are used.
+    
+    The lattice can be dumped, every generation, to a binary frame file
+    (see OpenFrameDump()) or to a sequence of PPM images (see
+    SetImagePrefix()).
+*/
+class LatticeTournament
+{
+public:
+	/**
+	    \brief The cells with which each cell interacts
+	*/
+	enum Neighborhood
+	{
+		VON_NEUMANN,   /**< The four orthogonal neighbors */
+		MOORE          /**< All eight surrounding cells */
+	};
+	
+	/**
+	    \brief How each cell picks its strategy for the next generation
+	*/
+	enum UpdateRule
+	{
+		/**
+		    Adopt the strategy of the highest-scoring cell among the cell
+		    and its neighbors (keeping our own on a tie)
+		*/
+		BEST_TAKES_OVER,
+		
+		/**
+		    Pick one neighbor at random, and adopt its strategy with
+		    probability <tt>1 / (1 + exp((own - neighbor) / K))</tt>, where
+		    \c K is \c fermiTemperature
+		*/
+		FERMI
+	};
+	
+	/**
+	    \brief Largest allowed lattice width or height
+	*/
+	static const unsigned int MAX_SIZE = 4096;
+	
+	
+	/**
+	    \brief Constructor
+	    
+	    Sets the \c game value, and creates a 64 by 64 lattice.
+	    
+	    \param gm Initial value of the \c game member.
+	*/
+	LatticeTournament(Game *gm);
+	
+	virtual ~LatticeTournament();
+	
+	
+	/**
+	    \brief Add a player (strategy) to the internal list
+	    
+	    The player passed will be cloned, and its pointer not stored.
+	    At most 65536 players may be added.
+	    
+	    \param player Player to be cloned and added to the tournament
+	*/
+	void AddPlayer(const Player *player);
+	
+	/**
+	    \brief Remove this player from the internal list
+	    
+	    Any cells holding this player are reassigned, and the tournament
+	    is reset.
+	    
+	    \param player Player of the same ID as that to be removed
+	*/
+	void RemovePlayer(const Player *player);
+	
+	
+	/**
+	    \brief Change the size of the lattice
+	    
+	    The lattice is reset, and every cell is set to the first player.
+	    
+	    \param newWidth Width of the lattice
+	    \param newHeight Height of the lattice
+	    \returns True if the size is allowed, false otherwise
+	*/
+	bool SetSize(unsigned int newWidth, unsigned int newHeight);
+	
+	/**
+	    \brief Get the width of the lattice
+	    \returns Lattice width
+	*/
+	unsigned int GetWidth() const { return width; }
+	
+	/**
+	    \brief Get the height of the lattice
+	    \returns Lattice height
+	*/
+	unsigned int GetHeight() const { return height; }
+	
+	/**
+	    \brief Get the strategy at a cell
+	    
+	    \param x Column of the cell
+	    \param y Row of the cell
+	    \returns Index (into \c players) of the cell's strategy
+	*/
+	wxUint16 GetCell(unsigned int x, unsigned int y) const
+	{ return grid[y * width + x]; }
+	
+	/**
+	    \brief Set the strategy at a cell
+	    
+	    \param x Column of the cell
+	    \param y Row of the cell
+	    \param strategy Index (into \c players) of the new strategy
+	*/
+	void SetCell(unsigned int x, unsigned int y, wxUint16 strategy)
+	{ grid[y * width + x] = strategy; }
+	
+	/**
+	    \brief Give every cell a strategy chosen uniformly at random
+	    
+	    The choice depends only on \c seed.
+	*/
+	void Randomize();
+	
+	
+	/**
+	    \brief Run the spatial tournament
+	    
+	    Computes the payoff matrix (if it hasn't been yet), and then runs
+	    the given number of generations.  The tournament may be run again
+	    to continue from where it stopped.  The population fractions at
+	    every generation are accumulated in \c data.
+	    
+	    \param numGenerations Number of generations to run
+	    \returns True if the tournament ran successfully, false otherwise
+	*/
+	bool Run(int numGenerations);
+	
+	/**
+	    \brief Has the tournament been played?
+	    \returns True if the tournament has been played, false otherwise
+	*/
+	bool IsPlayed() const { return played; }
+	
+	/**
+	    \brief Reset all internal data
+	    
+	    Clears the tournament data (but not the lattice itself), and resets
+	    the generation counter.
+	*/
+	void Reset();
+	
+	/**
+	    \brief Get the number of cells holding each strategy
+	    \returns Count of cells, indexed as \c players
+	*/
+	std::vector<wxUint32> GetCounts() const;
+	
+	
+	/**
+	    \brief Start writing every generation to a binary frame file
+	    
+	    The file begins with the eight bytes \c OYUNLATT, then the width,
+	    height, and number of players (all 32-bit, native byte order).
+	    Each frame is the 32-bit generation number followed by the
+	    lattice, as \c width * \c height 16-bit strategy indices in
+	    row-major order.  If the tournament has already been played, the
+	    current lattice is written as the first frame; otherwise the
+	    starting lattice is written when the tournament is run.
+	    
+	    \param fileName The file to write
+	    \returns True if the file was opened, false otherwise
+	*/
+	bool OpenFrameDump(const wxString &fileName);
+	
+	/**
+	    \brief Stop writing to the binary frame file
+	*/
+	void CloseFrameDump();
+	
+	/**
+	    \brief Write every generation to a sequence of PPM images
+	    
+	    Images are named \p prefix followed by a five-digit generation
+	    number and <tt>.ppm</tt>.  Pass an empty string to stop.
+	    
+	    \param prefix Prefix for the image file names
+	*/
+	void SetImagePrefix(const wxString &prefix) { imagePrefix = prefix; }
+	
+	/**
+	    \brief Save the current lattice as a PPM image
+	    
+	    Each strategy gets a distinct color, and each cell one pixel.
+	    
+	    \param fileName The image file to write
+	    \returns True if the image was saved, false otherwise
+	*/
+	bool SaveImage(const wxString &fileName) const;
+	
+	
+	/**
+	    \brief List of all players in this tournament
+	*/
+	PlayerPtrArray players;
+	
+	/**
+	    \brief Neighborhood used for interactions and imitation
+	*/
+	Neighborhood neighborhood;
+	
+	/**
+	    \brief Rule used to update strategies
+	*/
+	UpdateRule updateRule;
+	
+	/**
+	    \brief Noise (\c K) for the Fermi rule, in units of match score
+	*/
+	double fermiTemperature;
+	
+	/**
+	    \brief Seed for all random choices
+	*/
+	wxUint64 seed;
+	
+	/**
+	    \brief The number of generations run so far
+	*/
+	int generation;
+	
+	/**
+	    \brief The fraction of cells holding each player, at every
+	           generation
+	    
+	    This is in the same form as \c EvoTournament::data, so that the
+	    results may be graphed in the same way.
+	*/
+	Trajectory data;
+
+private:
+	friend class LatticeTileTask;
+	friend class LatticeScoreTask;
+	friend class LatticeUpdateTask;
+	
+	/**
+	    \brief Run a single generation
+	    \returns True if successful, false otherwise
+	*/
+	bool Step();
+	
+	/**
+	    \brief Record population fractions, frames, and images for the
+	           current generation
+	    \returns True if successful, false otherwise
+	*/
+	bool Record();
+	
+	/**
+	    \brief Write the current lattice to the frame file
+	    \returns True if successful, false otherwise
+	*/
+	bool WriteFrame();
+	
+	
+	/**
+	    \brief Width of the lattice
+	*/
+	unsigned int width;
+	
+	/**
+	    \brief Height of the lattice
+	*/
+	unsigned int height;
+	
+	/**
+	    \brief The strategy index at each cell, in row-major order
+	*/
+	std::vector<wxUint16> grid;
+	
+	/**
+	    \brief The lattice being built for the next generation
+	*/
+	std::vector<wxUint16> nextGrid;
+	
+	/**
+	    \brief The total score of each cell in this generation
+	*/
+	std::vector<float> cellScores;
+	
+	/**
+	    \brief Scores of every pair of players
+	*/
+	PayoffMatrix payoffs;
+	
+	/**
+	    \brief True when the tournament has been played
+	*/
+	bool played;
+	
+	/**
+	    \brief The binary frame file, if open
+	*/
+	wxFile frameFile;
+	
+	/**
+	    \brief Prefix for the PPM image sequence, if any
+	*/
+	wxString imagePrefix;
+	
+	/**
+	    \brief Game to be played
+	*/
+	Game *game;
+};
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
@@ -27,18 +27,123 @@
 #  include <wx/wx.h>
 #endif
 
+#include <wx/filename.h>
+
+#include <math.h>
+
 #ifdef BUILD_TESTS
 #  include <TestHarness.h>
+#  include "../game/random.h"
 #endif
 
+#include "../common/bits.h"
+#include "../common/error.h"
+#include "../common/rng.h"
 #include "../game/game.h"
+#include "../game/player.h"
+#include "../game/prisoner.h"
 #include "match.h"
 
 
-bool Match::Play(Game *game, bool quick)
+MatchHistoryFile::MatchHistoryFile() : end(0)
+{ }
+
+MatchHistoryFile::~MatchHistoryFile()
+{
+	if (file.IsOpened())
+	{
+		file.Close();
+		wxRemoveFile(fileName);
+	}
+}
+
+bool MatchHistoryFile::Open()
+{
+	fileName = wxFileName::CreateTempFileName(wxT("oyun"));
+	if (fileName.IsEmpty() || !file.Open(fileName, wxFile::read_write))
+	{
+		Error::Set(_("Could not create a temporary file for the match histories"));
+		return false;
+	}
+	
+	end = 0;
+	return true;
+}
+
+bool MatchHistoryFile::Write(const char *data, size_t length, wxFileOffset &offset)
+{
+	wxCriticalSectionLocker locker(lock);
+	
+	offset = end;
+	if (file.Seek(end) != end || file.Write(data, length) != length)
+	{
+		Error::Set(_("Could not write the match histories to disk"));
+		return false;
+	}
+	
+	end += length;
+	return true;
+}
+
+bool MatchHistoryFile::Read(wxFileOffset offset, char *data, size_t length)
+{
+	wxCriticalSectionLocker locker(lock);
+	
+	if (file.Seek(offset) != offset || file.Read(data, length) != (ssize_t)length)
+	{
+		Error::Set(_("Could not read the match histories from disk"));
+		return false;
+	}
+	
+	return true;
+}
+
+
+Match::Match(Player *one, Player *two, wxUint64 newSeed) :
+	playerOne(one), playerTwo(two), playerOneScore(0), playerTwoScore(0),
+	seed(newSeed), historyPolicy(HISTORY_FULL), historyFile(NULL), historyOffset(0),
+	matchHistory(NULL), continuation(0.0), numMoves(0), numGames(0), quick(false)
+{ }
+
+Match::~Match()
+{
+	delete[] matchHistory;
+}
+
+void Match::SetHistoryPolicy(HistoryPolicy policy, MatchHistoryFile *file)
+{
+	historyPolicy = policy;
+	historyFile = file;
+	
+	if (historyPolicy == HISTORY_DISK && !historyFile)
+		historyPolicy = HISTORY_SUMMARY;
+}
+
+bool Match::Play(Game *game, bool newQuick)
 {
-	// Clear score buffers
+	// Clear score buffers and anything kept from the last time
 	playerOneScore = playerTwoScore = 0;
+	numGames = 0;
+	quick = newQuick;
+	summary.clear();
+	delete[] matchHistory;
+	matchHistory = NULL;
+	
+	numMoves = game->GetGameMoves().Length();
+	if (historyPolicy != HISTORY_NONE)
+		summary.resize(5 * SummarySize());
+	if (historyPolicy == HISTORY_FULL)
+		matchHistory = new wxArrayString[5];
+	
+	// Random players draw from this match's own substream, so that the
+	// match can be replayed
+	if (seed)
+		game->SetRandomStream(seed);
+	else
+		game->ClearRandomStream();
+	
+	// Moves to be written to the history file
+	std::vector<char> diskBuffer;
 	
 	// Run five games
 	int max = (quick ? 1 : 5);
@@ -46,7 +151,9 @@ bool Match::Play(Game *game, bool quick)
 	{
 		// These were pre-computed using Axelrod's game-end factor (0.00346)
 		int matchLengths[5] = {168, 359, 306, 622, 319};
-		if (quick) matchLengths[0] = 200;
+		if (quick) matchLengths[0] = quickGameLength;
+		if (continuation > 0.0)
+			matchLengths[i] = DrawGameLength(i);
 		
 		// Prepare the players and the game for a new match
 		game->Reset();
@@ -66,16 +173,183 @@ bool Match::Play(Game *game, bool quick)
 				return false;
 		}
 		
-		// Save off the history and clear the old one
-		matchHistory[i] = game->GetGameHistory();
 		// Save off the scores
 		playerOneScore += playerOne->GetScore();
 		playerTwoScore += playerTwo->GetScore();
+		numGames++;
+		
+		// Keep as much of the history as we've been asked to
+		if (historyPolicy != HISTORY_NONE)
+			Summarize(game, i);
+		if (matchHistory)
+			matchHistory[i] = game->GetGameHistory();
+		
+		if (historyPolicy == HISTORY_DISK)
+		{
+			// The moves of every game go into one block, written at the
+			// end of the match
+			const wxArrayString &history = game->GetGameHistory();
+			for (size_t j = 0 ; j < history.size() ; j++)
+			{
+				diskBuffer.push_back((char)history[j][0]);
+				diskBuffer.push_back((char)history[j][1]);
+			}
+		}
+	}
+	
+	if (historyPolicy == HISTORY_DISK)
+	{
+		// Error already set in MatchHistoryFile::Write()
+		if (!historyFile->Write(&diskBuffer[0], diskBuffer.size(), historyOffset))
+			return false;
 	}
 	
 	return true;
 }
 
+int Match::DrawGameLength(int index) const
+{
+	// Each game gets its own draw from the match's key, independent of
+	// any random players
+	double u = Random::HashToFloat(Random::Hash(~seed ^ Random::Hash(index)));
+	double length = 1.0 + floor(log(1.0 - u) / log(continuation));
+	
+	if (!(length < maxGameLength))
+		return maxGameLength;
+	return (int)length;
+}
+
+void Match::Summarize(const Game *game, int index)
+{
+	int *entry = &summary[index * SummarySize()];
+	const wxString &oneMoves = game->GetRoleMoves(0), &twoMoves = game->GetRoleMoves(1);
+	const wxArrayString &history = game->GetGameHistory();
+	
+	entry[0] = history.size();
+	entry[1] = playerOne->GetScore();
+	entry[2] = playerTwo->GetScore();
+	
+	if (numMoves == 2)
+	{
+		// Count from the packed history, where a set bit is the
+		// second move
+		const std::vector<wxUint64> &one = game->GetMoveBits(0);
+		const std::vector<wxUint64> &two = game->GetMoveBits(1);
+		int oneSecond = 0, twoSecond = 0, both = 0;
+		
+		for (size_t w = 0 ; w < one.size() ; w++)
+		{
+			oneSecond += Bits::PopCount(one[w]);
+			twoSecond += Bits::PopCount(two[w]);
+			both += Bits::PopCount(one[w] & two[w]);
+		}
+		
+		entry[3] = entry[0] - oneSecond - twoSecond + both;
+		entry[4] = twoSecond - both;
+		entry[5] = oneSecond - both;
+		entry[6] = both;
+		return;
+	}
+	
+	for (size_t j = 0 ; j < history.size() ; j++)
+	{
+		int one = oneMoves.Find(history[j][0]);
+		int two = twoMoves.Find(history[j][1]);
+		entry[3 + one * numMoves + two]++;
+	}
+}
+
+bool Match::Rescore(const PayoffTable &payoffs)
+{
+	if (summary.empty() || numMoves != 2)
+	{
+		Error::Set(_("Only matches of two-move games which kept a summary can be rescored"));
+		return false;
+	}
+	
+	playerOneScore = playerTwoScore = 0;
+	for (int i = 0 ; i < numGames ; i++)
+	{
+		int *entry = &summary[i * SummarySize()];
+		int cc = entry[3], cd = entry[4], dc = entry[5], dd = entry[6];
+		
+		entry[1] = cc * payoffs.reward + cd * payoffs.sucker + dc * payoffs.temptation + dd * payoffs.punishment;
+		entry[2] = cc * payoffs.reward + cd * payoffs.temptation + dc * payoffs.sucker + dd * payoffs.punishment;
+		
+		playerOneScore += entry[1];
+		playerTwoScore += entry[2];
+	}
+	
+	return true;
+}
+
+bool Match::GetHistory(const Game *game, wxArrayString *history) const
+{
+	for (int i = 0 ; i < 5 ; i++)
+		history[i].Clear();
+	
+	if (!numGames)
+		return true;
+	
+	if (matchHistory)
+	{
+		for (int i = 0 ; i < numGames ; i++)
+			history[i] = matchHistory[i];
+		return true;
+	}
+	
+	if (historyPolicy == HISTORY_DISK)
+	{
+		size_t length = 0;
+		for (int i = 0 ; i < numGames ; i++)
+			length += 2 * GetGameLength(i);
+		
+		// Error already set in MatchHistoryFile::Read()
+		std::vector<char> data(length);
+		if (length && !historyFile->Read(historyOffset, &data[0], length))
+			return false;
+		
+		size_t at = 0;
+		for (int i = 0 ; i < numGames ; i++)
+		{
+			int gameLength = GetGameLength(i);
+			history[i].Alloc(gameLength);
+			
+			for (int j = 0 ; j < gameLength ; j++, at += 2)
+			{
+				wxString turn;
+				turn.Append((wxChar)data[at]);
+				turn.Append((wxChar)data[at + 1]);
+				history[i].Add(turn);
+			}
+		}
+		
+		return true;
+	}
+	
+	// Replay the match on copies of everything, keeping the history
+	Game *replayGame = game->Clone();
+	Player *one = playerOne->Clone();
+	Player *two = (playerTwo == playerOne) ? one : playerTwo->Clone();
+	
+	Match replay(one, two, seed);
+	replay.SetContinuation(continuation);
+	bool ok = replay.Play(replayGame, quick);
+	
+	if (ok)
+	{
+		for (int i = 0 ; i < numGames ; i++)
+			history[i] = replay.matchHistory[i];
+	}
+	
+	if (two != one)
+		delete two;
+	delete one;
+	delete replayGame;
+	
+	return ok;
+}
+
 
 /** \cond TEST */
 #ifdef BUILD_TESTS
@@ -136,7 +410,11 @@ TEST(Match, History)
 	CHECK(match.Play(&game, true));
 	
 	// Get the history and make sure it's stored properly
-	wxArrayString &hist = match.matchHistory[0];
+	wxArrayString histories[5];
+	CHECK(match.GetHistory(&game, histories));
+	CHECK_EQUAL(1, match.GetNumGames());
+	
+	wxArrayString &hist = histories[0];
 
 	CHECK_EQUAL(200, (int)hist.size());
 	for (int i = 0 ; i < 200 ; i++)
@@ -146,6 +424,112 @@ TEST(Match, History)
 	}
 }
 
+TEST(Match, Summary)
+{
+	MockPlayer p1, p2;
+	MockGame game;
+	Match match(&p1, &p2);
+	match.SetHistoryPolicy(Match::HISTORY_SUMMARY);
+
+	p1.nextMove = 'C';
+	p2.nextMove = 'D';
+
+	CHECK(match.Play(&game));
+	CHECK(match.HasSummary());
+	CHECK_EQUAL(5, match.GetNumGames());
+	
+	int total = 0;
+	for (int i = 0 ; i < 5 ; i++)
+	{
+		CHECK_EQUAL(match.GetGameLength(i), match.GetOutcomeCount(i, 0, 1));
+		CHECK_EQUAL(0, match.GetOutcomeCount(i, 0, 0));
+		CHECK_EQUAL(0, match.GetGameScore(i, 1));
+		total += match.GetGameScore(i, 0);
+	}
+	CHECK_EQUAL(match.playerOneScore, total);
+	
+	// The moves weren't kept, so they're replayed
+	wxArrayString histories[5];
+	CHECK(match.GetHistory(&game, histories));
+	CHECK_EQUAL(match.GetGameLength(3), (int)histories[3].size());
+	CHECK_EQUAL(wxT('D'), histories[3][0][1]);
+}
+
+TEST(Match, ReplayRandom)
+{
+	// A random player's moves come back exactly, whether they were
+	// stored, written to disk, or replayed
+	RandomPlayer p1, p2;
+	MockGame game;
+	MatchHistoryFile file;
+	CHECK(file.Open());
+	
+	Match full(&p1, &p2, 1234), none(&p1, &p2, 1234), disk(&p1, &p2, 1234);
+	none.SetHistoryPolicy(Match::HISTORY_NONE);
+	disk.SetHistoryPolicy(Match::HISTORY_DISK, &file);
+	
+	CHECK(full.Play(&game));
+	CHECK(none.Play(&game));
+	CHECK(disk.Play(&game));
+	CHECK(!none.HasSummary());
+	
+	wxArrayString fullHistory[5], noneHistory[5], diskHistory[5];
+	CHECK(full.GetHistory(&game, fullHistory));
+	CHECK(none.GetHistory(&game, noneHistory));
+	CHECK(disk.GetHistory(&game, diskHistory));
+	
+	int differences = 0, changes = 0;
+	for (int i = 0 ; i < 5 ; i++)
+	{
+		CHECK_EQUAL((int)fullHistory[i].size(), (int)noneHistory[i].size());
+		CHECK_EQUAL((int)fullHistory[i].size(), (int)diskHistory[i].size());
+		
+		for (size_t j = 0 ; j < fullHistory[i].size() ; j++)
+		{
+			if (fullHistory[i][j] != noneHistory[i][j] ||
+			    fullHistory[i][j] != diskHistory[i][j])
+				differences++;
+			if (j && fullHistory[i][j] != fullHistory[i][j - 1])
+				changes++;
+		}
+	}
+	
+	CHECK_EQUAL(0, differences);
+	CHECK(changes > 0);
+}
+
+TEST(Match, OutcomeCounts)
+{
+	// The counts taken from the packed history agree with the moves
+	RandomPlayer p1, p2;
+	MockGame game;
+	Match match(&p1, &p2, 99);
+	
+	CHECK(match.Play(&game));
+	CHECK(match.HasSummary());
+	
+	wxArrayString history[5];
+	CHECK(match.GetHistory(&game, history));
+	
+	for (int i = 0 ; i < 5 ; i++)
+	{
+		int counts[4] = { 0, 0, 0, 0 };
+		for (size_t j = 0 ; j < history[i].size() ; j++)
+			counts[(history[i][j][0] == wxT('D')) * 2 + (history[i][j][1] == wxT('D'))]++;
+		
+		for (int m = 0 ; m < 4 ; m++)
+			CHECK_EQUAL(counts[m], match.GetOutcomeCount(i, m / 2, m % 2));
+	}
+	
+	// The mock game pays player one a point a turn; paying both players
+	// a point a turn gives player two the same score
+	int score = match.playerOneScore;
+	CHECK_EQUAL(0, match.playerTwoScore);
+	CHECK(match.Rescore(PayoffTable(1, 1, 1, 1)));
+	CHECK_EQUAL(score, match.playerOneScore);
+	CHECK_EQUAL(score, match.playerTwoScore);
+}
+
 #endif
 /** \endcond */
 
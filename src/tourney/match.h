@@ -21,8 +21,76 @@
 #ifndef TOURNEY_MATCH_H__
 #define TOURNEY_MATCH_H__
 
+#include <vector>
+#include <wx/file.h>
+#include <wx/thread.h>
+
 class Game;
 class Player;
+struct PayoffTable;
+
+
+/**
+    \class MatchHistoryFile
+    \ingroup tourney
+    
+    \brief A temporary file holding the move histories of many matches
+    
+    Matches using \c Match::HISTORY_DISK write their moves here rather
+    than keeping them in memory.  Matches may be written from several
+    threads at once.  The file is deleted when this object is destroyed.
+*/
+class MatchHistoryFile
+{
+public:
+	/**
+	    \brief Constructor
+	*/
+	MatchHistoryFile();
+	
+	/**
+	    \brief Destructor
+	    
+	    Closes and deletes the file.
+	*/
+	~MatchHistoryFile();
+	
+	/**
+	    \brief Create the temporary file
+	    \returns True if the file was created, false otherwise
+	*/
+	bool Open();
+	
+	/**
+	    \brief Append a block of data to the file
+	    
+	    \param data The data to be written
+	    \param length The number of bytes to be written
+	    \param[out] offset Where the data was written
+	    \returns True if the data was written, false otherwise
+	*/
+	bool Write(const char *data, size_t length, wxFileOffset &offset);
+	
+	/**
+	    \brief Read back a block of data written by Write()
+	    
+	    \param offset The offset returned by Write()
+	    \param[out] data Buffer for the data
+	    \param length The number of bytes to be read
+	    \returns True if the data was read, false otherwise
+	*/
+	bool Read(wxFileOffset offset, char *data, size_t length);
+
+private:
+	// Files can't be copied
+	MatchHistoryFile(const MatchHistoryFile &);
+	MatchHistoryFile &operator=(const MatchHistoryFile &);
+	
+	wxFile file;			/**< \brief The temporary file */
+	wxString fileName;		/**< \brief Name of the temporary file */
+	wxFileOffset end;		/**< \brief Size of the data written so far */
+	wxCriticalSection lock;		/**< \brief Lock protecting the file */
+};
 
 
 /**
@@ -33,21 +101,48 @@ class Player;
     
     This class will run a match, a series of five games.  The scores are
     accumulated, and the results can be queried for later display.
+    
+    The moves of every game are only needed when a user looks at a
+    particular match, and storing them for every match in a large
+    tournament takes a great deal of memory.  How much of each match is
+    kept is set by the history policy (see \c HistoryPolicy).  Whatever
+    the policy, GetHistory() returns the full list of moves, replaying
+    the match if they weren't kept.  Players which make random choices
+    draw them from a substream of the game's generator keyed by the
+    match's \c seed (see \c Game::SetRandomStream), so the replay gives
+    exactly the same moves.
 */
 class Match
 {
 public:
+	/**
+	    \brief How much of each match's history is kept
+	*/
+	enum HistoryPolicy
+	{
+		/** \brief Keep only the match scores */
+		HISTORY_NONE,
+		/** \brief Keep the length, scores, and outcome counts of each game */
+		HISTORY_SUMMARY,
+		/** \brief Keep every move in memory */
+		HISTORY_FULL,
+		/** \brief Keep the summary, and write every move to a \c MatchHistoryFile */
+		HISTORY_DISK
+	};
+	
 	/**
 	    \brief Constructor
 	    
-	    Sets the \c playerOne and \c playerTwo values.
+	    Sets the \c playerOne, \c playerTwo, and \c seed values.  New
+	    matches keep their full history.
 	    
 	    \param one Initial value of the \c playerOne member
 	    \param two Initial value of the \c playerTwo member
+	    \param newSeed Initial value of the \c seed member
 	*/
-	Match(Player *one, Player *two) : playerOne(one), playerTwo(two),
-	                                  playerOneScore(0), playerTwoScore(0)
-	{ }
+	Match(Player *one, Player *two, wxUint64 newSeed = 0);
+	
+	~Match();
 
 	/**
 	    \brief Play a match between two players
@@ -57,7 +152,8 @@ public:
 	    games in the match is predetermined according to previously run trials 
 	    using Axelrod's random exit coefficient (0.00346).  The match lengths are 
 	    predetermined in order to make the score values for each match
-	    deterministic.
+	    deterministic.  Other continuation probabilities may be set with
+	    SetContinuation().
 	    
 	    The \p quick parameter allows for a one-game match to be played, which
 	    is useful in environments where match speed is critical (like the
@@ -69,6 +165,115 @@ public:
 	    \returns True if the match is successfully played, false otherwise
 	*/
 	bool Play(Game *game, bool quick = false);
+	
+	/**
+	    \brief Set how much of the history of this match is kept
+	    
+	    This should be called before Play().
+	    
+	    \param policy The history policy
+	    \param file File to which the moves are written, required
+	                 for (and only used by) \c HISTORY_DISK
+	*/
+	void SetHistoryPolicy(HistoryPolicy policy, MatchHistoryFile *file = NULL);
+	
+	/**
+	    \brief Get the history policy of this match
+	    \returns The history policy
+	*/
+	HistoryPolicy GetHistoryPolicy() const {return historyPolicy;}
+	
+	/**
+	    \brief Set the chance that each game goes on for another turn
+	    
+	    With a nonzero \p probability, the length of each game of the
+	    match is drawn from the geometric distribution with mean
+	    <tt>1 / (1 - probability)</tt>, keyed by \c seed, so that
+	    replaying the match gives the same lengths.  With zero, the
+	    standard lengths are used.  This should be called before Play().
+	    
+	    \param probability Continuation probability, in [0, 1)
+	*/
+	void SetContinuation(double probability) {continuation = probability;}
+	
+	/**
+	    \brief Longest game played with a continuation probability set
+	*/
+	static const int maxGameLength = 100000;
+	
+	/**
+	    \brief Length of the single game of a quick match
+	*/
+	static const int quickGameLength = 200;
+	
+	/**
+	    \brief Get the number of games played in this match
+	    \returns Number of games played (zero if the match hasn't been
+	             played, one for a quick match, five otherwise)
+	*/
+	int GetNumGames() const {return numGames;}
+	
+	/**
+	    \brief Get the moves of every game of this match
+	    
+	    The moves are taken from memory or from the history file if they
+	    were kept, and otherwise the match is replayed, on copies of the
+	    players and the game.  Each game's history has the same format
+	    as \c Game::GetGameHistory.
+	    
+	    \param game The game the match was played with
+	    \param[out] history The history of each game (an array of five)
+	    \returns True if the history was found, false otherwise
+	*/
+	bool GetHistory(const Game *game, wxArrayString *history) const;
+	
+	/**
+	    \brief Does this match keep a summary of each game?
+	    \returns True if the summary functions below may be called
+	*/
+	bool HasSummary() const {return !summary.empty();}
+	
+	/**
+	    \brief Get the number of turns in one game of the match
+	    \param game Index of the game
+	    \returns Number of turns
+	*/
+	int GetGameLength(int game) const
+	{ return summary[game * SummarySize()]; }
+	
+	/**
+	    \brief Get a player's score in one game of the match
+	    \param game Index of the game
+	    \param player Zero for player one, one for player two
+	    \returns The player's score
+	*/
+	int GetGameScore(int game, int player) const
+	{ return summary[game * SummarySize() + 1 + player]; }
+	
+	/**
+	    \brief Get the number of turns in one game on which the players
+	           made a given pair of moves
+	    \param game Index of the game
+	    \param moveOne Index of player one's move in the game's moves
+	    \param moveTwo Index of player two's move in the game's moves
+	    \returns Number of turns
+	*/
+	int GetOutcomeCount(int game, int moveOne, int moveTwo) const
+	{ return summary[game * SummarySize() + 3 + moveOne * numMoves + moveTwo]; }
+	
+	/**
+	    \brief Recompute the scores for different payoffs
+	    
+	    The players' moves don't depend on the payoffs, so the scores
+	    (\c playerOneScore, \c playerTwoScore and every game's score)
+	    can be worked out from the outcome counts, without playing the
+	    match again.  The match must have kept a summary, and been
+	    played with a two-move game.
+	    
+	    \param payoffs The new payoffs
+	    \returns True if the match was rescored, false otherwise
+	*/
+	bool Rescore(const PayoffTable &payoffs);
 
 	/**
 	    \brief The first game player
@@ -90,11 +295,85 @@ public:
 	*/
 	int playerTwoScore;
 	
+	/**
+	    \brief Key of the random substream used by this match
+	    
+	    If zero, random players draw from the shared generator instead,
+	    and their moves can't be replayed exactly.
+	*/
+	wxUint64 seed;
+
+private:
+	// Matches can't be copied
+	Match(const Match &);
+	Match &operator=(const Match &);
+	
+	/**
+	    \brief Number of entries per game in \c summary
+	    \returns Summary size
+	*/
+	size_t SummarySize() const {return 3 + numMoves * numMoves;}
+	
+	/**
+	    \brief Draw the length of one game from \c continuation
+	    \param index Index of the game in the match
+	    \returns Number of turns
+	*/
+	int DrawGameLength(int index) const;
+	
+	/**
+	    \brief Record the game just played in the summary
+	    \param game The game
+	    \param index Index of the game in the match
+	*/
+	void Summarize(const Game *game, int index);
+	
+	/**
+	    \brief How much of the history is kept
+	*/
+	HistoryPolicy historyPolicy;
+	
+	/**
+	    \brief File to which moves are written for \c HISTORY_DISK
+	*/
+	MatchHistoryFile *historyFile;
+	
+	/**
+	    \brief Where this match's moves start in \c historyFile
+	*/
+	wxFileOffset historyOffset;
+	
+	/**
+	    \brief Every move of the match, for \c HISTORY_FULL (an array
+	           of five), or \c NULL
+	*/
+	wxArrayString *matchHistory;
+	
+	/**
+	    \brief For each game, its length, the two scores, and the
+	           count of each pair of moves
+	*/
+	std::vector<int> summary;
+	
+	/**
+	    \brief Continuation probability, or zero for the standard lengths
+	*/
+	double continuation;
+	
+	/**
+	    \brief Number of moves in the game played
+	*/
+	size_t numMoves;
+	
+	/**
+	    \brief Number of games played
+	*/
+	int numGames;
 	
 	/**
-	    \brief The entire list of moves for this match
+	    \brief True if this was a quick match
 	*/
-	wxArrayString matchHistory[5];
+	bool quick;
 };
 
 
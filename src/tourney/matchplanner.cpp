@@ -0,0 +1,244 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#ifdef BUILD_TESTS
+#  include <TestHarness.h>
+#endif
+
+#include "../game/fsaplayer.h"
+#include "matchplanner.h"
+
+
+size_t MatchPlanner::GetFootprint(const Player *player)
+{
+	const FSAPlayer *machine = dynamic_cast<const FSAPlayer *>(player);
+	if (!machine)
+		return playerOverhead;
+	
+	return playerOverhead + machine->GetNumLines() * sizeof(FSAState);
+}
+
+void MatchPlanner::Plan(const PlayerPtrArray &players)
+{
+	size_t numPlayers = players.GetCount();
+	jobs.clear();
+	blockStarts.clear();
+	
+	// Split the players into runs which fill half of the cache each,
+	// so that two of them fit at once, and which are small enough to
+	// make at least minGroups of them
+	std::vector<size_t> groupStarts;
+	size_t maxPlayers = (numPlayers + minGroups - 1) / minGroups;
+	size_t used = 0;
+	
+	for (size_t i = 0 ; i < numPlayers ; i++)
+	{
+		size_t footprint = GetFootprint(players[i]);
+		
+		if (groupStarts.empty() || (cacheSize && used + footprint > cacheSize / 2) ||
+		    i - groupStarts.back() >= maxPlayers)
+		{
+			groupStarts.push_back(i);
+			used = 0;
+		}
+		used += footprint;
+	}
+	
+	numGroups = groupStarts.size();
+	groupStarts.push_back(numPlayers);
+	jobs.reserve(numPlayers * (numPlayers + 1) / 2);
+	
+	// Every other row of groups is swept backward, from the group the
+	// row before ended on.  A backward row plays its diagonal block
+	// second, so that it ends on a block with group a + 1, which the
+	// next row starts with; the last two rows are joined through the
+	// last group instead.  Each block then shares a group with the one
+	// before it.
+	std::vector<std::pair<size_t, size_t> > order;
+	for (size_t a = 0 ; a < numGroups ; a++)
+	{
+		size_t last = numGroups - 1;
+		
+		if (a % 2 == 0 || a == last)
+		{
+			for (size_t b = a ; b <= last ; b++)
+				order.push_back(std::make_pair(a, b));
+		}
+		else if (a + 1 == last)
+		{
+			order.push_back(std::make_pair(last, last));
+			order.push_back(std::make_pair(a, last));
+			order.push_back(std::make_pair(a, a));
+			break;
+		}
+		else
+		{
+			order.push_back(std::make_pair(a, last));
+			order.push_back(std::make_pair(a, a));
+			for (size_t b = last - 1 ; b > a ; b--)
+				order.push_back(std::make_pair(a, b));
+		}
+	}
+	
+	for (size_t k = 0 ; k < order.size() ; k++)
+	{
+		size_t a = order[k].first, b = order[k].second;
+		blockStarts.push_back(jobs.size());
+		
+		for (size_t i = groupStarts[a] ; i < groupStarts[a + 1] ; i++)
+		{
+			for (size_t j = (a == b) ? i : groupStarts[b] ; j < groupStarts[b + 1] ; j++)
+			{
+				MatchJob job = { (wxUint32)i, (wxUint32)j };
+				jobs.push_back(job);
+			}
+		}
+	}
+	
+	blockStarts.push_back(jobs.size());
+}
+
+
+/** \cond TEST */
+#ifdef BUILD_TESTS
+
+#include "../game/prisoner.h"
+#include <set>
+
+TEST(MatchPlanner, Blocks)
+{
+	PrisonerDilemma game;
+	PlayerPtrArray players;
+	
+	// Ten machines of 100 states, and a cache holding four of them
+	wxString script(wxT("Charles Pence\nBig\n100\n"));
+	for (int s = 0 ; s < 100 ; s++)
+		script += wxString::Format(wxT("C, %d, %d\n"), (s + 1) % 100, 0);
+	
+	for (int i = 0 ; i < 10 ; i++)
+	{
+		FSAPlayer *player = new FSAPlayer;
+		CHECK(player->LoadFromString(&game, script));
+		players.Add(player);
+	}
+	
+	size_t footprint = MatchPlanner::GetFootprint(players[0]);
+	CHECK_EQUAL(MatchPlanner::playerOverhead + 100 * sizeof(FSAState), footprint);
+	
+	MatchPlanner planner;
+	planner.SetCacheSize(4 * footprint);
+	planner.Plan(players);
+	
+	// Groups of two players, and fifteen blocks, each touching only
+	// two groups
+	CHECK_EQUAL(5, (int)planner.GetNumGroups());
+	CHECK_EQUAL(15, (int)planner.GetNumBlocks());
+	CHECK_EQUAL(55, (int)planner.GetNumJobs());
+	CHECK_EQUAL(0, (int)planner.GetBlockBegin(0));
+	CHECK_EQUAL(55, (int)planner.GetBlockEnd(14));
+	
+	std::set<std::pair<int, int> > seen;
+	for (size_t b = 0 ; b < planner.GetNumBlocks() ; b++)
+	{
+		std::set<int> groups;
+		for (size_t k = planner.GetBlockBegin(b) ; k < planner.GetBlockEnd(b) ; k++)
+		{
+			const MatchJob &job = planner.GetJob(k);
+			CHECK(job.one <= job.two);
+			groups.insert(job.one / 2);
+			groups.insert(job.two / 2);
+			seen.insert(std::make_pair((int)job.one, (int)job.two));
+		}
+		CHECK(groups.size() <= 2);
+	}
+	
+	// Every pair is played exactly once
+	CHECK_EQUAL(55, (int)seen.size());
+	
+	// The second row of groups starts where the first left off
+	CHECK_EQUAL(8, (int)planner.GetJob(planner.GetBlockBegin(5)).two);
+	
+	// However many groups there are, every block shares a group with
+	// the one before it
+	for (size_t numGroups = 1 ; numGroups <= 10 ; numGroups++)
+	{
+		planner.SetCacheSize(0);
+		planner.SetMinGroups(numGroups);
+		planner.Plan(players);
+		CHECK_EQUAL(55, (int)planner.GetNumJobs());
+		
+		size_t groupSize = (10 + numGroups - 1) / numGroups;
+		std::set<size_t> last;
+		bool shared = true;
+		for (size_t b = 0 ; b < planner.GetNumBlocks() ; b++)
+		{
+			std::set<size_t> groups;
+			for (size_t k = planner.GetBlockBegin(b) ; k < planner.GetBlockEnd(b) ; k++)
+			{
+				groups.insert(planner.GetJob(k).one / groupSize);
+				groups.insert(planner.GetJob(k).two / groupSize);
+			}
+			
+			bool any = (b == 0);
+			for (std::set<size_t>::const_iterator g = groups.begin() ; g != groups.end() ; g++)
+				any = any || last.count(*g);
+			shared = shared && any;
+			last.swap(groups);
+		}
+		CHECK(shared);
+	}
+	planner.SetCacheSize(4 * footprint);
+	
+	// Groups can be made smaller than the cache needs
+	planner.SetMinGroups(10);
+	planner.Plan(players);
+	CHECK_EQUAL(10, (int)planner.GetNumGroups());
+	CHECK_EQUAL(55, (int)planner.GetNumBlocks());
+	
+	// Without a cache, the matches are row by row
+	planner.SetMinGroups(1);
+	planner.SetCacheSize(0);
+	planner.Plan(players);
+	CHECK_EQUAL(1, (int)planner.GetNumGroups());
+	size_t k = 0;
+	for (int i = 0 ; i < 10 ; i++)
+	{
+		for (int j = i ; j < 10 ; j++, k++)
+		{
+			CHECK_EQUAL(i, (int)planner.GetJob(k).one);
+			CHECK_EQUAL(j, (int)planner.GetJob(k).two);
+		}
+	}
+	
+	for (size_t i = 0 ; i < players.GetCount() ; i++)
+		delete players[i];
+}
+
+#endif
+/** \endcond */
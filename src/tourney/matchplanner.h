@@ -0,0 +1,215 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TOURNEY_MATCHPLANNER_H__
+#define TOURNEY_MATCHPLANNER_H__
+
+#include <vector>
+
+#include "../game/player.h"
+
+
+/**
+    \class MatchJob
+    \ingroup tourney
+    
+    \brief One match of a round-robin, by the indices of its players
+*/
+struct MatchJob
+{
+	/**
+	    \brief Index of the first player (never more than \c two)
+	*/
+	wxUint32 one;
+	
+	/**
+	    \brief Index of the second player
+	*/
+	wxUint32 two;
+};
+
+/**
+    \class MatchPlanner
+    \ingroup tourney
+    
+    \brief Orders the matches of a round-robin so the players' state
+           tables stay in the cache
+    
+    Playing the matches row by row (player \c i against every
+    <tt>j >= i</tt>) reads every other player's state table once per
+    row, so with large machines each match starts from a cold cache.
+    The planner instead splits the players into groups whose tables
+    (see GetFootprint()) fit in half of the cache, and lists the matches
+    a pair of groups at a time.  Each such block of matches only touches
+    two groups, which stay resident while it is played, and the rows
+    of blocks are swept back and forth, in such a way that every
+    block shares a group with the one before it, which is still
+    resident when it starts.
+    
+    If every player fits in one group, the matches come out in the
+    same order as row by row.  Parallel code should hand out whole
+    blocks (see GetBlockBegin()) to each thread.
+*/
+class MatchPlanner
+{
+public:
+	/**
+	    \brief Constructor
+	    
+	    Creates an empty plan, for a cache of \c defaultCacheSize bytes.
+	*/
+	MatchPlanner() : cacheSize(defaultCacheSize), minGroups(1), numGroups(0) { }
+	
+	/**
+	    \brief Cache size assumed unless told otherwise, in bytes
+	    
+	    This is the size of a typical per-core L2 cache.
+	*/
+	static const size_t defaultCacheSize = 256 * 1024;
+	
+	/**
+	    \brief Bytes assumed for each player besides its state table
+	    
+	    This covers the player object itself, and its part of the match
+	    being played.
+	*/
+	static const size_t playerOverhead = 256;
+	
+	/**
+	    \brief Set the size of the cache to be planned for
+	    
+	    This takes effect the next time Plan() is called.
+	    
+	    \param newCacheSize Cache size in bytes, or zero to play the
+	                        matches row by row
+	*/
+	void SetCacheSize(size_t newCacheSize) { cacheSize = newCacheSize; }
+	
+	/**
+	    \brief Get the size of the cache to be planned for
+	    \returns Cache size in bytes
+	*/
+	size_t GetCacheSize() const { return cacheSize; }
+	
+	/**
+	    \brief Set the smallest number of groups to split the players into
+	    
+	    Smaller groups fit in the cache just as well, and give parallel
+	    code more blocks to share out.  This takes effect the next time
+	    Plan() is called.
+	    
+	    \param newMinGroups Smallest number of groups (there are never
+	                        more groups than players)
+	*/
+	void SetMinGroups(size_t newMinGroups) { minGroups = newMinGroups ? newMinGroups : 1; }
+	
+	/**
+	    \brief Get the number of bytes a player reads while it plays
+	    
+	    This is the size of a finite state machine's state table, plus
+	    \c playerOverhead.
+	    
+	    \param player The player
+	    \returns Bytes used by the player
+	*/
+	static size_t GetFootprint(const Player *player);
+	
+	/**
+	    \brief Plan the matches of a round-robin between players
+	    
+	    Every player plays every other, and itself, once.
+	    
+	    \param players The players (who are only looked at)
+	*/
+	void Plan(const PlayerPtrArray &players);
+	
+	/**
+	    \brief Get the number of matches in the plan
+	    \returns Number of matches
+	*/
+	size_t GetNumJobs() const { return jobs.size(); }
+	
+	/**
+	    \brief Get a match of the plan, in the order they should be played
+	    \param idx Index of the match, less than GetNumJobs()
+	    \returns The match
+	*/
+	const MatchJob &GetJob(size_t idx) const { return jobs[idx]; }
+	
+	/**
+	    \brief Get the number of groups the players were split into
+	    \returns Number of groups
+	*/
+	size_t GetNumGroups() const { return numGroups; }
+	
+	/**
+	    \brief Get the number of blocks of matches
+	    \returns Number of blocks
+	*/
+	size_t GetNumBlocks() const { return blockStarts.empty() ? 0 : blockStarts.size() - 1; }
+	
+	/**
+	    \brief Get the index of the first match of a block
+	    \param block Index of the block, less than GetNumBlocks()
+	    \returns Index of the block's first match
+	*/
+	size_t GetBlockBegin(size_t block) const { return blockStarts[block]; }
+	
+	/**
+	    \brief Get the index after the last match of a block
+	    \param block Index of the block, less than GetNumBlocks()
+	    \returns Index of the block's last match, plus one
+	*/
+	size_t GetBlockEnd(size_t block) const { return blockStarts[block + 1]; }
+	
+private:
+	/**
+	    \brief Size of the cache to be planned for, in bytes
+	*/
+	size_t cacheSize;
+	
+	/**
+	    \brief Smallest number of groups to split the players into
+	*/
+	size_t minGroups;
+	
+	/**
+	    \brief Number of groups of players
+	*/
+	size_t numGroups;
+	
+	/**
+	    \brief The matches, in the order they should be played
+	*/
+	std::vector<MatchJob> jobs;
+	
+	/**
+	    \brief Index of the first match of each block, followed by the
+	           number of matches
+	*/
+	std::vector<size_t> blockStarts;
+};
+
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,526 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#include <algorithm>
+#include <map>
+#include <math.h>
+#include <string.h>
+
+#ifdef BUILD_TESTS
+#  include <TestHarness.h>
+#  include "../game/prisoner.h"
+#endif
+
+#include "../common/error.h"
+#include "../common/kernels.h"
+#include "../common/outputfile.h"
+#include "../common/rng.h"
+#include "../game/fsaplayer.h"
+#include "mutation.h"
+
+
+// How far a row of a dense matrix may be from summing to one
+static const double rowTolerance = 1e-9;
+
+// The header of a saved matrix, followed by the diagonal, rowStart,
+// columns and values arrays
+struct MutationHeader
+{
+	wxUint32 type;
+	wxUint32 reserved;
+	wxUint64 size;
+	wxUint64 numDiagonal;
+	wxUint64 numRowStart;
+	wxUint64 numColumns;
+	wxUint64 numValues;
+	double rate;
+};
+
+template <typename T>
+static void WriteArray(OutputFile &out, const std::vector<T> &array)
+{
+	if (array.size())
+		out.Write((const char *)&array[0], array.size() * sizeof(T));
+}
+
+template <typename T>
+static bool ReadArray(const wxUint8 *&data, const wxUint8 *end, std::vector<T> &array, wxUint64 count)
+{
+	if (count > (wxUint64)(end - data) / sizeof(T))
+		return false;
+	
+	array.resize(count);
+	if (count)
+		memcpy(&array[0], data, count * sizeof(T));
+	data += count * sizeof(T);
+	
+	return true;
+}
+
+static bool EntryLess(const MutationEntry &a, const MutationEntry &b)
+{
+	return a.from < b.from || (a.from == b.from && a.to < b.to);
+}
+
+
+void MutationMatrix::Clear()
+{
+	type = NONE;
+	size = 0;
+	rate = 0.0;
+	diagonal.clear();
+	rowStart.clear();
+	columns.clear();
+	values.clear();
+}
+
+bool MutationMatrix::CheckRate(double newRate)
+{
+	if (newRate < 0.0 || newRate > 1.0)
+	{
+		Error::Set(wxString::Format(_("The mutation rate must be between zero and one (not %g)"), newRate));
+		return false;
+	}
+	
+	return true;
+}
+
+bool MutationMatrix::SetUniform(size_t newSize, double newRate)
+{
+	if (!CheckRate(newRate))
+		return false;
+	
+	Clear();
+	type = UNIFORM;
+	size = newSize;
+	rate = newRate;
+	
+	return true;
+}
+
+bool MutationMatrix::SetNeighbors(const PlayerPtrArray &players, double newRate)
+{
+	if (!CheckRate(newRate))
+		return false;
+	
+	// Two neighbors have the same table apart from one field.  So hash
+	// each machine's table once with each of its fields blanked out in
+	// turn, and neighbors will share (at least) one of those hashes.
+	typedef std::map<wxUint64, std::vector<size_t> > BucketMap;
+	BucketMap buckets;
+	std::vector<const FSAPlayer *> machines(players.GetCount(), (const FSAPlayer *)NULL);
+	
+	for (size_t p = 0 ; p < players.GetCount() ; p++)
+	{
+		const FSAPlayer *machine = dynamic_cast<const FSAPlayer *>(players[p]);
+		if (!machine)
+			continue;
+		machines[p] = machine;
+		
+		const wxUint32 *words = (const wxUint32 *)machine->GetStates();
+		size_t numWords = machine->GetNumLines() * 3;
+		
+		for (size_t blank = 0 ; blank < numWords ; blank++)
+		{
+			wxUint64 hash = Random::Hash(((wxUint64)numWords << 32) | blank);
+			for (size_t w = 0 ; w < numWords ; w++)
+				if (w != blank)
+					hash = Random::Hash(hash ^ words[w]);
+			
+			buckets[hash].push_back(p);
+		}
+	}
+	
+	// Check every pair sharing a hash, since the hashes may collide,
+	// and identical machines share all of them
+	std::vector<std::vector<size_t> > neighbors(players.GetCount());
+	for (BucketMap::const_iterator it = buckets.begin() ; it != buckets.end() ; ++it)
+	{
+		const std::vector<size_t> &bucket = it->second;
+		
+		for (size_t a = 0 ; a < bucket.size() ; a++)
+		{
+			for (size_t b = a + 1 ; b < bucket.size() ; b++)
+			{
+				const FSAPlayer *first = machines[bucket[a]], *second = machines[bucket[b]];
+				if (first->GetNumLines() != second->GetNumLines())
+					continue;
+				
+				const wxUint32 *x = (const wxUint32 *)first->GetStates();
+				const wxUint32 *y = (const wxUint32 *)second->GetStates();
+				size_t numWords = first->GetNumLines() * 3, differences = 0;
+				for (size_t w = 0 ; w < numWords && differences < 2 ; w++)
+					if (x[w] != y[w])
+						differences++;
+				
+				// Differing in exactly one field means this is the only
+				// bucket the pair shares
+				if (differences == 1)
+				{
+					neighbors[bucket[a]].push_back(bucket[b]);
+					neighbors[bucket[b]].push_back(bucket[a]);
+				}
+			}
+		}
+	}
+	
+	std::vector<MutationEntry> entries;
+	for (size_t p = 0 ; p < neighbors.size() ; p++)
+		for (size_t n = 0 ; n < neighbors[p].size() ; n++)
+			entries.push_back(MutationEntry(p, neighbors[p][n], newRate / (double)neighbors[p].size()));
+	
+	BuildSparse(players.GetCount(), entries);
+	return true;
+}
+
+bool MutationMatrix::SetSparse(size_t newSize, const std::vector<MutationEntry> &entries)
+{
+	std::vector<double> sums(newSize, 0.0);
+	
+	for (size_t e = 0 ; e < entries.size() ; e++)
+	{
+		const MutationEntry &entry = entries[e];
+		if (entry.from >= newSize || entry.to >= newSize || entry.from == entry.to ||
+		    !(entry.probability >= 0.0))
+		{
+			Error::Set(wxString::Format(_("Invalid mutation from strategy %d to strategy %d"),
+			                            (int)entry.from, (int)entry.to));
+			return false;
+		}
+		
+		sums[entry.from] += entry.probability;
+	}
+	
+	for (size_t i = 0 ; i < newSize ; i++)
+	{
+		if (sums[i] > 1.0 + rowTolerance)
+		{
+			Error::Set(wxString::Format(_("The mutations from strategy %d add up to more than one"), (int)i));
+			return false;
+		}
+	}
+	
+	BuildSparse(newSize, entries);
+	return true;
+}
+
+void MutationMatrix::BuildSparse(size_t newSize, const std::vector<MutationEntry> &entries)
+{
+	Clear();
+	type = SPARSE;
+	size = newSize;
+	diagonal.assign(size, 1.0);
+	rowStart.assign(size + 1, 0);
+	
+	// Sort the entries into rows, merging any repeats
+	std::vector<MutationEntry> sorted(entries);
+	std::sort(sorted.begin(), sorted.end(), EntryLess);
+	
+	for (size_t e = 0 ; e < sorted.size() ; e++)
+	{
+		const MutationEntry &entry = sorted[e];
+		diagonal[entry.from] -= entry.probability;
+		
+		if (e && sorted[e - 1].from == entry.from && sorted[e - 1].to == entry.to)
+			values.back() += entry.probability;
+		else
+		{
+			columns.push_back(entry.to);
+			values.push_back(entry.probability);
+			rowStart[entry.from + 1]++;
+		}
+	}
+	
+	for (size_t i = 0 ; i < size ; i++)
+	{
+		rowStart[i + 1] += rowStart[i];
+		if (diagonal[i] < 0.0)
+			diagonal[i] = 0.0;
+	}
+}
+
+bool MutationMatrix::SetDense(size_t newSize, const double *newValues)
+{
+	for (size_t i = 0 ; i < newSize ; i++)
+	{
+		double sum = 0.0;
+		for (size_t j = 0 ; j < newSize ; j++)
+		{
+			if (!(newValues[i * newSize + j] >= 0.0))
+				sum = -1.0;
+			if (sum >= 0.0)
+				sum += newValues[i * newSize + j];
+		}
+		
+		if (fabs(sum - 1.0) > rowTolerance)
+		{
+			Error::Set(wxString::Format(_("The mutations from strategy %d don't add up to one"), (int)i));
+			return false;
+		}
+	}
+	
+	Clear();
+	type = DENSE;
+	size = newSize;
+	values.assign(newValues, newValues + size * size);
+	
+	return true;
+}
+
+
+double MutationMatrix::Get(size_t from, size_t to) const
+{
+	switch (type)
+	{
+	case UNIFORM:
+		if (from == to)
+			return (size > 1) ? 1.0 - rate : 1.0;
+		return rate / (double)(size - 1);
+		
+	case SPARSE:
+		if (from == to)
+			return diagonal[from];
+		for (wxUint32 e = rowStart[from] ; e < rowStart[from + 1] ; e++)
+			if (columns[e] == to)
+				return values[e];
+		return 0.0;
+		
+	case DENSE:
+		return values[from * size + to];
+		
+	default:
+		return (from == to) ? 1.0 : 0.0;
+	}
+}
+
+void MutationMatrix::Apply(const double *v, double *out) const
+{
+	switch (type)
+	{
+	case UNIFORM:
+	{
+		// Everyone gets an equal share of everyone else's mutants
+		if (size < 2)
+		{
+			if (size)
+				out[0] = v[0];
+			return;
+		}
+		
+		double total = 0.0;
+		for (size_t i = 0 ; i < size ; i++)
+			total += v[i];
+		
+		double share = rate / (double)(size - 1);
+		for (size_t j = 0 ; j < size ; j++)
+			out[j] = (1.0 - rate) * v[j] + share * (total - v[j]);
+		return;
+	}
+	
+	case SPARSE:
+		for (size_t j = 0 ; j < size ; j++)
+			out[j] = diagonal[j] * v[j];
+		
+		for (size_t i = 0 ; i < size ; i++)
+		{
+			if (v[i] == 0.0)
+				continue;
+			for (wxUint32 e = rowStart[i] ; e < rowStart[i + 1] ; e++)
+				out[columns[e]] += values[e] * v[i];
+		}
+		return;
+		
+	case DENSE:
+		Kernels::MatTVec(&values[0], size, size, v, out);
+		return;
+		
+	default:
+		return;
+	}
+}
+
+
+void MutationMatrix::Save(OutputFile &out) const
+{
+	MutationHeader header;
+	memset(&header, 0, sizeof(MutationHeader));
+	header.type = type;
+	header.size = size;
+	header.numDiagonal = diagonal.size();
+	header.numRowStart = rowStart.size();
+	header.numColumns = columns.size();
+	header.numValues = values.size();
+	header.rate = rate;
+	
+	out.Write((const char *)&header, sizeof(MutationHeader));
+	WriteArray(out, diagonal);
+	WriteArray(out, rowStart);
+	WriteArray(out, columns);
+	WriteArray(out, values);
+}
+
+bool MutationMatrix::Load(const wxUint8 *&data, const wxUint8 *end)
+{
+	Clear();
+	
+	MutationHeader header;
+	if ((size_t)(end - data) < sizeof(MutationHeader))
+		return false;
+	memcpy(&header, data, sizeof(MutationHeader));
+	data += sizeof(MutationHeader);
+	
+	bool ok = header.type <= DENSE &&
+	          ReadArray(data, end, diagonal, header.numDiagonal) &&
+	          ReadArray(data, end, rowStart, header.numRowStart) &&
+	          ReadArray(data, end, columns, header.numColumns) &&
+	          ReadArray(data, end, values, header.numValues);
+	
+	// Check that the arrays fit together
+	if (ok)
+	{
+		size_t n = header.size;
+		
+		if (header.type == SPARSE)
+		{
+			ok = (diagonal.size() == n && rowStart.size() == n + 1 && rowStart[0] == 0 &&
+			      rowStart[n] == columns.size() && columns.size() == values.size());
+			for (size_t i = 0 ; ok && i < n ; i++)
+				ok = (rowStart[i] <= rowStart[i + 1]);
+			for (size_t e = 0 ; ok && e < columns.size() ; e++)
+				ok = (columns[e] < n);
+		}
+		else if (header.type == DENSE)
+			ok = (diagonal.empty() && rowStart.empty() && columns.empty() && 
+			      header.numValues == (wxUint64)n * n);
+		else
+			ok = (diagonal.empty() && rowStart.empty() && columns.empty() && values.empty());
+	}
+	
+	if (!ok)
+	{
+		Clear();
+		return false;
+	}
+	
+	type = (Type)header.type;
+	size = header.size;
+	rate = header.rate;
+	
+	return true;
+}
+
+
+
+/** \cond TEST */
+#ifdef BUILD_TESTS
+
+TEST(MutationMatrix, Forms)
+{
+	// The same matrix, stored three ways
+	const size_t size = 4;
+	const double rate = 0.03;
+	MutationMatrix uniform, sparse, dense;
+	std::vector<MutationEntry> entries;
+	std::vector<double> values(size * size);
+	
+	for (size_t i = 0 ; i < size ; i++)
+	{
+		for (size_t j = 0 ; j < size ; j++)
+		{
+			values[i * size + j] = (i == j) ? 1.0 - rate : rate / 3.0;
+			if (i != j)
+				entries.push_back(MutationEntry(i, j, rate / 3.0));
+		}
+	}
+	
+	CHECK(uniform.SetUniform(size, rate));
+	CHECK(sparse.SetSparse(size, entries));
+	CHECK(dense.SetDense(size, &values[0]));
+	
+	const double v[size] = { 0.1, 0.5, 0.0, 0.4 };
+	double a[size], b[size], c[size], sum = 0.0;
+	uniform.Apply(v, a);
+	sparse.Apply(v, b);
+	dense.Apply(v, c);
+	
+	for (size_t j = 0 ; j < size ; j++)
+	{
+		CHECK(fabs(a[j] - b[j]) < 1e-12);
+		CHECK(fabs(a[j] - c[j]) < 1e-12);
+		CHECK(fabs(sparse.Get(1, j) - values[size + j]) < 1e-12);
+		sum += a[j];
+	}
+	
+	// Nobody is lost, and extinct strategies come back
+	CHECK(fabs(sum - 1.0) < 1e-12);
+	CHECK(a[2] > 0.0);
+	
+	// Rows must add up
+	values[0] += 0.1;
+	CHECK(!dense.SetDense(size, &values[0]));
+	entries.push_back(MutationEntry(0, 1, 0.99));
+	CHECK(!sparse.SetSparse(size, entries));
+	CHECK(!uniform.SetUniform(size, 1.5));
+}
+
+TEST(MutationMatrix, Neighbors)
+{
+	PrisonerDilemma game;
+	PlayerPtrArray players;
+	
+	// TFT and the machine which opens with D are neighbors, as are TFT
+	// and the one which forgives once; All-D is nobody's neighbor, since
+	// it has fewer states
+	const wxString scripts[4] = { wxT("A\nTFT\n2\nC, 0, 1\nD, 0, 1"),
+	                              wxT("A\nSTFT\n2\nD, 0, 1\nD, 0, 1"),
+	                              wxT("A\nForgiving\n2\nC, 0, 1\nD, 0, 0"),
+	                              wxT("A\nAll-D\n1\nD, 0, 0") };
+	for (int i = 0 ; i < 4 ; i++)
+	{
+		FSAPlayer *player = new FSAPlayer;
+		CHECK(player->LoadFromString(&game, scripts[i]));
+		players.Add(player);
+	}
+	
+	MutationMatrix matrix;
+	CHECK(matrix.SetNeighbors(players, 0.01));
+	CHECK(fabs(matrix.Get(0, 0) - 0.99) < 1e-12);
+	CHECK(fabs(matrix.Get(0, 1) - 0.005) < 1e-12);
+	CHECK(fabs(matrix.Get(0, 2) - 0.005) < 1e-12);
+	CHECK(fabs(matrix.Get(1, 0) - 0.01) < 1e-12);
+	CHECK_EQUAL(0.0, matrix.Get(1, 2));
+	CHECK_EQUAL(1.0, matrix.Get(3, 3));
+	CHECK_EQUAL(0.0, matrix.Get(0, 3));
+	
+	for (size_t i = 0 ; i < players.GetCount() ; i++)
+		delete players[i];
+}
+
+#endif
+/** \endcond */
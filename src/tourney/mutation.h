@@ -0,0 +1,255 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TOURNEY_MUTATION_H__
+#define TOURNEY_MUTATION_H__
+
+#include <vector>
+#include "../game/player.h"
+class OutputFile;
+
+
+/**
+    \struct MutationEntry
+    \ingroup tourney
+    
+    \brief The chance that one strategy's offspring are born as another
+*/
+struct MutationEntry
+{
+	MutationEntry(size_t f, size_t t, double p) : from(f), to(t), probability(p) { }
+	
+	size_t from;		/**< \brief Index of the parent strategy */
+	size_t to;		/**< \brief Index of the offspring's strategy */
+	double probability;	/**< \brief Chance of this mutation */
+};
+
+
+/**
+    \class MutationMatrix
+    \ingroup tourney
+    
+    \brief The chances that the offspring of each strategy mutate into
+           each other strategy
+    
+    Entry <tt>(i, j)</tt> of the matrix, \c Q, is the chance that an
+    offspring of strategy \c i is born playing strategy \c j, so every
+    row sums to one.  Under the replicator-mutator equation, the
+    population produced by a generation whose offspring are \c v is then
+    <tt>Q<sup>T</sup> v</tt> (see Apply()).
+    
+    Most mutation schemes only ever need a few numbers per strategy, so
+    the matrix is stored in whichever of three forms fits: implicitly,
+    for the same mutation rate to every other strategy; as a sparse
+    matrix, for mutations to a few neighbors (see SetNeighbors()); or
+    dense.  An empty matrix means no mutation at all.
+*/
+class MutationMatrix
+{
+public:
+	/**
+	    \brief Constructor
+	    
+	    Creates an empty matrix (no mutation).
+	*/
+	MutationMatrix() : type(NONE), size(0), rate(0.0) { }
+	
+	/**
+	    \brief Turn off mutation
+	*/
+	void Clear();
+	
+	/**
+	    \brief Mutate to every other strategy equally often
+	    
+	    \param newSize The number of strategies
+	    \param newRate The chance that an offspring mutates, split
+	                   evenly between the other strategies
+	    \returns True if the rate is valid, false otherwise
+	*/
+	bool SetUniform(size_t newSize, double newRate);
+	
+	/**
+	    \brief Mutate only to neighboring finite state machines
+	    
+	    Two machines are neighbors if they have the same number of
+	    states, and differ only in the move or one of the transitions
+	    of one state.  Offspring mutate with chance \p newRate, split
+	    evenly between the neighbors of their parent in \p players.
+	    Players which aren't machines, or which have no neighbors, always
+	    breed true.
+	    
+	    \param players The players
+	    \param newRate The chance that an offspring mutates
+	    \returns True if the rate is valid, false otherwise
+	*/
+	bool SetNeighbors(const PlayerPtrArray &players, double newRate);
+	
+	/**
+	    \brief Set the chance of any mutations at all
+	    
+	    Each offspring keeps its parent's strategy with whatever chance
+	    is left over from \p entries.
+	    
+	    \param newSize The number of strategies
+	    \param entries The chance of each mutation between two different
+	                   strategies
+	    \returns True if the entries are valid, false otherwise
+	*/
+	bool SetSparse(size_t newSize, const std::vector<MutationEntry> &entries);
+	
+	/**
+	    \brief Set every entry of the matrix
+	    
+	    \param newSize The number of strategies
+	    \param values The matrix, row by row (\p newSize squared values,
+	                  each row summing to one)
+	    \returns True if the matrix is valid, false otherwise
+	*/
+	bool SetDense(size_t newSize, const double *values);
+	
+	
+	/**
+	    \brief Is mutation turned off?
+	    \returns True if the matrix is empty
+	*/
+	bool IsEmpty() const { return type == NONE; }
+	
+	/**
+	    \brief Get the number of strategies (rows and columns)
+	    \returns Size of the matrix, or zero if it is empty
+	*/
+	size_t GetSize() const { return size; }
+	
+	/**
+	    \brief Get one entry of the matrix
+	    
+	    \param from Index of the parent strategy
+	    \param to Index of the offspring's strategy
+	    \returns Chance that offspring of \p from are born as \p to
+	*/
+	double Get(size_t from, size_t to) const;
+	
+	/**
+	    \brief Work out the strategies of a generation's offspring
+	    
+	    Computes <tt>out = Q<sup>T</sup> v</tt>.
+	    
+	    \param v The offspring of each strategy, before mutation
+	             (GetSize() values)
+	    \param[out] out The offspring of each strategy, after mutation
+	*/
+	void Apply(const double *v, double *out) const;
+	
+	
+	/**
+	    \brief Write the matrix to a file
+	    
+	    Used for checkpoints (see \c EvoTournament::SaveCheckpoint).
+	    
+	    \param out The file
+	*/
+	void Save(OutputFile &out) const;
+	
+	/**
+	    \brief Read a matrix written by Save()
+	    
+	    \param[in,out] data The start of the matrix, moved past it on
+	                        success
+	    \param end The end of the data
+	    \returns True if the matrix was read, false if it was truncated
+	             or corrupt (in which case the matrix is empty)
+	*/
+	bool Load(const wxUint8 *&data, const wxUint8 *end);
+
+private:
+	/**
+	    \brief Check a mutation rate
+	    \param newRate The rate
+	    \returns True if \p newRate is between zero and one
+	*/
+	static bool CheckRate(double newRate);
+	
+	/**
+	    \brief Store the off-diagonal entries of a sparse matrix
+	    
+	    \param newSize The number of strategies
+	    \param entries The entries, which have already been checked
+	*/
+	void BuildSparse(size_t newSize, const std::vector<MutationEntry> &entries);
+	
+	
+	/**
+	    \brief The ways the matrix may be stored
+	*/
+	enum Type
+	{
+		NONE,		/**< \brief No mutation */
+		UNIFORM,	/**< \brief \c rate, spread over every other strategy */
+		SPARSE,		/**< \brief \c diagonal, plus the entries in \c rowStart */
+		DENSE		/**< \brief Every entry, in \c values */
+	};
+	
+	/**
+	    \brief How the matrix is stored
+	*/
+	Type type;
+	
+	/**
+	    \brief The number of strategies
+	*/
+	size_t size;
+	
+	/**
+	    \brief The mutation rate, for \c UNIFORM matrices
+	*/
+	double rate;
+	
+	/**
+	    \brief The chance that each strategy breeds true, for \c SPARSE
+	           matrices
+	*/
+	std::vector<double> diagonal;
+	
+	/**
+	    \brief The first of each row's entries in \c columns and
+	           \c values (<tt>size + 1</tt> values), for \c SPARSE
+	           matrices
+	*/
+	std::vector<wxUint32> rowStart;
+	
+	/**
+	    \brief The column of each off-diagonal entry, for \c SPARSE
+	           matrices
+	*/
+	std::vector<wxUint32> columns;
+	
+	/**
+	    \brief The off-diagonal entries of a \c SPARSE matrix, or every
+	           entry of a \c DENSE one, row by row
+	*/
+	std::vector<double> values;
+};
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,659 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#include <algorithm>
+#include <math.h>
+
+#ifdef BUILD_TESTS
+#  include <TestHarness.h>
+#  include <wx/file.h>
+#  include <wx/filename.h>
+#  include "../game/prisoner.h"
+#  include "../game/fsaplayer.h"
+#endif
+
+#include "../common/error.h"
+#include "../common/mappedfile.h"
+#include "../common/parallel.h"
+#include "../common/rng.h"
+#include "network.h"
+
+
+// Nodes are handed out to threads in chunks of this many
+static const size_t nodeChunkSize = 4096;
+
+
+InteractionGraph::InteractionGraph()
+{ }
+
+bool InteractionGraph::Build(wxUint32 numNodes, const std::vector<wxUint32> &edges)
+{
+	Clear();
+	
+	// Count the degree of every node (in both directions)
+	std::vector<wxUint64> degree((size_t)numNodes + 1, 0);
+	wxUint64 total = 0;
+	
+	for (size_t e = 0 ; e + 1 < edges.size() ; e += 2)
+	{
+		wxUint32 a = edges[e], b = edges[e + 1];
+		
+		if (a >= numNodes || b >= numNodes)
+		{
+			Error::Set(wxString::Format(_("Edge %d refers to a node that does not exist"), (int)(e / 2)));
+			return false;
+		}
+		if (a == b)
+			continue;
+		
+		degree[a]++;
+		degree[b]++;
+		total += 2;
+	}
+	
+	if (total > 0xFFFFFFFFu)
+	{
+		Error::Set(_("The network has too many edges"));
+		return false;
+	}
+	
+	offsets.resize((size_t)numNodes + 1);
+	offsets[0] = 0;
+	for (wxUint32 n = 0 ; n < numNodes ; n++)
+		offsets[n + 1] = offsets[n] + (wxUint32)degree[n];
+	
+	// Drop each edge into place, both ways
+	std::vector<wxUint32> cursor(offsets.begin(), offsets.end() - 1);
+	neighbors.resize((size_t)total);
+	
+	for (size_t e = 0 ; e + 1 < edges.size() ; e += 2)
+	{
+		wxUint32 a = edges[e], b = edges[e + 1];
+		if (a == b)
+			continue;
+		
+		neighbors[cursor[a]++] = b;
+		neighbors[cursor[b]++] = a;
+	}
+	
+	// Sort each row and squeeze out duplicate edges
+	wxUint32 out = 0;
+	for (wxUint32 n = 0 ; n < numNodes ; n++)
+	{
+		std::vector<wxUint32>::iterator begin = neighbors.begin() + offsets[n];
+		std::vector<wxUint32>::iterator end = neighbors.begin() + offsets[n + 1];
+		
+		std::sort(begin, end);
+		end = std::unique(begin, end);
+		
+		wxUint32 start = out;
+		for (std::vector<wxUint32>::iterator it = begin ; it != end ; ++it)
+			neighbors[out++] = *it;
+		
+		offsets[n] = start;
+	}
+	offsets[numNodes] = out;
+	neighbors.resize(out);
+	
+	return true;
+}
+
+bool InteractionGraph::LoadEdgeList(const wxString &fileName)
+{
+	MappedFile file;
+	if (!file.Open(fileName))
+		return false;
+	
+	const char *p = (const char *)file.GetData();
+	const char *end = p + file.GetSize();
+	
+	std::vector<wxUint32> edges;
+	wxUint64 maxNode = 0;
+	int line = 0;
+	
+	while (p < end)
+	{
+		line++;
+		
+		// Skip leading whitespace, blank lines, and comments
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+			p++;
+		if (p == end)
+			break;
+		
+		if (*p != '\n' && *p != '#' && *p != '%')
+		{
+			wxUint64 nodes[2];
+			
+			for (int i = 0 ; i < 2 ; i++)
+			{
+				if (i == 1)
+				{
+					while (p < end && (*p == ' ' || *p == '\t' || *p == ','))
+						p++;
+				}
+				
+				if (p == end || *p < '0' || *p > '9')
+				{
+					Error::Set(wxString::Format(_("Line %d of %s is not a valid edge"), line, fileName.c_str()));
+					return false;
+				}
+				
+				nodes[i] = 0;
+				while (p < end && *p >= '0' && *p <= '9')
+				{
+					nodes[i] = nodes[i] * 10 + (*p - '0');
+					if (nodes[i] >= 0xFFFFFFFFu)
+					{
+						Error::Set(wxString::Format(_("Line %d of %s has a node number which is too large"), line, fileName.c_str()));
+						return false;
+					}
+					p++;
+				}
+				
+				if (nodes[i] > maxNode)
+					maxNode = nodes[i];
+			}
+			
+			edges.push_back((wxUint32)nodes[0]);
+			edges.push_back((wxUint32)nodes[1]);
+		}
+		
+		// On to the next line
+		while (p < end && *p != '\n')
+			p++;
+		if (p < end)
+			p++;
+	}
+	
+	if (edges.empty())
+	{
+		Error::Set(wxString::Format(_("File %s contains no edges"), fileName.c_str()));
+		return false;
+	}
+	
+	return Build((wxUint32)maxNode + 1, edges);
+}
+
+void InteractionGraph::Clear()
+{
+	offsets.clear();
+	neighbors.clear();
+}
+
+
+/**
+    \brief Computes the score of every node against its neighbors
+*/
+class NetworkScoreTask : public ParallelTask
+{
+public:
+	NetworkScoreTask(NetworkTournament *t) : tourney(t) { }
+	
+	virtual bool Run(size_t begin, size_t end)
+	{
+		for (size_t n = begin ; n < end ; n++)
+			tourney->scores[n] = tourney->NodeScore(n);
+		return true;
+	}
+	
+private:
+	NetworkTournament *tourney;
+};
+
+/**
+    \brief Chooses the strategy of every node in the next generation
+*/
+class NetworkUpdateTask : public ParallelTask
+{
+public:
+	NetworkUpdateTask(NetworkTournament *t) : tourney(t) { }
+	
+	virtual bool Run(size_t begin, size_t end)
+	{
+		wxUint64 gen = (wxUint64)tourney->generation << 32;
+		
+		for (size_t n = begin ; n < end ; n++)
+			tourney->nextStrategies[n] = tourney->Imitate(n, gen ^ n);
+		return true;
+	}
+	
+private:
+	NetworkTournament *tourney;
+};
+
+
+NetworkTournament::NetworkTournament(Game *gm) :
+	updateMode(SYNCHRONOUS), updateRule(BEST_TAKES_OVER), fermiTemperature(10.0),
+	seed(0), generation(0), played(false), game(gm)
+{ }
+
+NetworkTournament::~NetworkTournament()
+{
+	for (size_t i = 0 ; i < players.GetCount() ; i++)
+		delete players[i];
+	players.Clear();
+}
+
+
+void NetworkTournament::AddPlayer(const Player *player)
+{
+	players.Add(player->Clone());
+	
+	payoffs.Clear();
+	Reset();
+}
+
+void NetworkTournament::RemovePlayer(const Player *player)
+{
+	for (size_t i = 0 ; i < players.GetCount() ; i++)
+	{
+		Player *t = players[i];
+		
+		if (player->GetID() == t->GetID())
+		{
+			delete t;
+			players.RemoveAt(i);
+			
+			// Nodes with this strategy go to the first player, and the
+			// others shift down to keep their strategy
+			for (size_t n = 0 ; n < strategies.size() ; n++)
+			{
+				if (strategies[n] == i)
+					strategies[n] = 0;
+				else if (strategies[n] > i)
+					strategies[n]--;
+			}
+			
+			payoffs.Clear();
+			Reset();
+			return;
+		}
+	}
+}
+
+
+bool NetworkTournament::LoadGraph(const wxString &fileName)
+{
+	InteractionGraph newGraph;
+	if (!newGraph.LoadEdgeList(fileName))
+		return false;
+	
+	SetGraph(newGraph);
+	return true;
+}
+
+void NetworkTournament::SetGraph(const InteractionGraph &newGraph)
+{
+	graph = newGraph;
+	
+	strategies.assign(graph.GetNumNodes(), 0);
+	nextStrategies.assign(graph.GetNumNodes(), 0);
+	scores.assign(graph.GetNumNodes(), 0.0);
+	
+	Reset();
+}
+
+void NetworkTournament::Randomize()
+{
+	if (!players.GetCount())
+		return;
+	
+	for (size_t n = 0 ; n < strategies.size() ; n++)
+		strategies[n] = Random::Hash(seed ^ Random::Hash(n)) % players.GetCount();
+	
+	Reset();
+}
+
+
+bool NetworkTournament::Run(int numGenerations)
+{
+	if (!players.GetCount())
+	{
+		Error::Set(_("Add at least one player to the network tournament"));
+		return false;
+	}
+	if (players.GetCount() > 65536)
+	{
+		Error::Set(_("A network tournament may have at most 65536 players"));
+		return false;
+	}
+	if (!graph.GetNumNodes())
+	{
+		Error::Set(_("Load an interaction network before running the tournament"));
+		return false;
+	}
+	
+	// Compute the payoffs once, and never play another match
+	if (payoffs.GetSize() != players.GetCount())
+	{
+		if (!payoffs.Compute(game, players))
+			return false;
+	}
+	
+	// Record the starting state
+	if (!played)
+	{
+		data.SetNumPlayers(players.GetCount());
+		Record();
+		played = true;
+	}
+	
+	for (int gen = 0 ; gen < numGenerations ; gen++)
+	{
+		if (updateMode == SYNCHRONOUS)
+		{
+			if (!SynchronousStep())
+				return false;
+		}
+		else if (!AsynchronousStep())
+			return false;
+		
+		generation++;
+		Record();
+	}
+	
+	return true;
+}
+
+void NetworkTournament::Reset()
+{
+	played = false;
+	generation = 0;
+	data.Clear();
+}
+
+std::vector<wxUint32> NetworkTournament::GetCounts() const
+{
+	std::vector<wxUint32> counts(players.GetCount(), 0);
+	
+	for (size_t n = 0 ; n < strategies.size() ; n++)
+		counts[strategies[n]]++;
+	
+	return counts;
+}
+
+
+bool NetworkTournament::SynchronousStep()
+{
+	NetworkScoreTask scoreTask(this);
+	if (!Parallel::For(strategies.size(), &scoreTask, nodeChunkSize))
+		return false;
+	
+	NetworkUpdateTask updateTask(this);
+	if (!Parallel::For(strategies.size(), &updateTask, nodeChunkSize))
+		return false;
+	
+	strategies.swap(nextStrategies);
+	return true;
+}
+
+bool NetworkTournament::AsynchronousStep()
+{
+	// Each update sees the results of all those before it, so the
+	// scores are computed once, and then kept up to date as nodes
+	// change strategy
+	NetworkScoreTask scoreTask(this);
+	if (!Parallel::For(strategies.size(), &scoreTask, nodeChunkSize))
+		return false;
+	
+	wxUint64 gen = (wxUint64)generation << 32;
+	size_t numNodes = strategies.size();
+	
+	for (size_t k = 0 ; k < numNodes ; k++)
+	{
+		wxUint64 r = Random::Hash(seed ^ Random::Hash(gen ^ k ^ wxULL(0x8000000000000000)));
+		wxUint32 node = r % numNodes;
+		
+		wxUint16 strategy = Imitate(node, gen ^ k);
+		if (strategy != strategies[node])
+			ChangeStrategy(node, strategy);
+	}
+	
+	return true;
+}
+
+void NetworkTournament::ChangeStrategy(wxUint32 node, wxUint16 strategy)
+{
+	const wxUint32 *nb = graph.GetNeighbors(node);
+	wxUint32 degree = graph.GetDegree(node);
+	wxUint16 old = strategies[node];
+	
+	strategies[node] = strategy;
+	
+	// Each neighbor now meets the new strategy instead of the old one
+	for (wxUint32 i = 0 ; i < degree ; i++)
+	{
+		const double *row = payoffs.GetRow(strategies[nb[i]]);
+		scores[nb[i]] += row[strategy] - row[old];
+	}
+	
+	scores[node] = NodeScore(node);
+}
+
+double NetworkTournament::NodeScore(wxUint32 node) const
+{
+	const double *row = payoffs.GetRow(strategies[node]);
+	const wxUint32 *nb = graph.GetNeighbors(node);
+	wxUint32 degree = graph.GetDegree(node);
+	double score = 0.0;
+	
+	for (wxUint32 i = 0 ; i < degree ; i++)
+		score += row[strategies[nb[i]]];
+	
+	return score;
+}
+
+wxUint16 NetworkTournament::Imitate(wxUint32 node, wxUint64 key) const
+{
+	const wxUint32 *nb = graph.GetNeighbors(node);
+	wxUint32 degree = graph.GetDegree(node);
+	wxUint16 strategy = strategies[node];
+	
+	// Isolated nodes have nobody to imitate
+	if (!degree)
+		return strategy;
+	
+	double own = scores[node];
+	
+	if (updateRule == BEST_TAKES_OVER)
+	{
+		double best = own;
+		
+		for (wxUint32 i = 0 ; i < degree ; i++)
+		{
+			double score = scores[nb[i]];
+			if (score > best)
+			{
+				best = score;
+				strategy = strategies[nb[i]];
+			}
+		}
+	}
+	else
+	{
+		wxUint64 r = Random::Hash(seed ^ Random::Hash(key));
+		wxUint32 other = nb[r % degree];
+		
+		double diff = own - scores[other];
+		double p = 1.0 / (1.0 + exp(diff / fermiTemperature));
+		
+		if (Random::HashToFloat(Random::Hash(r)) < p)
+			strategy = strategies[other];
+	}
+	
+	return strategy;
+}
+
+void NetworkTournament::Record()
+{
+	std::vector<wxUint32> counts = GetCounts();
+	std::vector<double> fractions(counts.size());
+	
+	for (size_t i = 0 ; i < counts.size() ; i++)
+		fractions[i] = (double)counts[i] / strategies.size();
+	data.Add(fractions);
+}
+
+
+/** \cond TEST */
+#ifdef BUILD_TESTS
+
+TEST(InteractionGraph, LoadEdgeList)
+{
+	wxString tempName = wxFileName::CreateTempFileName(wxT("oyun"));
+	wxFile file(tempName, wxFile::write);
+	CHECK(file.IsOpened());
+	file.Write(wxT("# A small test network\n0 1\n1\t2 0.5\n\n2,0\n1 0\n3 3\r\n  4 1\n"));
+	file.Close();
+	
+	InteractionGraph graph;
+	CHECK(graph.LoadEdgeList(tempName));
+	
+	// The duplicate edge and the self-loop are dropped
+	CHECK_EQUAL(5, (int)graph.GetNumNodes());
+	CHECK_EQUAL(4, (int)graph.GetNumEdges());
+	CHECK_EQUAL(3, (int)graph.GetDegree(1));
+	CHECK_EQUAL(0, (int)graph.GetDegree(3));
+	CHECK_EQUAL(0, (int)graph.GetNeighbors(1)[0]);
+	CHECK_EQUAL(2, (int)graph.GetNeighbors(1)[1]);
+	CHECK_EQUAL(4, (int)graph.GetNeighbors(1)[2]);
+	
+	file.Open(tempName, wxFile::write);
+	file.Write(wxT("0 1\n2 x\n"));
+	file.Close();
+	CHECK(!graph.LoadEdgeList(tempName));
+	
+	wxRemoveFile(tempName);
+}
+
+static const wxString test_network_allc("Charles Pence\nAll-C\n1\nC, 0, 0");
+static const wxString test_network_alld("Charles Pence\nAll-D\n1\nD, 0, 0");
+
+TEST(NetworkTournament, Star)
+{
+	PrisonerDilemma game;
+	FSAPlayer allc, alld;
+	NetworkTournament tourney(&game);
+	
+	CHECK(allc.LoadFromString(&game, test_network_allc));
+	CHECK(alld.LoadFromString(&game, test_network_alld));
+	tourney.AddPlayer(&allc);
+	tourney.AddPlayer(&alld);
+	
+	// A defector at the hub of a star, and one isolated node
+	std::vector<wxUint32> edges;
+	for (wxUint32 n = 1 ; n < 10 ; n++)
+	{
+		edges.push_back(0);
+		edges.push_back(n);
+	}
+	InteractionGraph graph;
+	CHECK(graph.Build(11, edges));
+	tourney.SetGraph(graph);
+	tourney.SetStrategy(0, 1);
+	
+	CHECK(tourney.Run(1));
+	
+	std::vector<wxUint32> counts = tourney.GetCounts();
+	CHECK_EQUAL(1, (int)counts[0]);
+	CHECK_EQUAL(10, (int)counts[1]);
+	CHECK_EQUAL(0, tourney.GetStrategy(10));
+	
+	CHECK_EQUAL(2, (int)tourney.data.GetNumRows());
+	CHECK_EQUAL(1.0f / 11.0f, tourney.data.Get(0, 1));
+	
+	// One node at a time, the leaves copy the hub as they come up,
+	// while the hub's score falls with every leaf that changes
+	tourney.Reset();
+	tourney.updateMode = NetworkTournament::ASYNCHRONOUS;
+	for (wxUint32 n = 0 ; n < 11 ; n++)
+		tourney.SetStrategy(n, n ? 0 : 1);
+	
+	CHECK(tourney.Run(1));
+	counts = tourney.GetCounts();
+	CHECK(counts[1] > 1 && counts[1] < 10);
+	
+	CHECK(tourney.Run(50));
+	counts = tourney.GetCounts();
+	CHECK_EQUAL(10, (int)counts[1]);
+	CHECK_EQUAL(1, tourney.GetStrategy(0));
+	CHECK_EQUAL(0, tourney.GetStrategy(10));
+}
+
+TEST(NetworkTournament, Deterministic)
+{
+	PrisonerDilemma game;
+	FSAPlayer allc, alld;
+	
+	CHECK(allc.LoadFromString(&game, test_network_allc));
+	CHECK(alld.LoadFromString(&game, test_network_alld));
+	
+	// A ring with some chords
+	std::vector<wxUint32> edges;
+	for (wxUint32 n = 0 ; n < 5000 ; n++)
+	{
+		edges.push_back(n);
+		edges.push_back((n + 1) % 5000);
+		edges.push_back(n);
+		edges.push_back((n * 37 + 11) % 5000);
+	}
+	InteractionGraph graph;
+	CHECK(graph.Build(5000, edges));
+	
+	// The same seed should give the same run, however many threads run it
+	std::vector<wxUint16> results[3];
+	for (int run = 0 ; run < 3 ; run++)
+	{
+		Parallel::SetNumThreads(run == 1 ? 4 : 1);
+		
+		NetworkTournament tourney(&game);
+		tourney.AddPlayer(&allc);
+		tourney.AddPlayer(&alld);
+		tourney.SetGraph(graph);
+		tourney.updateRule = NetworkTournament::FERMI;
+		tourney.updateMode = (run == 2) ? NetworkTournament::ASYNCHRONOUS : NetworkTournament::SYNCHRONOUS;
+		tourney.fermiTemperature = 500.0;
+		tourney.seed = 7;
+		tourney.Randomize();
+		
+		CHECK(tourney.Run(4));
+		CHECK_EQUAL(5, (int)tourney.data.GetNumRows());
+		
+		for (wxUint32 n = 0 ; n < 5000 ; n++)
+			results[run].push_back(tourney.GetStrategy(n));
+	}
+	Parallel::SetNumThreads(0);
+	
+	CHECK(results[0] == results[1]);
+	CHECK(results[0] != results[2]);
+}
+
+#endif
+/** \endcond */
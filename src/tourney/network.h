@@ -0,0 +1,428 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TOURNEY_NETWORK_H__
+#define TOURNEY_NETWORK_H__
+
+#include <vector>
+
+#include "../game/player.h"
+#include "payoffmatrix.h"
+#include "trajectory.h"
+class Game;
+
+
+/**
+    \class InteractionGraph
+    \ingroup tourney
+    
+    \brief An undirected graph, stored in compressed sparse row form
+    
+    The neighbors of every node are stored, sorted, in one contiguous
+    array, and node \c n's neighbors begin at offset \c n in a second
+    array.  This keeps graphs with millions of edges compact, and lets
+    each node's neighbors be read in one linear pass.  Self-loops and
+    duplicate edges are dropped.
+*/
+class InteractionGraph
+{
+public:
+	/**
+	    \brief Constructor
+	    
+	    Creates an empty graph.
+	*/
+	InteractionGraph();
+	
+	/**
+	    \brief Build the graph from a list of edges
+	    
+	    \param numNodes The number of nodes in the graph
+	    \param edges Pairs of node indices, one pair per edge
+	    \returns True if the graph was built, false otherwise
+	*/
+	bool Build(wxUint32 numNodes, const std::vector<wxUint32> &edges);
+	
+	/**
+	    \brief Load the graph from an edge-list file
+	    
+	    Each line holds two non-negative node numbers, separated by
+	    spaces, tabs, or a comma; anything else on the line (such as an
+	    edge weight) is ignored.  Blank lines and lines beginning with
+	    \c # or \c % are skipped.  The graph has as many nodes as the
+	    largest node number plus one.
+	    
+	    \param fileName The file to load
+	    \returns True if the graph was loaded, false otherwise
+	*/
+	bool LoadEdgeList(const wxString &fileName);
+	
+	/**
+	    \brief Empty the graph
+	*/
+	void Clear();
+	
+	/**
+	    \brief Get the number of nodes
+	    \returns Number of nodes
+	*/
+	wxUint32 GetNumNodes() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+	
+	/**
+	    \brief Get the number of (undirected) edges
+	    \returns Number of edges
+	*/
+	wxUint32 GetNumEdges() const { return neighbors.size() / 2; }
+	
+	/**
+	    \brief Get the number of neighbors of a node
+	    
+	    \param node The node
+	    \returns Degree of \p node
+	*/
+	wxUint32 GetDegree(wxUint32 node) const
+	{ return offsets[node + 1] - offsets[node]; }
+	
+	/**
+	    \brief Get the neighbors of a node
+	    
+	    \param node The node
+	    \returns Pointer to the GetDegree() neighbors of \p node, sorted
+	*/
+	const wxUint32 *GetNeighbors(wxUint32 node) const
+	{ return neighbors.empty() ? NULL : &neighbors[offsets[node]]; }
+
+private:
+	/**
+	    \brief Index into \c neighbors of each node's first neighbor,
+	           with one extra entry at the end
+	*/
+	std::vector<wxUint32> offsets;
+	
+	/**
+	    \brief Neighbors of every node, concatenated
+	*/
+	std::vector<wxUint32> neighbors;
+};
+
+
+/**
+    \class NetworkTournament
+    \ingroup tourney
+    
+    \brief Runs an evolutionary tournament on an interaction network
+    
+    This is the network counterpart of \c LatticeTournament: each node of
+    an \c InteractionGraph holds one player, plays each of its neighbors,
+    and then imitates a neighbor according to an update rule.  A node's
+    score is the sum of its scores against all its neighbors, taken from
+    a \c PayoffMatrix, so no matches are played after the first
+    generation.
+    
+    Updates may be synchronous, in which every node updates at once
+    (and the scores and updates are computed in parallel over the
+    nodes), or asynchronous, in which each generation is one update of
+    each of as many nodes, chosen at random, as there are in the graph.
+    Asynchronous updates depend on one another, and so run on a single
+    thread.  Random choices are drawn from \c Random::Hash, so that a run
+    depends only on \c seed.
+*/
+class NetworkTournament
+{
+public:
+	/**
+	    \brief How the nodes are updated
+	*/
+	enum UpdateMode
+	{
+		SYNCHRONOUS,   /**< All nodes update at once, from the last generation */
+		ASYNCHRONOUS   /**< Nodes update one at a time, in random order */
+	};
+	
+	/**
+	    \brief How each node picks its new strategy
+	*/
+	enum UpdateRule
+	{
+		/**
+		    Adopt the strategy of the highest-scoring node among the node
+		    and its neighbors (keeping our own on a tie)
+		*/
+		BEST_TAKES_OVER,
+		
+		/**
+		    Pick one neighbor at random, and adopt its strategy with
+		    probability <tt>1 / (1 + exp((own - neighbor) / K))</tt>, where
+		    \c K is \c fermiTemperature
+		*/
+		FERMI
+	};
+	
+	
+	/**
+	    \brief Constructor
+	    
+	    Sets the \c game value.  The graph starts out empty.
+	    
+	    \param gm Initial value of the \c game member.
+	*/
+	NetworkTournament(Game *gm);
+	
+	virtual ~NetworkTournament();
+	
+	
+	/**
+	    \brief Add a player (strategy) to the internal list
+	    
+	    The player passed will be cloned, and its pointer not stored.
+	    At most 65536 players may be added.
+	    
+	    \param player Player to be cloned and added to the tournament
+	*/
+	void AddPlayer(const Player *player);
+	
+	/**
+	    \brief Remove this player from the internal list
+	    
+	    Any nodes holding this player are reassigned, and the tournament
+	    is reset.
+	    
+	    \param player Player of the same ID as that to be removed
+	*/
+	void RemovePlayer(const Player *player);
+	
+	
+	/**
+	    \brief Load the interaction network from an edge-list file
+	    
+	    See \c InteractionGraph::LoadEdgeList() for the format.  Every node
+	    is set to the first player, and the tournament is reset.
+	    
+	    \param fileName The file to load
+	    \returns True if the graph was loaded, false otherwise
+	*/
+	bool LoadGraph(const wxString &fileName);
+	
+	/**
+	    \brief Set the interaction network
+	    
+	    Every node is set to the first player, and the tournament is reset.
+	    
+	    \param newGraph The new graph
+	*/
+	void SetGraph(const InteractionGraph &newGraph);
+	
+	/**
+	    \brief Get the interaction network
+	    \returns The graph
+	*/
+	const InteractionGraph &GetGraph() const { return graph; }
+	
+	/**
+	    \brief Get the strategy at a node
+	    
+	    \param node The node
+	    \returns Index (into \c players) of the node's strategy
+	*/
+	wxUint16 GetStrategy(wxUint32 node) const { return strategies[node]; }
+	
+	/**
+	    \brief Set the strategy at a node
+	    
+	    \param node The node
+	    \param strategy Index (into \c players) of the new strategy
+	*/
+	void SetStrategy(wxUint32 node, wxUint16 strategy) { strategies[node] = strategy; }
+	
+	/**
+	    \brief Give every node a strategy chosen uniformly at random
+	    
+	    The choice depends only on \c seed.
+	*/
+	void Randomize();
+	
+	
+	/**
+	    \brief Run the network tournament
+	    
+	    Computes the payoff matrix (if it hasn't been yet), and then runs
+	    the given number of generations.  The tournament may be run again
+	    to continue from where it stopped.  The population fractions at
+	    every generation are accumulated in \c data.
+	    
+	    \param numGenerations Number of generations to run
+	    \returns True if the tournament ran successfully, false otherwise
+	*/
+	bool Run(int numGenerations);
+	
+	/**
+	    \brief Has the tournament been played?
+	    \returns True if the tournament has been played, false otherwise
+	*/
+	bool IsPlayed() const { return played; }
+	
+	/**
+	    \brief Reset all internal data
+	    
+	    Clears the tournament data (but not the node strategies), and
+	    resets the generation counter.
+	*/
+	void Reset();
+	
+	/**
+	    \brief Get the number of nodes holding each strategy
+	    \returns Count of nodes, indexed as \c players
+	*/
+	std::vector<wxUint32> GetCounts() const;
+	
+	
+	/**
+	    \brief List of all players in this tournament
+	*/
+	PlayerPtrArray players;
+	
+	/**
+	    \brief How the nodes are updated
+	*/
+	UpdateMode updateMode;
+	
+	/**
+	    \brief Rule used to update strategies
+	*/
+	UpdateRule updateRule;
+	
+	/**
+	    \brief Noise (\c K) for the Fermi rule, in units of match score
+	*/
+	double fermiTemperature;
+	
+	/**
+	    \brief Seed for all random choices
+	*/
+	wxUint64 seed;
+	
+	/**
+	    \brief The number of generations run so far
+	*/
+	int generation;
+	
+	/**
+	    \brief The fraction of nodes holding each player, at every
+	           generation
+	    
+	    This is in the same form as \c EvoTournament::data, so that the
+	    results may be graphed and exported in the same way.
+	*/
+	Trajectory data;
+
+private:
+	friend class NetworkScoreTask;
+	friend class NetworkUpdateTask;
+	
+	/**
+	    \brief Run a single synchronous generation
+	    \returns True if successful, false otherwise
+	*/
+	bool SynchronousStep();
+	
+	/**
+	    \brief Run a single asynchronous generation
+	    \returns True if successful, false otherwise
+	*/
+	bool AsynchronousStep();
+	
+	/**
+	    \brief Change the strategy of a node, updating \c scores
+	    
+	    Only the scores of the node and its neighbors change, so the
+	    neighbors' are adjusted rather than computed again.
+	    
+	    \param node The node
+	    \param strategy New strategy for \p node
+	*/
+	void ChangeStrategy(wxUint32 node, wxUint16 strategy);
+	
+	/**
+	    \brief Compute the score of one node against its neighbors
+	    
+	    \param node The node
+	    \returns Score of \p node
+	*/
+	double NodeScore(wxUint32 node) const;
+	
+	/**
+	    \brief Choose the next strategy of a node
+	    
+	    Node scores are taken from \c scores, which must be up to date.
+	    
+	    \param node The node
+	    \param key Counter from which to draw random choices
+	    \returns New strategy for \p node
+	*/
+	wxUint16 Imitate(wxUint32 node, wxUint64 key) const;
+	
+	/**
+	    \brief Record the population fractions for the current generation
+	*/
+	void Record();
+	
+	
+	/**
+	    \brief The interaction network
+	*/
+	InteractionGraph graph;
+	
+	/**
+	    \brief The strategy index at each node
+	*/
+	std::vector<wxUint16> strategies;
+	
+	/**
+	    \brief Buffer for the next generation's strategies
+	*/
+	std::vector<wxUint16> nextStrategies;
+	
+	/**
+	    \brief The score of each node in the current generation (or,
+	           when updating asynchronously, at the current update)
+	*/
+	std::vector<double> scores;
+	
+	/**
+	    \brief Scores of every pair of strategies
+	*/
+	PayoffMatrix payoffs;
+	
+	/**
+	    \brief True when the tournament has been played
+	*/
+	bool played;
+	
+	/**
+	    \brief Game to be played
+	*/
+	Game *game;
+};
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,475 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#include <map>
+#include <string.h>
+
+#ifdef BUILD_TESTS
+#  include <TestHarness.h>
+#endif
+
+#include "../common/error.h"
+#include "../common/parallel.h"
+#include "../common/progress.h"
+#include "../common/rng.h"
+#include "../game/fsaplayer.h"
+#include "../game/game.h"
+#include "../game/matrixplayer.h"
+#include "../game/prisoner.h"
+#include "fsapairengine.h"
+#include "match.h"
+#include "matchplanner.h"
+#include "payoffmatrix.h"
+
+
+// The index of the pair (i, j), i <= j, in the upper triangle
+static size_t PairIndex(size_t i, size_t j, size_t size)
+{
+	return i * size - i * (i - 1) / 2 + (j - i);
+}
+
+// The bits of a score, for hashing
+static wxUint64 ScoreBits(double value)
+{
+	wxUint64 bits;
+	memcpy(&bits, &value, sizeof(wxUint64));
+	return bits;
+}
+
+
+/**
+    \brief Plays row \c i of the matrix against every player \c j >= \c i
+    
+    Each match fills in both (i, j) and (j, i), and the outcome counts
+    of the pair if they're being kept.  No two rows write to the same
+    cell, so the rows may be run on any threads.  If an engine is
+    given, every player is a machine it can play.  Progress is counted
+    in matches, and cancellation checked, a block at a time.
+*/
+class PayoffMatrixTask : public ParallelTask
+{
+public:
+	PayoffMatrixTask(const Game *g, const PlayerPtrArray &p, const MatchPlanner &pl,
+	                 const FSAPairEngine *e, std::vector<double> &m, std::vector<wxUint32> &o,
+	                 Progress *pr) :
+		game(g), players(p), planner(pl), engine(e), payoffs(m), outcomes(o), progress(pr)
+	{ }
+	
+	virtual bool Run(size_t begin, size_t end)
+	{
+		Game *localGame = game->Clone();
+		size_t size = players.GetCount();
+		
+		// Each thread plays whole blocks of the plan
+		for (size_t b = begin ; b < end ; b++)
+		{
+			if (progress && progress->IsCancelled())
+			{
+				Error::Set(_("The computation of the payoff matrix was cancelled"));
+				delete localGame;
+				return false;
+			}
+			
+			for (size_t k = planner.GetBlockBegin(b) ; k < planner.GetBlockEnd(b) ; k++)
+			{
+				size_t i = planner.GetJob(k).one, j = planner.GetJob(k).two;
+				
+				if (engine)
+				{
+					int oneScore, twoScore;
+					engine->Play(static_cast<const FSAPlayer *>(players[i]),
+					             static_cast<const FSAPlayer *>(players[j]), oneScore, twoScore,
+					             outcomes.empty() ? NULL : &outcomes[4 * PairIndex(i, j, size)]);
+					
+					payoffs[i * size + j] = oneScore;
+					payoffs[j * size + i] = twoScore;
+					continue;
+				}
+				
+				Player *one = players[i]->Clone();
+				Player *two = players[j]->Clone();
+				Match match(one, two);
+				match.SetHistoryPolicy(outcomes.empty() ? Match::HISTORY_NONE : Match::HISTORY_SUMMARY);
+				
+				bool ok = match.Play(localGame, true);
+				
+				delete one;
+				delete two;
+				
+				// Error already set in Match::Play()
+				if (!ok)
+				{
+					delete localGame;
+					return false;
+				}
+				
+				payoffs[i * size + j] = match.playerOneScore;
+				payoffs[j * size + i] = match.playerTwoScore;
+				
+				if (!outcomes.empty())
+				{
+					wxUint32 *count = &outcomes[4 * PairIndex(i, j, size)];
+					for (int m = 0 ; m < 4 ; m++)
+						count[m] = match.GetOutcomeCount(0, m / 2, m % 2);
+				}
+			}
+			
+			if (progress)
+				progress->Advance(planner.GetBlockEnd(b) - planner.GetBlockBegin(b));
+		}
+		
+		delete localGame;
+		return true;
+	}
+	
+private:
+	const Game *game;
+	const PlayerPtrArray &players;
+	const MatchPlanner &planner;
+	const FSAPairEngine *engine;
+	std::vector<double> &payoffs;
+	std::vector<wxUint32> &outcomes;
+	Progress *progress;
+};
+
+
+bool PayoffMatrix::Compute(const Game *game, const PlayerPtrArray &players, Progress *progress)
+{
+	// Imported strategies already have their scores
+	const ImportedMatrix *imported = NULL;
+	for (size_t i = 0 ; i < players.GetCount() ; i++)
+	{
+		const MatrixPlayer *player = dynamic_cast<const MatrixPlayer *>(players[i]);
+		if ((player && imported && player->GetMatrix() != imported) || (!player && imported) ||
+		    (player && !imported && i > 0))
+		{
+			Error::Set(_("Players from an imported payoff matrix can only be played against others from the same matrix"));
+			Clear();
+			return false;
+		}
+		
+		if (player)
+			imported = player->GetMatrix();
+	}
+	
+	if (imported)
+	{
+		size = players.GetCount();
+		payoffs.resize(size * size);
+		outcomes.clear();
+		
+		for (size_t i = 0 ; i < size ; i++)
+		{
+			size_t row = static_cast<const MatrixPlayer *>(players[i])->GetIndex();
+			for (size_t j = 0 ; j < size ; j++)
+				payoffs[i * size + j] = imported->Get(row, static_cast<const MatrixPlayer *>(players[j])->GetIndex());
+		}
+		
+		return true;
+	}
+	
+	// Only one machine of each canonical form has to play
+	WX_DECLARE_HASH_MAP(wxUint64, size_t, wxIntegerHash, wxIntegerEqual, HashIndex);
+	HashIndex machines;
+	PlayerPtrArray unique;
+	std::vector<size_t> uniqueOf(players.GetCount());
+	
+	for (size_t i = 0 ; i < players.GetCount() ; i++)
+	{
+		const FSAPlayer *machine = dynamic_cast<const FSAPlayer *>(players[i]);
+		if (machine)
+		{
+			HashIndex::iterator it = machines.find(machine->GetCanonicalHash());
+			if (it != machines.end())
+			{
+				uniqueOf[i] = it->second;
+				continue;
+			}
+			machines[machine->GetCanonicalHash()] = unique.GetCount();
+		}
+		
+		uniqueOf[i] = unique.GetCount();
+		unique.Add(players[i]);
+	}
+	
+	size_t numUnique = unique.GetCount();
+	bool keepOutcomes = (game->GetGameMoves().Length() == 2);
+	std::vector<double> uniquePayoffs(numUnique * numUnique, 0.0);
+	std::vector<wxUint32> uniqueOutcomes;
+	if (keepOutcomes)
+		uniqueOutcomes.assign(2 * numUnique * (numUnique + 1), 0);
+	
+	MatchPlanner planner;
+	planner.SetMinGroups(2 * Parallel::GetNumThreads());
+	planner.Plan(unique);
+	
+	// Machines can skip playing out their matches, if they all can
+	FSAPairEngine engine;
+	bool direct = engine.SetGame(game);
+	for (size_t u = 0 ; u < numUnique && direct ; u++)
+	{
+		const FSAPlayer *machine = dynamic_cast<const FSAPlayer *>(unique[u]);
+		direct = (machine && engine.CanPlay(machine));
+	}
+	
+	if (progress)
+		progress->Start(planner.GetNumJobs());
+	
+	PayoffMatrixTask task(game, unique, planner, direct ? &engine : NULL, uniquePayoffs, uniqueOutcomes,
+	                      progress);
+	if (!Parallel::For(planner.GetNumBlocks(), &task, 1))
+	{
+		Clear();
+		return false;
+	}
+	
+	// Copy the scores out to every player
+	size = players.GetCount();
+	payoffs.resize(size * size);
+	outcomes.clear();
+	if (keepOutcomes)
+		outcomes.resize(2 * size * (size + 1));
+	
+	for (size_t i = 0 ; i < size ; i++)
+	{
+		for (size_t j = 0 ; j < size ; j++)
+			payoffs[i * size + j] = uniquePayoffs[uniqueOf[i] * numUnique + uniqueOf[j]];
+		
+		if (!keepOutcomes)
+			continue;
+		
+		for (size_t j = i ; j < size ; j++)
+		{
+			size_t u = uniqueOf[i], v = uniqueOf[j];
+			wxUint32 *count = &outcomes[4 * PairIndex(i, j, size)];
+			
+			// The counts are kept from the first player's side, so CD
+			// and DC swap places if the pair is the other way around
+			if (u <= v)
+			{
+				const wxUint32 *from = &uniqueOutcomes[4 * PairIndex(u, v, numUnique)];
+				for (int m = 0 ; m < 4 ; m++)
+					count[m] = from[m];
+			}
+			else
+			{
+				const wxUint32 *from = &uniqueOutcomes[4 * PairIndex(v, u, numUnique)];
+				count[0] = from[0];
+				count[1] = from[2];
+				count[2] = from[1];
+				count[3] = from[3];
+			}
+		}
+	}
+	
+	return true;
+}
+
+size_t PayoffMatrix::FindTypes(std::vector<size_t> &typeOf) const
+{
+	// Players of a type have the same row and column, so hash those to
+	// find the candidates, and then check them
+	typedef std::map<wxUint64, std::vector<size_t> > BucketMap;
+	BucketMap buckets;
+	std::vector<size_t> firstOfType;
+	
+	typeOf.resize(size);
+	for (size_t i = 0 ; i < size ; i++)
+	{
+		wxUint64 hash = Random::Hash(size);
+		for (size_t j = 0 ; j < size ; j++)
+		{
+			hash = Random::Hash(hash ^ Random::Hash(ScoreBits(payoffs[i * size + j])));
+			hash = Random::Hash(hash ^ ScoreBits(payoffs[j * size + i]));
+		}
+		
+		std::vector<size_t> &bucket = buckets[hash];
+		size_t b;
+		for (b = 0 ; b < bucket.size() ; b++)
+		{
+			size_t t = bucket[b], first = firstOfType[t];
+			size_t j;
+			for (j = 0 ; j < size ; j++)
+				if (payoffs[i * size + j] != payoffs[first * size + j] ||
+				    payoffs[j * size + i] != payoffs[j * size + first])
+					break;
+			
+			if (j == size)
+				break;
+		}
+		
+		if (b < bucket.size())
+			typeOf[i] = bucket[b];
+		else
+		{
+			typeOf[i] = firstOfType.size();
+			bucket.push_back(firstOfType.size());
+			firstOfType.push_back(i);
+		}
+	}
+	
+	return firstOfType.size();
+}
+
+bool PayoffMatrix::Rescore(const PayoffTable &table)
+{
+	if (!HasOutcomes())
+	{
+		Error::Set(_("The payoff matrix can only be rescored for a two-move game"));
+		return false;
+	}
+	
+	for (size_t i = 0 ; i < size ; i++)
+	{
+		for (size_t j = i ; j < size ; j++)
+		{
+			const wxUint32 *count = &outcomes[4 * PairIndex(i, j, size)];
+			
+			payoffs[i * size + j] = (double)count[0] * table.reward + (double)count[1] * table.sucker +
+			                        (double)count[2] * table.temptation + (double)count[3] * table.punishment;
+			payoffs[j * size + i] = (double)count[0] * table.reward + (double)count[1] * table.temptation +
+			                        (double)count[2] * table.sucker + (double)count[3] * table.punishment;
+		}
+	}
+	
+	return true;
+}
+
+
+/** \cond TEST */
+#ifdef BUILD_TESTS
+
+TEST(PayoffMatrix, Compute)
+{
+	MockGame game;
+	MockPlayer p1, p2, p3;
+	PlayerPtrArray players;
+	
+	p1.nextMove = p2.nextMove = p3.nextMove = wxT('C');
+	players.Add(&p1);
+	players.Add(&p2);
+	players.Add(&p3);
+	
+	PayoffMatrix matrix;
+	CHECK(matrix.Compute(&game, players));
+	CHECK_EQUAL(3, (int)matrix.GetSize());
+	
+	// In the mock game, the first player always earns one point per turn
+	for (size_t i = 0 ; i < 3 ; i++)
+	{
+		for (size_t j = 0 ; j < 3 ; j++)
+		{
+			if (i < j)
+				CHECK_EQUAL(200.0, matrix.Get(i, j));
+			else if (i > j)
+				CHECK_EQUAL(0.0, matrix.Get(i, j));
+		}
+	}
+	
+	// Progress is counted in matches, and the matches can be cancelled
+	Progress progress;
+	CHECK(matrix.Compute(&game, players, &progress));
+	CHECK_EQUAL(6, (int)progress.GetDone());
+	CHECK_EQUAL(6, (int)progress.GetTotal());
+	
+	progress.Cancel();
+	CHECK(!matrix.Compute(&game, players, &progress));
+	CHECK(!Error::Get().IsEmpty());
+	CHECK_EQUAL(0, (int)matrix.GetSize());
+}
+
+TEST(PayoffMatrix, Rescore)
+{
+	PrisonerDilemma game, stagHunt(PayoffTable(3, 4, 2, 0));
+	MockPlayer p1, p2;
+	PlayerPtrArray players;
+	
+	p1.nextMove = wxT('C');
+	p2.nextMove = wxT('D');
+	players.Add(&p1);
+	players.Add(&p2);
+	
+	// Rescoring gives the matrix we'd get by playing the new game
+	PayoffMatrix matrix, direct;
+	CHECK(matrix.Compute(&game, players));
+	CHECK(matrix.HasOutcomes());
+	CHECK(matrix.Rescore(PayoffTable(3, 4, 2, 0)));
+	CHECK(direct.Compute(&stagHunt, players));
+	
+	for (size_t i = 0 ; i < 2 ; i++)
+		for (size_t j = 0 ; j < 2 ; j++)
+			CHECK_EQUAL(direct.Get(i, j), matrix.Get(i, j));
+	CHECK_EQUAL(600.0, matrix.Get(1, 0));
+	
+	matrix.Clear();
+	CHECK(!matrix.Rescore(PayoffTable()));
+}
+
+TEST(PayoffMatrix, Types)
+{
+	PrisonerDilemma game;
+	FSAPlayer allc, padded, alld;
+	MockPlayer mock;
+	PlayerPtrArray players;
+	
+	// The padded All-C has the same canonical form as All-C, and the
+	// mock player always cooperates too, so it scores the same
+	CHECK(allc.LoadFromString(&game, wxT("Charles Pence\nAll-C\n1\nC, 0, 0")));
+	CHECK(padded.LoadFromString(&game, wxT("Charles Pence\nPadded All-C\n2\nC, 0, 0\nD, 1, 1")));
+	CHECK(alld.LoadFromString(&game, wxT("Charles Pence\nAll-D\n1\nD, 0, 0")));
+	mock.nextMove = wxT('C');
+	players.Add(&allc);
+	players.Add(&alld);
+	players.Add(&padded);
+	players.Add(&mock);
+	
+	PayoffMatrix matrix;
+	CHECK(matrix.Compute(&game, players));
+	for (size_t j = 0 ; j < 4 ; j++)
+		CHECK_EQUAL(matrix.Get(0, j), matrix.Get(2, j));
+	
+	std::vector<size_t> typeOf;
+	CHECK_EQUAL(2, (int)matrix.FindTypes(typeOf));
+	CHECK_EQUAL(0, (int)typeOf[0]);
+	CHECK_EQUAL(1, (int)typeOf[1]);
+	CHECK_EQUAL(0, (int)typeOf[2]);
+	CHECK_EQUAL(0, (int)typeOf[3]);
+	
+	// Copying the outcomes around still rescores properly
+	PrisonerDilemma stagHunt(PayoffTable(3, 4, 2, 0));
+	PayoffMatrix direct;
+	CHECK(matrix.Rescore(PayoffTable(3, 4, 2, 0)));
+	CHECK(direct.Compute(&stagHunt, players));
+	for (size_t i = 0 ; i < 4 ; i++)
+		for (size_t j = 0 ; j < 4 ; j++)
+			CHECK_EQUAL(direct.Get(i, j), matrix.Get(i, j));
+}
+
+#endif
+/** \endcond */
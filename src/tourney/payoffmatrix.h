@@ -0,0 +1,179 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TOURNEY_PAYOFFMATRIX_H__
+#define TOURNEY_PAYOFFMATRIX_H__
+
+#include <vector>
+
+#include "../game/player.h"
+class Game;
+class Progress;
+struct PayoffTable;
+
+
+/**
+    \class PayoffMatrix
+    \ingroup tourney
+    
+    \brief The match scores of every pair of players in a list
+    
+    Entry <tt>(i, j)</tt> of the matrix is the score that player \c i earns
+    in a (quick) match against player \c j.  Since matches between
+    deterministic players always come out the same, population models
+    (such as \c LatticeTournament) compute this matrix once, and then
+    never play another match.  The matches are played in parallel (see
+    \c Parallel::For), a block of a \c MatchPlanner at a time.
+    
+    Finite state machines with the same canonical form (see
+    \c FSAPlayer::CanonicalHash) always play the same way, so only one
+    of them plays its matches, and the others are given copies of its
+    scores.
+*/
+class PayoffMatrix
+{
+public:
+	/**
+	    \brief Constructor
+	    
+	    Creates an empty matrix.
+	*/
+	PayoffMatrix() : size(0) { }
+	
+	/**
+	    \brief Play every pair of players and fill in the matrix
+	    
+	    If every player is a machine the \c FSAPairEngine can play,
+	    the matches are worked out by the engine rather than played.
+	    Players imported from a payoff matrix (see \c MatrixPlayer)
+	    aren't played; their scores are copied from the matrix.  They
+	    can only be mixed with other players from the same matrix.
+	    
+	    \param game The game to be played
+	    \param players The players (who will not be modified)
+	    \param progress If not \c NULL, counts the matches played and
+	                    may be used to cancel the computation (checked
+	                    after each block of the plan)
+	    \returns True if every match was played, false otherwise
+	*/
+	bool Compute(const Game *game, const PlayerPtrArray &players, Progress *progress = NULL);
+	
+	/**
+	    \brief Refill the matrix for different payoffs
+	    
+	    Compute() keeps the number of times each pair of moves came up
+	    in each match of a two-move game, so the matrix can be rebuilt
+	    for any other payoffs without playing the matches again.
+	    
+	    \param table The new payoffs
+	    \returns True if the matrix was rebuilt, false if there are no
+	             outcome counts to rebuild it from
+	*/
+	bool Rescore(const PayoffTable &table);
+	
+	/**
+	    \brief Can the matrix be rebuilt by Rescore()?
+	    \returns True if the outcome counts were kept
+	*/
+	bool HasOutcomes() const { return size && outcomes.size() == 2 * size * (size + 1); }
+	
+	/**
+	    \brief Sort the players into types which do equally well
+	    
+	    Two players are the same type if they earn the same score
+	    against every player, and every player earns the same score
+	    against them.  Population models can then treat all the players
+	    of a type as one.  Types are numbered in order of their first
+	    player.
+	    
+	    \param[out] typeOf The type of each player
+	    \returns The number of types
+	*/
+	size_t FindTypes(std::vector<size_t> &typeOf) const;
+	
+	/**
+	    \brief Fill in the matrix from saved values
+	    
+	    \param newSize The number of players
+	    \param values The matrix, row by row (\p newSize squared values)
+	*/
+	void Assign(size_t newSize, const double *values)
+	{
+		size = newSize;
+		payoffs.assign(values, values + size * size);
+		outcomes.clear();
+	}
+	
+	/**
+	    \brief Empty the matrix
+	*/
+	void Clear()
+	{
+		payoffs.clear();
+		outcomes.clear();
+		size = 0;
+	}
+	
+	/**
+	    \brief Get the number of players (rows and columns)
+	    \returns Size of the matrix
+	*/
+	size_t GetSize() const { return size; }
+	
+	/**
+	    \brief Get the score of one player against another
+	    
+	    \param i Index of the scoring player
+	    \param j Index of the opponent
+	    \returns Score of player \p i against player \p j
+	*/
+	double Get(size_t i, size_t j) const { return payoffs[i * size + j]; }
+	
+	/**
+	    \brief Get a row of the matrix
+	    
+	    \param i Index of the scoring player
+	    \returns Pointer to the scores of player \p i against every player
+	*/
+	const double *GetRow(size_t i) const { return &payoffs[i * size]; }
+
+private:
+	/**
+	    \brief The matrix, in row-major order
+	*/
+	std::vector<double> payoffs;
+	
+	/**
+	    \brief Counts of CC, CD, DC and DD in each match, for every
+	           pair <tt>i <= j</tt> in turn, from player \c i's side
+	*/
+	std::vector<wxUint32> outcomes;
+	
+	/**
+	    \brief The number of rows (and columns)
+	*/
+	size_t size;
+};
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,805 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#include <wx/textfile.h>
+#include <wx/tokenzr.h>
+
+#include <algorithm>
+#include <map>
+#include <math.h>
+
+#ifdef BUILD_TESTS
+#  include <TestHarness.h>
+#  include "../game/prisoner.h"
+#  include "../game/fsaplayer.h"
+#  include "tournament.h"
+#endif
+
+#include "../common/error.h"
+#include "../common/outputfile.h"
+#include "../common/parallel.h"
+#include "../common/progress.h"
+#include "../common/rng.h"
+#include "../game/game.h"
+#include "match.h"
+#include "sweep.h"
+
+
+/**
+    \brief Plays the matches shared by every point at one noise level
+           and continuation probability
+    
+    For each pair of players, the number of turns on which each pair of
+    moves (CC, CD, DC, DD) came up is added to \c counts.  Every pair
+    writes only its own counts, so the pairs may be run on any threads.
+*/
+class SweepTask : public ParallelTask
+{
+public:
+	SweepTask(const Game *g, const PlayerPtrArray &p,
+	          const std::vector<std::pair<size_t, size_t> > &pr,
+	          double n, double c, wxUint64 k, Progress *prog, std::vector<double> &cnt) :
+		game(g), players(p), pairs(pr), noise(n), continuation(c), key(k),
+		progress(prog), counts(cnt)
+	{ }
+	
+	virtual bool Run(size_t begin, size_t end)
+	{
+		Game *localGame = game->Clone();
+		localGame->SetNoise(noise);
+		
+		for (size_t k = begin ; k < end ; k++)
+		{
+			if (progress && progress->IsCancelled())
+			{
+				Error::Set(_("The sweep was cancelled"));
+				delete localGame;
+				return false;
+			}
+			
+			size_t i = pairs[k].first, j = pairs[k].second;
+			Player *one = players[i]->Clone();
+			Player *two = players[j]->Clone();
+			
+			// Each pair gets the same substream at every setting
+			wxUint64 seed = Random::Hash(key ^ Random::Hash(((wxUint64)i << 32) | j));
+			Match match(one, two, seed ? seed : 1);
+			match.SetHistoryPolicy(Match::HISTORY_SUMMARY);
+			match.SetContinuation(continuation);
+			
+			bool ok = match.Play(localGame);
+			
+			delete one;
+			delete two;
+			
+			// Error already set in Match::Play()
+			if (!ok)
+			{
+				delete localGame;
+				return false;
+			}
+			
+			for (int g = 0 ; g < match.GetNumGames() ; g++)
+			{
+				for (int m = 0 ; m < 4 ; m++)
+					counts[k * 4 + m] += match.GetOutcomeCount(g, m / 2, m % 2);
+			}
+			
+			if (progress)
+				progress->Advance();
+		}
+		
+		delete localGame;
+		return true;
+	}
+	
+private:
+	const Game *game;
+	const PlayerPtrArray &players;
+	const std::vector<std::pair<size_t, size_t> > &pairs;
+	double noise;
+	double continuation;
+	wxUint64 key;
+	Progress *progress;
+	std::vector<double> &counts;
+};
+
+
+Sweep::Sweep(Game *gm) : numMatches(0), seed(0), game(gm)
+{ }
+
+Sweep::~Sweep()
+{
+	for (size_t i = 0 ; i < players.GetCount() ; i++)
+		delete players[i];
+	players.Clear();
+}
+
+
+void Sweep::AddPlayer(const Player *player)
+{
+	players.Add(player->Clone());
+}
+
+size_t Sweep::AddRoster(const std::vector<size_t> &roster)
+{
+	std::vector<size_t> sorted(roster);
+	std::sort(sorted.begin(), sorted.end());
+	sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+	
+	rosters.push_back(sorted);
+	return rosters.size();
+}
+
+std::vector<size_t> Sweep::GetRoster(size_t roster) const
+{
+	if (roster)
+		return rosters[roster - 1];
+	
+	std::vector<size_t> everyone(players.GetCount());
+	for (size_t i = 0 ; i < everyone.size() ; i++)
+		everyone[i] = i;
+	return everyone;
+}
+
+void Sweep::AddPoint(const SweepPoint &point)
+{
+	points.push_back(point);
+}
+
+
+bool Sweep::Load(const wxString &fileName)
+{
+	wxTextFile file;
+	
+	if (!file.Open(fileName))
+	{
+		Error::Set(wxString::Format(_("Could not open file %s"), fileName.c_str()));
+		return false;
+	}
+	
+	wxArrayString lines;
+	for (size_t i = 0 ; i < file.GetLineCount() ; i++)
+		lines.Add(file[i]);
+	
+	file.Close();
+	
+	return DoLoad(lines);
+}
+
+bool Sweep::LoadFromString(const wxString &spec)
+{
+	wxStringTokenizer tokenizer(spec, "\n", wxTOKEN_RET_EMPTY_ALL);
+	wxArrayString lines;
+	
+	while (tokenizer.HasMoreTokens())
+		lines.Add(tokenizer.GetNextToken());
+	
+	return DoLoad(lines);
+}
+
+bool Sweep::ParseValues(const wxString &str, std::vector<double> &values)
+{
+	wxStringTokenizer tokenizer(str, wxT(","));
+	
+	while (tokenizer.HasMoreTokens())
+	{
+		wxString token = tokenizer.GetNextToken();
+		token.Trim(true).Trim(false);
+		
+		// A range, from:to:step
+		if (token.Find(wxT(':')) != wxNOT_FOUND)
+		{
+			wxString from = token.BeforeFirst(wxT(':'));
+			wxString to = token.AfterFirst(wxT(':')).BeforeFirst(wxT(':'));
+			wxString step = token.AfterFirst(wxT(':')).AfterFirst(wxT(':'));
+			double a, b, h;
+			
+			if (!from.Trim(true).Trim(false).ToCDouble(&a) ||
+			    !to.Trim(true).Trim(false).ToCDouble(&b) ||
+			    !step.Trim(true).Trim(false).ToCDouble(&h) || h <= 0.0 || b < a)
+				return false;
+			
+			// Allow for roundoff in the last step
+			int count = (int)floor((b - a) / h + 1e-9);
+			for (int i = 0 ; i <= count ; i++)
+				values.push_back(a + i * h);
+			continue;
+		}
+		
+		double value;
+		if (!token.ToCDouble(&value))
+			return false;
+		values.push_back(value);
+	}
+	
+	return !values.empty();
+}
+
+bool Sweep::ParseRoster(const wxString &str, std::vector<size_t> &roster)
+{
+	wxStringTokenizer tokenizer(str, wxT(", \t"), wxTOKEN_STRTOK);
+	
+	while (tokenizer.HasMoreTokens())
+	{
+		wxString token = tokenizer.GetNextToken();
+		wxString from = token.BeforeFirst(wxT('-'));
+		wxString to = (token.Find(wxT('-')) != wxNOT_FOUND) ? token.AfterFirst(wxT('-')) : from;
+		unsigned long a, b;
+		
+		if (!from.ToULong(&a) || !to.ToULong(&b) || a < 1 || b < a)
+			return false;
+		
+		for (unsigned long i = a ; i <= b ; i++)
+			roster.push_back(i - 1);
+	}
+	
+	return !roster.empty();
+}
+
+bool Sweep::DoLoad(const wxArrayString &lines)
+{
+	// The grid, as given so far.  An empty list takes the default.
+	static const char *gridNames[6] = { "T", "R", "P", "S", "noise", "continuation" };
+	std::vector<double> grid[6];
+	std::vector<size_t> gridRosters;
+	bool hasGrid = false;
+	std::vector<SweepPoint> listed;
+	
+	for (size_t l = 0 ; l < lines.GetCount() ; l++)
+	{
+		wxString line = lines[l].BeforeFirst(wxT('#'));
+		line.Trim(true).Trim(false);
+		if (line.IsEmpty())
+			continue;
+		
+		wxString error;
+		wxString point;
+		
+		if (line.StartsWith(wxT("point"), &point) && (point.IsEmpty() || wxIsspace(point[0])))
+		{
+			// A single point, with key=value pairs
+			SweepPoint p;
+			wxStringTokenizer tokenizer(point, wxT(" \t"), wxTOKEN_STRTOK);
+			
+			while (tokenizer.HasMoreTokens() && error.IsEmpty())
+			{
+				wxString token = tokenizer.GetNextToken();
+				wxString key = token.BeforeFirst(wxT('='));
+				wxString value = token.AfterFirst(wxT('='));
+				double *fields[6] = { &p.temptation, &p.reward, &p.punishment, &p.sucker,
+				                      &p.noise, &p.continuation };
+				
+				if (key == wxT("roster"))
+				{
+					std::vector<size_t> roster;
+					if (value == wxT("all"))
+						p.roster = 0;
+					else if (ParseRoster(value, roster))
+						p.roster = AddRoster(roster);
+					else
+						error = wxString::Format(_("the roster \"%s\" is not a list of player numbers"), value.c_str());
+					continue;
+				}
+				
+				int field = -1;
+				for (int f = 0 ; f < 6 ; f++)
+				{
+					if (key == wxString(gridNames[f]))
+						field = f;
+				}
+				
+				if (field < 0)
+					error = wxString::Format(_("unknown setting \"%s\""), key.c_str());
+				else if (!value.ToCDouble(fields[field]))
+					error = wxString::Format(_("the value of %s is not a number"), key.c_str());
+			}
+			
+			if (error.IsEmpty())
+				listed.push_back(p);
+		}
+		else if (line.Find(wxT('=')) != wxNOT_FOUND)
+		{
+			wxString key = line.BeforeFirst(wxT('=')).Trim(true);
+			wxString value = line.AfterFirst(wxT('=')).Trim(false);
+			
+			int field = -1;
+			for (int f = 0 ; f < 6 ; f++)
+			{
+				if (key == wxString(gridNames[f]))
+					field = f;
+			}
+			
+			if (key == wxT("seed"))
+			{
+				unsigned long number;
+				if (value.ToULong(&number))
+					seed = number;
+				else
+					error = _("the seed is not a number");
+			}
+			else if (key == wxT("roster"))
+			{
+				std::vector<size_t> roster;
+				if (value == wxT("all"))
+					gridRosters.push_back(0);
+				else if (ParseRoster(value, roster))
+					gridRosters.push_back(AddRoster(roster));
+				else
+					error = wxString::Format(_("the roster \"%s\" is not a list of player numbers"), value.c_str());
+				hasGrid = true;
+			}
+			else if (field < 0)
+				error = wxString::Format(_("unknown setting \"%s\""), key.c_str());
+			else if (!ParseValues(value, grid[field]))
+				error = wxString::Format(_("the values of %s are not a list of numbers"), key.c_str());
+			else
+				hasGrid = true;
+		}
+		else
+			error = _("doesn't have the correct syntax (expected \"setting = values\" or \"point ...\")");
+		
+		if (!error.IsEmpty())
+		{
+			Error::Set(wxString::Format(_("Sweep specification, line %d: %s"), (int)l + 1, error.c_str()));
+			return false;
+		}
+	}
+	
+	if (hasGrid)
+	{
+		// Fill in the defaults, and then take every combination
+		SweepPoint defaults;
+		double defaultValues[6] = { defaults.temptation, defaults.reward, defaults.punishment,
+		                            defaults.sucker, defaults.noise, defaults.continuation };
+		for (int f = 0 ; f < 6 ; f++)
+		{
+			if (grid[f].empty())
+				grid[f].push_back(defaultValues[f]);
+		}
+		if (gridRosters.empty())
+			gridRosters.push_back(0);
+		
+		size_t total = gridRosters.size();
+		for (int f = 0 ; f < 6 ; f++)
+			total *= grid[f].size();
+		
+		for (size_t n = 0 ; n < total ; n++)
+		{
+			SweepPoint p;
+			size_t rest = n;
+			double *fields[6] = { &p.temptation, &p.reward, &p.punishment, &p.sucker,
+			                      &p.noise, &p.continuation };
+			
+			// The last setting varies fastest
+			p.roster = gridRosters[rest % gridRosters.size()];
+			rest /= gridRosters.size();
+			for (int f = 5 ; f >= 0 ; f--)
+			{
+				*fields[f] = grid[f][rest % grid[f].size()];
+				rest /= grid[f].size();
+			}
+			
+			points.push_back(p);
+		}
+	}
+	
+	points.insert(points.end(), listed.begin(), listed.end());
+	
+	return true;
+}
+
+
+bool Sweep::CheckPoint(const SweepPoint &point) const
+{
+	int number = (int)(&point - &points[0]) + 1;
+	
+	if (point.roster > rosters.size())
+	{
+		Error::Set(wxString::Format(_("Sweep point %d has an invalid roster"), number));
+		return false;
+	}
+	
+	std::vector<size_t> roster = GetRoster(point.roster);
+	if (roster.empty() || roster.back() >= players.GetCount())
+	{
+		Error::Set(wxString::Format(_("Sweep point %d uses players who haven't been added"), number));
+		return false;
+	}
+	
+	if (!(point.noise >= 0.0 && point.noise <= 1.0))
+	{
+		Error::Set(wxString::Format(_("Sweep point %d: the noise must be between zero and one"), number));
+		return false;
+	}
+	
+	if (!(point.continuation >= 0.0 && point.continuation < 1.0))
+	{
+		Error::Set(wxString::Format(_("Sweep point %d: the continuation probability must be at least zero and less than one"), number));
+		return false;
+	}
+	
+	return true;
+}
+
+bool Sweep::Run(Progress *progress)
+{
+	size_t numPlayers = players.GetCount();
+	if (!numPlayers)
+	{
+		Error::Set(_("Add at least one player to the sweep"));
+		return false;
+	}
+	if (game->GetGameMoves().Length() != 2)
+	{
+		Error::Set(_("Sweeps can only be run for two-move games"));
+		return false;
+	}
+	
+	for (size_t p = 0 ; p < points.size() ; p++)
+	{
+		if (!CheckPoint(points[p]))
+			return false;
+	}
+	
+	scores.assign(points.size() * numPlayers, 0.0);
+	turns.assign(points.size() * numPlayers, 0.0);
+	numMatches = 0;
+	
+	wxUint64 key = seed;
+	if (!key)
+		key = ((wxUint64)Random::Generate() << 32) | Random::Generate();
+	
+	// Points at the same noise level and continuation probability play
+	// the same matches
+	typedef std::map<std::pair<double, double>, std::vector<size_t> > GroupMap;
+	GroupMap groups;
+	for (size_t p = 0 ; p < points.size() ; p++)
+		groups[std::make_pair(points[p].noise, points[p].continuation)].push_back(p);
+	
+	// Find the pairs of players each group needs, so that we know how
+	// many matches there are in all
+	std::vector<std::vector<std::pair<size_t, size_t> > > groupPairs;
+	std::vector<std::vector<size_t> > groupIndex;
+	std::vector<size_t> groupUsed;
+	size_t total = 0;
+	
+	for (GroupMap::iterator it = groups.begin() ; it != groups.end() ; ++it)
+	{
+		std::vector<bool> used(numPlayers, false);
+		for (size_t p = 0 ; p < it->second.size() ; p++)
+		{
+			std::vector<size_t> roster = GetRoster(points[it->second[p]].roster);
+			for (size_t i = 0 ; i < roster.size() ; i++)
+				used[roster[i]] = true;
+		}
+		
+		// Index the pairs by player, so the scoring can find them
+		std::vector<size_t> index(numPlayers, 0);
+		std::vector<std::pair<size_t, size_t> > pairs;
+		size_t numUsed = 0;
+		for (size_t i = 0 ; i < numPlayers ; i++)
+		{
+			if (used[i])
+				index[i] = numUsed++;
+		}
+		for (size_t i = 0 ; i < numPlayers ; i++)
+		{
+			for (size_t j = i ; j < numPlayers ; j++)
+			{
+				if (used[i] && used[j])
+					pairs.push_back(std::make_pair(i, j));
+			}
+		}
+		
+		groupPairs.push_back(pairs);
+		groupIndex.push_back(index);
+		groupUsed.push_back(numUsed);
+		total += pairs.size();
+	}
+	
+	if (progress)
+		progress->Start(total);
+	
+	size_t g = 0;
+	for (GroupMap::iterator it = groups.begin() ; it != groups.end() ; ++it, g++)
+	{
+		const std::vector<std::pair<size_t, size_t> > &pairs = groupPairs[g];
+		const std::vector<size_t> &index = groupIndex[g];
+		size_t numUsed = groupUsed[g];
+		std::vector<double> counts(pairs.size() * 4, 0.0);
+		
+		SweepTask task(game, players, pairs, it->first.first, it->first.second, key, progress, counts);
+		if (!Parallel::For(pairs.size(), &task, 1))
+			return false;
+		numMatches += pairs.size();
+		
+		// Score every point from the counts
+		for (size_t p = 0 ; p < it->second.size() ; p++)
+		{
+			size_t point = it->second[p];
+			const SweepPoint &sp = points[point];
+			std::vector<size_t> roster = GetRoster(sp.roster);
+			
+			// Payoffs for CC, CD, DC and DD, to each of the two players
+			double payOne[4] = { sp.reward, sp.sucker, sp.temptation, sp.punishment };
+			double payTwo[4] = { sp.reward, sp.temptation, sp.sucker, sp.punishment };
+			
+			double *score = &scores[point * numPlayers];
+			double *turn = &turns[point * numPlayers];
+			
+			for (size_t a = 0 ; a < roster.size() ; a++)
+			{
+				for (size_t b = a ; b < roster.size() ; b++)
+				{
+					// The pairs are listed row by row of the upper
+					// triangle, over the players used
+					size_t i = index[roster[a]], j = index[roster[b]];
+					size_t k = i * numUsed - i * (i - 1) / 2 + (j - i);
+					const double *c = &counts[k * 4];
+					double length = c[0] + c[1] + c[2] + c[3];
+					
+					score[roster[a]] += c[0] * payOne[0] + c[1] * payOne[1] + c[2] * payOne[2] + c[3] * payOne[3];
+					score[roster[b]] += c[0] * payTwo[0] + c[1] * payTwo[1] + c[2] * payTwo[2] + c[3] * payTwo[3];
+					turn[roster[a]] += length;
+					turn[roster[b]] += length;
+				}
+			}
+		}
+	}
+	
+	return true;
+}
+
+
+bool Sweep::Write(const wxString &fileName) const
+{
+	size_t numPlayers = players.GetCount();
+	if (scores.size() != points.size() * numPlayers)
+	{
+		Error::Set(_("The sweep has not been run"));
+		return false;
+	}
+	
+	OutputFile out;
+	if (!out.Open(fileName))
+		return false;
+	
+	const wxString columns[] = 
+	{ _("Point"), wxT("T"), wxT("R"), wxT("P"), wxT("S"), _("Noise"), _("Continuation"),
+	  _("Roster"), _("Player Name"), _("Player Author"), _("Score"), _("Score per Turn"),
+	  _("Rank") };
+	size_t numColumns = sizeof(columns) / sizeof(columns[0]);
+	
+	for (size_t c = 0 ; c < numColumns ; c++)
+	{
+		out.Write(columns[c]);
+		if (c == numColumns - 1)
+			out.EndLine();
+		else
+			out.Write(',');
+	}
+	
+	for (size_t p = 0 ; p < points.size() ; p++)
+	{
+		const SweepPoint &sp = points[p];
+		std::vector<size_t> roster = GetRoster(sp.roster);
+		const double *score = &scores[p * numPlayers];
+		
+		for (size_t r = 0 ; r < roster.size() ; r++)
+		{
+			size_t i = roster[r];
+			
+			// Rank one is the winner, and ties share a rank
+			int rank = 1;
+			for (size_t s = 0 ; s < roster.size() ; s++)
+			{
+				if (score[roster[s]] > score[i])
+					rank++;
+			}
+			
+			out.WriteInt(p + 1);
+			out.Write(',');
+			out.WriteFloat(sp.temptation);
+			out.Write(',');
+			out.WriteFloat(sp.reward);
+			out.Write(',');
+			out.WriteFloat(sp.punishment);
+			out.Write(',');
+			out.WriteFloat(sp.sucker);
+			out.Write(',');
+			out.WriteFloat(sp.noise);
+			out.Write(',');
+			out.WriteFloat(sp.continuation);
+			out.Write(',');
+			out.WriteInt(sp.roster);
+			out.Write(',');
+			out.Write(players[i]->GetPlayerName());
+			out.Write(',');
+			out.Write(players[i]->GetPlayerAuthor());
+			out.Write(',');
+			out.WriteFloat(score[i]);
+			out.Write(',');
+			out.WriteFloat(GetNumTurns(p, i) ? score[i] / GetNumTurns(p, i) : 0.0);
+			out.Write(',');
+			out.WriteInt(rank);
+			out.EndLine();
+		}
+	}
+	
+	return out.Close();
+}
+
+
+
+/** \cond TEST */
+#ifdef BUILD_TESTS
+
+static const wxString test_sweep_tft("Charles Pence\nTit-for-Tat\n2\nC, 0, 1\nD, 0, 1");
+static const wxString test_sweep_allc("Charles Pence\nAll-C\n1\nC, 0, 0");
+static const wxString test_sweep_alld("Charles Pence\nAll-D\n1\nD, 0, 0");
+
+TEST(Sweep, Parse)
+{
+	PrisonerDilemma game;
+	Sweep sweep(&game);
+	
+	CHECK(sweep.LoadFromString(wxT("# Vary the temptation\n"
+	                               "T = 4:6:1\n"
+	                               "noise = 0, 0.01   # with and without noise\n"
+	                               "roster = all\n"
+	                               "roster = 1-2, 4\n"
+	                               "\n"
+	                               "point T=7 S=-1 roster=2,3\n")));
+	CHECK_EQUAL(13, (int)sweep.GetNumPoints());
+	
+	// The last setting varies fastest
+	CHECK_EQUAL(4.0, sweep.GetPoint(0).temptation);
+	CHECK_EQUAL(0.0, sweep.GetPoint(0).noise);
+	CHECK_EQUAL(0, (int)sweep.GetPoint(0).roster);
+	CHECK_EQUAL(1, (int)sweep.GetPoint(1).roster);
+	CHECK_EQUAL(0.01, sweep.GetPoint(2).noise);
+	CHECK_EQUAL(6.0, sweep.GetPoint(11).temptation);
+	CHECK_EQUAL(3.0, sweep.GetPoint(11).reward);
+	
+	std::vector<size_t> roster = sweep.GetRoster(1);
+	CHECK_EQUAL(3, (int)roster.size());
+	CHECK_EQUAL(3, (int)roster[2]);
+	
+	const SweepPoint &last = sweep.GetPoint(12);
+	CHECK_EQUAL(7.0, last.temptation);
+	CHECK_EQUAL(-1.0, last.sucker);
+	CHECK_EQUAL(2, (int)last.roster);
+	
+	// Errors give the line number
+	Sweep bad(&game);
+	CHECK(!bad.LoadFromString(wxT("T = 5\nX = 3\n")));
+	CHECK(Error::Get().Find(wxT("line 2")) != wxNOT_FOUND);
+	CHECK(!bad.LoadFromString(wxT("T = 5, five\n")));
+	CHECK(!bad.LoadFromString(wxT("roster = 0\n")));
+}
+
+TEST(Sweep, SharedMatches)
+{
+	PrisonerDilemma game;
+	FSAPlayer tft, allc, alld;
+	Sweep sweep(&game);
+	Tournament tourney(&game), pair(&game);
+	
+	CHECK(tft.LoadFromString(&game, test_sweep_tft));
+	CHECK(allc.LoadFromString(&game, test_sweep_allc));
+	CHECK(alld.LoadFromString(&game, test_sweep_alld));
+	sweep.AddPlayer(&tft);
+	sweep.AddPlayer(&allc);
+	sweep.AddPlayer(&alld);
+	tourney.AddPlayer(&tft);
+	tourney.AddPlayer(&allc);
+	tourney.AddPlayer(&alld);
+	pair.AddPlayer(&allc);
+	pair.AddPlayer(&alld);
+	
+	CHECK(sweep.LoadFromString(wxT("T = 4:6:0.5\nR = 3, 2\nroster = all\nroster = 2, 3\n")));
+	CHECK_EQUAL(20, (int)sweep.GetNumPoints());
+	CHECK(sweep.Run());
+	
+	// Only the payoffs and rosters change, so every match is only
+	// played once
+	CHECK_EQUAL(6, (int)sweep.GetNumMatchesPlayed());
+	
+	// The standard payoffs give the same scores as a tournament
+	CHECK(tourney.Run());
+	CHECK(pair.Run());
+	for (size_t p = 0 ; p < sweep.GetNumPoints() ; p++)
+	{
+		const SweepPoint &sp = sweep.GetPoint(p);
+		if (sp.temptation != 5.0 || sp.reward != 3.0)
+			continue;
+		
+		if (sp.roster == 0)
+		{
+			CHECK_EQUAL((double)tourney.scores[tft.GetID()], sweep.GetScore(p, 0));
+			CHECK_EQUAL((double)tourney.scores[allc.GetID()], sweep.GetScore(p, 1));
+			CHECK_EQUAL((double)tourney.scores[alld.GetID()], sweep.GetScore(p, 2));
+		}
+		else
+		{
+			CHECK_EQUAL((double)pair.scores[allc.GetID()], sweep.GetScore(p, 1));
+			CHECK_EQUAL((double)pair.scores[alld.GetID()], sweep.GetScore(p, 2));
+			CHECK_EQUAL(0.0, sweep.GetNumTurns(p, 0));
+		}
+	}
+	
+	// All-D's score against All-C grows with the temptation
+	CHECK(sweep.GetScore(18, 2) > sweep.GetScore(2, 2));
+}
+
+TEST(Sweep, NoiseAndContinuation)
+{
+	PrisonerDilemma game;
+	FSAPlayer tft, alld;
+	Sweep sweep(&game);
+	
+	CHECK(tft.LoadFromString(&game, test_sweep_tft));
+	CHECK(alld.LoadFromString(&game, test_sweep_alld));
+	sweep.AddPlayer(&tft);
+	sweep.AddPlayer(&alld);
+	sweep.SetSeed(1234);
+	
+	CHECK(sweep.LoadFromString(wxT("noise = 0, 0.1\ncontinuation = 0, 0.9\n")));
+	CHECK(sweep.Run());
+	CHECK_EQUAL(12, (int)sweep.GetNumMatchesPlayed());
+	
+	// Two tit-for-tats cooperate forever without noise, but not with it
+	double perTurn = sweep.GetScore(0, 0) / sweep.GetNumTurns(0, 0);
+	double noisyPerTurn = sweep.GetScore(2, 0) / sweep.GetNumTurns(2, 0);
+	CHECK(noisyPerTurn < perTurn);
+	
+	// Games which continue with probability 0.9 last about ten turns
+	double meanLength = sweep.GetNumTurns(1, 1) / 15.0;
+	CHECK(meanLength > 5.0 && meanLength < 20.0);
+	
+	// The same seed gives the same results
+	Sweep again(&game);
+	again.AddPlayer(&tft);
+	again.AddPlayer(&alld);
+	again.SetSeed(1234);
+	CHECK(again.LoadFromString(wxT("noise = 0, 0.1\ncontinuation = 0, 0.9\n")));
+	CHECK(again.Run());
+	for (size_t p = 0 ; p < sweep.GetNumPoints() ; p++)
+		CHECK_EQUAL(sweep.GetScore(p, 0), again.GetScore(p, 0));
+	
+	// Invalid settings are caught
+	Sweep bad(&game);
+	bad.AddPlayer(&tft);
+	CHECK(bad.LoadFromString(wxT("continuation = 1\n")));
+	CHECK(!bad.Run());
+}
+
+#endif
+/** \endcond */
@@ -0,0 +1,330 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TOURNEY_SWEEP_H__
+#define TOURNEY_SWEEP_H__
+
+#include <vector>
+#include "../game/player.h"
+class Game;
+class Progress;
+
+
+/**
+    \struct SweepPoint
+    \ingroup tourney
+    
+    \brief One set of parameters for a round-robin tournament in a
+           \c Sweep
+*/
+struct SweepPoint
+{
+	SweepPoint() : temptation(5.0), reward(3.0), punishment(1.0), sucker(0.0),
+	               noise(0.0), continuation(0.0), roster(0)
+	{ }
+	
+	double temptation;	/**< \brief Payoff for defecting on a cooperator (T) */
+	double reward;		/**< \brief Payoff for mutual cooperation (R) */
+	double punishment;	/**< \brief Payoff for mutual defection (P) */
+	double sucker;		/**< \brief Payoff for cooperating with a defector (S) */
+	
+	double noise;		/**< \brief See \c Game::SetNoise */
+	double continuation;	/**< \brief See \c Match::SetContinuation */
+	
+	/**
+	    \brief Index of the players taking part (see \c Sweep::GetRoster)
+	*/
+	size_t roster;
+};
+
+
+/**
+    \class Sweep
+    \ingroup tourney
+    
+    \brief Runs the same set of players through many round-robin
+           tournaments with different parameters
+    
+    Each point of the sweep (see \c SweepPoint) is a round-robin
+    tournament, scored like \c Tournament, between some subset of the
+    players, with its own prisoner's dilemma payoffs, noise level and
+    continuation probability.
+    
+    The moves the players make don't depend on the payoffs, or on who
+    else is in the tournament.  So the matches are only played once for
+    each distinct noise level and continuation probability, between
+    every pair of players used at those settings, and only the number
+    of times each pair of moves came up is kept.  Every point's scores
+    are then worked out from those counts.  Each pair of players uses
+    the same random substream at every setting, so differences between
+    points aren't drowned out by sampling noise.
+    
+    Points may be added one at a time, or loaded from a sweep
+    specification (see LoadFromString()).
+*/
+class Sweep
+{
+public:
+	/**
+	    \brief Constructor
+	    
+	    Sets the \c game value.  The game must have exactly two moves,
+	    cooperate and defect, in that order.
+	    
+	    \param gm Initial value of the \c game member
+	*/
+	Sweep(Game *gm);
+	
+	~Sweep();
+	
+	
+	/**
+	    \brief Add a player to the sweep
+	    
+	    The player will be cloned; the pointer passed is not stored.
+	    
+	    \param player Player to be cloned and added
+	*/
+	void AddPlayer(const Player *player);
+	
+	/**
+	    \brief Add a subset of the players
+	    
+	    Roster zero, which is always present, contains every player.
+	    
+	    \param players Indices of the players in the roster
+	    \returns The index of the new roster
+	*/
+	size_t AddRoster(const std::vector<size_t> &players);
+	
+	/**
+	    \brief Get the players in a roster
+	    
+	    \param roster Index of the roster
+	    \returns Indices of the players, in increasing order
+	*/
+	std::vector<size_t> GetRoster(size_t roster) const;
+	
+	/**
+	    \brief Add a point to the sweep
+	    \param point The point to be added
+	*/
+	void AddPoint(const SweepPoint &point);
+	
+	/**
+	    \brief Load points from a sweep specification
+	    
+	    The specification has one setting per line, and \c # starts a
+	    comment:
+	    
+	    \code
+	    T = 5, 6, 7
+	    S = -1:1:0.5
+	    noise = 0, 0.01
+	    continuation = 0.99
+	    roster = all
+	    roster = 1-3, 5
+	    point T=4 R=3 P=1 S=0 noise=0.05 roster=2,4
+	    seed = 42
+	    \endcode
+	    
+	    The \c T, \c R, \c P, \c S, \c noise and \c continuation lines
+	    each give a list of values (\c from:to:step is a range), and
+	    every \c roster line gives one subset of the players, numbered
+	    from one in the order they were added.  Together they make a
+	    grid, with a point for every combination of values, and
+	    settings which aren't given take their default values (see
+	    \c SweepPoint).  Each \c point line adds a single point.
+	    
+	    \param spec The specification
+	    \returns True if it was loaded, false otherwise
+	*/
+	bool LoadFromString(const wxString &spec);
+	
+	/**
+	    \brief Load points from a sweep specification file
+	    
+	    \param fileName The file to be loaded
+	    \returns True if it was loaded, false otherwise
+	    \see LoadFromString
+	*/
+	bool Load(const wxString &fileName);
+	
+	/**
+	    \brief Set the key from which every match's random substream
+	           is derived
+	    
+	    If never set, a key is drawn from the shared generator when the
+	    sweep is run.
+	    
+	    \param newSeed The key
+	*/
+	void SetSeed(wxUint64 newSeed) { seed = newSeed; }
+	
+	
+	/**
+	    \brief Run every point of the sweep
+	    
+	    The matches are played on all available processors (see
+	    \c Parallel::For).
+	    
+	    \param progress If not \c NULL, counts the matches played and
+	                    may be used to cancel the sweep
+	    \returns True if the sweep ran successfully, false otherwise
+	*/
+	bool Run(Progress *progress = NULL);
+	
+	/**
+	    \brief Write the results as a CSV file
+	    
+	    The file has one row for each player at each point of the
+	    sweep, giving the parameters of the point, the player, and its
+	    score, score per turn and rank.
+	    
+	    \param fileName The file to be written
+	    \returns True if the file was written, false otherwise
+	*/
+	bool Write(const wxString &fileName) const;
+	
+	
+	/**
+	    \brief Get the number of points in the sweep
+	    \returns Number of points
+	*/
+	size_t GetNumPoints() const { return points.size(); }
+	
+	/**
+	    \brief Get a point of the sweep
+	    \param point Index of the point
+	    \returns The point
+	*/
+	const SweepPoint &GetPoint(size_t point) const { return points[point]; }
+	
+	/**
+	    \brief Get a player's score at one point of the sweep
+	    
+	    \param point Index of the point
+	    \param player Index of the player, who must be in the point's
+	                  roster
+	    \returns The player's total score
+	*/
+	double GetScore(size_t point, size_t player) const
+	{ return scores[point * players.GetCount() + player]; }
+	
+	/**
+	    \brief Get the number of turns a player played at one point
+	    
+	    \param point Index of the point
+	    \param player Index of the player
+	    \returns Number of turns, or zero if not in the point's roster
+	*/
+	double GetNumTurns(size_t point, size_t player) const
+	{ return turns[point * players.GetCount() + player]; }
+	
+	/**
+	    \brief Get the number of matches played by the last run
+	    \returns Number of matches
+	*/
+	size_t GetNumMatchesPlayed() const { return numMatches; }
+	
+	
+	/**
+	    \brief The players in the sweep
+	*/
+	PlayerPtrArray players;
+
+private:
+	/**
+	    \brief Load points from the lines of a sweep specification
+	    
+	    \param lines The lines of the specification
+	    \returns True if it was loaded, false otherwise
+	*/
+	bool DoLoad(const wxArrayString &lines);
+	
+	/**
+	    \brief Parse a list of values, with ranges
+	    
+	    \param str The list
+	    \param[out] values The values
+	    \returns True if successful, false otherwise
+	*/
+	static bool ParseValues(const wxString &str, std::vector<double> &values);
+	
+	/**
+	    \brief Parse a list of player numbers, with ranges
+	    
+	    \param str The list
+	    \param[out] roster The player indices (counted from zero)
+	    \returns True if successful, false otherwise
+	*/
+	static bool ParseRoster(const wxString &str, std::vector<size_t> &roster);
+	
+	/**
+	    \brief Check that a point's values make sense
+	    \param point The point
+	    \returns True if so, false otherwise (with an error set)
+	*/
+	bool CheckPoint(const SweepPoint &point) const;
+	
+	
+	/**
+	    \brief The points of the sweep
+	*/
+	std::vector<SweepPoint> points;
+	
+	/**
+	    \brief The subsets of players (roster zero, everyone, isn't
+	           stored)
+	*/
+	std::vector<std::vector<size_t> > rosters;
+	
+	/**
+	    \brief Total score of each player at each point
+	*/
+	std::vector<double> scores;
+	
+	/**
+	    \brief Turns played by each player at each point
+	*/
+	std::vector<double> turns;
+	
+	/**
+	    \brief Number of matches played by the last run
+	*/
+	size_t numMatches;
+	
+	/**
+	    \brief Key for the matches' random substreams, or zero
+	*/
+	wxUint64 seed;
+	
+	/**
+	    \brief Game to be played
+	*/
+	Game *game;
+};
+
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,868 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#include <wx/filename.h>
+
+#include <map>
+#include <math.h>
+#include <string.h>
+
+#ifdef BUILD_TESTS
+#  include <TestHarness.h>
+#endif
+
+#include "../common/error.h"
+#include "../common/kernels.h"
+#include "../common/mappedfile.h"
+#include "../common/outputfile.h"
+#include "../common/parallel.h"
+#include "../common/progress.h"
+#include "../common/rng.h"
+#include "../game/fsaplayer.h"
+#include "../game/game.h"
+#include "fsapairengine.h"
+#include "match.h"
+#include "tiledpayoffmatrix.h"
+
+
+// The header of the index file, which describes the whole matrix
+struct IndexHeader
+{
+	char magic[8];
+	wxUint32 version;
+	wxUint32 byteOrder;
+	wxUint64 playersHash;
+	wxUint64 gameHash;
+	wxUint32 size;
+	wxUint32 tileSize;
+	wxUint32 encoding;
+	wxUint32 reserved;
+};
+
+// The header of each tile file, followed by its scores, row by row.
+// Each stored value v stands for the score offset + scale * v.
+struct TileHeader
+{
+	char magic[8];
+	wxUint32 version;
+	wxUint32 byteOrder;
+	wxUint64 playersHash;
+	wxUint64 gameHash;
+	wxUint32 size;
+	wxUint32 tileSize;
+	wxUint32 encoding;
+	wxUint32 row;
+	wxUint32 col;
+	wxUint32 reserved;
+	double offset;
+	double scale;
+};
+
+static const char indexMagic[8] = { 'O', 'Y', 'U', 'N', 'P', 'M', 'A', 'T' };
+static const char tileMagic[8] = { 'O', 'Y', 'U', 'N', 'T', 'I', 'L', 'E' };
+static const wxUint32 tileVersion = 2;
+static const wxUint32 tileByteOrder = 0x01020304;
+
+// Largest value of a SCALED16 score
+static const double maxScaled = 65535.0;
+
+// Rows of a tile handed to a thread at a time
+static const size_t rowChunk = 64;
+
+
+// Bytes taken by each score in the given encoding
+static size_t ValueSize(wxUint32 encoding)
+{
+	return (encoding == TiledPayoffMatrix::FLOAT32) ? sizeof(float) : sizeof(wxUint16);
+}
+
+// Write a file under a temporary name, and then move it into place, so
+// that a file which exists is always complete
+static bool WriteAtomically(const wxString &fileName, const void *header, size_t headerSize,
+                            const void *data, size_t dataSize)
+{
+	wxString tempName = fileName + wxT(".tmp");
+	OutputFile out;
+	if (!out.Open(tempName))
+		return false;
+	
+	out.Write((const char *)header, headerSize);
+	if (dataSize)
+		out.Write((const char *)data, dataSize);
+	
+	if (!out.Close())
+	{
+		wxRemoveFile(tempName);
+		return false;
+	}
+	
+	if (!wxRenameFile(tempName, fileName, true))
+	{
+		wxRemoveFile(tempName);
+		Error::Set(wxString::Format(_("Could not write to file %s"), fileName.c_str()));
+		return false;
+	}
+	
+	return true;
+}
+
+
+/**
+    \brief A tile mapped into memory, with its scores ready to decode
+*/
+class MappedTile
+{
+public:
+	MappedTile() : header(NULL), data(NULL), rows(0), cols(0) { }
+	
+	// Map tile (row, col) of the matrix, and check that it belongs there
+	bool Open(const wxString &fileName, wxUint64 playersHash, wxUint64 gameHash, size_t size,
+	          size_t tileSize, wxUint32 encoding, size_t row, size_t col)
+	{
+		if (!file.Open(fileName))
+			return false;
+		
+		rows = (size - row * tileSize < tileSize) ? size - row * tileSize : tileSize;
+		cols = (size - col * tileSize < tileSize) ? size - col * tileSize : tileSize;
+		
+		header = (const TileHeader *)file.GetData();
+		if (file.GetSize() != sizeof(TileHeader) + rows * cols * ValueSize(encoding) ||
+		    memcmp(header->magic, tileMagic, sizeof(tileMagic)) || header->version != tileVersion ||
+		    header->byteOrder != tileByteOrder || header->playersHash != playersHash ||
+		    header->gameHash != gameHash || header->size != size || header->tileSize != tileSize || header->encoding != encoding ||
+		    header->row != row || header->col != col)
+		{
+			Error::Set(wxString::Format(_("File %s is not a tile of this payoff matrix"), fileName.c_str()));
+			file.Close();
+			return false;
+		}
+		
+		data = file.GetData() + sizeof(TileHeader);
+		return true;
+	}
+	
+	// Add the tile's rows [begin, end), times the slice of x, to the
+	// slice of y
+	void MultiplyRows(size_t begin, size_t end, const double *x, double *y) const
+	{
+		double sum = 0.0;
+		for (size_t j = 0 ; j < cols ; j++)
+			sum += x[j];
+		
+		for (size_t i = begin ; i < end ; i++)
+		{
+			double dot = 0.0;
+			
+			if (header->encoding == TiledPayoffMatrix::FLOAT32)
+			{
+				const float *row = (const float *)data + i * cols;
+				for (size_t j = 0 ; j < cols ; j++)
+					dot += (double)row[j] * x[j];
+			}
+			else
+			{
+				const wxUint16 *row = (const wxUint16 *)data + i * cols;
+				for (size_t j = 0 ; j < cols ; j++)
+					dot += (double)row[j] * x[j];
+			}
+			
+			y[i] += header->offset * sum + header->scale * dot;
+		}
+	}
+	
+	// Get the score at (i, j) within the tile
+	double Get(size_t i, size_t j) const
+	{
+		if (header->encoding == TiledPayoffMatrix::FLOAT32)
+			return header->offset + header->scale * ((const float *)data)[i * cols + j];
+		return header->offset + header->scale * ((const wxUint16 *)data)[i * cols + j];
+	}
+	
+	size_t GetRows() const { return rows; }
+	size_t GetCols() const { return cols; }
+	
+private:
+	MappedFile file;
+	const TileHeader *header;
+	const wxUint8 *data;
+	size_t rows, cols;
+};
+
+
+/**
+    \brief Multiplies the rows of one tile by a vector, split between
+           threads
+*/
+class TileStreamTask : public ParallelTask
+{
+public:
+	TileStreamTask(const MappedTile &t, const double *x_, double *y_) : tile(t), x(x_), y(y_) { }
+	
+	virtual bool Run(size_t begin, size_t end)
+	{
+		size_t last = (end * rowChunk < tile.GetRows()) ? end * rowChunk : tile.GetRows();
+		tile.MultiplyRows(begin * rowChunk, last, x, y);
+		return true;
+	}
+	
+private:
+	const MappedTile &tile;
+	const double *x;
+	double *y;
+};
+
+
+/**
+    \brief Plays the matches of pairs of tiles, (r, c) and (c, r), and
+           writes them to disk
+*/
+class TileTask : public ParallelTask
+{
+public:
+	TileTask(const TiledPayoffMatrix &m, const Game *g, const PlayerPtrArray &p,
+	         const std::vector<std::pair<size_t, size_t> > &t, Progress *pr) :
+		matrix(m), game(g), players(p), tiles(t), progress(pr), direct(p.GetCount(), false)
+	{
+		// Machines the engine can play don't need a match
+		if (engine.SetGame(game))
+		{
+			for (size_t i = 0 ; i < players.GetCount() ; i++)
+			{
+				const FSAPlayer *machine = dynamic_cast<const FSAPlayer *>(players[i]);
+				direct[i] = (machine && engine.CanPlay(machine));
+			}
+		}
+	}
+	
+	virtual bool Run(size_t begin, size_t end)
+	{
+		Game *localGame = game->Clone();
+		bool ok = true;
+		
+		for (size_t t = begin ; t < end && ok ; t++)
+		{
+			ok = PlayTiles(localGame, tiles[t].first, tiles[t].second);
+			if (ok && progress)
+				progress->Advance();
+		}
+		
+		delete localGame;
+		return ok;
+	}
+	
+private:
+	typedef std::map<std::pair<wxUint64, wxUint64>, std::pair<double, double> > ScoreCache;
+	
+	// Play one match, or copy its scores from one between machines
+	// with the same canonical forms
+	bool Play(Game *localGame, size_t i, size_t j, ScoreCache &cache, double &one, double &two)
+	{
+		const FSAPlayer *first = dynamic_cast<const FSAPlayer *>(players[i]);
+		const FSAPlayer *second = dynamic_cast<const FSAPlayer *>(players[j]);
+		std::pair<wxUint64, wxUint64> key;
+		
+		if (direct[i] && direct[j])
+		{
+			int oneScore, twoScore;
+			engine.Play(first, second, oneScore, twoScore);
+			one = oneScore;
+			two = twoScore;
+			return true;
+		}
+		
+		if (first && second)
+		{
+			key = std::make_pair(first->GetCanonicalHash(), second->GetCanonicalHash());
+			ScoreCache::iterator it = cache.find(key);
+			if (it != cache.end())
+			{
+				one = it->second.first;
+				two = it->second.second;
+				return true;
+			}
+		}
+		
+		Player *playerOne = players[i]->Clone();
+		Player *playerTwo = players[j]->Clone();
+		Match match(playerOne, playerTwo);
+		match.SetHistoryPolicy(Match::HISTORY_NONE);
+		
+		bool ok = match.Play(localGame, true);
+		
+		delete playerOne;
+		delete playerTwo;
+		
+		// Error already set in Match::Play()
+		if (!ok)
+			return false;
+		
+		one = match.playerOneScore;
+		two = match.playerTwoScore;
+		
+		if (first && second)
+		{
+			cache[key] = std::make_pair(one, two);
+			cache[std::make_pair(key.second, key.first)] = std::make_pair(two, one);
+		}
+		
+		return true;
+	}
+	
+	bool PlayTiles(Game *localGame, size_t r, size_t c)
+	{
+		size_t size = matrix.size, tileSize = matrix.tileSize;
+		size_t rowStart = r * tileSize, colStart = c * tileSize;
+		size_t rows = (size - rowStart < tileSize) ? size - rowStart : tileSize;
+		size_t cols = (size - colStart < tileSize) ? size - colStart : tileSize;
+		
+		// Scores of the rows against the columns, and the other way
+		std::vector<double> forward(rows * cols), backward(cols * rows);
+		ScoreCache cache;
+		
+		for (size_t i = 0 ; i < rows ; i++)
+		{
+			if (progress && progress->IsCancelled())
+			{
+				Error::Set(_("The computation of the payoff matrix was cancelled"));
+				return false;
+			}
+			
+			// On the diagonal, the two tiles are the same one
+			for (size_t j = (r == c) ? i : 0 ; j < cols ; j++)
+			{
+				double one, two;
+				if (!Play(localGame, rowStart + i, colStart + j, cache, one, two))
+					return false;
+				
+				forward[i * cols + j] = one;
+				backward[j * rows + i] = two;
+				if (r == c)
+					forward[j * cols + i] = two;
+			}
+		}
+		
+		if (!WriteTile(r, c, forward, rows, cols))
+			return false;
+		return (r == c) || WriteTile(c, r, backward, cols, rows);
+	}
+	
+	bool WriteTile(size_t r, size_t c, const std::vector<double> &values, size_t rows, size_t cols)
+	{
+		TileHeader header;
+		memset(&header, 0, sizeof(TileHeader));
+		memcpy(header.magic, tileMagic, sizeof(tileMagic));
+		header.version = tileVersion;
+		header.byteOrder = tileByteOrder;
+		header.playersHash = matrix.playersHash;
+		header.gameHash = matrix.gameHash;
+		header.size = matrix.size;
+		header.tileSize = matrix.tileSize;
+		header.encoding = matrix.encoding;
+		header.row = r;
+		header.col = c;
+		header.offset = 0.0;
+		header.scale = 1.0;
+		
+		size_t count = rows * cols;
+		wxString fileName = matrix.GetTileFileName(r, c);
+		
+		if (matrix.encoding == TiledPayoffMatrix::FLOAT32)
+		{
+			std::vector<float> stored(values.begin(), values.end());
+			return WriteAtomically(fileName, &header, sizeof(TileHeader), &stored[0], count * sizeof(float));
+		}
+		
+		// Scale the scores to fill 16 bits, unless they're whole numbers
+		// which already fit, in which case they're stored exactly
+		double low = values[0], high = values[0];
+		bool whole = true;
+		for (size_t k = 0 ; k < count ; k++)
+		{
+			if (values[k] < low)
+				low = values[k];
+			if (values[k] > high)
+				high = values[k];
+			if (values[k] != floor(values[k]))
+				whole = false;
+		}
+		
+		header.offset = low;
+		if (!whole || high - low > maxScaled)
+			header.scale = (high - low) / maxScaled;
+		if (header.scale <= 0.0)
+			header.scale = 1.0;
+		
+		std::vector<wxUint16> stored(count);
+		for (size_t k = 0 ; k < count ; k++)
+		{
+			double q = floor((values[k] - low) / header.scale + 0.5);
+			stored[k] = (wxUint16)((q > maxScaled) ? maxScaled : q);
+		}
+		
+		return WriteAtomically(fileName, &header, sizeof(TileHeader), &stored[0], count * sizeof(wxUint16));
+	}
+	
+	const TiledPayoffMatrix &matrix;
+	const Game *game;
+	const PlayerPtrArray &players;
+	const std::vector<std::pair<size_t, size_t> > &tiles;
+	Progress *progress;
+	FSAPairEngine engine;
+	std::vector<bool> direct;
+};
+
+
+wxString TiledPayoffMatrix::GetTileFileName(size_t row, size_t col) const
+{
+	return wxFileName(directory, wxString::Format(wxT("tile-%05u-%05u.oyt"), (unsigned)row, (unsigned)col)).GetFullPath();
+}
+
+wxString TiledPayoffMatrix::GetIndexFileName() const
+{
+	return wxFileName(directory, wxT("payoffs.oyi")).GetFullPath();
+}
+
+bool TiledPayoffMatrix::IsTileValid(size_t row, size_t col) const
+{
+	if (!wxFileExists(GetTileFileName(row, col)))
+		return false;
+	
+	MappedTile tile;
+	return tile.Open(GetTileFileName(row, col), playersHash, gameHash, size, tileSize, encoding, row, col);
+}
+
+bool TiledPayoffMatrix::Compute(const wxString &newDirectory, const Game *game, const PlayerPtrArray &players,
+                                Progress *progress)
+{
+	size = 0;
+	
+	if (!players.GetCount())
+	{
+		Error::Set(_("There are no players to play"));
+		return false;
+	}
+	if (!tileSize)
+	{
+		Error::Set(_("The tiles of the payoff matrix must hold at least one player"));
+		return false;
+	}
+	if (!wxDirExists(newDirectory) && !wxMkdir(newDirectory))
+	{
+		Error::Set(wxString::Format(_("Could not create directory %s"), newDirectory.c_str()));
+		return false;
+	}
+	
+	directory = newDirectory;
+	playersHash = HashPlayers(players);
+	gameHash = Random::Hash(HashGame(game) ^ Match::quickGameLength);
+	
+	IndexHeader header;
+	memset(&header, 0, sizeof(IndexHeader));
+	memcpy(header.magic, indexMagic, sizeof(indexMagic));
+	header.version = tileVersion;
+	header.byteOrder = tileByteOrder;
+	header.playersHash = playersHash;
+	header.gameHash = gameHash;
+	header.size = players.GetCount();
+	header.tileSize = tileSize;
+	header.encoding = encoding;
+	
+	if (!WriteAtomically(GetIndexFileName(), &header, sizeof(IndexHeader), NULL, 0))
+		return false;
+	
+	// Find the pairs of tiles which aren't on disk yet
+	size = players.GetCount();
+	size_t numTiles = GetNumTiles();
+	std::vector<std::pair<size_t, size_t> > tiles;
+	
+	if (progress)
+		progress->Start(numTiles * (numTiles + 1) / 2);
+	
+	for (size_t r = 0 ; r < numTiles ; r++)
+	{
+		for (size_t c = r ; c < numTiles ; c++)
+		{
+			if (IsTileValid(r, c) && IsTileValid(c, r))
+			{
+				if (progress)
+					progress->Advance();
+			}
+			else
+				tiles.push_back(std::make_pair(r, c));
+		}
+	}
+	
+	// Error already set in TileTask::Run()
+	TileTask task(*this, game, players, tiles, progress);
+	if (!Parallel::For(tiles.size(), &task, 1))
+	{
+		size = 0;
+		return false;
+	}
+	
+	return true;
+}
+
+bool TiledPayoffMatrix::Open(const wxString &newDirectory)
+{
+	size = 0;
+	directory = newDirectory;
+	
+	MappedFile file;
+	if (!file.Open(GetIndexFileName()))
+		return false;
+	
+	IndexHeader header;
+	if (file.GetSize() != sizeof(IndexHeader))
+	{
+		Error::Set(wxString::Format(_("Directory %s does not hold a payoff matrix"), directory.c_str()));
+		return false;
+	}
+	memcpy(&header, file.GetData(), sizeof(IndexHeader));
+	
+	if (memcmp(header.magic, indexMagic, sizeof(indexMagic)) || header.version != tileVersion ||
+	    header.byteOrder != tileByteOrder || header.encoding > SCALED16 || !header.size || !header.tileSize)
+	{
+		Error::Set(wxString::Format(_("Directory %s does not hold a payoff matrix"), directory.c_str()));
+		return false;
+	}
+	
+	size = header.size;
+	tileSize = header.tileSize;
+	encoding = (Encoding)header.encoding;
+	playersHash = header.playersHash;
+	gameHash = header.gameHash;
+	
+	for (size_t r = 0 ; r < GetNumTiles() ; r++)
+	{
+		for (size_t c = 0 ; c < GetNumTiles() ; c++)
+		{
+			if (!IsTileValid(r, c))
+			{
+				Error::Set(wxString::Format(_("The payoff matrix in %s is incomplete"), directory.c_str()));
+				size = 0;
+				return false;
+			}
+		}
+	}
+	
+	return true;
+}
+
+void TiledPayoffMatrix::Delete()
+{
+	if (directory.IsEmpty())
+		return;
+	
+	// Without an index, we don't know how many tiles there were
+	if (!size && !Open(directory) && !size)
+	{
+		MappedFile file;
+		IndexHeader header;
+		if (!file.Open(GetIndexFileName()) || file.GetSize() != sizeof(IndexHeader))
+			return;
+		memcpy(&header, file.GetData(), sizeof(IndexHeader));
+		size = header.size;
+		tileSize = header.tileSize;
+		if (!tileSize)
+			return;
+	}
+	
+	for (size_t r = 0 ; r < GetNumTiles() ; r++)
+		for (size_t c = 0 ; c < GetNumTiles() ; c++)
+			if (wxFileExists(GetTileFileName(r, c)))
+				wxRemoveFile(GetTileFileName(r, c));
+	
+	wxRemoveFile(GetIndexFileName());
+	wxRmdir(directory);
+	size = 0;
+}
+
+bool TiledPayoffMatrix::Get(size_t i, size_t j, double &value) const
+{
+	if (i >= size || j >= size)
+	{
+		Error::Set(_("There is no such entry in the payoff matrix"));
+		return false;
+	}
+	
+	MappedTile tile;
+	if (!tile.Open(GetTileFileName(i / tileSize, j / tileSize), playersHash, gameHash, size, tileSize,
+	               encoding, i / tileSize, j / tileSize))
+		return false;
+	
+	value = tile.Get(i % tileSize, j % tileSize);
+	return true;
+}
+
+bool TiledPayoffMatrix::MatVec(const double *x, double *y, Progress *progress) const
+{
+	if (progress)
+		progress->Start(GetNumTiles() * GetNumTiles());
+	
+	return Stream(x, y, progress);
+}
+
+bool TiledPayoffMatrix::Stream(const double *x, double *y, Progress *progress) const
+{
+	if (!size)
+	{
+		Error::Set(_("There is no payoff matrix to read"));
+		return false;
+	}
+	
+	for (size_t i = 0 ; i < size ; i++)
+		y[i] = 0.0;
+	
+	// Tiles are read a row of tiles at a time, each from front to back
+	size_t numTiles = GetNumTiles();
+	for (size_t r = 0 ; r < numTiles ; r++)
+	{
+		for (size_t c = 0 ; c < numTiles ; c++)
+		{
+			if (progress && progress->IsCancelled())
+			{
+				Error::Set(_("The pass over the payoff matrix was cancelled"));
+				return false;
+			}
+			
+			MappedTile tile;
+			if (!tile.Open(GetTileFileName(r, c), playersHash, gameHash, size, tileSize, encoding, r, c))
+				return false;
+			
+			TileStreamTask task(tile, x + c * tileSize, y + r * tileSize);
+			size_t numChunks = (tile.GetRows() + rowChunk - 1) / rowChunk;
+			
+			if (tile.GetRows() * tile.GetCols() < Kernels::parallelThreshold)
+				task.Run(0, numChunks);
+			else
+				Parallel::For(numChunks, &task, 1);
+			
+			if (progress)
+				progress->Advance();
+		}
+	}
+	
+	return true;
+}
+
+bool TiledPayoffMatrix::GetMeanScores(std::vector<double> &means, Progress *progress) const
+{
+	std::vector<double> x(size, size ? 1.0 / (double)size : 0.0);
+	means.resize(size);
+	
+	// Error already set in MatVec()
+	return MatVec(&x[0], &means[0], progress);
+}
+
+bool TiledPayoffMatrix::Evolve(std::vector<double> &x, int numGenerations, double tolerance, Progress *progress) const
+{
+	if (x.size() != size)
+		x.assign(size, size ? 1.0 / (double)size : 0.0);
+	
+	if (progress)
+		progress->Start(numGenerations * GetNumTiles() * GetNumTiles());
+	
+	std::vector<double> f(size);
+	for (int gen = 0 ; gen < numGenerations ; gen++)
+	{
+		// Error already set in Stream()
+		if (!Stream(&x[0], &f[0], progress))
+			return false;
+		
+		double mean = Kernels::Dot(&x[0], &f[0], size);
+		if (mean <= 0.0)
+			break;
+		
+		double distance = 0.0;
+		for (size_t i = 0 ; i < size ; i++)
+		{
+			double next = x[i] * f[i] / mean;
+			distance += (next - x[i]) * (next - x[i]);
+			x[i] = next;
+		}
+		
+		if (sqrt(distance) < tolerance)
+			break;
+	}
+	
+	return true;
+}
+
+
+/** \cond TEST */
+#ifdef BUILD_TESTS
+
+#include "../game/prisoner.h"
+#include "payoffmatrix.h"
+
+static const wxString test_tiled_allc("Charles Pence\nAll-C\n1\nC, 0, 0");
+static const wxString test_tiled_alld("Charles Pence\nAll-D\n1\nD, 0, 0");
+static const wxString test_tiled_tft("Charles Pence\nTFT\n2\nC, 0, 1\nD, 0, 1");
+
+// A temporary directory for a matrix
+static wxString TestDirectory()
+{
+	wxString name = wxFileName::CreateTempFileName(wxT("oyun"));
+	wxRemoveFile(name);
+	return name;
+}
+
+TEST(TiledPayoffMatrix, Compute)
+{
+	PrisonerDilemma game;
+	const wxString *scripts[3] = { &test_tiled_allc, &test_tiled_alld, &test_tiled_tft };
+	PlayerPtrArray players;
+	
+	// Seven players, in tiles of three, so the edge tiles are ragged
+	for (size_t i = 0 ; i < 7 ; i++)
+	{
+		FSAPlayer *player = new FSAPlayer;
+		CHECK(player->LoadFromString(&game, *scripts[i % 3]));
+		players.Add(player);
+	}
+	
+	PayoffMatrix direct;
+	CHECK(direct.Compute(&game, players));
+	
+	const TiledPayoffMatrix::Encoding encodings[2] = { TiledPayoffMatrix::FLOAT32, TiledPayoffMatrix::SCALED16 };
+	for (size_t e = 0 ; e < 2 ; e++)
+	{
+		wxString dir = TestDirectory();
+		TiledPayoffMatrix matrix;
+		matrix.SetTileSize(3);
+		matrix.SetEncoding(encodings[e]);
+		CHECK(matrix.Compute(dir, &game, players));
+		CHECK_EQUAL(7, (int)matrix.GetSize());
+		
+		// The scores are whole numbers, so they're stored exactly
+		for (size_t i = 0 ; i < 7 ; i++)
+		{
+			for (size_t j = 0 ; j < 7 ; j++)
+			{
+				double value = -1.0;
+				CHECK(matrix.Get(i, j, value));
+				CHECK_EQUAL(direct.Get(i, j), value);
+			}
+		}
+		
+		// Streaming gives the same products
+		std::vector<double> x(7), y(7), means;
+		for (size_t i = 0 ; i < 7 ; i++)
+			x[i] = 0.1 * (double)(i + 1);
+		CHECK(matrix.MatVec(&x[0], &y[0]));
+		CHECK(matrix.GetMeanScores(means));
+		for (size_t i = 0 ; i < 7 ; i++)
+		{
+			double expected = 0.0, mean = 0.0;
+			for (size_t j = 0 ; j < 7 ; j++)
+			{
+				expected += direct.Get(i, j) * x[j];
+				mean += direct.Get(i, j) / 7.0;
+			}
+			CHECK(fabs(y[i] - expected) < 1e-9);
+			CHECK(fabs(means[i] - mean) < 1e-9);
+		}
+		
+		// A stored matrix can be opened again, but not if it's missing
+		// a tile, until it's computed again
+		TiledPayoffMatrix reopened;
+		CHECK(reopened.Open(dir));
+		CHECK_EQUAL(3, (int)reopened.GetTileSize());
+		CHECK_EQUAL(encodings[e], reopened.GetEncoding());
+		
+		wxRemoveFile(dir + wxT("/tile-00001-00002.oyt"));
+		CHECK(!reopened.Open(dir));
+		CHECK(matrix.Compute(dir, &game, players));
+		CHECK(reopened.Open(dir));
+		
+		double value = -1.0;
+		CHECK(reopened.Get(4, 6, value));
+		CHECK_EQUAL(direct.Get(4, 6), value);
+		
+		// A different game in the same directory plays every tile again
+		PrisonerDilemma stag(PayoffTable(3, 4, 1, 0));
+		PayoffMatrix stagDirect;
+		CHECK(stagDirect.Compute(&stag, players));
+		CHECK(matrix.Compute(dir, &stag, players));
+		CHECK(reopened.Open(dir));
+		CHECK(reopened.GetGameHash() != 0 && reopened.GetGameHash() == matrix.GetGameHash());
+		CHECK(reopened.Get(4, 6, value));
+		CHECK_EQUAL(stagDirect.Get(4, 6), value);
+		CHECK(stagDirect.Get(4, 6) != direct.Get(4, 6));
+		
+		reopened.Delete();
+		CHECK(!wxDirExists(dir));
+	}
+	
+	for (size_t i = 0 ; i < players.GetCount() ; i++)
+		delete players[i];
+}
+
+TEST(TiledPayoffMatrix, Scaling)
+{
+	PrisonerDilemma game;
+	PlayerPtrArray players;
+	FSAPlayer allc, alld;
+	CHECK(allc.LoadFromString(&game, test_tiled_allc));
+	CHECK(alld.LoadFromString(&game, test_tiled_alld));
+	players.Add(&allc);
+	players.Add(&alld);
+	
+	// Scores spanning more than 16 bits are rounded to one part in
+	// 65535 of their range
+	PrisonerDilemma wide(PayoffTable(100000, 3, 1, 0));
+	PayoffMatrix direct;
+	CHECK(direct.Compute(&wide, players));
+	
+	wxString dir = TestDirectory();
+	TiledPayoffMatrix matrix;
+	CHECK(matrix.Compute(dir, &wide, players));
+	
+	double range = direct.Get(1, 0) - direct.Get(0, 1);
+	for (size_t i = 0 ; i < 2 ; i++)
+	{
+		for (size_t j = 0 ; j < 2 ; j++)
+		{
+			double value;
+			CHECK(matrix.Get(i, j, value));
+			CHECK(fabs(value - direct.Get(i, j)) <= range / 65535.0);
+		}
+	}
+	
+	// Defectors take over
+	std::vector<double> x;
+	CHECK(matrix.Evolve(x, 200, 1e-8));
+	CHECK(x[1] > 0.999);
+	
+	matrix.Delete();
+}
+
+#endif
+/** \endcond */
@@ -0,0 +1,290 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TOURNEY_TILEDPAYOFFMATRIX_H__
+#define TOURNEY_TILEDPAYOFFMATRIX_H__
+
+#include <vector>
+#include "../game/player.h"
+class Game;
+class Progress;
+
+
+/**
+    \class TiledPayoffMatrix
+    \ingroup tourney
+    
+    \brief A payoff matrix kept on disk, for rosters too large for memory
+    
+    This holds the same scores as a \c PayoffMatrix, but split into
+    square tiles of GetTileSize() players by GetTileSize() players, each
+    stored in its own file in a directory.  With a hundred thousand
+    players, even single-precision scores come to 40 GB, so the tiles
+    are never all in memory at once: each one is memory-mapped (see
+    \c MappedFile) while it's needed, and the analyses below stream
+    through them one at a time, in order, reading each file from start
+    to end.
+    
+    The tiles are computed in parallel (see \c Parallel::For), and each
+    one is written to a temporary file and then renamed, so a tile
+    which exists is complete.  If a computation is stopped part-way,
+    running it again with the same players and game skips the tiles
+    already on disk.
+    
+    Scores may be stored as floats, or (by default) as 16-bit integers
+    with an offset and scale for each tile, which halves the size again.
+    Match scores are whole numbers, and whenever a tile's scores span
+    less than 65536 they are stored exactly.
+*/
+class TiledPayoffMatrix
+{
+public:
+	/**
+	    \brief How the scores in each tile are stored
+	*/
+	enum Encoding
+	{
+		FLOAT32,	/**< \brief Single-precision floats */
+		SCALED16	/**< \brief 16-bit integers, scaled for each tile */
+	};
+	
+	/**
+	    \brief Constructor
+	    
+	    Creates an empty matrix, not attached to any directory.
+	*/
+	TiledPayoffMatrix() : size(0), tileSize(1024), encoding(SCALED16), playersHash(0), gameHash(0) { }
+	
+	/**
+	    \brief Play every pair of players and store the matrix in a
+	           directory
+	    
+	    The directory is created if it doesn't exist.  Tiles which are
+	    already there, for the same players, game, tile size and
+	    encoding, are kept rather than played again.
+	    
+	    \param directory The directory for the tiles
+	    \param game The game to be played
+	    \param players The players (who will not be modified)
+	    \param progress If not \c NULL, counts the pairs of tiles done and
+	                    may be used to cancel the computation
+	    \returns True if every tile is on disk, false otherwise
+	*/
+	bool Compute(const wxString &directory, const Game *game, const PlayerPtrArray &players,
+	             Progress *progress = NULL);
+	
+	/**
+	    \brief Use a matrix already stored in a directory
+	    
+	    \param directory The directory holding the tiles
+	    \returns True if the directory holds a complete matrix, false
+	             otherwise
+	*/
+	bool Open(const wxString &directory);
+	
+	/**
+	    \brief Delete the files of the matrix, and the directory if it's
+	           left empty
+	*/
+	void Delete();
+	
+	
+	/**
+	    \brief Set the tile size used by Compute()
+	    \param newTileSize Number of players on each side of a tile
+	*/
+	void SetTileSize(size_t newTileSize) { tileSize = newTileSize; }
+	
+	/**
+	    \brief Get the tile size
+	    \returns Number of players on each side of a tile
+	*/
+	size_t GetTileSize() const { return tileSize; }
+	
+	/**
+	    \brief Set the encoding used by Compute()
+	    \param newEncoding The encoding
+	*/
+	void SetEncoding(Encoding newEncoding) { encoding = newEncoding; }
+	
+	/**
+	    \brief Get the encoding of the scores
+	    \returns The encoding
+	*/
+	Encoding GetEncoding() const { return encoding; }
+	
+	/**
+	    \brief Get the number of players (rows and columns)
+	    \returns Size of the matrix, or zero if none is open
+	*/
+	size_t GetSize() const { return size; }
+	
+	/**
+	    \brief Get the hash of the players the matrix was computed for
+	    \returns The hash (see \c HashPlayers)
+	*/
+	wxUint64 GetPlayersHash() const { return playersHash; }
+	
+	/**
+	    \brief Get the hash of the game the matrix was computed for
+	    \returns The hash (see \c HashGame), which also covers the
+	             length of a quick match
+	*/
+	wxUint64 GetGameHash() const { return gameHash; }
+	
+	
+	/**
+	    \brief Get the score of one player against another
+	    
+	    This maps a whole tile, so it's only meant for looking up a few
+	    scores.
+	    
+	    \param i Index of the scoring player
+	    \param j Index of the opponent
+	    \param[out] value Score of player \p i against player \p j
+	    \returns True if successful, false otherwise
+	*/
+	bool Get(size_t i, size_t j, double &value) const;
+	
+	/**
+	    \brief Multiply the matrix by a vector
+	    
+	    Computes <tt>y = A x</tt>, reading every tile once.
+	    
+	    \param x Vector of GetSize() values
+	    \param[out] y Vector of GetSize() values
+	    \param progress If not \c NULL, counts the tiles read and may be
+	                    used to cancel the product
+	    \returns True if successful, false otherwise
+	*/
+	bool MatVec(const double *x, double *y, Progress *progress = NULL) const;
+	
+	/**
+	    \brief Get every player's average score against the roster
+	    
+	    \param[out] means The mean of each row of the matrix
+	    \param progress If not \c NULL, counts the tiles read and may be
+	                    used to cancel the pass
+	    \returns True if successful, false otherwise
+	*/
+	bool GetMeanScores(std::vector<double> &means, Progress *progress = NULL) const;
+	
+	/**
+	    \brief Evolve a population in discrete generations
+	    
+	    Applies the replicator equation as in \c EvoTournament::DISCRETE,
+	    with one pass over the tiles for each generation, stopping early
+	    once the population moves less than \p tolerance.
+	    
+	    \param[in,out] x The fraction of each player, or empty to start
+	                     with every player equally common
+	    \param numGenerations Most generations to run
+	    \param tolerance Convergence tolerance (see
+	                     \c EvoTournament::tolerance)
+	    \param progress If not \c NULL, counts the tiles read and may be
+	                    used to cancel the run
+	    \returns True if successful, false otherwise
+	*/
+	bool Evolve(std::vector<double> &x, int numGenerations, double tolerance, Progress *progress = NULL) const;
+
+private:
+	/**
+	    \brief Get the number of tiles on each side of the matrix
+	    \returns Number of tile rows (and columns)
+	*/
+	size_t GetNumTiles() const { return (size + tileSize - 1) / tileSize; }
+	
+	/**
+	    \brief Get the name of the file holding a tile
+	    \param row Tile row
+	    \param col Tile column
+	    \returns The file name
+	*/
+	wxString GetTileFileName(size_t row, size_t col) const;
+	
+	/**
+	    \brief Get the name of the file describing the matrix
+	    \returns The file name
+	*/
+	wxString GetIndexFileName() const;
+	
+	/**
+	    \brief Is a tile on disk, and does it belong to this matrix?
+	    \param row Tile row
+	    \param col Tile column
+	    \returns True if the tile can be used
+	*/
+	bool IsTileValid(size_t row, size_t col) const;
+	
+	/**
+	    \brief Multiply the matrix by a vector, reading each tile once
+	    
+	    Like MatVec(), but advances \p progress once per tile without
+	    starting it, so that several passes can share one count.
+	    
+	    \param x Vector of GetSize() values
+	    \param[out] y Vector of GetSize() values, set to the product
+	    \param progress If not \c NULL, advanced once per tile and
+	                    checked for cancellation
+	    \returns True if successful, false otherwise
+	*/
+	bool Stream(const double *x, double *y, Progress *progress) const;
+	
+	
+	/**
+	    \brief The directory holding the tiles
+	*/
+	wxString directory;
+	
+	/**
+	    \brief The number of players
+	*/
+	size_t size;
+	
+	/**
+	    \brief Number of players on each side of a tile
+	*/
+	size_t tileSize;
+	
+	/**
+	    \brief How the scores are stored
+	*/
+	Encoding encoding;
+	
+	/**
+	    \brief Hash of the players the matrix was computed for
+	*/
+	wxUint64 playersHash;
+	
+	/**
+	    \brief Hash of the game the matrix was computed for, and of the
+	           length of its matches
+	*/
+	wxUint64 gameHash;
+	
+	friend class TileTask;
+	friend class TileStreamTask;
+};
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
@@ -27,19 +27,25 @@
 #  include <wx/wx.h>
 #endif
 
-#include <wx/progdlg.h>
-
 #ifdef BUILD_TESTS
 #  include <TestHarness.h>
+#  include "../game/fsaplayer.h"
 #endif
 
+#include "../common/error.h"
+#include "../common/progress.h"
+#include "../common/rng.h"
 #include "../ui/oyunapp.h"
 #include "../game/game.h"
+#include "../game/prisoner.h"
 #include "tournament.h"
 #include "match.h"
+#include "matchplanner.h"
 
 
-Tournament::Tournament(Game *newGame) : played(false), game(newGame)
+Tournament::Tournament(Game *newGame) :
+	played(false), numPlayed(0), historyPolicy(Match::HISTORY_FULL),
+	historyPolicySet(false), historyFile(NULL), game(newGame)
 { }
 
 Tournament::~Tournament()
@@ -60,17 +66,23 @@ Tournament::~Tournament()
 
 	// Destroy the old tournament scores
 	scores.clear();
+	
+	delete historyFile;
 }
 
 void Tournament::Reset()
 {
 	// Clear scores
 	scores.clear();
+	numPlayed = 0;
 
 	// Free matches list
 	for (size_t i = 0 ; i < matches.GetCount() ; i++)
 		delete matches[i];
 	matches.Clear();
+	
+	delete historyFile;
+	historyFile = NULL;
 
 	// Leave the players intact, recalculate matches
 	RecalculateMatchList();
@@ -89,6 +101,24 @@ void Tournament::AddPlayer(const Player *player)
 	Reset();
 }
 
+void Tournament::AddPlayers(const PlayerPtrArray &players)
+{
+	if (!players.GetCount())
+		return;
+	
+	playerOneList.Alloc(playerOneList.GetCount() + players.GetCount());
+	playerTwoList.Alloc(playerTwoList.GetCount() + players.GetCount());
+	
+	for (size_t i = 0 ; i < players.GetCount() ; i++)
+	{
+		playerOneList.push_back(players[i]->Clone());
+		playerTwoList.push_back(players[i]->Clone());
+	}
+	
+	// Only rebuild the match list once
+	Reset();
+}
+
 void Tournament::RemovePlayer(const Player *player)
 {
 	for (size_t i = 0 ; i < playerOneList.GetCount() ; i++)
@@ -121,52 +151,136 @@ void Tournament::RecalculateMatchList()
 		delete matches[i];
 	matches.Clear();
 
-	// Create the list again from scratch
-	unsigned int i, j;
-	for (i = 0 ; i < playerOneList.size() ; i++)
+	// Create the list again from scratch, in an order which keeps the
+	// players' state tables in the cache
+	MatchPlanner planner;
+	planner.Plan(playerOneList);
+	
+	for (size_t k = 0 ; k < planner.GetNumJobs() ; k++)
 	{
-		for (j = i ; j < playerTwoList.size() ; j++)
-		{
-			Match *newMatch = new Match(playerOneList[i], playerTwoList[j]);
-			matches.Add(newMatch);
-		}
+		const MatchJob &job = planner.GetJob(k);
+		
+		// Each match gets its own random substream, so that it can
+		// be replayed
+		wxUint64 seed = ((wxUint64)Random::Generate() << 32) | Random::Generate();
+		if (!seed)
+			seed = 1;
+		
+		Match *newMatch = new Match(playerOneList[job.one], playerTwoList[job.two], seed);
+		matches.Add(newMatch);
 	}
 }
 
-bool Tournament::Run()
+bool Tournament::Run(Progress *progress)
 {
-	// See if we need to reset the matches and such
-	if (played)
+	// See if we need to reset the matches and such (including after
+	// a run that was cancelled part-way through)
+	if (played || numPlayed)
 		Reset();
 
 	// Make sure we're really ready to go
 	if (!playerOneList.size() || !playerTwoList.size() || !matches.GetCount())
 		return false;
 
-	wxBeginBusyCursor();
+	// Set up the match histories
+	Match::HistoryPolicy policy = GetHistoryPolicy();
+	if (policy == Match::HISTORY_DISK)
+	{
+		historyFile = new MatchHistoryFile;
+		
+		// Error already set in MatchHistoryFile::Open()
+		if (!historyFile->Open())
+		{
+			delete historyFile;
+			historyFile = NULL;
+			return false;
+		}
+	}
+	
+	for (size_t i = 0 ; i < matches.GetCount() ; i++)
+		matches[i]->SetHistoryPolicy(policy, historyFile);
+
+	if (progress)
+		progress->Start(matches.GetCount());
 
 	// Run the tournament itself
 	for (size_t i = 0 ; i < matches.GetCount() ; i++)
 	{
+		if (progress && progress->IsCancelled())
+		{
+			Error::Set(_("The tournament was cancelled"));
+			return false;
+		}
+		
 		// Error already set in Match::Play()
 		if (!matches[i]->Play(game, false))
 			return false;
+		
+		// Accumulate the scores for each player
+		{
+			wxCriticalSectionLocker locker(lock);
+			
+			scores[matches[i]->playerOne->GetID()] += matches[i]->playerOneScore;
+			scores[matches[i]->playerTwo->GetID()] += matches[i]->playerTwoScore;
+			numPlayed++;
+		}
+		
+		if (progress)
+			progress->Advance();
 	}
 
-	wxEndBusyCursor();
+	// Set the played flag
+	played = true;
+	return true;
+}
 
-	// Accumulate the scores for each player
+bool Tournament::Rescore(const PayoffTable &payoffs)
+{
+	if (!played)
+	{
+		Error::Set(_("The tournament must be played before it can be rescored"));
+		return false;
+	}
+	
+	// Check every match first, so a failure leaves the scores alone
 	for (size_t i = 0 ; i < matches.GetCount() ; i++)
 	{
+		if (!matches[i]->HasSummary() || game->GetGameMoves().Length() != 2)
+		{
+			Error::Set(_("Only tournaments of two-move games which kept a summary of each match can be rescored"));
+			return false;
+		}
+	}
+	
+	wxCriticalSectionLocker locker(lock);
+	scores.clear();
+	
+	for (size_t i = 0 ; i < matches.GetCount() ; i++)
+	{
+		matches[i]->Rescore(payoffs);
 		scores[matches[i]->playerOne->GetID()] += matches[i]->playerOneScore;
 		scores[matches[i]->playerTwo->GetID()] += matches[i]->playerTwoScore;
 	}
-
-	// Set the played flag
-	played = true;
+	
 	return true;
 }
 
+void Tournament::SetHistoryPolicy(Match::HistoryPolicy policy)
+{
+	historyPolicy = policy;
+	historyPolicySet = true;
+}
+
+Match::HistoryPolicy Tournament::GetHistoryPolicy() const
+{
+	if (historyPolicySet)
+		return historyPolicy;
+	
+	if (matches.GetCount() > (size_t)fullHistoryMatches)
+		return Match::HISTORY_SUMMARY;
+	return Match::HISTORY_FULL;
+}
+
 /** \cond TEST */
 #ifdef BUILD_TESTS
 
@@ -182,6 +296,27 @@ TEST(Tournament, AddPlayer)
 	CHECK_EQUAL(1, tourney.GetNumPlayers());
 }
 
+TEST(Tournament, AddPlayers)
+{
+	MockGame game;
+	MockPlayer p1, p2, p3;
+	Tournament tourney(&game);
+	
+	PlayerPtrArray players;
+	players.Add(&p1);
+	players.Add(&p2);
+	players.Add(&p3);
+	tourney.AddPlayers(players);
+	
+	// The lists hold copies, and the matches are the same as if the
+	// players had been added one at a time
+	CHECK_EQUAL(3, tourney.GetNumPlayers());
+	CHECK_EQUAL(3, tourney.playerTwoList.GetCount());
+	CHECK(tourney.playerOneList[1] != &p2);
+	CHECK_EQUAL(p2.GetID(), tourney.playerOneList[1]->GetID());
+	CHECK_EQUAL(6, tourney.GetNumMatches());
+}
+
 TEST(Tournament, PlayerLists)
 {
 	// Ensure that you get one player in each player list
@@ -302,6 +437,104 @@ TEST(Tournament, Reset)
 	CHECK_EQUAL(0, tourney.scores.size());
 }
 
+TEST(Tournament, Progress)
+{
+	MockGame game;
+	MockPlayer p1, p2;
+	Tournament tourney(&game);
+	Progress progress;
+	
+	p1.nextMove = p2.nextMove = wxT('C');
+	
+	tourney.AddPlayer(&p1);
+	tourney.AddPlayer(&p2);
+	
+	// Every match is counted
+	CHECK(tourney.Run(&progress));
+	CHECK_EQUAL(3, (int)progress.GetDone());
+	CHECK_EQUAL(3, (int)progress.GetTotal());
+	CHECK_EQUAL(3, tourney.GetNumMatchesPlayed());
+	
+	// A cancelled tournament stops, and isn't played
+	progress.Cancel();
+	CHECK(!tourney.Run(&progress));
+	CHECK(!tourney.IsPlayed());
+	CHECK_EQUAL(0, tourney.GetNumMatchesPlayed());
+	CHECK_EQUAL(0, tourney.scores.size());
+}
+
+TEST(Tournament, HistoryPolicy)
+{
+	MockGame game;
+	MockPlayer player;
+	Tournament tourney(&game);
+	
+	player.nextMove = wxT('C');
+	
+	// Small tournaments keep everything
+	tourney.AddPlayer(&player);
+	CHECK_EQUAL((int)Match::HISTORY_FULL, (int)tourney.GetHistoryPolicy());
+	
+	// Large ones only keep summaries
+	for (int i = 0 ; i < 45 ; i++)
+		tourney.AddPlayer(&player);
+	CHECK(tourney.GetNumMatches() > Tournament::fullHistoryMatches);
+	CHECK_EQUAL((int)Match::HISTORY_SUMMARY, (int)tourney.GetHistoryPolicy());
+	
+	// Histories on disk read back properly
+	Tournament small(&game);
+	small.AddPlayer(&player);
+	small.AddPlayer(&player);
+	small.SetHistoryPolicy(Match::HISTORY_DISK);
+	CHECK(small.Run());
+	
+	wxArrayString histories[5];
+	Match *match = small.GetMatch(1);
+	CHECK(match->GetHistory(&game, histories));
+	CHECK_EQUAL(match->GetGameLength(4), (int)histories[4].size());
+	CHECK_EQUAL(wxString(wxT("CC")), histories[4][0]);
+}
+
+TEST(Tournament, Rescore)
+{
+	PrisonerDilemma game, chicken(PayoffTable(4, 3, 0, 1));
+	FSAPlayer tft, alld, allc;
+	Tournament tourney(&game), direct(&chicken);
+	
+	CHECK(tft.LoadFromString(&game, wxT("Charles Pence\nTit-for-Tat\n2\nC, 0, 1\nD, 0, 1")));
+	CHECK(alld.LoadFromString(&game, wxT("Charles Pence\nAll-D\n1\nD, 0, 0")));
+	CHECK(allc.LoadFromString(&game, wxT("Charles Pence\nAll-C\n1\nC, 0, 0")));
+	tourney.AddPlayer(&tft);
+	tourney.AddPlayer(&alld);
+	tourney.AddPlayer(&allc);
+	direct.AddPlayer(&tft);
+	direct.AddPlayer(&alld);
+	direct.AddPlayer(&allc);
+	
+	// Not until it's been played
+	CHECK(!tourney.Rescore(PayoffTable(4, 3, 0, 1)));
+	
+	// Rescoring for chicken gives the scores of playing chicken
+	CHECK(tourney.Run());
+	CHECK(direct.Run());
+	CHECK(tourney.Rescore(PayoffTable(4, 3, 0, 1)));
+	CHECK_EQUAL(direct.scores[tft.GetID()], tourney.scores[tft.GetID()]);
+	CHECK_EQUAL(direct.scores[alld.GetID()], tourney.scores[alld.GetID()]);
+	CHECK_EQUAL(direct.scores[allc.GetID()], tourney.scores[allc.GetID()]);
+	
+	// ...and back again
+	int before = tourney.scores[alld.GetID()];
+	CHECK(tourney.Rescore(PayoffTable()));
+	CHECK(tourney.scores[alld.GetID()] != before);
+	CHECK(direct.Rescore(PayoffTable()));
+	CHECK_EQUAL(direct.scores[alld.GetID()], tourney.scores[alld.GetID()]);
+	
+	// Matches which kept nothing can't be rescored
+	tourney.SetHistoryPolicy(Match::HISTORY_NONE);
+	CHECK(tourney.Run());
+	CHECK(!tourney.Rescore(PayoffTable(4, 3, 0, 1)));
+}
+
 #endif
 /** \endcond */
 
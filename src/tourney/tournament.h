@@ -29,15 +29,26 @@
     with one winner using five-game matches, while the \c EvoTournament is
     an "evolutionary" tournament in which the score of each player after
     each match determines each player's fraction in the next "generation"
-    of players.
+    of players.  The \c GeneticTournament breeds new finite state machines,
+    rather than playing a fixed set of them.  The \c LatticeTournament and
+    \c NetworkTournament evolve populations in which each individual only
+    meets its neighbors, on a grid or on an arbitrary network.  A
+    \c Sweep runs round-robin tournaments between the same players under
+    many different payoffs, noise levels and game lengths.  The
+    \c TwoPopulationTournament evolves separate populations for the two
+    roles of an asymmetric game against each other.
 */
 
 #ifndef TOURNEY_TOURNAMENT_H__
 #define TOURNEY_TOURNAMENT_H__
 
+#include <wx/thread.h>
+
 #include "../game/player.h"
 #include "../tourney/match.h"
 class Game;
+class Progress;
+struct PayoffTable;
 
 
 /**
@@ -56,6 +67,10 @@ class Game;
     
     The individual matches are then run, and the scores are accumulated in
     the \c scores member, which can be queried to determine the results.
+    
+    Unless told otherwise with SetHistoryPolicy(), large tournaments
+    only keep a summary of each match, and the moves are replayed when
+    they're asked for (see \c Match::GetHistory).
 */
 class Tournament
 {
@@ -84,6 +99,16 @@ public:
 	    \param player Player to be cloned and added to the tournament
 	*/
 	void AddPlayer(const Player *player);
+	
+	/**
+	    \brief Add a number of players to the internal list
+	    
+	    Like AddPlayer(), but the match list is only rebuilt once,
+	    after all of the players have been added.
+	    
+	    \param players Players to be cloned and added to the tournament
+	*/
+	void AddPlayers(const PlayerPtrArray &players);
 
 	/**
 	    \brief Remove a player like this from the internal list
@@ -108,9 +133,23 @@ public:
 	    Run the actual matches in the tournament, accumulating the
 	    player scores into the \c scores member.
 	    
+	    This may be called on a worker thread.  Matches are played in
+	    order, and each match's scores are added (holding GetLock()) as
+	    soon as it finishes, so the scores always reflect exactly the
+	    first GetNumMatchesPlayed() matches.  If \p progress is cancelled,
+	    the tournament stops after the current match and fails, and is
+	    not marked as played.
+	    
+	    A tournament which has already been played (or started) is
+	    reset first, which rebuilds the match list.  If the matches are
+	    read on another thread while it runs, call Reset() on that
+	    thread before starting it instead.
+	    
+	    \param progress If not \c NULL, counts the matches played and
+	                    may be used to cancel the tournament
 	    \returns True if the tournament ran successfully, false otherwise
 	*/
-	bool Run();
+	bool Run(Progress *progress = NULL);
 
 	/**
 	    \brief Reset all internal data
@@ -120,6 +159,48 @@ public:
 	*/
 	void Reset();
 	
+	/**
+	    \brief Recompute the scores for different payoffs
+	    
+	    Rebuilds \c scores as if the tournament had been played with a
+	    prisoner's dilemma with the given payoffs, from the counts of
+	    each pair of moves kept by the matches (see
+	    \c Match::Rescore), without playing any turns.  The game itself
+	    isn't changed.  The tournament must have been played with a
+	    two-move game, and a history policy other than
+	    \c Match::HISTORY_NONE.
+	    
+	    \param payoffs The new payoffs
+	    \returns True if the tournament was rescored, false otherwise
+	              (in which case the scores are unchanged)
+	*/
+	bool Rescore(const PayoffTable &payoffs);
+	
+	/**
+	    \brief Set how much of each match's history is kept
+	    
+	    This takes effect the next time the tournament is run.
+	    
+	    \param policy The history policy for every match
+	*/
+	void SetHistoryPolicy(Match::HistoryPolicy policy);
+	
+	/**
+	    \brief Get the history policy for the matches
+	    
+	    If no policy has been set, tournaments with more than
+	    \c fullHistoryMatches matches keep a summary of each match, and
+	    smaller ones keep everything.
+	    
+	    \returns The history policy
+	*/
+	Match::HistoryPolicy GetHistoryPolicy() const;
+	
+	/**
+	    \brief Largest tournament which keeps every move by default
+	*/
+	static const int fullHistoryMatches = 1000;
+	
 	
 	/**
 	    \brief Has the tournament been played?
@@ -139,6 +220,23 @@ public:
 	*/
 	int GetNumMatches() const {return matches.size();}
 	
+	/**
+	    \brief Get the number of matches that have been played so far
+	    
+	    Hold GetLock() while calling this if the tournament may be
+	    running on another thread.
+	    
+	    \returns Number of matches played
+	*/
+	int GetNumMatchesPlayed() const {return numPlayed;}
+	
+	/**
+	    \brief Get the lock which protects the scores while the
+	           tournament is running
+	    \returns The lock
+	*/
+	wxCriticalSection &GetLock() {return lock;}
+	
 	/**
 	    \brief Get a given match from the matches array
 	    
@@ -179,7 +277,8 @@ private:
 	    \brief Recompute the list of matches
 	    
 	    Calculates the round-robin match list, with one match between
-	    each pair of players.  See the \c matches member.
+	    each pair of players, ordered by a \c MatchPlanner.  See the
+	    \c matches member.
 	*/
 	void RecalculateMatchList();
 	
@@ -189,6 +288,32 @@ private:
 	*/
 	bool played;
 	
+	/**
+	    \brief The number of matches played so far
+	*/
+	int numPlayed;
+	
+	/**
+	    \brief Lock protecting \c scores and \c numPlayed
+	*/
+	wxCriticalSection lock;
+	
+	/**
+	    \brief The history policy set by SetHistoryPolicy()
+	*/
+	Match::HistoryPolicy historyPolicy;
+	
+	/**
+	    \brief True if SetHistoryPolicy() has been called
+	*/
+	bool historyPolicySet;
+	
+	/**
+	    \brief File holding the moves when they're kept on disk, or
+	           \c NULL
+	*/
+	MatchHistoryFile *historyFile;
+	
 	
 	/**
 	    \brief List of all matches to be played
@@ -0,0 +1,1048 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#ifdef BUILD_TESTS
+#  include <TestHarness.h>
+#endif
+
+#include <wx/filename.h>
+
+#include "../common/error.h"
+#include "../common/outputfile.h"
+#include "trajectory.h"
+
+
+// Every this many stored rows, a compressed row is stored in full
+static const size_t keyRowInterval = 256;
+
+// Fractions are stored (when compressed) as multiples of 2^-30
+static const double quantum = 1073741824.0;
+
+static const size_t noRow = (size_t)-1;
+
+
+// The header of a saved trajectory, followed by the last row, the
+// encoder state, and the uncompressed values, compressed bytes and
+// key-row offsets stored since the ones already saved
+struct TrajectoryHeader
+{
+	wxUint64 numPlayers;
+	wxUint64 numGenerations;
+	wxUint64 numStored;
+	wxUint64 firstValue;
+	wxUint64 numValues;
+	wxUint64 firstByte;
+	wxUint64 numBytes;
+	wxUint64 firstKeyRow;
+	wxUint64 numKeyRows;
+	wxUint32 interval;
+	wxUint32 compressed;
+};
+
+template <typename T>
+static void WriteArray(OutputFile &out, const std::vector<T> &array, size_t first = 0)
+{
+	if (array.size() > first)
+		out.Write((const char *)&array[first], (array.size() - first) * sizeof(T));
+}
+
+// Read count more elements onto the end of array
+template <typename T>
+static bool ReadArray(const wxUint8 *&data, const wxUint8 *end, std::vector<T> &array, wxUint64 count)
+{
+	if (count > (wxUint64)(end - data) / sizeof(T))
+		return false;
+	
+	size_t first = array.size();
+	array.resize(first + count);
+	if (count)
+		memcpy(&array[first], data, count * sizeof(T));
+	data += count * sizeof(T);
+	
+	return true;
+}
+
+
+static void PutVarint(std::vector<wxUint8> &bytes, wxUint32 value)
+{
+	while (value >= 0x80)
+	{
+		bytes.push_back((wxUint8)(value | 0x80));
+		value >>= 7;
+	}
+	bytes.push_back((wxUint8)value);
+}
+
+static wxUint32 GetVarint(const std::vector<wxUint8> &bytes, size_t &offset)
+{
+	wxUint32 value = 0;
+	int shift = 0;
+	
+	while (bytes[offset] & 0x80)
+	{
+		value |= (wxUint32)(bytes[offset++] & 0x7F) << shift;
+		shift += 7;
+	}
+	value |= (wxUint32)bytes[offset++] << shift;
+	
+	return value;
+}
+
+// Like GetVarint(), but fails rather than reading past the end of
+// the bytes, or taking more bytes than a 32-bit value needs
+static bool CheckVarint(const std::vector<wxUint8> &bytes, size_t &offset, wxUint32 &value)
+{
+	value = 0;
+	
+	for (int shift = 0 ; shift < 35 && offset < bytes.size() ; shift += 7)
+	{
+		wxUint8 b = bytes[offset++];
+		value |= (wxUint32)(b & 0x7F) << shift;
+		
+		if (!(b & 0x80))
+			return true;
+	}
+	
+	return false;
+}
+
+// Zig-zag encoding, so that small negative changes are small numbers
+static wxUint32 ZigZag(wxInt32 value)
+{ return ((wxUint32)value << 1) ^ (wxUint32)(value >> 31); }
+
+static wxInt32 UnZigZag(wxUint32 value)
+{ return (wxInt32)(value >> 1) ^ -(wxInt32)(value & 1); }
+
+
+Trajectory::Trajectory() : numPlayers(0), interval(1), compressed(false)
+{
+	Clear();
+}
+
+
+void Trajectory::SetNumPlayers(size_t players)
+{
+	numPlayers = players;
+	Clear();
+}
+
+void Trajectory::Clear()
+{
+	numGenerations = 0;
+	numStored = 0;
+	
+	values.clear();
+	lastRow.assign(numPlayers, 0.0f);
+	
+	bytes.clear();
+	keyRows.clear();
+	encodeState.assign(numPlayers, 0);
+	
+	decodeState.assign(numPlayers, 0);
+	decodeRow = noRow;
+	decodeOffset = 0;
+	rowBuffer.assign(numPlayers, 0.0f);
+}
+
+void Trajectory::SetSampleInterval(unsigned int newInterval)
+{
+	interval = newInterval ? newInterval : 1;
+	Clear();
+}
+
+void Trajectory::SetCompressed(bool compress)
+{
+	compressed = compress;
+	Clear();
+}
+
+
+void Trajectory::Add(const std::vector<double> &fractions)
+{
+	for (size_t i = 0 ; i < numPlayers ; i++)
+		lastRow[i] = fractions[i];
+	
+	if (IsSampled(numGenerations))
+	{
+		if (compressed)
+		{
+			std::vector<wxInt32> row(numPlayers);
+			for (size_t i = 0 ; i < numPlayers ; i++)
+			{
+				double x = fractions[i];
+				if (x < 0.0)
+					x = 0.0;
+				else if (x > 1.0)
+					x = 1.0;
+				
+				row[i] = (wxInt32)(x * quantum + 0.5);
+			}
+			
+			Encode(row);
+		}
+		else
+			values.insert(values.end(), lastRow.begin(), lastRow.end());
+		
+		numStored++;
+	}
+	
+	numGenerations++;
+}
+
+
+size_t Trajectory::GetNumRows() const
+{
+	// The latest generation gets a row of its own if it wasn't sampled
+	if (numGenerations && !IsSampled(numGenerations - 1))
+		return numStored + 1;
+	return numStored;
+}
+
+size_t Trajectory::GetGeneration(size_t row) const
+{
+	if (row >= numStored)
+		return numGenerations - 1;
+	return row * interval;
+}
+
+const float *Trajectory::GetRow(size_t row) const
+{
+	if (!numPlayers)
+		return NULL;
+	
+	if (row >= numStored)
+		return &lastRow[0];
+	
+	if (!compressed)
+		return &values[row * numPlayers];
+	
+	Decode(row);
+	return &rowBuffer[0];
+}
+
+size_t Trajectory::GetMemoryUsage() const
+{
+	return values.size() * sizeof(float) + bytes.size() + keyRows.size() * sizeof(size_t);
+}
+
+
+void Trajectory::Save(OutputFile &out) const
+{
+	TrajectoryMark mark;
+	Save(out, mark);
+}
+
+void Trajectory::Save(OutputFile &out, TrajectoryMark &mark) const
+{
+	TrajectoryHeader header;
+	memset(&header, 0, sizeof(TrajectoryHeader));
+	header.numPlayers = numPlayers;
+	header.numGenerations = numGenerations;
+	header.numStored = numStored;
+	header.firstValue = mark.numValues;
+	header.numValues = values.size() - mark.numValues;
+	header.firstByte = mark.numBytes;
+	header.numBytes = bytes.size() - mark.numBytes;
+	header.firstKeyRow = mark.numKeyRows;
+	header.numKeyRows = keyRows.size() - mark.numKeyRows;
+	header.interval = interval;
+	header.compressed = compressed ? 1 : 0;
+	
+	out.Write((const char *)&header, sizeof(TrajectoryHeader));
+	WriteArray(out, lastRow);
+	WriteArray(out, encodeState);
+	WriteArray(out, values, mark.numValues);
+	WriteArray(out, bytes, mark.numBytes);
+	
+	std::vector<wxUint64> keys(keyRows.begin() + mark.numKeyRows, keyRows.end());
+	WriteArray(out, keys);
+	
+	mark.numValues = values.size();
+	mark.numBytes = bytes.size();
+	mark.numKeyRows = keyRows.size();
+}
+
+bool Trajectory::Load(const wxUint8 *&data, const wxUint8 *end)
+{
+	TrajectoryHeader header;
+	if ((size_t)(end - data) < sizeof(TrajectoryHeader))
+		return false;
+	memcpy(&header, data, sizeof(TrajectoryHeader));
+	
+	// Either start over, or carry on from exactly where we are
+	bool replace = !header.firstValue && !header.firstByte && !header.firstKeyRow;
+	if (replace)
+	{
+		// Each player takes up room in the saved data
+		if (header.numPlayers > (wxUint64)(end - data) / (sizeof(float) + sizeof(wxInt32)))
+			return false;
+		
+		numPlayers = header.numPlayers;
+		interval = header.interval ? header.interval : 1;
+		compressed = (header.compressed != 0);
+		Clear();
+	}
+	else if (header.numPlayers != numPlayers || header.interval != interval ||
+	         (header.compressed != 0) != compressed || header.firstValue != values.size() ||
+	         header.firstByte != bytes.size() || header.firstKeyRow != keyRows.size() ||
+	         header.numStored < numStored || header.numGenerations < numGenerations)
+		return false;
+	
+	// Remember where we were, to put things back if this fails
+	size_t oldStored = numStored, oldValues = values.size(), oldBytes = bytes.size();
+	size_t oldKeyRows = keyRows.size();
+	std::vector<float> oldLastRow(lastRow);
+	std::vector<wxInt32> oldEncodeState(encodeState);
+	
+	const wxUint8 *pos = data + sizeof(TrajectoryHeader);
+	std::vector<wxUint64> keys;
+	
+	lastRow.clear();
+	encodeState.clear();
+	bool ok = ReadArray(pos, end, lastRow, header.numPlayers) &&
+	          ReadArray(pos, end, encodeState, header.numPlayers) &&
+	          ReadArray(pos, end, values, header.numValues) &&
+	          ReadArray(pos, end, bytes, header.numBytes) &&
+	          ReadArray(pos, end, keys, header.numKeyRows);
+	
+	// Check that the rows are all there
+	if (ok)
+	{
+		keyRows.insert(keyRows.end(), keys.begin(), keys.end());
+		
+		if (compressed)
+			ok = (values.empty() && keyRows.size() == (header.numStored + keyRowInterval - 1) / keyRowInterval);
+		else if (header.numPlayers)
+			ok = (bytes.empty() && values.size() % header.numPlayers == 0 &&
+			      values.size() / header.numPlayers == header.numStored);
+		else
+			ok = (bytes.empty() && values.empty());
+		
+		ok = ok && header.numStored <= header.numGenerations &&
+		     header.numStored == (header.numGenerations + interval - 1) / interval;
+	}
+	
+	if (ok)
+	{
+		numStored = header.numStored;
+		
+		// Decode() trusts the rows, so go through the new ones once here
+		ok = !compressed || CheckRows(oldStored, oldBytes, oldEncodeState);
+	}
+	
+	if (!ok)
+	{
+		if (replace)
+			Clear();
+		else
+		{
+			numStored = oldStored;
+			values.resize(oldValues);
+			bytes.resize(oldBytes);
+			keyRows.resize(oldKeyRows);
+			lastRow = oldLastRow;
+			encodeState = oldEncodeState;
+		}
+		
+		return false;
+	}
+	
+	numGenerations = header.numGenerations;
+	data = pos;
+	
+	// Start decoding over, as the rows may have been replaced
+	decodeRow = noRow;
+	
+	return true;
+}
+
+
+void Trajectory::Encode(const std::vector<wxInt32> &row)
+{
+	if ((numStored % keyRowInterval) == 0)
+	{
+		// Key rows are stored in full
+		keyRows.push_back(bytes.size());
+		
+		for (size_t i = 0 ; i < numPlayers ; i++)
+			PutVarint(bytes, (wxUint32)row[i]);
+	}
+	else
+	{
+		// Other rows are the number of players that changed, then the
+		// gap since the last changed player and the change for each
+		size_t numChanged = 0;
+		for (size_t i = 0 ; i < numPlayers ; i++)
+			if (row[i] != encodeState[i])
+				numChanged++;
+		
+		PutVarint(bytes, (wxUint32)numChanged);
+		
+		size_t next = 0;
+		for (size_t i = 0 ; i < numPlayers ; i++)
+		{
+			if (row[i] == encodeState[i])
+				continue;
+			
+			PutVarint(bytes, (wxUint32)(i - next));
+			PutVarint(bytes, ZigZag(row[i] - encodeState[i]));
+			next = i + 1;
+		}
+	}
+	
+	encodeState = row;
+}
+
+bool Trajectory::CheckRows(size_t firstRow, size_t offset, const std::vector<wxInt32> &startState) const
+{
+	std::vector<wxInt64> state(startState.begin(), startState.end());
+	wxUint32 value;
+	
+	for (size_t row = firstRow ; row < numStored ; row++)
+	{
+		if ((row % keyRowInterval) == 0)
+		{
+			if (keyRows[row / keyRowInterval] != offset)
+				return false;
+			
+			for (size_t i = 0 ; i < numPlayers ; i++)
+			{
+				if (!CheckVarint(bytes, offset, value) || value > quantum)
+					return false;
+				state[i] = value;
+			}
+			
+			continue;
+		}
+		
+		if (!CheckVarint(bytes, offset, value) || value > numPlayers)
+			return false;
+		
+		size_t numChanged = value, next = 0;
+		for (size_t c = 0 ; c < numChanged ; c++)
+		{
+			if (!CheckVarint(bytes, offset, value) || value >= numPlayers - next)
+				return false;
+			
+			size_t i = next + value;
+			if (!CheckVarint(bytes, offset, value))
+				return false;
+			
+			// Every fraction stays between zero and one
+			state[i] += UnZigZag(value);
+			if (state[i] < 0 || state[i] > quantum)
+				return false;
+			
+			next = i + 1;
+		}
+	}
+	
+	if (offset != bytes.size())
+		return false;
+	
+	// New rows are encoded against the last one stored
+	for (size_t i = 0 ; i < numPlayers ; i++)
+		if (state[i] != encodeState[i])
+			return false;
+	
+	return true;
+}
+
+void Trajectory::Decode(size_t row) const
+{
+	size_t key = row / keyRowInterval;
+	
+	// Start over from the key row, unless we can pick up from the last
+	// row decoded
+	if (decodeRow == noRow || decodeRow > row || decodeRow / keyRowInterval != key)
+	{
+		decodeOffset = keyRows[key];
+		for (size_t i = 0 ; i < numPlayers ; i++)
+			decodeState[i] = (wxInt32)GetVarint(bytes, decodeOffset);
+		
+		decodeRow = key * keyRowInterval;
+	}
+	
+	while (decodeRow < row)
+	{
+		size_t numChanged = GetVarint(bytes, decodeOffset);
+		size_t next = 0;
+		
+		for (size_t c = 0 ; c < numChanged ; c++)
+		{
+			size_t i = next + GetVarint(bytes, decodeOffset);
+			decodeState[i] += UnZigZag(GetVarint(bytes, decodeOffset));
+			next = i + 1;
+		}
+		
+		decodeRow++;
+	}
+	
+	for (size_t i = 0 ; i < numPlayers ; i++)
+		rowBuffer[i] = (float)(decodeState[i] / quantum);
+}
+
+
+// The finest level of a pyramid has blocks of this many rows
+static const size_t pyramidBlockRows = 16;
+
+
+size_t TrajectoryPyramid::BlockRows(size_t level) const
+{
+	return pyramidBlockRows << level;
+}
+
+void TrajectoryPyramid::Build(const Trajectory &data)
+{
+	Clear();
+	Update(data);
+}
+
+void TrajectoryPyramid::Update(const Trajectory &data)
+{
+	size_t newRows = data.GetNumRows();
+	if (data.GetNumPlayers() != numPlayers || newRows < numRows)
+		Clear();
+	
+	numPlayers = data.GetNumPlayers();
+	if (!numPlayers || !newRows)
+	{
+		numRows = newRows;
+		return;
+	}
+	
+	// The last row summarized may have been the latest generation, which
+	// changes until it's sampled, so its block is summarized again
+	size_t firstBlock = numRows ? (numRows - 1) / pyramidBlockRows : 0;
+	size_t numBlocks = (newRows + pyramidBlockRows - 1) / pyramidBlockRows;
+	
+	// The finest level comes straight from the trajectory, read in order
+	if (levels.empty())
+		levels.push_back(std::vector<float>());
+	levels[0].resize(numBlocks * numPlayers * 2);
+	std::vector<float> &first = levels[0];
+	
+	for (size_t row = firstBlock * pyramidBlockRows ; row < newRows ; row++)
+	{
+		const float *values = data.GetRow(row);
+		float *block = &first[(row / pyramidBlockRows) * numPlayers * 2];
+		bool start = (row % pyramidBlockRows) == 0;
+		
+		for (size_t p = 0 ; p < numPlayers ; p++)
+		{
+			if (start || values[p] < block[p * 2])
+				block[p * 2] = values[p];
+			if (start || values[p] > block[p * 2 + 1])
+				block[p * 2 + 1] = values[p];
+		}
+	}
+	
+	numRows = newRows;
+	
+	// Each coarser level combines pairs of blocks from the one before,
+	// and only those which take in a changed block need doing again
+	for (size_t level = 1 ; numBlocks > 1 ; level++)
+	{
+		size_t coarseBlocks = (numBlocks + 1) / 2;
+		firstBlock /= 2;
+		
+		if (levels.size() == level)
+			levels.push_back(std::vector<float>());
+		levels[level].resize(coarseBlocks * numPlayers * 2);
+		
+		const std::vector<float> &fine = levels[level - 1];
+		std::vector<float> &coarse = levels[level];
+		
+		for (size_t b = firstBlock ; b < coarseBlocks ; b++)
+		{
+			const float *left = &fine[(b * 2) * numPlayers * 2];
+			const float *right = (b * 2 + 1 < numBlocks) ? left + numPlayers * 2 : left;
+			float *out = &coarse[b * numPlayers * 2];
+			
+			for (size_t i = 0 ; i < numPlayers ; i++)
+			{
+				out[i * 2] = wxMin(left[i * 2], right[i * 2]);
+				out[i * 2 + 1] = wxMax(left[i * 2 + 1], right[i * 2 + 1]);
+			}
+		}
+		
+		numBlocks = coarseBlocks;
+	}
+}
+
+void TrajectoryPyramid::Clear()
+{
+	numRows = 0;
+	numPlayers = 0;
+	levels.clear();
+}
+
+void TrajectoryPyramid::Reduce(const Trajectory &data, size_t player, size_t firstRow, size_t endRow,
+                               size_t numColumns, std::vector<double> &generations,
+                               std::vector<float> &values) const
+{
+	generations.clear();
+	values.clear();
+	
+	if (endRow > data.GetNumRows())
+		endRow = data.GetNumRows();
+	if (firstRow >= endRow || !numColumns)
+		return;
+	
+	size_t count = endRow - firstRow;
+	
+	// Few enough rows to draw them all
+	if (count <= numColumns * 2)
+	{
+		for (size_t row = firstRow ; row < endRow ; row++)
+		{
+			generations.push_back(data.GetGeneration(row));
+			values.push_back(data.GetRow(row)[player]);
+		}
+		return;
+	}
+	
+	// Use the coarsest level whose blocks fit inside a column; a column
+	// may then take in a little more than its own range, which can only
+	// widen its extremes
+	size_t rowsPerColumn = count / numColumns;
+	size_t level = 0;
+	bool useLevels = (rowsPerColumn >= pyramidBlockRows && numRows == data.GetNumRows() && !levels.empty());
+	
+	if (useLevels)
+	{
+		while (level + 1 < levels.size() && BlockRows(level + 1) <= rowsPerColumn)
+			level++;
+	}
+	
+	size_t blockRows = BlockRows(level);
+	float last = 0.0f;
+	
+	for (size_t c = 0 ; c < numColumns ; c++)
+	{
+		size_t columnStart = firstRow + (c * count) / numColumns;
+		size_t columnEnd = firstRow + ((c + 1) * count) / numColumns;
+		float low, high;
+		
+		if (useLevels)
+		{
+			size_t blockStart = columnStart / blockRows;
+			size_t blockEnd = (columnEnd + blockRows - 1) / blockRows;
+			
+			low = levels[level][(blockStart * numPlayers + player) * 2];
+			high = levels[level][(blockStart * numPlayers + player) * 2 + 1];
+			
+			for (size_t b = blockStart + 1 ; b < blockEnd ; b++)
+			{
+				low = wxMin(low, levels[level][(b * numPlayers + player) * 2]);
+				high = wxMax(high, levels[level][(b * numPlayers + player) * 2 + 1]);
+			}
+		}
+		else
+		{
+			// Too fine for the pyramid, so read the rows themselves
+			low = high = data.GetRow(columnStart)[player];
+			
+			for (size_t row = columnStart + 1 ; row < columnEnd ; row++)
+			{
+				float v = data.GetRow(row)[player];
+				low = wxMin(low, v);
+				high = wxMax(high, v);
+			}
+		}
+		
+		// Draw the end nearest the last column first
+		double generation = data.GetGeneration(columnStart);
+		bool highFirst = (c > 0) && (fabs(high - last) < fabs(low - last));
+		
+		generations.push_back(generation);
+		values.push_back(highFirst ? high : low);
+		generations.push_back(generation);
+		values.push_back(highFirst ? low : high);
+		
+		last = values.back();
+	}
+}
+
+
+bool TrajectoryColumns::Open(const Trajectory &data, size_t blockValues)
+{
+	Close();
+	
+	numPlayers = data.GetNumPlayers();
+	numRows = data.GetNumRows();
+	if (!numPlayers || !numRows)
+		return true;
+	
+	blockRows = blockValues / numPlayers;
+	if (!blockRows)
+		blockRows = 1;
+	
+	size_t numBlocks = GetNumBlocks();
+	buffer.resize(GetBlockRows(0) * numPlayers);
+	
+	OutputFile out;
+	if (numBlocks > 1)
+	{
+		tempName = wxFileName::CreateTempFileName(wxT("oyun"));
+		if (tempName.IsEmpty())
+		{
+			Error::Set(_("Could not create a temporary file"));
+			Close();
+			return false;
+		}
+		
+		// Error already set in OutputFile::Open()
+		if (!out.Open(tempName))
+		{
+			Close();
+			return false;
+		}
+	}
+	
+	// Decode every row once, in order
+	for (size_t b = 0 ; b < numBlocks ; b++)
+	{
+		size_t rows = GetBlockRows(b), first = b * blockRows;
+		
+		for (size_t r = 0 ; r < rows ; r++)
+		{
+			const float *row = data.GetRow(first + r);
+			for (size_t p = 0 ; p < numPlayers ; p++)
+				buffer[p * rows + r] = row[p];
+		}
+		
+		if (numBlocks > 1)
+			out.Write((const char *)&buffer[0], rows * numPlayers * sizeof(float));
+	}
+	
+	if (numBlocks == 1)
+	{
+		base = &buffer[0];
+		return true;
+	}
+	
+	// Errors already set in OutputFile::Close() and MappedFile::Open()
+	std::vector<float>().swap(buffer);
+	if (!out.Close() || !file.Open(tempName))
+	{
+		Close();
+		return false;
+	}
+	
+	base = (const float *)file.GetData();
+	return true;
+}
+
+void TrajectoryColumns::Close()
+{
+	file.Close();
+	if (!tempName.IsEmpty())
+		wxRemoveFile(tempName);
+	tempName.Clear();
+	
+	std::vector<float>().swap(buffer);
+	base = NULL;
+	numPlayers = numRows = blockRows = 0;
+}
+
+
+/** \cond TEST */
+#ifdef BUILD_TESTS
+
+TEST(Trajectory, Sampling)
+{
+	Trajectory trajectory;
+	trajectory.SetNumPlayers(2);
+	trajectory.SetSampleInterval(10);
+	
+	std::vector<double> x(2);
+	for (int gen = 0 ; gen < 25 ; gen++)
+	{
+		x[0] = gen / 100.0;
+		x[1] = 1.0 - x[0];
+		trajectory.Add(x);
+	}
+	
+	// Generations 0, 10, 20, and the last one
+	CHECK_EQUAL(25, (int)trajectory.GetNumGenerations());
+	CHECK_EQUAL(4, (int)trajectory.GetNumRows());
+	CHECK_EQUAL(10, (int)trajectory.GetGeneration(1));
+	CHECK_EQUAL(24, (int)trajectory.GetGeneration(3));
+	CHECK_EQUAL(0.2f, trajectory.Get(2, 0));
+	CHECK_EQUAL(0.76f, trajectory.Get(3, 1));
+	
+	// The last generation doesn't get two rows
+	trajectory.Clear();
+	for (int gen = 0 ; gen < 21 ; gen++)
+		trajectory.Add(x);
+	CHECK_EQUAL(3, (int)trajectory.GetNumRows());
+	CHECK_EQUAL(20, (int)trajectory.GetGeneration(2));
+}
+
+TEST(Trajectory, Compression)
+{
+	Trajectory plain, packed;
+	plain.SetNumPlayers(7);
+	packed.SetNumPlayers(7);
+	packed.SetCompressed(true);
+	
+	// A population that wanders for a while, and then settles down
+	std::vector<double> x(7);
+	for (int gen = 0 ; gen < 10000 ; gen++)
+	{
+		double t = (gen < 300) ? gen : 300;
+		double sum = 0.0;
+		
+		for (int i = 0 ; i < 7 ; i++)
+		{
+			x[i] = 1.0 + sin(t * (i + 1) / 50.0);
+			sum += x[i];
+		}
+		for (int i = 0 ; i < 7 ; i++)
+			x[i] /= sum;
+		
+		plain.Add(x);
+		packed.Add(x);
+	}
+	
+	CHECK_EQUAL(plain.GetNumRows(), packed.GetNumRows());
+	CHECK(packed.GetMemoryUsage() < plain.GetMemoryUsage() / 10);
+	
+	// Read backwards, to make sure random access works
+	bool same = true;
+	for (size_t row = plain.GetNumRows() ; row-- > 0 ; )
+		for (size_t i = 0 ; i < 7 ; i++)
+			if (fabs(plain.Get(row, i) - packed.Get(row, i)) > 1e-7)
+				same = false;
+	CHECK(same);
+}
+
+TEST(Trajectory, Load)
+{
+	Trajectory trajectory, loaded;
+	trajectory.SetNumPlayers(3);
+	trajectory.SetCompressed(true);
+	
+	std::vector<double> x(3);
+	for (int gen = 0 ; gen < 600 ; gen++)
+	{
+		x[0] = (gen % 7) / 10.0;
+		x[1] = (gen % 3) / 10.0;
+		x[2] = 1.0 - x[0] - x[1];
+		trajectory.Add(x);
+	}
+	
+	wxString tempName = wxFileName::CreateTempFileName(wxT("oyun"));
+	OutputFile out;
+	CHECK(out.Open(tempName));
+	trajectory.Save(out);
+	CHECK(out.Close());
+	
+	MappedFile mapping;
+	CHECK(mapping.Open(tempName));
+	std::vector<wxUint8> file(mapping.GetData(), mapping.GetData() + mapping.GetSize());
+	mapping.Close();
+	wxRemoveFile(tempName);
+	
+	const wxUint8 *pos = &file[0];
+	CHECK(loaded.Load(pos, pos + file.size()));
+	CHECK(pos == &file[0] + file.size());
+	CHECK_EQUAL(trajectory.GetNumRows(), loaded.GetNumRows());
+	CHECK_EQUAL(trajectory.Get(599, 1), loaded.Get(599, 1));
+	
+	// Saving as we go, and loading the pieces in turn, gives back the
+	// same thing
+	Trajectory first, journal;
+	first.SetNumPlayers(3);
+	first.SetCompressed(true);
+	TrajectoryMark mark;
+	
+	wxString journalName = wxFileName::CreateTempFileName(wxT("oyun"));
+	CHECK(out.Open(journalName));
+	for (int gen = 0 ; gen < 600 ; gen++)
+	{
+		first.Add(std::vector<double>(3, (gen % 5) / 10.0));
+		if (gen == 299 || gen == 599)
+			first.Save(out, mark);
+	}
+	CHECK(out.Close());
+	
+	CHECK(mapping.Open(journalName));
+	std::vector<wxUint8> pieces(mapping.GetData(), mapping.GetData() + mapping.GetSize());
+	mapping.Close();
+	wxRemoveFile(journalName);
+	
+	pos = &pieces[0];
+	CHECK(journal.Load(pos, pos + pieces.size()));
+	CHECK_EQUAL(300, (int)journal.GetNumGenerations());
+	CHECK(!journal.Load(pos, pos + (pieces.size() - (pos - &pieces[0])) / 2));
+	CHECK_EQUAL(300, (int)journal.GetNumGenerations());
+	CHECK(journal.Load(pos, &pieces[0] + pieces.size()));
+	CHECK_EQUAL(600, (int)journal.GetNumGenerations());
+	CHECK_EQUAL(first.Get(450, 2), journal.Get(450, 2));
+	
+	// Damaged rows are caught when loading, not when they're read
+	size_t rowStart = sizeof(TrajectoryHeader) + 3 * sizeof(float) + 3 * sizeof(wxInt32);
+	for (size_t i = 0 ; i < 20 ; i++)
+		file[rowStart + 300 + i] = 0xFF;
+	
+	pos = &file[0];
+	CHECK(!loaded.Load(pos, pos + file.size()));
+	CHECK_EQUAL(0, (int)loaded.GetNumRows());
+	
+	// As is a truncated file
+	pos = &file[0];
+	CHECK(!loaded.Load(pos, pos + file.size() / 2));
+}
+
+TEST(TrajectoryPyramid, Reduce)
+{
+	Trajectory trajectory;
+	trajectory.SetNumPlayers(2);
+	
+	// A flat line with a single spike, and a steady climb
+	std::vector<double> x(2);
+	for (int gen = 0 ; gen < 100000 ; gen++)
+	{
+		x[0] = (gen == 54321) ? 0.9 : 0.1;
+		x[1] = gen / 100000.0;
+		trajectory.Add(x);
+	}
+	
+	TrajectoryPyramid pyramid;
+	pyramid.Build(trajectory);
+	CHECK_EQUAL(100000, (int)pyramid.GetNumRows());
+	
+	// The spike survives the reduction
+	std::vector<double> generations;
+	std::vector<float> values;
+	pyramid.Reduce(trajectory, 0, 0, 100000, 500, generations, values);
+	CHECK_EQUAL(1000, (int)values.size());
+	
+	float high = 0.0f;
+	for (size_t i = 0 ; i < values.size() ; i++)
+		high = wxMax(high, values[i]);
+	CHECK_EQUAL(0.9f, high);
+	
+	// ...and so does the climb
+	pyramid.Reduce(trajectory, 1, 0, 100000, 500, generations, values);
+	CHECK_EQUAL(0.0, generations[0]);
+	CHECK_EQUAL(0.0f, values[0]);
+	CHECK(values[999] > 0.99f);
+	CHECK(generations[999] >= generations[998]);
+	
+	// Zoomed in far enough, the rows come back as they are
+	pyramid.Reduce(trajectory, 0, 54300, 54400, 500, generations, values);
+	CHECK_EQUAL(100, (int)values.size());
+	CHECK_EQUAL(54321.0, generations[21]);
+	CHECK_EQUAL(0.9f, values[21]);
+	
+	// In between, the rows are read one column at a time
+	pyramid.Reduce(trajectory, 0, 50000, 60000, 1000, generations, values);
+	CHECK_EQUAL(2000, (int)values.size());
+	high = 0.0f;
+	for (size_t i = 0 ; i < values.size() ; i++)
+		high = wxMax(high, values[i]);
+	CHECK_EQUAL(0.9f, high);
+	
+	// Keeping up with a trajectory as it grows gives the same summary
+	// as building it at the end, even with a sampled last generation
+	Trajectory growing;
+	growing.SetNumPlayers(2);
+	growing.SetSampleInterval(3);
+	
+	TrajectoryPyramid incremental;
+	for (int gen = 0 ; gen < 5000 ; gen++)
+	{
+		x[0] = (gen % 997) / 1000.0;
+		x[1] = 1.0 - x[0];
+		growing.Add(x);
+		
+		if (gen % 37 == 0)
+			incremental.Update(growing);
+	}
+	incremental.Update(growing);
+	pyramid.Build(growing);
+	CHECK_EQUAL((int)growing.GetNumRows(), (int)incremental.GetNumRows());
+	
+	std::vector<double> otherGenerations;
+	std::vector<float> otherValues;
+	pyramid.Reduce(growing, 0, 0, growing.GetNumRows(), 20, generations, values);
+	incremental.Reduce(growing, 0, 0, growing.GetNumRows(), 20, otherGenerations, otherValues);
+	CHECK(generations == otherGenerations);
+	CHECK(values == otherValues);
+}
+
+TEST(TrajectoryColumns, Open)
+{
+	Trajectory trajectory;
+	trajectory.SetNumPlayers(3);
+	trajectory.SetCompressed(true);
+	
+	std::vector<double> x(3);
+	for (int gen = 0 ; gen < 1000 ; gen++)
+	{
+		x[0] = (gen % 101) / 400.0;
+		x[1] = (gen % 7) / 20.0;
+		x[2] = 1.0 - x[0] - x[1];
+		trajectory.Add(x);
+	}
+	
+	// A single block is held in memory, several go through a
+	// temporary file, with a short block at the end
+	size_t sizes[] = { TrajectoryColumns::defaultBlockValues, 3 * 64, 2 };
+	for (size_t s = 0 ; s < sizeof(sizes) / sizeof(sizes[0]) ; s++)
+	{
+		TrajectoryColumns columns;
+		CHECK(columns.Open(trajectory, sizes[s]));
+		
+		size_t row = 0;
+		bool same = true;
+		for (size_t b = 0 ; b < columns.GetNumBlocks() ; b++)
+		{
+			for (size_t p = 0 ; p < 3 ; p++)
+			{
+				const float *column = columns.GetColumn(b, p);
+				for (size_t r = 0 ; r < columns.GetBlockRows(b) ; r++)
+					if (column[r] != trajectory.GetRow(row + r)[p])
+						same = false;
+			}
+			row += columns.GetBlockRows(b);
+		}
+		CHECK(same);
+		CHECK_EQUAL(trajectory.GetNumRows(), row);
+	}
+}
+
+#endif
+/** \endcond */
@@ -0,0 +1,562 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TOURNEY_TRAJECTORY_H__
+#define TOURNEY_TRAJECTORY_H__
+
+#include <vector>
+
+#include "../common/mappedfile.h"
+
+class OutputFile;
+
+
+/**
+    \brief How much of a \c Trajectory has been written out
+    
+    See Trajectory::Save().
+*/
+struct TrajectoryMark
+{
+	/**
+	    \brief Constructor, marking an empty trajectory
+	*/
+	TrajectoryMark() : numValues(0), numBytes(0), numKeyRows(0) { }
+	
+	size_t numValues;	/**< \brief Uncompressed values written */
+	size_t numBytes;	/**< \brief Compressed bytes written */
+	size_t numKeyRows;	/**< \brief Key-row offsets written */
+};
+
+
+/**
+    \class Trajectory
+    \ingroup tourney
+    
+    \brief The population fractions of every player over the course of
+           an evolutionary tournament
+    
+    This is a dense matrix of generations by players, in which each
+    player is identified by its slot (its index in the tournament's
+    \c players array).  Generations are added one at a time with Add().
+    
+    To keep very long runs small, the trajectory can store only every
+    \c k-th generation (see SetSampleInterval()); the most recent
+    generation is always available as the last row, whether or not it
+    falls on the interval.  It can also be delta-compressed (see
+    SetCompressed()), in which case each fraction is stored to a
+    precision of 2<sup>-30</sup>, and each row only as the changes from
+    the row before.  A population that has settled down then costs about
+    one byte per row.  Compressed rows are decoded on demand, which is
+    fastest when they are read in order.
+*/
+class Trajectory
+{
+public:
+	/**
+	    \brief Constructor
+	    
+	    Creates an empty, uncompressed trajectory with no players, which
+	    stores every generation.
+	*/
+	Trajectory();
+	
+	
+	/**
+	    \brief Clear the trajectory and set the number of players
+	    \param players The number of players (columns)
+	*/
+	void SetNumPlayers(size_t players);
+	
+	/**
+	    \brief Remove every generation from the trajectory
+	    
+	    The number of players, the sampling interval, and compression are
+	    kept.
+	*/
+	void Clear();
+	
+	/**
+	    \brief Store only every \p interval-th generation
+	    
+	    This clears the trajectory.
+	    
+	    \param interval Sampling interval (1 stores every generation)
+	*/
+	void SetSampleInterval(unsigned int interval);
+	
+	/**
+	    \brief Get the sampling interval
+	    \returns Sampling interval
+	*/
+	unsigned int GetSampleInterval() const { return interval; }
+	
+	/**
+	    \brief Turn delta compression on or off
+	    
+	    This clears the trajectory.
+	    
+	    \param compress True to compress the trajectory
+	*/
+	void SetCompressed(bool compress);
+	
+	/**
+	    \brief Is the trajectory delta-compressed?
+	    \returns True if compressed, false otherwise
+	*/
+	bool IsCompressed() const { return compressed; }
+	
+	
+	/**
+	    \brief Add the next generation
+	    \param fractions Population fraction of each player
+	*/
+	void Add(const std::vector<double> &fractions);
+	
+	
+	/**
+	    \brief Get the number of players (columns)
+	    \returns Number of players
+	*/
+	size_t GetNumPlayers() const { return numPlayers; }
+	
+	/**
+	    \brief Get the number of generations added
+	    \returns Number of calls to Add() since the trajectory was cleared
+	*/
+	size_t GetNumGenerations() const { return numGenerations; }
+	
+	/**
+	    \brief Get the number of stored generations (rows)
+	    \returns Number of rows
+	*/
+	size_t GetNumRows() const;
+	
+	/**
+	    \brief Get the generation number of a row
+	    
+	    \param row The row
+	    \returns Generation number, counting the first generation added
+	             as zero
+	*/
+	size_t GetGeneration(size_t row) const;
+	
+	/**
+	    \brief Get every player's fraction in a row
+	    
+	    \param row The row
+	    \returns Pointer to the fraction of each player, valid until the
+	             next call to a method of this trajectory
+	*/
+	const float *GetRow(size_t row) const;
+	
+	/**
+	    \brief Get one player's fraction in a row
+	    
+	    \param row The row
+	    \param player Slot of the player
+	    \returns Population fraction of \p player
+	*/
+	float Get(size_t row, size_t player) const { return GetRow(row)[player]; }
+	
+	/**
+	    \brief Get the amount of memory used by the stored rows
+	    \returns Size of the storage, in bytes
+	*/
+	size_t GetMemoryUsage() const;
+	
+	/**
+	    \brief Write the trajectory to a binary file
+	    
+	    The stored rows are written as they are, compressed or not, so
+	    that Load() gives back exactly the same trajectory.
+	    
+	    \param out The file to write to
+	*/
+	void Save(OutputFile &out) const;
+	
+	/**
+	    \brief Write the rows added since the last save
+	    
+	    Only the rows stored since \p mark are written (along with the
+	    latest generation), and \p mark is moved past them.  Loading
+	    each of the saves in turn with Load() gives back the whole
+	    trajectory, so that a long run can be saved by appending to a
+	    file rather than rewriting it.
+	    
+	    \param out The file to write to
+	    \param[in,out] mark How much of the trajectory has already been
+	                        saved
+	*/
+	void Save(OutputFile &out, TrajectoryMark &mark) const;
+	
+	/**
+	    \brief Read a trajectory written by Save()
+	    
+	    If the data was saved from the start of a trajectory, it
+	    replaces this one; otherwise, it must pick up exactly where
+	    this one ends, and its rows are added on.
+	    
+	    \param[in,out] data Pointer to the saved trajectory, advanced
+	                        past it
+	    \param end End of the available data
+	    \returns True if the trajectory was read, false if the data is
+	             truncated or corrupt (in which case rows being added on
+	             are dropped, and a trajectory being replaced is left
+	             empty)
+	*/
+	bool Load(const wxUint8 *&data, const wxUint8 *end);
+
+private:
+	/**
+	    \brief Is this generation stored as a row of its own?
+	    \param generation The generation
+	    \returns True if \p generation falls on the sampling interval
+	*/
+	bool IsSampled(size_t generation) const { return (generation % interval) == 0; }
+	
+	/**
+	    \brief Append a compressed row
+	    \param row The quantized fractions
+	*/
+	void Encode(const std::vector<wxInt32> &row);
+	
+	/**
+	    \brief Decode a compressed row into \c rowBuffer
+	    \param row The row
+	*/
+	void Decode(size_t row) const;
+	
+	/**
+	    \brief Check that compressed rows can be decoded
+	    
+	    Every row from \p firstRow on must lie within \c bytes, change
+	    only players which exist, and start at its key row offset, and
+	    the last row must match \c encodeState.
+	    
+	    \param firstRow The first row to check
+	    \param offset The offset of \p firstRow in \c bytes
+	    \param state The decoded row before \p firstRow
+	    \returns True if the rows are intact, false otherwise
+	*/
+	bool CheckRows(size_t firstRow, size_t offset, const std::vector<wxInt32> &state) const;
+	
+	
+	/**
+	    \brief The number of players
+	*/
+	size_t numPlayers;
+	
+	/**
+	    \brief Sampling interval
+	*/
+	unsigned int interval;
+	
+	/**
+	    \brief True if rows are delta-compressed
+	*/
+	bool compressed;
+	
+	/**
+	    \brief The number of generations added
+	*/
+	size_t numGenerations;
+	
+	/**
+	    \brief The number of sampled rows stored
+	*/
+	size_t numStored;
+	
+	/**
+	    \brief The uncompressed sampled rows, one after another
+	*/
+	std::vector<float> values;
+	
+	/**
+	    \brief The most recently added generation
+	*/
+	std::vector<float> lastRow;
+	
+	
+	/**
+	    \brief The compressed sampled rows
+	*/
+	std::vector<wxUint8> bytes;
+	
+	/**
+	    \brief Offset into \c bytes of every key row
+	    
+	    Every so often, a row is stored in full rather than as changes,
+	    so that decoding a row never has to start from the beginning.
+	*/
+	std::vector<size_t> keyRows;
+	
+	/**
+	    \brief The last row compressed, quantized
+	*/
+	std::vector<wxInt32> encodeState;
+	
+	/**
+	    \brief The last row decoded, quantized
+	*/
+	mutable std::vector<wxInt32> decodeState;
+	
+	/**
+	    \brief The row in \c decodeState, or -1 if none
+	*/
+	mutable size_t decodeRow;
+	
+	/**
+	    \brief Offset into \c bytes just past \c decodeRow
+	*/
+	mutable size_t decodeOffset;
+	
+	/**
+	    \brief The last row decoded, as fractions
+	*/
+	mutable std::vector<float> rowBuffer;
+};
+
+
+/**
+    \class TrajectoryPyramid
+    \ingroup tourney
+    
+    \brief A min/max summary of a \c Trajectory, for drawing it quickly
+    
+    Drawing every generation of a long run is slow, and pointless when
+    there are many more generations than pixels.  This class stores the
+    smallest and largest fraction of each player over blocks of rows,
+    at successively coarser levels (each block twice as long as the
+    last), so that any range of rows can be reduced to two points per
+    pixel column without losing the peaks and valleys in between.
+    
+    Build it once after the tournament has been run, or Update() it
+    while the tournament runs, and then call Reduce() for every redraw.
+*/
+class TrajectoryPyramid
+{
+public:
+	/**
+	    \brief Constructor
+	    
+	    Creates an empty pyramid.
+	*/
+	TrajectoryPyramid() : numRows(0), numPlayers(0) { }
+	
+	/**
+	    \brief Summarize a trajectory
+	    \param data The trajectory
+	*/
+	void Build(const Trajectory &data);
+	
+	/**
+	    \brief Summarize the rows added to a trajectory since the last
+	           call
+	    
+	    Only the blocks taking in new (or the latest generation's) rows
+	    are summarized again, so this is cheap to call while the
+	    trajectory grows.  If the trajectory has been emptied or has a
+	    different number of players, the pyramid is built again.
+	    
+	    \param data The trajectory
+	*/
+	void Update(const Trajectory &data);
+	
+	/**
+	    \brief Empty the pyramid
+	*/
+	void Clear();
+	
+	/**
+	    \brief Get the number of rows in the summarized trajectory
+	    \returns Number of rows
+	*/
+	size_t GetNumRows() const { return numRows; }
+	
+	/**
+	    \brief Reduce a range of one player's fractions to a polyline
+	    
+	    If the range has no more than two rows per column, every row is
+	    returned as it is.  Otherwise, each column gives two points, at
+	    the generation where the column starts: the least and the greatest
+	    fraction within it (in whichever order joins up best with the
+	    column before).
+	    
+	    \param data The trajectory this pyramid was built from
+	    \param player Slot of the player
+	    \param firstRow First row of the range
+	    \param endRow One past the last row of the range
+	    \param numColumns Number of columns (usually pixels) to reduce to
+	    \param[out] generations Generation of each point
+	    \param[out] values Population fraction at each point
+	*/
+	void Reduce(const Trajectory &data, size_t player, size_t firstRow, size_t endRow,
+	            size_t numColumns, std::vector<double> &generations,
+	            std::vector<float> &values) const;
+
+private:
+	/**
+	    \brief Number of rows of the trajectory in one block at a level
+	    \param level The level
+	    \returns Rows per block
+	*/
+	size_t BlockRows(size_t level) const;
+	
+	
+	/**
+	    \brief The number of rows summarized
+	*/
+	size_t numRows;
+	
+	/**
+	    \brief The number of players summarized
+	*/
+	size_t numPlayers;
+	
+	/**
+	    \brief Each level of the pyramid
+	    
+	    Each level holds, for each block and then for each player, the
+	    smallest and then the largest fraction.
+	*/
+	std::vector<std::vector<float> > levels;
+};
+
+
+/**
+    \class TrajectoryColumns
+    \ingroup tourney
+    
+    \brief The rows of a \c Trajectory turned into one column per player
+    
+    Exports write each player's fractions on a line of their own, but a
+    compressed trajectory can only be decoded a whole row at a time, so
+    reading it once per player costs players times rows times players.
+    This class decodes each row once, and sorts the values into
+    columns, a block of rows at a time.  If there is more than one
+    block, they are written to a temporary file, which is mapped back
+    into memory, so only one block is ever held in memory.
+*/
+class TrajectoryColumns
+{
+public:
+	/**
+	    \brief Constructor
+	*/
+	TrajectoryColumns() : numPlayers(0), numRows(0), blockRows(0), base(NULL) { }
+	
+	/**
+	    \brief Destructor
+	    
+	    Removes the temporary file, if there is one.
+	*/
+	~TrajectoryColumns() { Close(); }
+	
+	/**
+	    \brief Most values held in memory at once, unless told otherwise
+	*/
+	static const size_t defaultBlockValues = 4 * 1024 * 1024;
+	
+	/**
+	    \brief Sort a trajectory into columns
+	    
+	    \param data The trajectory
+	    \param blockValues Most values to hold in memory at once
+	    \returns True if the columns are ready, false otherwise
+	*/
+	bool Open(const Trajectory &data, size_t blockValues = defaultBlockValues);
+	
+	/**
+	    \brief Release the columns, and remove the temporary file
+	*/
+	void Close();
+	
+	/**
+	    \brief Get the number of blocks of rows
+	    \returns Number of blocks
+	*/
+	size_t GetNumBlocks() const
+	{ return blockRows ? (numRows + blockRows - 1) / blockRows : 0; }
+	
+	/**
+	    \brief Get the number of rows in a block
+	    \param block The block
+	    \returns Number of rows in \p block
+	*/
+	size_t GetBlockRows(size_t block) const
+	{ return (numRows - block * blockRows < blockRows) ? numRows - block * blockRows : blockRows; }
+	
+	/**
+	    \brief Get one player's fractions over a block of rows
+	    
+	    \param block The block
+	    \param player Slot of the player
+	    \returns GetBlockRows() fractions, in order
+	*/
+	const float *GetColumn(size_t block, size_t player) const
+	{ return base + block * blockRows * numPlayers + player * GetBlockRows(block); }
+
+private:
+	// Columns can't be copied
+	TrajectoryColumns(const TrajectoryColumns &);
+	TrajectoryColumns &operator=(const TrajectoryColumns &);
+	
+	/**
+	    \brief Number of players in the trajectory
+	*/
+	size_t numPlayers;
+	
+	/**
+	    \brief Number of rows in the trajectory
+	*/
+	size_t numRows;
+	
+	/**
+	    \brief Number of rows in each block (but perhaps the last)
+	*/
+	size_t blockRows;
+	
+	/**
+	    \brief The columns, when there is only one block
+	*/
+	std::vector<float> buffer;
+	
+	/**
+	    \brief The temporary file, when there are several blocks
+	*/
+	MappedFile file;
+	
+	/**
+	    \brief Name of the temporary file, if there is one
+	*/
+	wxString tempName;
+	
+	/**
+	    \brief Start of the first block of columns
+	*/
+	const float *base;
+};
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,384 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#include <math.h>
+
+#ifdef BUILD_TESTS
+#  include <TestHarness.h>
+#  include "../game/bimatrix.h"
+#  include "../game/titfortat.h"
+#endif
+
+#include "../common/error.h"
+#include "../common/kernels.h"
+#include "../common/parallel.h"
+#include "../common/progress.h"
+#include "../game/fsaplayer.h"
+#include "../game/game.h"
+#include "match.h"
+#include "twopopulation.h"
+
+
+/**
+    \brief Plays row players against every column player
+    
+    Each row of the block belongs to one row player, so the rows may be
+    run on any threads.
+*/
+class TwoPopulationTask : public ParallelTask
+{
+public:
+	TwoPopulationTask(const Game *g, const PlayerPtrArray *p, std::vector<double> *m, Progress *pr) :
+		game(g), players(p), payoffs(m), progress(pr)
+	{ }
+	
+	virtual bool Run(size_t begin, size_t end)
+	{
+		Game *localGame = game->Clone();
+		size_t numColumns = players[1].GetCount();
+		
+		for (size_t i = begin ; i < end ; i++)
+		{
+			if (progress && progress->IsCancelled())
+			{
+				Error::Set(_("The tournament was cancelled"));
+				delete localGame;
+				return false;
+			}
+			
+			for (size_t j = 0 ; j < numColumns ; j++)
+			{
+				Player *one = players[0][i]->Clone();
+				Player *two = players[1][j]->Clone();
+				Match match(one, two);
+				match.SetHistoryPolicy(Match::HISTORY_NONE);
+				
+				bool ok = match.Play(localGame, true);
+				
+				delete one;
+				delete two;
+				
+				// Error already set in Match::Play()
+				if (!ok)
+				{
+					delete localGame;
+					return false;
+				}
+				
+				payoffs[0][i * numColumns + j] = match.playerOneScore;
+				payoffs[1][i * numColumns + j] = match.playerTwoScore;
+			}
+			
+			if (progress)
+				progress->Advance();
+		}
+		
+		delete localGame;
+		return true;
+	}
+	
+private:
+	const Game *game;
+	const PlayerPtrArray *players;
+	std::vector<double> *payoffs;
+	Progress *progress;
+};
+
+
+TwoPopulationTournament::TwoPopulationTournament(Game *gm) :
+	tolerance(1e-8), convergedAt(-1), played(false), game(gm)
+{ }
+
+TwoPopulationTournament::~TwoPopulationTournament()
+{
+	for (int role = 0 ; role < 2 ; role++)
+	{
+		for (size_t i = 0 ; i < players[role].GetCount() ; i++)
+			delete players[role][i];
+		players[role].Clear();
+	}
+}
+
+bool TwoPopulationTournament::AddPlayer(const Player *player, int role)
+{
+	// The built-in players only know the moves of a symmetric game
+	if (!game->IsSymmetric() && !dynamic_cast<const FSAPlayer *>(player))
+	{
+		Error::Set(wxString::Format(_("Player %s can't play a game whose roles have different moves; use a finite state machine instead"),
+		           player->GetPlayerName().c_str()));
+		return false;
+	}
+	
+	players[role].Add(player->Clone());
+	payoffs[0].clear();
+	payoffs[1].clear();
+	return true;
+}
+
+void TwoPopulationTournament::RemovePlayer(const Player *player)
+{
+	for (int role = 0 ; role < 2 ; role++)
+	{
+		for (size_t i = 0 ; i < players[role].GetCount() ; i++)
+		{
+			Player *t = players[role][i];
+			
+			if (player->GetID() == t->GetID())
+			{
+				players[role].RemoveAt(i);
+				delete t;
+				payoffs[0].clear();
+				payoffs[1].clear();
+				return;
+			}
+		}
+	}
+}
+
+bool TwoPopulationTournament::ComputePayoffs(Progress *progress)
+{
+	size_t size = players[0].GetCount() * players[1].GetCount();
+	payoffs[0].assign(size, 0.0);
+	payoffs[1].assign(size, 0.0);
+	
+	if (progress)
+		progress->Start(players[0].GetCount());
+	
+	TwoPopulationTask task(game, players, payoffs, progress);
+	if (!Parallel::For(players[0].GetCount(), &task, 1))
+	{
+		payoffs[0].clear();
+		payoffs[1].clear();
+		return false;
+	}
+	
+	return true;
+}
+
+bool TwoPopulationTournament::Run(int numGenerations, Progress *progress)
+{
+	// If we've already played (or been cancelled part-way), reset
+	if (played || data[0].GetNumRows())
+		Reset();
+	
+	if (!players[0].GetCount() || !players[1].GetCount())
+	{
+		Error::Set(_("Add at least one player of each role to the tournament"));
+		return false;
+	}
+	
+	// (Error already set in Match::Play())
+	size_t size = players[0].GetCount() * players[1].GetCount();
+	if (payoffs[0].size() != size && !ComputePayoffs(progress))
+		return false;
+	
+	// Every player of each role starts out equal
+	for (int role = 0 ; role < 2 ; role++)
+	{
+		size_t numPlayers = players[role].GetCount();
+		population[role].assign(numPlayers, 1.0 / numPlayers);
+		
+		wxCriticalSectionLocker locker(lock);
+		data[role].SetNumPlayers(numPlayers);
+		data[role].Add(population[role]);
+	}
+	
+	if (progress)
+		progress->Start(numGenerations);
+	
+	std::vector<double> &x = population[0], &y = population[1];
+	std::vector<double> f, g;
+	for (int gen = 0 ; gen < numGenerations ; gen++)
+	{
+		if (progress && progress->IsCancelled())
+		{
+			Error::Set(_("The tournament was cancelled"));
+			return false;
+		}
+		
+		// Both populations move at once, each scored against the other
+		// as it was at the start of the generation
+		double meanRow = Fitness(0, x, y, f);
+		double meanColumn = Fitness(1, y, x, g);
+		double distance = 0.0;
+		
+		// If nobody in a population scored at all, it doesn't change
+		if (meanRow > 0.0)
+		{
+			for (size_t i = 0 ; i < x.size() ; i++)
+			{
+				double next = x[i] * f[i] / meanRow;
+				distance += (next - x[i]) * (next - x[i]);
+				x[i] = next;
+			}
+		}
+		if (meanColumn > 0.0)
+		{
+			for (size_t j = 0 ; j < y.size() ; j++)
+			{
+				double next = y[j] * g[j] / meanColumn;
+				distance += (next - y[j]) * (next - y[j]);
+				y[j] = next;
+			}
+		}
+		
+		{
+			wxCriticalSectionLocker locker(lock);
+			data[0].Add(x);
+			data[1].Add(y);
+		}
+		
+		if (progress)
+			progress->Advance();
+		
+		if (sqrt(distance) < tolerance)
+		{
+			convergedAt = gen + 1;
+			break;
+		}
+	}
+	
+	played = true;
+	return true;
+}
+
+double TwoPopulationTournament::Fitness(int role, const std::vector<double> &x, const std::vector<double> &other,
+                                        std::vector<double> &f) const
+{
+	// A row player's score is its row of the row payoffs times the
+	// column population, and a column player's is its column of the
+	// column payoffs times the row population
+	size_t rows = players[0].GetCount(), columns = players[1].GetCount();
+	
+	f.resize(x.size());
+	if (role == 0)
+		Kernels::MatVec(&payoffs[0][0], rows, columns, &other[0], &f[0]);
+	else
+		Kernels::MatTVec(&payoffs[1][0], rows, columns, &other[0], &f[0]);
+	
+	return Kernels::Dot(&x[0], &f[0], x.size());
+}
+
+void TwoPopulationTournament::Reset()
+{
+	played = false;
+	convergedAt = -1;
+	population[0].clear();
+	population[1].clear();
+	
+	wxCriticalSectionLocker locker(lock);
+	data[0].Clear();
+	data[1].Clear();
+}
+
+
+
+/** \cond TEST */
+#ifdef BUILD_TESTS
+
+TEST(TwoPopulationTournament, BuyerSeller)
+{
+	// Trusting is always better for the buyer, and cheating a truster
+	// is best for the seller
+	BimatrixGame game;
+	CHECK(game.SetMoves(wxT("TI"), wxT("HC")));
+	game.SetPayoff(0, 0, 3, 3);
+	game.SetPayoff(0, 1, 1, 4);
+	game.SetPayoff(1, 0, 2, 2);
+	game.SetPayoff(1, 1, 0, 0);
+	
+	FSAPlayer trust, inspect, honest, cheat, fair;
+	CHECK(trust.LoadFromString(&game, wxT("Charles Pence\nTrust\n1\nT, 0, 0")));
+	CHECK(inspect.LoadFromString(&game, wxT("Charles Pence\nInspect\n1\nI, 0, 0")));
+	CHECK(honest.LoadFromString(&game, wxT("Charles Pence\nHonest\n1\nH, 0, 0")));
+	CHECK(cheat.LoadFromString(&game, wxT("Charles Pence\nCheat\n1\nC, 0, 0")));
+	CHECK(fair.LoadFromString(&game, wxT("Charles Pence\nFair\n2\nH, 0, 1\nC, 0, 1")));
+	
+	TwoPopulationTournament tourney(&game);
+	CHECK(tourney.AddPlayer(&trust, 0));
+	CHECK(!tourney.Run(10));
+	Error::Get();
+	
+	CHECK(tourney.AddPlayer(&inspect, 0));
+	CHECK(tourney.AddPlayer(&honest, 1));
+	CHECK(tourney.AddPlayer(&cheat, 1));
+	CHECK(tourney.AddPlayer(&fair, 1));
+	
+	// Sellers can't play as buyers
+	TwoPopulationTournament backwards(&game);
+	CHECK(backwards.AddPlayer(&honest, 0));
+	CHECK(backwards.AddPlayer(&trust, 1));
+	CHECK(!backwards.Run(10));
+	Error::Get();
+	
+	// Nor can the built-in players, who only know the row moves
+	TitForTatPlayer tft;
+	CHECK(!tourney.AddPlayer(&tft, 1));
+	Error::Get();
+	
+	// The matches may be cancelled too
+	Progress progress;
+	progress.Cancel();
+	CHECK(!tourney.Run(1, &progress));
+	Error::Get();
+	
+	tourney.tolerance = 0.0;
+	CHECK(tourney.Run(1));
+	CHECK_EQUAL(600.0, tourney.GetPayoff(0, 0, 0));
+	CHECK_EQUAL(800.0, tourney.GetPayoff(1, 0, 1));
+	CHECK_EQUAL(600.0, tourney.GetPayoff(1, 0, 2));
+	CHECK_EQUAL(2.0, tourney.GetPayoff(1, 1, 2));
+	CHECK_EQUAL(400.0, tourney.GetPayoff(0, 1, 0));
+	
+	// The first generation, worked out by hand
+	double f[2] = { 0.0, 0.0 }, g[3] = { 0.0, 0.0, 0.0 };
+	for (size_t i = 0 ; i < 2 ; i++)
+	{
+		for (size_t j = 0 ; j < 3 ; j++)
+		{
+			f[i] += tourney.GetPayoff(0, i, j) / 3.0;
+			g[j] += tourney.GetPayoff(1, i, j) / 2.0;
+		}
+	}
+	double meanRow = (f[0] + f[1]) / 2.0, meanColumn = (g[0] + g[1] + g[2]) / 3.0;
+	CHECK(fabs(tourney.data[0].Get(1, 0) - 0.5 * f[0] / meanRow) < 1e-6);
+	CHECK(fabs(tourney.data[1].Get(1, 2) - g[2] / 3.0 / meanColumn) < 1e-6);
+	CHECK(fabs(tourney.data[1].Get(1, 0) + tourney.data[1].Get(1, 1) + tourney.data[1].Get(1, 2) - 1.0) < 1e-6);
+	
+	// Buyers learn to trust, and sellers to cheat them
+	tourney.tolerance = 1e-8;
+	CHECK(tourney.Run(5000));
+	CHECK(tourney.HasConverged());
+	int last = tourney.GetNumGenerationsRun();
+	CHECK(tourney.data[0].Get(last, 0) > 0.999f);
+	CHECK(tourney.data[1].Get(last, 1) > 0.999f);
+}
+
+#endif
+/** \endcond */
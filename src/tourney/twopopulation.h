@@ -0,0 +1,262 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TOURNEY_TWOPOPULATION_H__
+#define TOURNEY_TWOPOPULATION_H__
+
+class Game;
+class Progress;
+#include <vector>
+#include <wx/thread.h>
+#include "../game/player.h"
+#include "trajectory.h"
+
+
+/**
+    \class TwoPopulationTournament
+    \ingroup tourney
+    
+    \brief Evolves two populations, one for each role of an asymmetric
+           game, against each other
+    
+    In a game with two roles (see \c BimatrixGame), such as buyers and
+    sellers or hosts and parasites, the players of each role come from
+    their own population, and only ever meet players of the other role.
+    Each population's players are added separately (see AddPlayer()).
+    
+    Every row player plays one match, as player one, against every
+    column player, giving a rectangular block of payoffs for each side.
+    The two populations then evolve together in discrete generations:
+    each row player's score is its row of the row payoffs times the
+    column population, and each column player's score is its column of
+    the column payoffs times the row population, and each population
+    grows in proportion to its scores, as in \c EvoTournament.
+    
+    The fractions of each population at every generation are stored in
+    the \c data members.
+*/
+class TwoPopulationTournament
+{
+public:
+	/**
+	    \brief Constructor
+	    
+	    Sets the \c game value.
+	    
+	    \param gm Initial value of the \c game member.
+	*/
+	TwoPopulationTournament(Game *gm);
+
+	virtual ~TwoPopulationTournament();
+	
+	
+	/**
+	    \brief Add a player to one of the populations
+	    
+	    The player passed will be cloned and placed on the list of
+	    players of the given role.  If the roles have different moves,
+	    only finite state machines may be added, since the built-in
+	    players only know the moves of player one.
+	    
+	    This function will not store the pointer passed to it.
+	    
+	    \param player Player to be cloned and added to the tournament
+	    \param role Zero for the row players (player one), one for the
+	                column players (player two)
+	    \returns True if the player was added, false otherwise
+	*/
+	bool AddPlayer(const Player *player, int role);
+	
+	/**
+	    \brief Remove this player from whichever population it's in
+	    
+	    This function will search both lists for a player of the same ID
+	    as the one passed, and remove it if found.
+	    
+	    This function will not store the pointer passed to it.
+	    
+	    \param player Player of the same ID as that to be removed
+	*/
+	void RemovePlayer(const Player *player);
+	
+	
+	/**
+	    \brief Run the tournament
+	    
+	    Plays the matches between the two populations (if they haven't
+	    been played since the players last changed), and then evolves
+	    both, beginning with every player of each role at an equal
+	    fraction.  The tournament stops before \p numGenerations if both
+	    populations converge.
+	    
+	    This may be called on a worker thread, in which case hold
+	    GetLock() while reading \c data.
+	    
+	    \param numGenerations Largest number of generations to compute
+	    \param progress If not \c NULL, counts the row players' matches
+	                    and then the generations run, and may be used to
+	                    cancel the tournament
+	    \returns True if the tournament ran successfully, false otherwise
+	*/
+	bool Run(int numGenerations, Progress *progress = NULL);
+	
+	/**
+	    \brief Get a player's score against a player of the other role
+	    
+	    Only valid once the tournament has been run.
+	    
+	    \param role Zero for the row player's score, one for the column
+	                player's
+	    \param row Index of the row player in <tt>players[0]</tt>
+	    \param column Index of the column player in <tt>players[1]</tt>
+	    \returns Score of one of the players in their match
+	*/
+	double GetPayoff(int role, size_t row, size_t column) const
+	{ return payoffs[role][row * players[1].GetCount() + column]; }
+	
+	/**
+	    \brief Get the number of generations which have been run
+	    \returns Number of generations run so far
+	*/
+	int GetNumGenerationsRun() const
+	{ return data[0].GetNumGenerations() ? (int)data[0].GetNumGenerations() - 1 : 0; }
+	
+	/**
+	    \brief Did the last run stop because the populations converged?
+	    \returns True if the populations converged, false otherwise
+	*/
+	bool HasConverged() const { return convergedAt >= 0; }
+	
+	/**
+	    \brief Get the generation at which the populations converged
+	    \returns Generation of convergence, or -1 if the populations did
+	             not converge
+	*/
+	int GetConvergenceTime() const { return convergedAt; }
+	
+	/**
+	    \brief Get the lock which protects \c data while the tournament
+	           is running
+	    \returns The lock
+	*/
+	wxCriticalSection &GetLock() { return lock; }
+	
+	/**
+	    \brief Has the tournament been played?
+	    \returns True if the tournament has been played, false otherwise
+	*/
+	bool IsPlayed() const { return played; }
+
+	/**
+	    \brief Reset all internal data
+	    
+	    This function clears the tournament data and resets the
+	    \c played value to false.  The payoffs are kept.
+	*/
+	void Reset();
+	
+	
+	/**
+	    \brief The players of each role: row players (player one)
+	           first, then column players (player two)
+	*/
+	PlayerPtrArray players[2];
+	
+	/**
+	    \brief The fractions of each population at every generation
+	    
+	    Each trajectory has a row for every sampled generation, and a
+	    column for each player of its role, in the same order as
+	    \c players.
+	*/
+	Trajectory data[2];
+	
+	/**
+	    \brief Convergence tolerance
+	    
+	    The tournament stops once the Euclidean distance between the
+	    fractions of both populations (taken together) in two successive
+	    generations falls below this value.  Set to zero to always run
+	    every generation.
+	*/
+	double tolerance;
+
+private:
+	/**
+	    \brief Play every row player against every column player
+	    \param progress If not \c NULL, counts the row players whose
+	                    matches are done, and may be used to cancel them
+	    \returns True if every match was played, false otherwise
+	*/
+	bool ComputePayoffs(Progress *progress);
+	
+	/**
+	    \brief Compute the score of every player of one role
+	    
+	    \param role The role whose scores are wanted
+	    \param x The population of \p role
+	    \param other The population of the other role
+	    \param[out] f Score of each player of \p role
+	    \returns The mean score of \p role, weighted by \p x
+	*/
+	double Fitness(int role, const std::vector<double> &x, const std::vector<double> &other,
+	               std::vector<double> &f) const;
+	
+	
+	/**
+	    \brief Scores of each role, by row player and then column player
+	    
+	    Empty until the matches are played, and cleared whenever a
+	    player is added or removed.
+	*/
+	std::vector<double> payoffs[2];
+	
+	/**
+	    \brief The current fractions of each population
+	*/
+	std::vector<double> population[2];
+	
+	/**
+	    \brief Generation at which the populations converged, or -1
+	*/
+	int convergedAt;
+	
+	/**
+	    \brief Lock protecting \c data while the tournament runs
+	*/
+	wxCriticalSection lock;
+	
+	/**
+	    \brief True if the tournament has been played
+	*/
+	bool played;
+	
+	/**
+	    \brief The game to be played
+	*/
+	Game *game;
+};
+
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
@@ -27,13 +27,18 @@
 #  include <wx/wx.h>
 #endif
 
-#include <wx/file.h>
-#include <wx/textfile.h>
 #include <wx/filename.h>
 #include <wx/wfstream.h>
 
+#include <math.h>
+
+#include "../common/error.h"
+#include "../common/outputfile.h"
+#include "../tourney/basins.h"
 #include "../tourney/evotournament.h"
+#include "../tourney/invasion.h"
 
+#include "tools/exportthread.h"
 #include "oyunapp.h"
 #include "oyunwizard.h"
 #include "evofinishpage.h"
@@ -43,7 +48,329 @@ enum
 {
 	ID_SAVE_IMAGE = wxID_HIGHEST,
 	ID_SAVE_SVG,
-	ID_SAVE_CSV
+	ID_SAVE_CSV,
+	ID_SAVE_INVASION,
+	ID_SAVE_BASINS,
+	ID_SAVE_MATRIX
+};
+
+
+// Saves the graph as a bitmap image
+class ImageExport : public ExportThread
+{
+public:
+	ImageExport(const wxString &fileName, const wxImage &newImage, const wxString &newMimeType) :
+		ExportThread(fileName), image(newImage), mimeType(newMimeType)
+	{ }
+
+protected:
+	virtual bool Export()
+	{
+		progress.Start(1);
+		
+		wxFileOutputStream fileStream(fileName);
+		if (!fileStream.IsOk())
+		{
+			Error::Set(wxString::Format(_("Could not open file %s for writing"), fileName.c_str()));
+			return false;
+		}
+		
+		if (!image.SaveFile(fileStream, mimeType))
+		{
+			Error::Set(wxString::Format(_("Could not write to file %s"), fileName.c_str()));
+			return false;
+		}
+		
+		progress.Advance();
+		return true;
+	}
+
+private:
+	wxImage image;
+	wxString mimeType;
+};
+
+// Saves the graph as an SVG image
+class SVGExport : public ExportThread
+{
+public:
+	SVGExport(const wxString &fileName, const wxString &newSVG) :
+		ExportThread(fileName), svg(newSVG)
+	{ }
+
+protected:
+	virtual bool Export()
+	{
+		progress.Start(1);
+		
+		OutputFile out;
+		if (!out.Open(fileName))
+			return false;
+		
+		out.Write(svg);
+		progress.Advance();
+		
+		return out.Close();
+	}
+
+private:
+	wxString svg;
+};
+
+// Saves the frequency of every player at every generation.  The file
+// has one line per player, but the trajectory can only be decoded a
+// row at a time, so we sort it into columns first.
+class EvoCSVExport : public ExportThread
+{
+public:
+	EvoCSVExport(const wxString &fileName, EvoTournament *newTourney) :
+		ExportThread(fileName), evoTourney(newTourney)
+	{ }
+
+protected:
+	virtual bool Export()
+	{
+		const Trajectory &data = evoTourney->data;
+		size_t numPlayers = evoTourney->players.GetCount();
+		size_t numRows = data.GetNumRows();
+		
+		progress.Start(numPlayers + 2);
+		
+		// Error already set in TrajectoryColumns::Open()
+		TrajectoryColumns columns;
+		if (!columns.Open(data))
+			return false;
+		progress.Advance();
+		
+		OutputFile out;
+		if (!out.Open(fileName))
+			return false;
+		
+		// Write the file header.  Split the column name around its
+		// number, so we don't have to format a string for every column.
+		out.Write(_("Player Name"));
+		out.Write(',');
+		out.Write(_("Player Author"));
+		out.Write(',');
+		out.Write(_("Initial Fraction"));
+		out.Write(',');
+		
+		wxString generation(_("Generation %d"));
+		wxString before(generation), after;
+		int at = generation.Find(wxT("%d"));
+		if (at != wxNOT_FOUND)
+		{
+			before = generation.Left(at);
+			after = generation.Mid(at + 2);
+		}
+		
+		for (size_t row = 1 ; row < numRows ; row++)
+		{
+			out.Write(before);
+			out.WriteInt(data.GetGeneration(row));
+			out.Write(after);
+			
+			if (row != numRows - 1)
+				out.Write(',');
+		}
+		out.EndLine();
+		progress.Advance();
+		
+		// Write the data, one player per line
+		for (size_t p = 0 ; p < numPlayers ; p++)
+		{
+			if (Cancelled())
+				return false;
+			
+			Player *player = evoTourney->players[p];
+			out.Write(player->GetPlayerName());
+			out.Write(',');
+			out.Write(player->GetPlayerAuthor());
+			out.Write(',');
+			
+			for (size_t b = 0 ; b < columns.GetNumBlocks() ; b++)
+			{
+				const float *column = columns.GetColumn(b, p);
+				for (size_t r = 0 ; r < columns.GetBlockRows(b) ; r++)
+				{
+					if (b || r)
+						out.Write(',');
+					out.WriteFloat(column[r]);
+				}
+			}
+			out.EndLine();
+			
+			progress.Advance();
+		}
+		
+		return out.Close();
+	}
+
+private:
+	EvoTournament *evoTourney;
+};
+
+// Works out which players can invade which others, and saves the
+// results as a spreadsheet or as a heatmap
+class InvasionExport : public ExportThread
+{
+public:
+	InvasionExport(const wxString &fileName, EvoTournament *newTourney, bool newHeatmap) :
+		ExportThread(fileName), evoTourney(newTourney), heatmap(newHeatmap)
+	{ }
+
+protected:
+	virtual bool Export()
+	{
+		// Error already set in InvasionAnalysis::Compute()
+		InvasionAnalysis analysis;
+		if (!evoTourney->AnalyzeInvasion(analysis, &progress))
+			return false;
+		
+		// Error already set in InvasionAnalysis::Write()
+		if (!heatmap)
+			return analysis.Write(fileName, evoTourney->players);
+		
+		return WriteHeatmap(analysis);
+	}
+
+private:
+	// Escape a player's name for use in an SVG file
+	static wxString Escape(const wxString &text)
+	{
+		wxString ret(text);
+		ret.Replace(wxT("&"), wxT("&amp;"));
+		ret.Replace(wxT("<"), wxT("&lt;"));
+		ret.Replace(wxT(">"), wxT("&gt;"));
+		return ret;
+	}
+	
+	// Draw a cell for every pair, red where the mutant is favored to
+	// take over and blue where it isn't, with a dot where it can invade
+	bool WriteHeatmap(const InvasionAnalysis &analysis)
+	{
+		static const int cell = 12, margin = 150;
+		
+		size_t numPlayers = analysis.GetSize();
+		double neutral = 1.0 / analysis.GetPopulationSize();
+		double range = log((double)analysis.GetPopulationSize());
+		int size = margin + (int)numPlayers * cell;
+		
+		progress.Start(numPlayers + 1);
+		
+		OutputFile out;
+		if (!out.Open(fileName))
+			return false;
+		
+		static const wxChar *svgHeader =
+			wxT("<!DOCTYPE svg PUBLIC \"-//W3C//DTD SVG 1.0//EN\"\n")
+			wxT(" \"http://www.w3.org/TR/2001/REC-SVG-20010904/DTD/svg10.dtd\">\n")
+			wxT("<svg xmlns=\"http://www.w3.org/2000/svg\"\n")
+			wxT(" width='%dpx' height='%dpx'>\n\n")
+			wxT("<title>Oyun Invasion Heatmap</title>\n\n");
+		
+		out.Write(wxString::Format(svgHeader, size, size));
+		
+		// Mutants across the top, residents down the side
+		for (size_t p = 0 ; p < numPlayers ; p++)
+		{
+			wxString name = Escape(evoTourney->players[p]->GetPlayerName());
+			int at = margin + (int)p * cell + cell / 2;
+			
+			out.Write(wxString::Format(wxT("<text x='%d' y='%d' font-family='sans-serif' font-size='8pt' text-anchor='start' ")
+			                           wxT("style='dominant-baseline: central' transform='rotate(-90 %d %d)'>%s</text>\n"),
+			                           at, margin - 4, at, margin - 4, name.c_str()));
+			out.Write(wxString::Format(wxT("<text x='%d' y='%d' font-family='sans-serif' font-size='8pt' text-anchor='end' ")
+			                           wxT("style='dominant-baseline: central'>%s</text>\n"),
+			                           margin - 4, at, name.c_str()));
+		}
+		progress.Advance();
+		
+		for (size_t r = 0 ; r < numPlayers ; r++)
+		{
+			if (Cancelled())
+				return false;
+			
+			for (size_t m = 0 ; m < numPlayers ; m++)
+			{
+				// How many times more (or less) likely than chance the
+				// mutant is to take over, on a log scale
+				double fixation = analysis.GetFixation(r, m);
+				double shade = (fixation > 0.0) ? log(fixation / neutral) / range : -1.0;
+				if (shade > 1.0)
+					shade = 1.0;
+				else if (shade < -1.0)
+					shade = -1.0;
+				
+				int red = 255, green, blue = 255;
+				if (shade > 0.0)
+					green = blue = (int)(255.0 * (1.0 - shade));
+				else
+					red = green = (int)(255.0 * (1.0 + shade));
+				
+				int x = margin + (int)m * cell, y = margin + (int)r * cell;
+				out.Write(wxString::Format(wxT("<rect x='%d' y='%d' width='%dpx' height='%dpx' style='fill: rgb(%d, %d, %d);'/>\n"),
+				                           x, y, cell, cell, red, green, blue));
+				
+				if (analysis.CanInvade(r, m))
+					out.Write(wxString::Format(wxT("<circle cx='%d' cy='%d' r='2' fill='black'/>\n"),
+					                           x + cell / 2, y + cell / 2));
+			}
+			
+			progress.Advance();
+		}
+		
+		out.Write(wxT("\n</svg>\n\n"));
+		return out.Close();
+	}
+	
+	EvoTournament *evoTourney;
+	bool heatmap;
+};
+
+// Evolves the tournament from many starting mixes, and saves where each
+// one ended up
+class BasinsExport : public ExportThread
+{
+public:
+	BasinsExport(const wxString &fileName, EvoTournament *newTourney) :
+		ExportThread(fileName), evoTourney(newTourney)
+	{ }
+
+protected:
+	virtual bool Export()
+	{
+		// Error already set in BasinMap::Compute()
+		BasinMap map;
+		if (!evoTourney->MapBasins(map, &progress))
+			return false;
+		
+		// Error already set in BasinMap::Write()
+		return map.Write(fileName, evoTourney->players);
+	}
+
+private:
+	EvoTournament *evoTourney;
+};
+
+// Saves the payoff matrix, so that it can be loaded again without
+// playing any matches
+class MatrixExport : public ExportThread
+{
+public:
+	MatrixExport(const wxString &fileName, EvoTournament *newTourney) :
+		ExportThread(fileName), evoTourney(newTourney)
+	{ }
+
+protected:
+	virtual bool Export()
+	{
+		// Error already set in EvoTournament::SavePayoffs()
+		return evoTourney->SavePayoffs(fileName, &progress);
+	}
+
+private:
+	EvoTournament *evoTourney;
 };
 
 IMPLEMENT_CLASS(EvoFinishPage, FinishPage)
@@ -54,6 +381,9 @@ BEGIN_EVENT_TABLE(EvoFinishPage, FinishPage)
 	EVT_BUTTON(ID_SAVE_IMAGE, EvoFinishPage::OnSaveImage)
 	EVT_BUTTON(ID_SAVE_SVG, EvoFinishPage::OnSaveSVG)
 	EVT_BUTTON(ID_SAVE_CSV, EvoFinishPage::OnSaveCSV)
+	EVT_BUTTON(ID_SAVE_INVASION, EvoFinishPage::OnSaveInvasion)
+	EVT_BUTTON(ID_SAVE_BASINS, EvoFinishPage::OnSaveBasins)
+	EVT_BUTTON(ID_SAVE_MATRIX, EvoFinishPage::OnSaveMatrix)
 
 	EVT_NOTIFY(wxEVT_DATA_UPDATE, wxID_ANY, EvoFinishPage::OnDataUpdate)
 END_EVENT_TABLE()
@@ -76,6 +406,19 @@ EvoFinishPage::EvoFinishPage(OyunWizard *parent, EvoPage *prev) :
 	AddButton(ID_SAVE_CSV, _("Save CS&V..."), _("Save a spreadsheet of the detailed tournament data.\n\n"
 	                                            "This is a spreadsheet containing the frequency of each player\n"
 	                                            "at each generation in the evolutionary tournament."));
+	AddButton(ID_SAVE_INVASION, _("Save I&nvasion..."), _("Save which players can invade populations of which others.\n\n"
+	                                                      "For every pair of players, this works out whether one of them\n"
+	                                                      "can invade a population of the other, and the chance that it\n"
+	                                                      "takes over a population of 100, as a spreadsheet or as an\n"
+	                                                      "SVG heatmap."));
+	AddButton(ID_SAVE_BASINS, _("Save &Basins..."), _("Save where the population ends up from many different starts.\n\n"
+	                                                  "This evolves the tournament from a thousand random mixes of\n"
+	                                                  "the players, and saves a spreadsheet of the populations they\n"
+	                                                  "settle down to, and which of them each start ended up at."));
+	AddButton(ID_SAVE_MATRIX, _("Save &Matrix..."), _("Save the payoff matrix between the players.\n\n"
+	                                                  "This is the score of every player against every other, as a\n"
+	                                                  "spreadsheet or a binary file, which can be added on the players\n"
+	                                                  "page to run more tournaments without playing any matches."));
 }
 
 void EvoFinishPage::OnDataUpdate(wxNotifyEvent & WXUNUSED(event))
@@ -144,13 +487,9 @@ void EvoFinishPage::OnSaveImage(wxCommandEvent & WXUNUSED(event))
 	}
 	
 	// Save the image file
-	wxFileOutputStream fileStream(filename.GetFullPath());
-	if (fileStream.IsOk())
-		previous->imageGraph.SaveFile(fileStream, mimeType);
-	else
-		; // FIXME: show error box
-	
-	dataSaved = true;
+	ImageExport image(filename.GetFullPath(), previous->imageGraph, mimeType);
+	if (image.Execute(this))
+		dataSaved = true;
 }
 
 void EvoFinishPage::OnSaveSVG(wxCommandEvent & WXUNUSED(event))
@@ -172,15 +511,9 @@ void EvoFinishPage::OnSaveSVG(wxCommandEvent & WXUNUSED(event))
 		filename.SetExt(wxT("svg"));
 	
 	// Save the SVG file
-	wxFile file(filename.GetFullPath(), wxFile::write);
-	if (!file.IsOpened())
-		return;
-	
-	file.Write(previous->svgGraph);
-	file.Flush();
-	file.Close();
-
-	dataSaved = true;
+	SVGExport svg(filename.GetFullPath(), previous->svgGraph);
+	if (svg.Execute(this))
+		dataSaved = true;
 }
 
 void EvoFinishPage::OnSaveCSV(wxCommandEvent & WXUNUSED(event))
@@ -202,71 +535,79 @@ void EvoFinishPage::OnSaveCSV(wxCommandEvent & WXUNUSED(event))
 		filename.SetExt(wxT("csv"));
 
 	// Save the CSV file
-	wxTextFile file(filename.GetFullPath());
-
-	if (file.Exists())
-	{
-		file.Open();
-		file.Clear();
-	}
-	else
-		file.Create();
+	EvoCSVExport csv(filename.GetFullPath(), previous->evoTourney);
+	if (csv.Execute(this))
+		dataSaved = true;
+}
 
-	// Generate the lines of the CSV file	
-	size_t numPlayers = previous->evoTourney->players.GetCount();
-	size_t numGenerations = previous->evoTourney->data.GetCount();
-	wxArrayString lines;
-	lines.SetCount(numPlayers);
+void EvoFinishPage::OnSaveInvasion(wxCommandEvent & WXUNUSED(event))
+{
+	// Get a filename from the user
+	static const wxString filter(_("CSV spreadsheet (*.csv)|*.csv|SVG heatmap (*.svg)|*.svg"));
+	wxString str;
 	
-	for (size_t p = 0 ; p < numPlayers ; p++)
-	{
-		Player *player = previous->evoTourney->players[p];
-		int id = player->GetID();
-		
-		// Start by writing out the player name and author
-		wxString playerData;
-		playerData = player->GetPlayerName() + wxT(",") +
-		             player->GetPlayerAuthor() + wxT(",");
-		
-		lines[p] = playerData;
-		
-		for (size_t gen = 0 ; gen < numGenerations ; gen++)
-		{
-			// Get this generation's worth of data
-			GenerationWeights &w = previous->evoTourney->data[gen];
-			
-			// Get the value for this player at this generation
-			wxString val;
-			val.Printf(wxT("%f"), w[id]);
-			
-			// Append a comma if we need to
-			if (gen != numGenerations - 1)
-				val += wxT(",");
-			
-			// Add the value to the line
-			lines[p] += val;
-		}
-	}
-
-	// Write the file header
-	wxString header = _("Player Name") + wxString(wxT(",")) +
-	                  _("Player Author") + wxString(wxT(",")) +
-	                  _("Initial Fraction") + wxString(wxT(","));
-	for (size_t gen = 1 ; gen < numGenerations ; gen++)
-	{
-		header += wxString::Format(_("Generation %d"), gen);
-		if (gen != numGenerations - 1)
-			header += wxT(",");
-	}
-	file.AddLine(header);
+	str = wxFileSelector(_("Select where to save the invasion analysis"), wxEmptyString, _("invasion.csv"),
+	                     wxT(".csv"), filter, wxFD_SAVE | wxFD_OVERWRITE_PROMPT, this);
+	if (str.IsEmpty())
+		return;
 	
-	// Write the data
-	for (size_t p = 0 ; p < numPlayers ; p++)
-		file.AddLine(lines[p]);
-
-	file.Write();
-	file.Close();
+	// Figure out what the type of the file is
+	wxFileName filename(str);
+	wxString extension = filename.GetExt();
+	
+	if (extension != wxT("csv") && extension != wxT("svg"))
+		filename.SetExt(wxT("csv"));
+	
+	// Analyze and save
+	InvasionExport invasion(filename.GetFullPath(), previous->evoTourney, filename.GetExt() == wxT("svg"));
+	if (invasion.Execute(this))
+		dataSaved = true;
+}
 
-	dataSaved = true;
+void EvoFinishPage::OnSaveBasins(wxCommandEvent & WXUNUSED(event))
+{
+	// Get a filename from the user
+	static const wxString filter(_("CSV spreadsheet (*.csv)|*.csv"));
+	wxString str;
+	
+	str = wxFileSelector(_("Select where to save the basins"), wxEmptyString, _("basins.csv"),
+	                     wxT(".csv"), filter, wxFD_SAVE | wxFD_OVERWRITE_PROMPT, this);
+	if (str.IsEmpty())
+		return;
+	
+	// Figure out what the type of the file is
+	wxFileName filename(str);
+	wxString extension = filename.GetExt();
+	
+	if (extension != wxT("csv"))
+		filename.SetExt(wxT("csv"));
+	
+	// Map and save
+	BasinsExport basins(filename.GetFullPath(), previous->evoTourney);
+	if (basins.Execute(this))
+		dataSaved = true;
 }
 
+void EvoFinishPage::OnSaveMatrix(wxCommandEvent & WXUNUSED(event))
+{
+	// Get a filename from the user
+	static const wxString filter(_("CSV spreadsheet (*.csv)|*.csv|Oyun payoff matrix (*.oym)|*.oym"));
+	wxString str;
+	
+	str = wxFileSelector(_("Select where to save the payoff matrix"), wxEmptyString, _("payoffs.csv"),
+	                     wxT(".csv"), filter, wxFD_SAVE | wxFD_OVERWRITE_PROMPT, this);
+	if (str.IsEmpty())
+		return;
+	
+	// Figure out what the type of the file is
+	wxFileName filename(str);
+	wxString extension = filename.GetExt();
+	
+	if (extension != wxT("csv") && extension != wxT("oym"))
+		filename.SetExt(wxT("csv"));
+	
+	// Play (if we have to) and save
+	MatrixExport matrix(filename.GetFullPath(), previous->evoTourney);
+	if (matrix.Execute(this))
+		dataSaved = true;
+}
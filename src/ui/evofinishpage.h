@@ -83,6 +83,24 @@ private:
 	    \param event The event generated
 	*/
 	void OnSaveCSV(wxCommandEvent &event);
+	
+	/**
+	    \brief Called when the "Save Invasion" button is clicked
+	    \param event The event generated
+	*/
+	void OnSaveInvasion(wxCommandEvent &event);
+	
+	/**
+	    \brief Called when the "Save Basins" button is clicked
+	    \param event The event generated
+	*/
+	void OnSaveBasins(wxCommandEvent &event);
+	
+	/**
+	    \brief Called when the "Save Matrix" button is clicked
+	    \param event The event generated
+	*/
+	void OnSaveMatrix(wxCommandEvent &event);
 
 	/**
 	    \brief Called when the page receives a 'data update' message	    
@@ -28,6 +28,7 @@
 #endif
 
 #include <wx/wizard.h>
+#include <wx/filename.h>
 
 #include "../common/error.h"
 #include "../tourney/evotournament.h"
@@ -37,6 +38,43 @@
 #include "oyunapp.h"
 #include "oyunwizard.h"
 #include "evopage.h"
+#include "tools/tournamentthread.h"
+
+
+// Here's some constants for graph formatting
+static const float sideSeparatorX = 0.05f;
+static const float tickWidth = 0.01f;
+static const float sideSeparatorY = 0.1f;
+static const float tickHeight = 0.01f;
+
+// The graph is reduced to at least this many columns, the width of the
+// bitmap drawn for saving as an image
+static const int minGraphColumns = 800;
+
+// Long runs are saved to a checkpoint this often (in generations), so
+// that they can be resumed after a crash
+static const int checkpointInterval = 100;
+
+// Only runs which have taken this long (in milliseconds) are saved
+static const long checkpointDelay = 10000;
+
+
+// Find the first row of a trajectory at or after a generation
+static size_t FindRow(const Trajectory &data, size_t generation)
+{
+	size_t low = 0, high = data.GetNumRows();
+	
+	while (low < high)
+	{
+		size_t mid = (low + high) / 2;
+		if (data.GetGeneration(mid) < generation)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	
+	return low;
+}
 
 
 IMPLEMENT_CLASS(EvoPage, OyunWizardPage)
@@ -46,6 +84,31 @@ enum
 	ID_RUN_TOURNAMENT = wxID_HIGHEST,
 	ID_SHOW_LEGEND,
 	ID_GEN_SPINNER,
+	ID_TIMER
+};
+
+
+// The worker thread which plays the tournament
+class EvoThread : public TournamentThread
+{
+public:
+	EvoThread(wxEvtHandler *handler, EvoTournament *newTourney, int newGenerations, bool newExtend) :
+		TournamentThread(handler), evoTourney(newTourney), generations(newGenerations),
+		extend(newExtend)
+	{ }
+
+protected:
+	virtual bool RunTournament()
+	{
+		if (extend)
+			return evoTourney->Continue(generations, &progress);
+		return evoTourney->Run(generations, &progress);
+	}
+
+private:
+	EvoTournament *evoTourney;
+	int generations;
+	bool extend;
 };
 
 BEGIN_EVENT_TABLE(EvoPage, OyunWizardPage)
@@ -58,8 +121,12 @@ BEGIN_EVENT_TABLE(EvoPage, OyunWizardPage)
 	EVT_BUTTON(ID_RUN_TOURNAMENT, EvoPage::OnRunTournament)
 	EVT_BUTTON(ID_SHOW_LEGEND, EvoPage::OnShowLegend)
 	
+	EVT_TIMER(ID_TIMER, EvoPage::OnTimer)
+	EVT_COMMAND(wxID_ANY, wxEVT_TOURNAMENT_DONE, EvoPage::OnTournamentDone)
+	
 	EVT_NOTIFY(wxEVT_DATA_UPDATE, wxID_ANY, EvoPage::OnDataUpdate)
 	EVT_NOTIFY(wxEVT_ADD_PLAYER, wxID_ANY, EvoPage::OnAddPlayer)
+	EVT_NOTIFY(wxEVT_ADD_PLAYERS, wxID_ANY, EvoPage::OnAddPlayers)
 	EVT_NOTIFY(wxEVT_REMOVE_PLAYER, wxID_ANY, EvoPage::OnRemovePlayer)
 END_EVENT_TABLE()
 
@@ -68,6 +135,7 @@ EvoPage::EvoPage(OyunWizard *parent, wxWizardPage *prev, wxWizardPage *next) :
 	OyunWizardPage(_("Evolutionary Tournament"),
                    _("This tournament uses scores as weights for future generations in a population."),
                    parent, prev, next),
+	viewStart(0), viewEnd(0), thread(NULL), timer(this, ID_TIMER), genSpinner(NULL),
 	graphWindow(NULL),
 	renderer(wxSize(800, 800)) // FIXME: configure this?
 {
@@ -88,6 +156,9 @@ EvoPage::EvoPage(OyunWizard *parent, wxWizardPage *prev, wxWizardPage *next) :
 	// The spinner seems to come out small unless we call this
 	genSpinner->SetInitialSize(genSpinner->GetBestSize());
 	
+	gauge = new wxGauge(this, wxID_ANY, 100, wxDefaultPosition, wxSize(150, -1));
+	gauge->Show(false);
+	
 	graphWindow = new EvoGraphWindow(this);
 			
 	// Make a sizer and add the controls to it
@@ -96,6 +167,7 @@ EvoPage::EvoPage(OyunWizard *parent, wxWizardPage *prev, wxWizardPage *next) :
 	topSizer->Add(runTournament, 0, wxLEFT | wxRIGHT | wxALIGN_CENTER_VERTICAL, 12);
 	topSizer->Add(legend, 0, wxLEFT | wxRIGHT | wxALIGN_CENTER_VERTICAL, 12);
 	topSizer->AddStretchSpacer();
+	topSizer->Add(gauge, 0, wxLEFT | wxRIGHT | wxALIGN_CENTER_VERTICAL, 12);
 	topSizer->Add(spinnerLabel, 0, wxLEFT | wxRIGHT | wxALIGN_CENTER_VERTICAL, 12);
 	topSizer->Add(genSpinner, 0, wxTOP | wxBOTTOM | wxRIGHT | wxALIGN_CENTER_VERTICAL, 12);
 	
@@ -108,6 +180,7 @@ EvoPage::EvoPage(OyunWizard *parent, wxWizardPage *prev, wxWizardPage *next) :
 
 EvoPage::~EvoPage()
 {
+	StopTournament();
 	delete evoTourney;
 }
 
@@ -119,20 +192,136 @@ void EvoPage::OnHelp(wxWizardEvent & WXUNUSED(event))
 
 void EvoPage::OnRunTournament(wxCommandEvent & WXUNUSED(event))
 {
-	wxBusyCursor busy;
+	// While the tournament runs, this is the cancel button
+	if (thread)
+	{
+		thread->progress.Cancel();
+		runTournament->Disable();
+		return;
+	}
+	
+	// Raising the number of generations after a run extends it
 	int generations = genSpinner->GetValue();
+	bool extend = evoTourney->IsPlayed() && generations > evoTourney->GetNumGenerationsRun();
+	
+	// Each set of players gets its own checkpoint, so that runs of
+	// different tournaments don't overwrite each other's
+	wxUint64 hash = HashPlayers(evoTourney->players);
+	wxString baseName = wxString::Format(wxT("oyun-evolution-%08x%08x.oyc"), (unsigned int)(hash >> 32),
+	                                     (unsigned int)(hash & 0xFFFFFFFF));
+	checkpointName = wxFileName(wxFileName::GetTempDir(), baseName).GetFullPath();
+	evoTourney->SetCheckpoint(checkpointName, checkpointInterval, checkpointDelay);
+	
+	// Offer to pick up a run of these players which didn't finish
+	if (!evoTourney->IsPlayed() && wxFileExists(checkpointName))
+	{
+		if (evoTourney->LoadCheckpoint(checkpointName))
+		{
+			wxString question(wxString::Format(_("An unfinished run of this tournament was saved after %d generations.  Continue where it left off?"),
+			                                   evoTourney->GetNumGenerationsRun()));
+			if (wxMessageBox(question, _("Oyun: Resume Tournament"), wxYES_NO | wxICON_QUESTION, this) == wxYES)
+				extend = true;
+			else
+			{
+				evoTourney->Reset();
+				wxRemoveFile(checkpointName);
+			}
+		}
+		else
+		{
+			// It's left over from an older version, or damaged
+			Error::Get();
+			wxRemoveFile(checkpointName);
+		}
+	}
 	
-	if (!evoTourney->Run(generations))
+	// Start the tournament on a worker thread
+	thread = new EvoThread(this, evoTourney, generations, extend);
+	if (thread->Create() != wxTHREAD_NO_ERROR || thread->Run() != wxTHREAD_NO_ERROR)
 	{
-		wxString errStr(wxString::Format(_("Could not run tournament.  Error reported:\n\n%s"), Error::Get().c_str()));
-		wxMessageBox(errStr, _("Oyun: Error"), wxOK | wxICON_ERROR, this);
+		delete thread;
+		thread = NULL;
+		
+		wxMessageBox(_("Could not start the tournament."), _("Oyun: Error"),
+		             wxOK | wxICON_ERROR, this);
 		return;
 	}
 	
+	runTournament->SetLabel(_("&Cancel"));
+	legend->Disable();
+	genSpinner->Disable();
+	gauge->SetValue(0);
+	gauge->Show(true);
+	Layout();
+	
+	pyramid.Clear();
+	viewStart = viewEnd = 0;
+	
+	timer.Start(250);
+}
+
+void EvoPage::OnTimer(wxTimerEvent & WXUNUSED(event))
+{
+	if (!thread)
+		return;
+	
+	int total = thread->progress.GetTotal();
+	gauge->SetRange(total > 0 ? total : 1);
+	gauge->SetValue(thread->progress.GetDone());
+	
+	if (graphWindow)
+		graphWindow->Refresh();
+}
+
+void EvoPage::OnTournamentDone(wxCommandEvent &event)
+{
+	bool cancelled = thread && thread->progress.IsCancelled();
+	StopTournament();
+	
+	runTournament->SetLabel(_("&Run Tournament"));
+	runTournament->Enable();
+	genSpinner->Enable();
+	gauge->Show(false);
+	Layout();
+	
+	if (event.GetInt())
+	{
+		// Nothing left to resume
+		wxRemoveFile(checkpointName);
+	}
+	else
+	{
+		// The generations run so far are still drawn, but don't
+		// complain if the user asked for this
+		wxString error = Error::Get();
+		if (!cancelled)
+		{
+			wxString errStr(wxString::Format(_("Could not run tournament.  Error reported:\n\n%s"), error.c_str()));
+			wxMessageBox(errStr, _("Oyun: Error"), wxOK | wxICON_ERROR, this);
+		}
+	}
+	
+	// Summarize the last few generations
+	pyramid.Update(evoTourney->data);
+	viewStart = viewEnd = 0;
+	
 	// This qualifies as a data update
 	parent->Update();
 }
 
+void EvoPage::StopTournament()
+{
+	timer.Stop();
+	
+	if (!thread)
+		return;
+	
+	thread->progress.Cancel();
+	thread->Wait();
+	delete thread;
+	thread = NULL;
+}
+
 
 void EvoPage::OnDataUpdate(wxNotifyEvent & WXUNUSED(event))
 {
@@ -142,7 +331,7 @@ void EvoPage::OnDataUpdate(wxNotifyEvent & WXUNUSED(event))
 		graphWindow->Refresh();
 
 	// Update control states if we're visible
-	if (IsShownOnScreen())
+	if (IsShownOnScreen() && !thread)
 	{
 		if (evoTourney->IsPlayed())
 		{
@@ -178,6 +367,12 @@ void EvoPage::OnAddPlayer(wxNotifyEvent &event)
 	evoTourney->AddPlayer((Player *)event.GetClientData());
 }
 
+void EvoPage::OnAddPlayers(wxNotifyEvent &event)
+{
+	// Send these to the tournament all at once
+	evoTourney->AddPlayers(*(const PlayerPtrArray *)event.GetClientData());
+}
+
 void EvoPage::OnRemovePlayer(wxNotifyEvent &event)
 {
 	// Send this to the tournamnent
@@ -187,14 +382,29 @@ void EvoPage::OnRemovePlayer(wxNotifyEvent &event)
 
 void EvoPage::OnSpinner(wxSpinEvent & WXUNUSED(event))
 {
-	evoTourney->Reset();
-	if (graphWindow)
-		graphWindow->Refresh();
+	GenerationsChanged();
 }
 
 void EvoPage::OnSpinnerText(wxCommandEvent & WXUNUSED(event))
 {
-	evoTourney->Reset();
+	GenerationsChanged();
+}
+
+void EvoPage::GenerationsChanged()
+{
+	// The spinner may send events while it's being created
+	if (!genSpinner)
+		return;
+	
+	// More generations than we've run can be added on to the run, so
+	// only throw it away if there are now fewer
+	if (genSpinner->GetValue() < evoTourney->GetNumGenerationsRun())
+	{
+		evoTourney->Reset();
+		pyramid.Clear();
+		viewStart = viewEnd = 0;
+	}
+	
 	if (graphWindow)
 		graphWindow->Refresh();
 }
@@ -239,6 +449,15 @@ void EvoPage::OnShowLegend(wxCommandEvent & WXUNUSED(event))
 
 void EvoPage::OnPageChanging(wxWizardEvent &event)
 {
+	// Don't let the players change while the tournament is running
+	if (thread)
+	{
+		wxMessageBox(_("Please wait for the tournament to finish, or cancel it."),
+		             _("Oyun: Error"), wxOK | wxICON_ERROR, this);
+		event.Veto();
+		return;
+	}
+	
 	// We only care if we're moving forward
 	if (!event.GetDirection())
 	{
@@ -479,7 +698,10 @@ void EvoPage::PaintGraph(wxWindowDC &pdc)
 	renderer.SetBrush(*wxWHITE_BRUSH);
 	renderer.DrawRectangle(0, 0, 1, 1);
 	
-	if (!evoTourney->IsPlayed())
+	// The tournament may be running, in which case we draw the
+	// generations run so far
+	wxCriticalSectionLocker locker(evoTourney->GetLock());
+	if (!evoTourney->data.GetNumRows())
 		return;
 
 	// Set default pen and font
@@ -488,12 +710,6 @@ void EvoPage::PaintGraph(wxWindowDC &pdc)
 	wxFont font(8, wxFONTFAMILY_MODERN, wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL, false, wxT("Courier New"));
 	renderer.SetFont(font);
 	
-	// Here's some constants for graph formatting
-	const float sideSeparatorX = 0.05f;
-	const float tickWidth = 0.01f;
-	const float sideSeparatorY = 0.1f;
-	const float tickHeight = 0.01f;
-	
 	// Draw a frame for the graph
 	renderer.DrawLine(sideSeparatorX, sideSeparatorY, 1.0 - sideSeparatorX, sideSeparatorY);
 	renderer.DrawLine(sideSeparatorX, sideSeparatorY, sideSeparatorX, 1.0 - sideSeparatorY);
@@ -514,6 +730,16 @@ void EvoPage::PaintGraph(wxWindowDC &pdc)
 		}
 	}
 	
+	// Work out which generations are in view
+	size_t first = viewStart, last = viewEnd ? viewEnd : numGenerations;
+	if (last > numGenerations)
+		last = numGenerations;
+	if (first >= last)
+	{
+		first = 0;
+		last = numGenerations;
+	}
+	
 	// Draw ten ticks across the X-axis, print every other value
 	for (int i = 0 ; i <= 10 ; i++)
 	{
@@ -522,57 +748,102 @@ void EvoPage::PaintGraph(wxWindowDC &pdc)
 		
 		if ((i % 2) == 0)
 		{
-			int val = (int)((float)i / 10.0f * (float)numGenerations);
+			int val = (int)(first + (float)i / 10.0f * (float)(last - first));
 			wxString str(wxString::Format(wxT("%d"), val));
 			renderer.DrawText(x, 1.0 - sideSeparatorY + 1.5 * tickHeight, false, str);
 		}
 	}
 	
-	// Make an array of X-coordinates
-	float *x = new float[numGenerations + 1];
-	for (size_t i = 0 ; i <= numGenerations ; i++)
-		x[i] = sideSeparatorX + ((1.0 - 2 * sideSeparatorX) * ((float)i / numGenerations));
+	// The tournament stops early if the population converges, and may
+	// only have kept every few generations, so there may be fewer points
+	// than generations.  Either way, each curve is reduced to a couple of
+	// points per pixel.
+	const Trajectory &data = evoTourney->data;
+	pyramid.Update(data);
+	
+	size_t firstRow = FindRow(data, first);
+	size_t endRow = FindRow(data, last + 1);
+	size_t numColumns = wxMax(graphWindow->GetClientSize().GetWidth(), minGraphColumns);
 	
-	// Convert the hash map to arrays of Y-coordinates
 	size_t numPlayers = evoTourney->players.GetCount();
-	float **y = new float *[numPlayers];
+	std::vector<double> generations;
+	std::vector<float> values, x, y;
 	
 	for (size_t i = 0 ; i < numPlayers ; i++)
 	{
-		y[i] = new float[numGenerations + 1];
+		pyramid.Reduce(data, i, firstRow, endRow, numColumns, generations, values);
+		if (values.empty())
+			continue;
 		
-		// What's the ID of this player?
-		int id = evoTourney->players[i]->GetID();
-		
-		for (size_t j = 0 ; j <= numGenerations ; j++)
+		// Convert to graph coordinates
+		x.resize(values.size());
+		y.resize(values.size());
+		for (size_t j = 0 ; j < values.size() ; j++)
 		{
-			// Get the data for this player from the tournament
-			GenerationWeights &weights = evoTourney->data[j];
-			y[i][j] = sideSeparatorY + ((1.0 - weights[id]) * (1.0 - 2 * sideSeparatorY));
+			x[j] = sideSeparatorX + ((1.0 - 2 * sideSeparatorX) * ((generations[j] - first) / (last - first)));
+			y[j] = sideSeparatorY + ((1.0 - values[j]) * (1.0 - 2 * sideSeparatorY));
 		}
+		
+		// Draw the curve
+		renderer.SetGraphColor(i % 15);
+		renderer.DrawPolyLine(values.size(), &x[0], &y[0]);
 	}
 	
-	// Draw the curves and clean up
-	for (size_t i = 0 ; i < numPlayers ; i++)
+	renderer.FinishDrawing(bitmap, svgGraph);
+}
+
+
+
+
+
+void EvoPage::ZoomGraph(int rotation, int mouseX)
+{
+	if (thread || !evoTourney->IsPlayed() || !rotation)
+		return;
+	
+	size_t numGenerations = genSpinner->GetValue();
+	size_t first = viewStart, last = viewEnd ? viewEnd : numGenerations;
+	
+	// Which part of the graph is the mouse over?
+	double at = (double)mouseX / graphWindow->GetClientSize().GetWidth();
+	at = (at - sideSeparatorX) / (1.0 - 2 * sideSeparatorX);
+	at = wxMax(0.0, wxMin(1.0, at));
+	
+	double center = first + at * (last - first);
+	double span = (last - first) * ((rotation > 0) ? 0.5 : 2.0);
+	
+	if (span < 10.0)
+		span = 10.0;
+	if (span >= numGenerations)
 	{
-		renderer.SetGraphColor(i % 15);
-		renderer.DrawPolyLine(numGenerations + 1, x, y[i]);
-		
-		delete[] y[i];
+		ResetZoom();
+		return;
 	}
 	
-	delete[] x;
-	delete[] y;
+	// Keep the generation under the mouse where it is
+	double start = center - at * span;
+	start = wxMax(0.0, wxMin(numGenerations - span, start));
 	
-	renderer.FinishDrawing(bitmap, svgGraph);
+	viewStart = (size_t)(start + 0.5);
+	viewEnd = viewStart + (size_t)span;
+	
+	graphWindow->Refresh();
 }
 
-
+void EvoPage::ResetZoom()
+{
+	viewStart = viewEnd = 0;
+	
+	if (graphWindow)
+		graphWindow->Refresh();
+}
 
 
 
 BEGIN_EVENT_TABLE(EvoGraphWindow, wxWindow)
 	EVT_PAINT(EvoGraphWindow::OnPaint)
+	EVT_MOUSEWHEEL(EvoGraphWindow::OnMouseWheel)
+	EVT_LEFT_DCLICK(EvoGraphWindow::OnDoubleClick)
 END_EVENT_TABLE()
 
 
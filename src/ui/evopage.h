@@ -24,10 +24,14 @@
 #include <wx/spinctrl.h>
 #include <wx/wizard.h>
 #include <wx/graphics.h>
+#include <wx/gauge.h>
+#include <wx/timer.h>
 #include "tools/oyunwizardpage.h"
+#include "../tourney/trajectory.h"
 
 class EvoTournament;
 class EvoGraphWindow;
+class TournamentThread;
 
 
 /**
@@ -185,7 +189,8 @@ private:
     \brief Wizard page on which an evolutionary tournament is run
     
     This page runs an evolutionary tournament and draws its results as
-    a graph.
+    a graph.  The tournament is run on a worker thread, and the graph
+    is redrawn periodically with the generations run so far.
 */
 class EvoPage : public OyunWizardPage
 {
@@ -232,12 +237,38 @@ private:
 	*/
 	void OnSpinnerText(wxCommandEvent &event);
 	
+	/**
+	    \brief Respond to a new number of generations
+	    
+	    The results are thrown away if there are now fewer generations
+	    than have been run.  If there are more, the next run extends
+	    the last one.
+	*/
+	void GenerationsChanged();
+	
 	/**
 	    \brief Called when the "Run Tournament" button is pressed
 	    \param event The event generated
 	*/
 	void OnRunTournament(wxCommandEvent &event);
 	
+	/**
+	    \brief Called periodically while the tournament runs
+	    \param event The event generated
+	*/
+	void OnTimer(wxTimerEvent &event);
+	
+	/**
+	    \brief Called when the tournament thread finishes
+	    \param event The event generated
+	*/
+	void OnTournamentDone(wxCommandEvent &event);
+	
+	/**
+	    \brief Cancel the running tournament, if any, and wait for it
+	*/
+	void StopTournament();
+	
 	/**
 	    \brief Called when the "Show Legend" button is pressed
 	    \param event The event generated
@@ -256,6 +287,12 @@ private:
 	*/
 	void OnAddPlayer(wxNotifyEvent &event);
 	
+	/**
+	    \brief Add a number of players to the tournament
+	    \param event The event generated
+	*/
+	void OnAddPlayers(wxNotifyEvent &event);
+	
 	/**
 	    \brief Remove a player from the tournament
 	    \param event The event generated
@@ -274,6 +311,22 @@ private:
 	*/
 	void PaintGraph(wxWindowDC &dc);
 	
+	/**
+	    \brief Zoom the graph in or out around a point
+	    
+	    Each step halves (or doubles) the range of generations shown,
+	    keeping the generation under the mouse in place.
+	    
+	    \param rotation Mouse wheel rotation; positive zooms in
+	    \param mouseX Position of the mouse in the graph window
+	*/
+	void ZoomGraph(int rotation, int mouseX);
+	
+	/**
+	    \brief Show every generation on the graph again
+	*/
+	void ResetZoom();
+	
 	
 	friend class EvoFinishPage;
 	
@@ -294,17 +347,56 @@ private:
 	    time the graph is redrawn.
 	*/
 	wxImage imageGraph;
+	
+	/**
+	    \brief Min/max summary of the tournament data
+	    
+	    This is built once after the tournament is run (and on every
+	    redraw while it runs), so that
+	    redrawing the graph only has to draw about two points per pixel,
+	    however many generations were run.  The saved SVG and image
+	    files are drawn the same way.
+	*/
+	TrajectoryPyramid pyramid;
+	
+	/**
+	    \brief The first generation shown on the graph
+	*/
+	size_t viewStart;
+	
+	/**
+	    \brief The last generation shown on the graph, or zero to show
+	           every generation
+	*/
+	size_t viewEnd;
 		
 	
 	/**
 	    \brief The evolutionary tournament to be run
 	*/
 	EvoTournament *evoTourney;
+	
+	/**
+	    \brief The thread running the tournament, or \c NULL if it
+	           isn't running
+	*/
+	TournamentThread *thread;
+	
+	/**
+	    \brief Timer used to redraw the graph while the tournament runs
+	*/
+	wxTimer timer;
+	
+	/**
+	    \brief The file where long runs of these players are checkpointed
+	*/
+	wxString checkpointName;
 
 	wxButton *runTournament;		/**< \brief The run tournament button */
 	wxButton *legend;			/**< \brief The show legend button */
 	wxStaticText *spinnerLabel;		/**< \brief The text label for the spinner */
 	wxSpinCtrl *genSpinner;			/**< \brief The spinner to select generation number */
+	wxGauge *gauge;				/**< \brief The progress of the running tournament */
 	
 	friend class EvoGraphWindow;
 	EvoGraphWindow *graphWindow;		/**< \brief The window in which we draw the graph */
@@ -354,6 +446,20 @@ private:
 		wxPaintDC pdc(this);
 		parent->PaintGraph(pdc);
 	}
+	
+	/**
+	    \brief Respond to the mouse wheel by zooming the graph
+	    \param event The event generated
+	*/
+	void OnMouseWheel(wxMouseEvent &event)
+	{ parent->ZoomGraph(event.GetWheelRotation(), event.GetX()); }
+	
+	/**
+	    \brief Respond to a double-click by showing the whole graph
+	    \param event The event generated
+	*/
+	void OnDoubleClick(wxMouseEvent & WXUNUSED(event))
+	{ parent->ResetZoom(); }
 };
 
 
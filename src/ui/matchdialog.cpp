@@ -30,12 +30,13 @@
 #include <wx/statline.h>
 
 #include "matchdialog.h"
+#include "../common/error.h"
 #include "../tourney/match.h"
 
 IMPLEMENT_CLASS(MatchDialog, wxDialog)
 
 
-MatchDialog::MatchDialog(wxWindow *parent, Match *match) :
+MatchDialog::MatchDialog(wxWindow *parent, Match *match, const Game *game) :
 	wxDialog(parent, wxID_ANY, wxString(_("Match Details")))
 {
 	// Make the header controls
@@ -56,6 +57,12 @@ MatchDialog::MatchDialog(wxWindow *parent, Match *match) :
 	height += 12;
 	width *= 30;
 	
+	// Get the moves, replaying the match if need be
+	wxArrayString histories[5];
+	if (!match->GetHistory(game, histories))
+		wxMessageBox(wxString::Format(_("Could not replay the match.  Error reported:\n\n%s"), Error::Get().c_str()),
+		             _("Oyun: Error"), wxOK | wxICON_ERROR, parent);
+	
 	for (size_t i = 0 ; i < 5 ; i++)
 	{
 		wxString str;
@@ -63,7 +70,7 @@ MatchDialog::MatchDialog(wxWindow *parent, Match *match) :
 		labels[i] = new wxStaticText(this, wxID_ANY, str);
 		
 		str.Clear();
-		wxArrayString &history = match->matchHistory[i];
+		wxArrayString &history = histories[i];
 		
 		str += _("Player 1: ");
 		for (size_t j = 0 ; j < history.size() ; j++)
@@ -22,6 +22,7 @@
 #define MATCHDIALOG_H__
 
 class Match;
+class Game;
 
 
 /**
@@ -39,12 +40,14 @@ public:
 	    \brief Constructor
 	    
 	    Constructs the dialog and fills its controls with information
-	    about the match
+	    about the match.  If the match's moves weren't kept, it is
+	    replayed to recover them.
 	    
 	    \param parent The parent of this dialog box
 	    \param match The match to be displayed
+	    \param game The game the match was played with
 	*/
-	MatchDialog(wxWindow *parent, Match *match);
+	MatchDialog(wxWindow *parent, Match *match, const Game *game);
 	
 private:
 	wxBoxSizer *sizer;		/**< \brief The sizer for the dialog controls */
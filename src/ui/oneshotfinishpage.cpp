@@ -27,11 +27,12 @@
 #  include <wx/wx.h>
 #endif
 
-#include <wx/textfile.h>
 #include <wx/filename.h>
 
+#include "../common/outputfile.h"
 #include "../tourney/tournament.h"
 
+#include "tools/exportthread.h"
 #include "oyunapp.h"
 #include "oyunwizard.h"
 #include "oneshotfinishpage.h"
@@ -43,6 +44,340 @@ enum
 	ID_SAVE_TEXT
 };
 
+
+// Writes the scores and match results as a spreadsheet
+class OneShotCSVExport : public ExportThread
+{
+public:
+	OneShotCSVExport(const wxString &fileName, Tournament *newTourney) :
+		ExportThread(fileName), tourney(newTourney)
+	{ }
+
+protected:
+	virtual bool Export()
+	{
+		progress.Start(tourney->GetNumMatches());
+		
+		OutputFile out;
+		if (!out.Open(fileName))
+			return false;
+		
+		// This is a seven-column CSV:
+		//
+		// Oyun Tournament Summary
+		//
+		// Player, Author, Net Score
+		// ...
+		//
+		// Player 1, Player 1 Author, Player 2, Player 2 Author, Winner, Player 1 Score, Player 2 Score
+		// ...
+	
+		// Write the header
+		wxString header = _("Oyun Tournament Summary") + wxString(wxT(",,,,,,"));
+		out.WriteLine(header);
+	
+		// Write a blank line
+		wxString blankLine = wxT(",,,,,,");
+		out.WriteLine(blankLine);
+	
+		// Write the header for the first block
+		wxString firstHeader = _("Player Name") + wxString(wxT(",")) +
+		                       _("Player Author") + wxString(wxT(",")) +
+		                       _("Net Score") + wxString(wxT(",,,,"));
+		out.WriteLine(firstHeader);
+	
+		// Add the data for the first table
+		size_t numPlayers = tourney->playerOneList.GetCount();
+		for (size_t p = 0 ; p < numPlayers ; p++)
+		{
+			Player *player = tourney->playerOneList[p];
+			int score = tourney->scores[player->GetID()];
+		
+			wxString line = player->GetPlayerName() + wxT(",") +
+			                player->GetPlayerAuthor() + wxT(",") +
+			                wxString::Format(wxT("%d"), score) + wxT(",,,,");
+			out.WriteLine(line);
+		}
+	
+		// Add another blank line
+		out.WriteLine(blankLine);
+	
+		// Write the header for the second block
+		wxString secondHeader = _("Player 1") + wxString(wxT(",")) +
+		                        _("Player 1 Author") + wxString(wxT(",")) +
+		                        _("Player 2") + wxString(wxT(",")) +
+		                        _("Player 2 Author") + wxString(wxT(",")) +
+		                        _("Winner") + wxString(wxT(",")) +
+		                        _("Player 1 Score") + wxString(wxT(",")) +
+		                        _("Player 2 Score");
+		out.WriteLine(secondHeader);
+	
+		size_t numMatches = tourney->GetNumMatches();
+		for (size_t m = 0 ; m < numMatches ; m++)
+		{
+			if (Cancelled())
+				return false;
+			
+			Match *match = tourney->GetMatch(m);
+		
+			wxString result;
+			if (match->playerOneScore > match->playerTwoScore)
+				result = _("Player One");
+			else if (match->playerTwoScore > match->playerOneScore)
+				result = _("Player Two");
+			else
+				result = _("Tie");
+		
+			out.Write(match->playerOne->GetPlayerName());
+			out.Write(',');
+			out.Write(match->playerOne->GetPlayerAuthor());
+			out.Write(',');
+			out.Write(match->playerTwo->GetPlayerName());
+			out.Write(',');
+			out.Write(match->playerTwo->GetPlayerAuthor());
+			out.Write(',');
+			out.Write(result);
+			out.Write(',');
+			out.WriteInt(match->playerOneScore);
+			out.Write(',');
+			out.WriteInt(match->playerTwoScore);
+			out.EndLine();
+			
+			progress.Advance();
+		}
+		
+		return out.Close();
+	}
+
+private:
+	Tournament *tourney;
+};
+
+// Writes a detailed report, with every move of every match, as RTF
+class RTFExport : public ExportThread
+{
+public:
+	RTFExport(const wxString &fileName, Tournament *newTourney, const Game *newGame) :
+		ExportThread(fileName), tourney(newTourney), game(newGame)
+	{ }
+
+protected:
+	virtual bool Export()
+	{
+		progress.Start(tourney->GetNumMatches());
+		
+		OutputFile out;
+		if (!out.Open(fileName))
+			return false;
+		
+		// Write a standard RTF file header
+		out.WriteLine(wxT("{\\rtf1\\ansi\\ansicpg1252\\deff0{\\fonttbl{\\f0\\fswiss Arial;}{\\f1\\fmodern Courier New;}}\\fs24\n"));
+	
+		// we want to write lines like:
+		// {\par\pard\plain Text!}
+		//
+		// To enable/disable font attributes we do:
+		// \fs24 = 12-pt font
+		// \fs36 = 18-pt font
+		// \b = bold font
+		// \b0 = disable bold font
+		// \i = italic font
+		// \i0 = disable italic font
+	
+		// We'll need this often later
+		wxString blankLine = wxString(wxT("{\\par\\pard\\plain  }"));
+	
+		// Write a heading
+		wxString header = wxString(wxT("{\\par\\pard\\plain \\fs36\\b ")) +
+		                  _("Oyun: Detailed Tournament Report") + 
+		                  wxString(wxT(" \\b0\\fs24}"));
+		out.WriteLine(header);
+		out.WriteLine(blankLine);
+		out.WriteLine(blankLine);
+	
+		// Write a header for the player summary data
+		wxString playerSumm = wxString(wxT("{\\par\\pard\\plain \\fs28\\i ")) +
+		                      _("Player Summary Data") +
+		                      wxString(wxT(" \\i0}"));
+		out.WriteLine(playerSumm);
+		out.WriteLine(blankLine);
+	
+		// Write the player summary data
+		size_t numPlayers = tourney->playerOneList.GetCount();
+		for (size_t p = 0 ; p < numPlayers ; p++)
+		{
+			Player *player = tourney->playerOneList[p];
+			int score = tourney->scores[player->GetID()];
+			wxString scoreStr = wxString::Format(wxT("%i"), score);
+		
+			wxString line;
+			line = wxT("{\\par\\pard\\plain ") +
+			       player->GetPlayerName() + wxT(" [") +
+			       player->GetPlayerAuthor() + wxT("]: ") +
+			       scoreStr + wxT(" ") +
+			       _("points") + wxT(" }");
+		
+			out.WriteLine(line);
+		}
+		out.WriteLine(blankLine);
+		out.WriteLine(blankLine);
+	
+		// Write a header for the match summary data
+		wxString matchSumm = wxString(wxT("{\\par\\pard\\plain \\fs28\\i ")) +
+		                     _("Match Summary Data") +
+		                     wxString(wxT(" \\i0}"));
+		out.WriteLine(matchSumm);
+		out.WriteLine(blankLine);
+	
+		// Write the match summary info
+		size_t numMatches = tourney->GetNumMatches();
+		for (size_t m = 0 ; m < numMatches ; m++)
+		{
+			Match *match = tourney->GetMatch(m);
+
+			wxString playerOne = wxT("\\b ") +
+			                     match->playerOne->GetPlayerName() + wxT(" [") +
+			                     match->playerOne->GetPlayerAuthor() + wxT("]") +
+			                     wxT("\\b0 ");
+			wxString playerTwo = wxT("\\b ") +
+			                     match->playerTwo->GetPlayerName() + wxT(" [") +
+			                     match->playerTwo->GetPlayerAuthor() + wxT("]") +
+			                     wxT("\\b0 ");
+			wxString players = wxString::Format(_("%s played %s:"), playerOne.c_str(), playerTwo.c_str());
+		
+			wxString result;
+			if (match->playerOneScore == match->playerTwoScore)
+			{
+				result = wxString::Format(_("the match was a tie, %d to %d"), 
+				                          match->playerOneScore, match->playerTwoScore);
+			}
+			else
+			{
+				wxString winner;
+				int winnerScore, loserScore;
+			
+				if (match->playerOneScore > match->playerTwoScore)
+				{
+					winner = wxString(wxT("\\b ")) + _("Player One") + wxString(wxT("\\b0 "));
+					winnerScore = match->playerOneScore;
+					loserScore = match->playerTwoScore;
+				}
+				else
+				{
+					winner = wxString(wxT("\\b ")) + _("Player Two") + wxString(wxT("\\b0 "));
+					winnerScore = match->playerTwoScore;
+					loserScore = match->playerOneScore;
+				}
+			
+				result = wxString::Format(_("%s won, by a score of %d to %d"), winner.c_str(),
+				                          winnerScore, loserScore);
+			}
+		
+			wxString line = wxT("{\\par\\pard\\plain \\~\\~\\~\\bullet\\~\\~\\~ ") + 
+			                players + wxT(" ") + result + wxT(" }");
+			out.WriteLine(line);
+		}
+	
+		// Now, write detailed data for each match
+		for (size_t m = 0 ; m < numMatches ; m++)
+		{
+			if (Cancelled())
+				return false;
+			
+			Match *match = tourney->GetMatch(m);
+		
+			// Emit a page break
+			out.WriteLine(wxT("\\page"));
+		
+			// Once again, get the player strings
+			wxString playerOne = match->playerOne->GetPlayerName() + wxT(" [") +
+			                     match->playerOne->GetPlayerAuthor() + wxT("]");
+			wxString playerTwo = match->playerTwo->GetPlayerName() + wxT(" [") +
+			                     match->playerTwo->GetPlayerAuthor() + wxT("]");
+		
+			// Make a header
+			wxString secHeader = wxString(wxT("{\\par\\pard\\plain \\fs32\\b ")) +
+			                     wxString::Format(_("Match %d: %s vs. %s"), m + 1, playerOne.c_str(), playerTwo.c_str()) + 
+		        	             wxString(wxT(" \\b0\\fs24}"));
+			out.WriteLine(secHeader);
+			out.WriteLine(blankLine);
+			out.WriteLine(blankLine);
+		
+			// These pages deserve some explanation
+			wxString descrip = wxString(wxT("{\\par\\pard\\plain ")) +
+			                   _("The moves for this match are listed in order, in groups of forty.  Moves for player one "
+			                     "are on the first line of each group, player two on the second line.") +
+			                   wxString(wxT(" }"));
+			out.WriteLine(descrip);
+			out.WriteLine(blankLine);
+		
+			// Get the moves, which may mean replaying the match
+			wxArrayString histories[5];
+			if (!match->GetHistory(game, histories))
+				return false;
+			
+			// Output information for each of the five games
+			for (size_t gm = 0 ; gm < 5 ; gm++)
+			{
+				wxArrayString &history = histories[gm];
+				size_t numMoves = history.size();
+			
+				// Output info on which game this is
+				wxString gameHeader = wxString(wxT("{\\par\\pard\\plain ")) +
+				                      wxString::Format(_("Game %d/5 (%d moves):"), gm + 1, numMoves) +
+				                      wxString(wxT(" }"));
+				out.WriteLine(gameHeader);
+				out.WriteLine(blankLine);
+			
+				// Output a header for the match moves list
+				out.WriteLine(wxT("{\\par\\pard\\plain\\f1{1   .    10   .    20   .    30   .    40}\\f0}"));
+				out.WriteLine(blankLine);
+					
+				// Now, we have a problem here, because we want to keep the vertical
+				// alignment between the strings.  So, we should just output 30 matches
+				// per line.
+				size_t numLines = (size_t)ceil(numMoves / 40.0);
+				for (size_t l = 0 ; l < numLines ; l++)
+				{
+					// Figure out which moves are on this line
+					size_t start = l * 40;
+					size_t end = l * 40 + 40;
+					if (end > numMoves)
+						end = numMoves;
+				
+					// Output the player one moves
+					wxString p1line = wxT("{\\par\\pard\\plain\\f1{");
+					for (size_t mv = start ; mv < end ; mv++)
+						p1line += history[mv][0];
+					p1line += wxT("}\\f0}");
+					out.WriteLine(p1line);
+
+					// Output the player two moves
+					wxString p2line = wxT("{\\par\\pard\\plain\\f1{");
+					for (size_t mv = start ; mv < end ; mv++)
+						p2line += history[mv][1];
+					p2line += wxT("}\\f0}");
+					out.WriteLine(p2line);
+				
+					// Add a blank line for spacing
+					out.WriteLine(blankLine);
+				}
+			}
+			
+			progress.Advance();
+		}
+	
+		// Write a standard RTF file footer
+		out.WriteLine(wxT("}"));
+		
+		return out.Close();
+	}
+
+private:
+	Tournament *tourney;
+	const Game *game;
+};
+
 IMPLEMENT_CLASS(OneShotFinishPage, FinishPage)
 
 
@@ -126,93 +461,9 @@ void OneShotFinishPage::OnSaveCSV(wxCommandEvent & WXUNUSED(event))
 		filename.SetExt(wxT("csv"));
 
 	// Save the CSV file
-	wxTextFile file(filename.GetFullPath());
-
-	if (file.Exists())
-	{
-		file.Open();
-		file.Clear();
-	}
-	else
-		file.Create();	
-	
-	// This is a seven-column CSV:
-	//
-	// Oyun Tournament Summary
-	//
-	// Player, Author, Net Score
-	// ...
-	//
-	// Player 1, Player 1 Author, Player 2, Player 2 Author, Winner, Player 1 Score, Player 2 Score
-	// ...
-	
-	// Write the header
-	wxString header = _("Oyun Tournament Summary") + wxString(wxT(",,,,,,"));
-	file.AddLine(header);
-	
-	// Write a blank line
-	wxString blankLine = wxT(",,,,,,");
-	file.AddLine(blankLine);
-	
-	// Write the header for the first block
-	wxString firstHeader = _("Player Name") + wxString(wxT(",")) +
-	                       _("Player Author") + wxString(wxT(",")) +
-	                       _("Net Score") + wxString(wxT(",,,,"));
-	file.AddLine(firstHeader);
-	
-	// Add the data for the first table
-	size_t numPlayers = previous->tourney->playerOneList.GetCount();
-	for (size_t p = 0 ; p < numPlayers ; p++)
-	{
-		Player *player = previous->tourney->playerOneList[p];
-		int score = previous->tourney->scores[player->GetID()];
-		
-		wxString line = player->GetPlayerName() + wxT(",") +
-		                player->GetPlayerAuthor() + wxT(",") +
-		                wxString::Format(wxT("%d"), score) + wxT(",,,,");
-		file.AddLine(line);
-	}
-	
-	// Add another blank line
-	file.AddLine(blankLine);
-	
-	// Write the header for the second block
-	wxString secondHeader = _("Player 1") + wxString(wxT(",")) +
-	                        _("Player 1 Author") + wxString(wxT(",")) +
-	                        _("Player 2") + wxString(wxT(",")) +
-	                        _("Player 2 Author") + wxString(wxT(",")) +
-	                        _("Winner") + wxString(wxT(",")) +
-	                        _("Player 1 Score") + wxString(wxT(",")) +
-	                        _("Player 2 Score");
-	file.AddLine(secondHeader);
-	
-	size_t numMatches = previous->tourney->GetNumMatches();
-	for (size_t m = 0 ; m < numMatches ; m++)
-	{
-		Match *match = previous->tourney->GetMatch(m);
-		
-		wxString result;
-		if (match->playerOneScore > match->playerTwoScore)
-			result = _("Player One");
-		else if (match->playerTwoScore > match->playerOneScore)
-			result = _("Player Two");
-		else
-			result = _("Tie");
-		
-		wxString line = match->playerOne->GetPlayerName() + wxT(",") +
-		                match->playerOne->GetPlayerAuthor() + wxT(",") +
-		                match->playerTwo->GetPlayerName() + wxT(",") +
-		                match->playerTwo->GetPlayerAuthor() + wxT(",") +
-		                result + wxT(",") +
-		                wxString::Format(wxT("%d"), match->playerOneScore) + wxT(",") +
-		                wxString::Format(wxT("%d"), match->playerTwoScore);
-		file.AddLine(line);
-	}
-	
-	file.Write();
-	file.Close();
-	
-	dataSaved = true;
+	OneShotCSVExport csv(filename.GetFullPath(), previous->tourney);
+	if (csv.Execute(this))
+		dataSaved = true;
 }
 
 void OneShotFinishPage::OnSaveText(wxCommandEvent & WXUNUSED(event))
@@ -234,209 +485,8 @@ void OneShotFinishPage::OnSaveText(wxCommandEvent & WXUNUSED(event))
 		filename.SetExt(wxT("rtf"));
 
 	// Save the RTF file
-	wxTextFile file(filename.GetFullPath());
-
-	if (file.Exists())
-	{
-		file.Open();
-		file.Clear();
-	}
-	else
-		file.Create();	
-	
-	// Write a standard RTF file header
-	file.AddLine(wxT("{\\rtf1\\ansi\\ansicpg1252\\deff0{\\fonttbl{\\f0\\fswiss Arial;}{\\f1\\fmodern Courier New;}}\\fs24\n"));
-	
-	// we want to write lines like:
-	// {\par\pard\plain Text!}
-	//
-	// To enable/disable font attributes we do:
-	// \fs24 = 12-pt font
-	// \fs36 = 18-pt font
-	// \b = bold font
-	// \b0 = disable bold font
-	// \i = italic font
-	// \i0 = disable italic font
-	
-	// We'll need this often later
-	wxString blankLine = wxString(wxT("{\\par\\pard\\plain  }"));
-	
-	// Write a heading
-	wxString header = wxString(wxT("{\\par\\pard\\plain \\fs36\\b ")) +
-	                  _("Oyun: Detailed Tournament Report") + 
-	                  wxString(wxT(" \\b0\\fs24}"));
-	file.AddLine(header);
-	file.AddLine(blankLine);
-	file.AddLine(blankLine);
-	
-	// Write a header for the player summary data
-	wxString playerSumm = wxString(wxT("{\\par\\pard\\plain \\fs28\\i ")) +
-	                      _("Player Summary Data") +
-	                      wxString(wxT(" \\i0}"));
-	file.AddLine(playerSumm);
-	file.AddLine(blankLine);
-	
-	// Write the player summary data
-	size_t numPlayers = previous->tourney->playerOneList.GetCount();
-	for (size_t p = 0 ; p < numPlayers ; p++)
-	{
-		Player *player = previous->tourney->playerOneList[p];
-		int score = previous->tourney->scores[player->GetID()];
-		wxString scoreStr = wxString::Format(wxT("%i"), score);
-		
-		wxString line;
-		line = wxT("{\\par\\pard\\plain ") +
-		       player->GetPlayerName() + wxT(" [") +
-		       player->GetPlayerAuthor() + wxT("]: ") +
-		       scoreStr + wxT(" ") +
-		       _("points") + wxT(" }");
-		
-		file.AddLine(line);
-	}
-	file.AddLine(blankLine);
-	file.AddLine(blankLine);
-	
-	// Write a header for the match summary data
-	wxString matchSumm = wxString(wxT("{\\par\\pard\\plain \\fs28\\i ")) +
-	                     _("Match Summary Data") +
-	                     wxString(wxT(" \\i0}"));
-	file.AddLine(matchSumm);
-	file.AddLine(blankLine);
-	
-	// Write the match summary info
-	size_t numMatches = previous->tourney->GetNumMatches();
-	for (size_t m = 0 ; m < numMatches ; m++)
-	{
-		Match *match = previous->tourney->GetMatch(m);
-
-		wxString playerOne = wxT("\\b ") +
-		                     match->playerOne->GetPlayerName() + wxT(" [") +
-		                     match->playerOne->GetPlayerAuthor() + wxT("]") +
-		                     wxT("\\b0 ");
-		wxString playerTwo = wxT("\\b ") +
-		                     match->playerTwo->GetPlayerName() + wxT(" [") +
-		                     match->playerTwo->GetPlayerAuthor() + wxT("]") +
-		                     wxT("\\b0 ");
-		wxString players = wxString::Format(_("%s played %s:"), playerOne.c_str(), playerTwo.c_str());
-		
-		wxString result;
-		if (match->playerOneScore == match->playerTwoScore)
-		{
-			result = wxString::Format(_("the match was a tie, %d to %d"), 
-			                          match->playerOneScore, match->playerTwoScore);
-		}
-		else
-		{
-			wxString winner;
-			int winnerScore, loserScore;
-			
-			if (match->playerOneScore > match->playerTwoScore)
-			{
-				winner = wxString(wxT("\\b ")) + _("Player One") + wxString(wxT("\\b0 "));
-				winnerScore = match->playerOneScore;
-				loserScore = match->playerTwoScore;
-			}
-			else
-			{
-				winner = wxString(wxT("\\b ")) + _("Player Two") + wxString(wxT("\\b0 "));
-				winnerScore = match->playerTwoScore;
-				loserScore = match->playerOneScore;
-			}
-			
-			result = wxString::Format(_("%s won, by a score of %d to %d"), winner.c_str(),
-			                          winnerScore, loserScore);
-		}
-		
-		wxString line = wxT("{\\par\\pard\\plain \\~\\~\\~\\bullet\\~\\~\\~ ") + 
-		                players + wxT(" ") + result + wxT(" }");
-		file.AddLine(line);
-	}
-	
-	// Now, write detailed data for each match
-	for (size_t m = 0 ; m < numMatches ; m++)
-	{
-		Match *match = previous->tourney->GetMatch(m);
-		
-		// Emit a page break
-		file.AddLine(wxT("\\page"));
-		
-		// Once again, get the player strings
-		wxString playerOne = match->playerOne->GetPlayerName() + wxT(" [") +
-		                     match->playerOne->GetPlayerAuthor() + wxT("]");
-		wxString playerTwo = match->playerTwo->GetPlayerName() + wxT(" [") +
-		                     match->playerTwo->GetPlayerAuthor() + wxT("]");
-		
-		// Make a header
-		wxString secHeader = wxString(wxT("{\\par\\pard\\plain \\fs32\\b ")) +
-		                     wxString::Format(_("Match %d: %s vs. %s"), m + 1, playerOne.c_str(), playerTwo.c_str()) + 
-	        	             wxString(wxT(" \\b0\\fs24}"));
-		file.AddLine(secHeader);
-		file.AddLine(blankLine);
-		file.AddLine(blankLine);
-		
-		// These pages deserve some explanation
-		wxString descrip = wxString(wxT("{\\par\\pard\\plain ")) +
-		                   _("The moves for this match are listed in order, in groups of forty.  Moves for player one "
-		                     "are on the first line of each group, player two on the second line.") +
-		                   wxString(wxT(" }"));
-		file.AddLine(descrip);
-		file.AddLine(blankLine);
-		
-		// Output information for each of the five games
-		for (size_t gm = 0 ; gm < 5 ; gm++)
-		{
-			wxArrayString &history = match->matchHistory[gm];
-			size_t numMoves = history.size();
-			
-			// Output info on which game this is
-			wxString gameHeader = wxString(wxT("{\\par\\pard\\plain ")) +
-			                      wxString::Format(_("Game %d/5 (%d moves):"), gm + 1, numMoves) +
-			                      wxString(wxT(" }"));
-			file.AddLine(gameHeader);
-			file.AddLine(blankLine);
-			
-			// Output a header for the match moves list
-			file.AddLine(wxT("{\\par\\pard\\plain\\f1{1   .    10   .    20   .    30   .    40}\\f0}"));
-			file.AddLine(blankLine);
-					
-			// Now, we have a problem here, because we want to keep the vertical
-			// alignment between the strings.  So, we should just output 30 matches
-			// per line.
-			size_t numLines = (size_t)ceil(numMoves / 40.0);
-			for (size_t l = 0 ; l < numLines ; l++)
-			{
-				// Figure out which moves are on this line
-				size_t start = l * 40;
-				size_t end = l * 40 + 40;
-				if (end > numMoves)
-					end = numMoves;
-				
-				// Output the player one moves
-				wxString p1line = wxT("{\\par\\pard\\plain\\f1{");
-				for (size_t mv = start ; mv < end ; mv++)
-					p1line += history[mv][0];
-				p1line += wxT("}\\f0}");
-				file.AddLine(p1line);
-
-				// Output the player two moves
-				wxString p2line = wxT("{\\par\\pard\\plain\\f1{");
-				for (size_t mv = start ; mv < end ; mv++)
-					p2line += history[mv][1];
-				p2line += wxT("}\\f0}");
-				file.AddLine(p2line);
-				
-				// Add a blank line for spacing
-				file.AddLine(blankLine);
-			}
-		}
-	}
-	
-	// Write a standard RTF file footer
-	file.AddLine(wxT("}"));
-	
-	file.Write();
-	file.Close();
-	
-	dataSaved = true;
+	RTFExport rtf(filename.GetFullPath(), previous->tourney, parent->game);
+	if (rtf.Execute(this))
+		dataSaved = true;
 }
 
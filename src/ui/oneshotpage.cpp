@@ -30,6 +30,11 @@
 #include <wx/wizard.h>
 #include <wx/splitter.h>
 #include <wx/listctrl.h>
+#include <wx/gauge.h>
+#include <wx/timer.h>
+
+#include <vector>
+#include <algorithm>
 
 #include "../common/error.h"
 #include "../game/player.h"
@@ -40,6 +45,7 @@
 #include "oyunwizard.h"
 #include "oneshotpage.h"
 #include "matchdialog.h"
+#include "tools/tournamentthread.h"
 
 IMPLEMENT_CLASS(OneShotPage, OyunWizardPage)
 
@@ -49,7 +55,25 @@ enum
 	ID_LEFT_WINDOW,
 	ID_RIGHT_WINDOW,
 	ID_SHOW_DETAILS,
-	ID_MATCH_LIST
+	ID_MATCH_LIST,
+	ID_TIMER
+};
+
+
+// The worker thread which plays the tournament
+class OneShotThread : public TournamentThread
+{
+public:
+	OneShotThread(wxEvtHandler *handler, Tournament *newTourney) :
+		TournamentThread(handler), tourney(newTourney)
+	{ }
+
+protected:
+	virtual bool RunTournament()
+	{ return tourney->Run(&progress); }
+
+private:
+	Tournament *tourney;
 };
 
 
@@ -61,11 +85,15 @@ BEGIN_EVENT_TABLE(OneShotPage, OyunWizardPage)
 	EVT_BUTTON(ID_RUN_TOURNAMENT, OneShotPage::OnRunTournament)
 	EVT_BUTTON(ID_SHOW_DETAILS, OneShotPage::OnMatchDetails)
 	
+	EVT_TIMER(ID_TIMER, OneShotPage::OnTimer)
+	EVT_COMMAND(wxID_ANY, wxEVT_TOURNAMENT_DONE, OneShotPage::OnTournamentDone)
+	
 	EVT_LIST_ITEM_SELECTED(ID_MATCH_LIST, OneShotPage::OnMatchSelected)
 	EVT_LIST_ITEM_DESELECTED(ID_MATCH_LIST, OneShotPage::OnMatchSelected)
 	
 	EVT_NOTIFY(wxEVT_DATA_UPDATE, wxID_ANY, OneShotPage::OnDataUpdate)
 	EVT_NOTIFY(wxEVT_ADD_PLAYER, wxID_ANY, OneShotPage::OnAddPlayer)
+	EVT_NOTIFY(wxEVT_ADD_PLAYERS, wxID_ANY, OneShotPage::OnAddPlayers)
 	EVT_NOTIFY(wxEVT_REMOVE_PLAYER, wxID_ANY, OneShotPage::OnRemovePlayer)
 END_EVENT_TABLE()
 
@@ -73,7 +101,8 @@ END_EVENT_TABLE()
 OneShotPage::OneShotPage(OyunWizard *parent, wxWizardPage *prev, wxWizardPage *next) :
                          OyunWizardPage(_("One-Shot Tournament"),
                                         _("This tournament runs one round of the prisoner's dilemma between a set of players."),
-                                        parent, prev, next)
+                                        parent, prev, next),
+                         thread(NULL), timer(this, ID_TIMER), matchesShown(0)
 {
 	// Make the tournament
 	tourney = new Tournament(parent->game);
@@ -92,6 +121,7 @@ OneShotPage::OneShotPage(OyunWizard *parent, wxWizardPage *prev, wxWizardPage *n
 	runTournament = new wxButton(rightWindow, ID_RUN_TOURNAMENT, _("&Run Tournament"));
 	details = new wxButton(rightWindow, ID_SHOW_DETAILS, _("&Show Details..."));
 	details->Disable();
+	gauge = new wxGauge(rightWindow, wxID_ANY, 100, wxDefaultPosition, wxSize(150, -1));
 	
 	playerListLabel = new wxStaticText(leftWindow, wxID_ANY, _("Tournament players:"));
 	
@@ -135,6 +165,7 @@ OneShotPage::OneShotPage(OyunWizard *parent, wxWizardPage *prev, wxWizardPage *n
 	buttonSizer->Add(runTournament, 0, wxEXPAND | wxALL, 6);
 	buttonSizer->Add(details, 0, wxEXPAND | wxALL, 6);
 	buttonSizer->AddStretchSpacer();
+	buttonSizer->Add(gauge, 0, wxALIGN_CENTER_VERTICAL | wxALL, 6);
 	
 	rightSizer->Add(buttonSizer, 0, wxEXPAND);
 	rightSizer->Add(matchListLabel, 0, wxEXPAND | wxALL, 6);
@@ -163,10 +194,12 @@ OneShotPage::OneShotPage(OyunWizard *parent, wxWizardPage *prev, wxWizardPage *n
 
 	// And hide the winner display, or things go wrong
 	winner->Show(false);
+	gauge->Show(false);
 }
 
 OneShotPage::~OneShotPage()
 {
+	StopTournament();
 	delete tourney;
 }
 
@@ -196,15 +229,23 @@ int wxCALLBACK OneShotPage::PlayerNumSortColumn1(long item1, long item2, long so
 	return 0;
 }
 
-int wxCALLBACK OneShotPage::MatchAlphaSortColumn0(long item1, long item2, long sortData)
+// Orders match indices by the name of player one, as the match list
+// is shown
+class MatchNameLess
 {
-	OneShotPage *op = (OneShotPage *)sortData;
-	Match *one = op->tourney->GetMatch(item1);
-	Match *two = op->tourney->GetMatch(item2);
+public:
+	MatchNameLess(Tournament *newTourney) : tourney(newTourney)
+	{ }
+	
+	bool operator()(int one, int two) const
+	{
+		return (tourney->GetMatch(one)->playerOne->GetPlayerName() <
+		        tourney->GetMatch(two)->playerOne->GetPlayerName());
+	}
 
-	return (one->playerOne->GetPlayerName() < two->playerOne->GetPlayerName() ? -1 :
-		(one->playerOne->GetPlayerName() == two->playerOne->GetPlayerName() ? 0 : 1));
-}
+private:
+	Tournament *tourney;
+};
 
 void OneShotPage::OnDataUpdate(wxNotifyEvent & WXUNUSED(event))
 {
@@ -244,9 +285,14 @@ void OneShotPage::OnDataUpdate(wxNotifyEvent & WXUNUSED(event))
 		rightSizer->Show(winner, true);
 		rightSizer->Layout();
 	}
+	else
+	{
+		rightSizer->Show(winner, false);
+		rightSizer->Layout();
+	}
 	
 	// Update the control states if we're visible
-	if (IsShownOnScreen())
+	if (IsShownOnScreen() && !thread)
 	{
 		if (tourney->IsPlayed())
 		{
@@ -301,8 +347,9 @@ void OneShotPage::UpdatePlayerList()
 	// See if we have any work to do
 	if (!tourney->playerOneList.size())
 		return;
-
-	// Loop through and add the players to the list
+	
+	// Loop through and add the players to the list, with their
+	// scores filled in below
 	// This is weird, because the players are added two-at-a-time
 	for (size_t i = 0 ; i < tourney->playerOneList.GetCount() ; i++)
 	{
@@ -316,23 +363,40 @@ void OneShotPage::UpdatePlayerList()
 		item.m_col = 0;
 		item.m_data = i;
 		playerList->InsertItem(item);
-
-		// See if we've played a match
-		item.m_col = 1;
-		if (tourney->IsPlayed())
-			item.m_text.Printf(wxT("%d"), tourney->scores[player->GetID()]);
-		else
-			item.m_text = wxT("");
-		playerList->SetItem(item);
 	}
 
-
-	// Update the width of the columns 
+	// Update the width of the name column
 	CalcColumnWidth(playerList, 0);
+	
+	UpdatePlayerScores();
+}
+
+void OneShotPage::UpdatePlayerScores()
+{
+	if (!tourney->playerOneList.size())
+		return;
+	
+	// The tournament might be running, so hold its lock while we read
+	// the scores, which are complete for the matches played so far
+	wxCriticalSectionLocker locker(tourney->GetLock());
+	bool haveScores = (tourney->GetNumMatchesPlayed() > 0);
+	
+	// The rows are only sorted, never added or removed here, so
+	// just rewrite the score of each one
+	for (int row = 0 ; row < playerList->GetItemCount() ; row++)
+	{
+		Player *player = tourney->playerOneList[playerList->GetItemData(row)];
+		
+		if (haveScores)
+			playerList->SetItem(row, 1, wxString::Format(wxT("%d"), tourney->scores[player->GetID()]));
+		else
+			playerList->SetItem(row, 1, wxT(""));
+	}
+	
 	CalcColumnWidth(playerList, 1);
 
 	// Sort--if we've played, by col. 1 numerically descending, else by col. 2
-	if (tourney->IsPlayed())
+	if (haveScores)
 		playerList->SortItems((wxListCtrlCompare)PlayerNumSortColumn1, (long)this);
 	else
 		playerList->SortItems((wxListCtrlCompare)PlayerAlphaSortColumn0, (long)this);
@@ -342,6 +406,8 @@ void OneShotPage::UpdateMatchList()
 {
 	// Clear the report control
 	matchList->ClearAll();
+	matchRows.clear();
+	matchesShown = 0;
 
 	// Reset the columns
 	matchList->InsertColumn(0, _("Competitors"), wxLIST_FORMAT_LEFT, wxLIST_AUTOSIZE);
@@ -352,69 +418,85 @@ void OneShotPage::UpdateMatchList()
 	// See if we have nothing to do
 	if (!tourney->GetNumMatches())
 		return;
-
-	// Run through the match list and add them all
-	int i;
-	for (i = 0 ; i < tourney->GetNumMatches() ; i++)
+	
+	// Insert the matches already sorted, so that we know which row
+	// each one lands on, and the results can be filled in later
+	// without searching the list
+	std::vector<int> order(tourney->GetNumMatches());
+	for (size_t i = 0 ; i < order.size() ; i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), MatchNameLess(tourney));
+	
+	matchRows.resize(order.size());
+	for (size_t row = 0 ; row < order.size() ; row++)
 	{
 		wxListItem item;
-		Match *match = tourney->GetMatch(i);
+		Match *match = tourney->GetMatch(order[row]);
 
-		item.m_itemId = 0;
+		item.m_itemId = row;
 		item.m_mask = wxLIST_MASK_TEXT | wxLIST_MASK_DATA;
 		item.m_text.Printf(_("%s vs %s"), match->playerOne->GetPlayerName().c_str(),
 			match->playerTwo->GetPlayerName().c_str());
 		item.m_col = 0;
-		item.m_data = i;
-		matchList->InsertItem(item);
-
-		// Add results if we've played the tournament
-		if (tourney->IsPlayed())
-		{
-			if (match->playerOneScore > match->playerTwoScore)
-				item.m_text = _("Player One");
-			else if (match->playerTwoScore > match->playerOneScore)
-				item.m_text = _("Player Two");
-			else
-				item.m_text = _("Tie");
-			item.m_col = 1;
-			matchList->SetItem(item);
+		item.m_data = order[row];
+		matchRows[order[row]] = matchList->InsertItem(item);
+	}
 
-			item.m_text.Printf(wxT("%d"), match->playerOneScore);
-			item.m_col = 2;
-			matchList->SetItem(item);
+	CalcColumnWidth(matchList, 0);
+	
+	UpdateMatchResults();
+}
 
-			item.m_text.Printf(wxT("%d"), match->playerTwoScore);
-			item.m_col = 3;
-			matchList->SetItem(item);
-		}
+void OneShotPage::UpdateMatchResults()
+{
+	// Only the first GetNumMatchesPlayed() matches have results, as
+	// the tournament might be running
+	int numPlayed;
+	{
+		wxCriticalSectionLocker locker(tourney->GetLock());
+		numPlayed = tourney->GetNumMatchesPlayed();
+	}
+	
+	if (numPlayed <= matchesShown)
+		return;
+	
+	// Fill in the rows of the matches played since the last update
+	for (int i = matchesShown ; i < numPlayed ; i++)
+	{
+		Match *match = tourney->GetMatch(i);
+		long row = matchRows[i];
+		
+		if (match->playerOneScore > match->playerTwoScore)
+			matchList->SetItem(row, 1, _("Player One"));
+		else if (match->playerTwoScore > match->playerOneScore)
+			matchList->SetItem(row, 1, _("Player Two"));
 		else
-		{
-			// Add blank results
-			item.m_text = wxT("");
-			item.m_col = 1;
-			matchList->SetItem(item);
-			item.m_col = 2;
-			matchList->SetItem(item);
-			item.m_col = 3;
-			matchList->SetItem(item);
-		}
+			matchList->SetItem(row, 1, _("Tie"));
+		
+		matchList->SetItem(row, 2, wxString::Format(wxT("%d"), match->playerOneScore));
+		matchList->SetItem(row, 3, wxString::Format(wxT("%d"), match->playerTwoScore));
 	}
+	matchesShown = numPlayed;
 
 	// Update the width of the columns
-	CalcColumnWidth(matchList, 0);
 	CalcColumnWidth(matchList, 1);
 	CalcColumnWidth(matchList, 2);
 	CalcColumnWidth(matchList, 3);
-
-	// Sort
-	matchList->SortItems((wxListCtrlCompare)MatchAlphaSortColumn0, (long)this);
 }
 
 
 
 void OneShotPage::OnPageChanging(wxWizardEvent &event)
 {
+	// Don't let the players change while the tournament is running
+	if (thread)
+	{
+		wxMessageBox(_("Please wait for the tournament to finish, or cancel it."),
+		             _("Oyun: Error"), wxOK | wxICON_ERROR, this);
+		event.Veto();
+		return;
+	}
+	
 	// We only care if we're going forward
 	if (!event.GetDirection())
 	{
@@ -442,26 +524,108 @@ void OneShotPage::OnHelp(wxWizardEvent & WXUNUSED(event))
 
 void OneShotPage::OnRunTournament(wxCommandEvent & WXUNUSED(event))
 {
-	wxBusyCursor busy;
+	// While the tournament runs, this is the cancel button
+	if (thread)
+	{
+		thread->progress.Cancel();
+		runTournament->Disable();
+		return;
+	}
 	
-	// Run the tournament
-	if (!tourney->Run())
+	// Throw away the last run's matches here, rather than on the
+	// worker thread, as the timer reads them while it runs
+	if (tourney->IsPlayed() || tourney->GetNumMatchesPlayed())
 	{
-		wxString errStr(wxString::Format(_("Could not run tournament.  Error reported:\n\n%s"), Error::Get().c_str()));
-		wxMessageBox(errStr, _("Oyun: Error"), wxOK | wxICON_ERROR, this);
+		tourney->Reset();
+		UpdateMatchList();
+	}
+	
+	// Start the tournament on a worker thread
+	thread = new OneShotThread(this, tourney);
+	if (thread->Create() != wxTHREAD_NO_ERROR || thread->Run() != wxTHREAD_NO_ERROR)
+	{
+		delete thread;
+		thread = NULL;
+		
+		wxMessageBox(_("Could not start the tournament."), _("Oyun: Error"),
+		             wxOK | wxICON_ERROR, this);
+		return;
+	}
+	
+	runTournament->SetLabel(_("&Cancel"));
+	details->Disable();
+	gauge->SetValue(0);
+	gauge->Show(true);
+	rightSizer->Show(winner, false);
+	rightSizer->Layout();
+	
+	timer.Start(250);
+}
+
+void OneShotPage::OnTimer(wxTimerEvent & WXUNUSED(event))
+{
+	if (!thread)
 		return;
+	
+	int total = thread->progress.GetTotal();
+	gauge->SetRange(total > 0 ? total : 1);
+	gauge->SetValue(thread->progress.GetDone());
+	
+	UpdatePlayerScores();
+	UpdateMatchResults();
+}
+
+void OneShotPage::OnTournamentDone(wxCommandEvent &event)
+{
+	bool cancelled = thread && thread->progress.IsCancelled();
+	StopTournament();
+	
+	runTournament->SetLabel(_("&Run Tournament"));
+	runTournament->Enable();
+	gauge->Show(false);
+	rightSizer->Layout();
+	
+	if (!event.GetInt())
+	{
+		// The results so far are still shown, but don't complain if
+		// the user asked for this
+		wxString error = Error::Get();
+		if (!cancelled)
+		{
+			wxString errStr(wxString::Format(_("Could not run tournament.  Error reported:\n\n%s"), error.c_str()));
+			wxMessageBox(errStr, _("Oyun: Error"), wxOK | wxICON_ERROR, this);
+		}
 	}
 	
 	// This qualifies as a data update
 	parent->Update();
 }
 
+void OneShotPage::StopTournament()
+{
+	timer.Stop();
+	
+	if (!thread)
+		return;
+	
+	thread->progress.Cancel();
+	thread->Wait();
+	delete thread;
+	thread = NULL;
+}
+
 void OneShotPage::OnAddPlayer(wxNotifyEvent &event)
 {
 	// Send this to the tournament
 	tourney->AddPlayer((Player *)event.GetClientData());
 }
 
+void OneShotPage::OnAddPlayers(wxNotifyEvent &event)
+{
+	// Send these to the tournament all at once
+	tourney->AddPlayers(*(const PlayerPtrArray *)event.GetClientData());
+}
+
 void OneShotPage::OnRemovePlayer(wxNotifyEvent &event)
 {
 	// Send this to the tournament
@@ -493,7 +657,7 @@ void OneShotPage::OnMatchDetails(wxCommandEvent & WXUNUSED(event))
 	
 	Match *match = tourney->GetMatch(matchIndex);
 	
-	MatchDialog dialog(this, match);
+	MatchDialog dialog(this, match, parent->game);
 	dialog.ShowModal();
 }
 
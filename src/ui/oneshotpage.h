@@ -25,10 +25,15 @@
 
 class Tournament;
 class Match;
+class TournamentThread;
 
 #include <wx/wizard.h>
 #include <wx/splitter.h>
 #include <wx/listctrl.h>
+#include <wx/gauge.h>
+#include <wx/timer.h>
+
+#include <vector>
 
 
 /**
@@ -38,7 +43,9 @@ class Match;
     \brief Wizard page on which a round-robin tournament is run
     
     This page runs and presents the results of a round-robin tournament
-    between a set of players.
+    between a set of players.  The tournament is run on a worker thread;
+    while it runs, the lists are refreshed periodically with the results
+    of the matches played so far, and the run button cancels it.
 */
 class OneShotPage : public OyunWizardPage
 {
@@ -68,6 +75,28 @@ private:
 	*/
 	Tournament *tourney;
 	
+	/**
+	    \brief The thread running the tournament, or \c NULL if it
+	           isn't running
+	*/
+	TournamentThread *thread;
+	
+	/**
+	    \brief Timer used to refresh the results while the tournament runs
+	*/
+	wxTimer timer;
+	
+	
+	/**
+	    \brief Row of the match list showing each match, by match index
+	*/
+	std::vector<long> matchRows;
+	
+	/**
+	    \brief Number of matches whose results are shown in the match list
+	*/
+	int matchesShown;
+	
 	
 	/**
 	    \brief Update the player list control
@@ -77,6 +106,14 @@ private:
 	*/
 	void UpdatePlayerList();
 	
+	/**
+	    \brief Update the scores shown in the player list
+	    
+	    Rewrites the score of each row and re-sorts the list, without
+	    rebuilding it.  Called periodically while the tournament runs.
+	*/
+	void UpdatePlayerScores();
+	
 	/**
 	    \brief Update the match list control
 	    
@@ -85,6 +122,14 @@ private:
 	*/
 	void UpdateMatchList();
 	
+	/**
+	    \brief Fill in the results of newly played matches
+	    
+	    Only the rows of the matches played since the last update are
+	    changed.  Called periodically while the tournament runs.
+	*/
+	void UpdateMatchResults();
+	
 	/**
 	    \brief Utility function to calculate column width
 	    
@@ -108,6 +153,7 @@ private:
 	wxSizer *buttonSizer;		/**< \brief The sizer which contains the buttons */	
 	wxButton *runTournament;	/**< \brief The run tournament button */
 	wxButton *details;		/**< \brief The show details button */
+	wxGauge *gauge;			/**< \brief The progress of the running tournament */
 
 	wxStaticText *playerListLabel;	/**< \brief The label for the player list */
 	wxListCtrl *playerList;		/**< \brief The player list on the left side of the page */
@@ -135,6 +181,27 @@ private:
 	*/
 	void OnRunTournament(wxCommandEvent &event);
 	
+	/**
+	    \brief Called periodically while the tournament runs
+	    
+	    Updates the progress gauge and the lists with the matches
+	    played so far.
+	    
+	    \param event The event generated
+	*/
+	void OnTimer(wxTimerEvent &event);
+	
+	/**
+	    \brief Called when the tournament thread finishes
+	    \param event The event generated
+	*/
+	void OnTournamentDone(wxCommandEvent &event);
+	
+	/**
+	    \brief Cancel the running tournament, if any, and wait for it
+	*/
+	void StopTournament();
+	
 	/**
 	    \brief Called when a match-list item is clicked
 	    \param event The event generated
@@ -164,6 +231,12 @@ private:
 	*/
 	void OnAddPlayer(wxNotifyEvent &event);
 	
+	/**
+	    \brief Add a number of players to the tournament
+	    \param event The event generated
+	*/
+	void OnAddPlayers(wxNotifyEvent &event);
+	
 	/**
 	    \brief Remove a player from the tournament
 	    \param event The event generated
@@ -190,16 +263,6 @@ private:
 	    \returns Results of the comparison, similar to \c strcmp()
 	*/
 	static int wxCALLBACK PlayerNumSortColumn1(long item1, long item2, long sortData);
-	
-	/**
-	    \brief Sort the \c matchList by the first column, alphabetically
-
-	    \param item1 Index of the first item to be compared
-	    \param item2 Index of the second item to be compared
-	    \param sortData Pointer to the \c OneShotPage class
-	    \returns Results of the comparison, similar to \c strcmp()
-	*/
-	static int wxCALLBACK MatchAlphaSortColumn0(long item1, long item2, long sortData);
 };
 
 
@@ -51,6 +51,7 @@ IMPLEMENT_DYNAMIC_CLASS(OyunWizard, wxWizard);
 
 DEFINE_EVENT_TYPE(wxEVT_DATA_UPDATE)
 DEFINE_EVENT_TYPE(wxEVT_ADD_PLAYER)
+DEFINE_EVENT_TYPE(wxEVT_ADD_PLAYERS)
 DEFINE_EVENT_TYPE(wxEVT_REMOVE_PLAYER)
 
 BEGIN_EVENT_TABLE(OyunWizard, wxWizard)
@@ -206,6 +207,20 @@ void OyunWizard::AddPlayer(Player *player)
 	pageEvoFinish->GetEventHandler()->ProcessEvent(event);
 }
 
+void OyunWizard::AddPlayers(const PlayerPtrArray &players)
+{
+	wxNotifyEvent event(wxEVT_ADD_PLAYERS, wxID_ANY);
+	event.SetEventObject(this);
+	event.SetClientData((void *)&players);
+	
+	pagePlayers->GetEventHandler()->ProcessEvent(event);
+	pageType->GetEventHandler()->ProcessEvent(event);
+	pageOneShot->GetEventHandler()->ProcessEvent(event);
+	pageOneShotFinish->GetEventHandler()->ProcessEvent(event);
+	pageEvo->GetEventHandler()->ProcessEvent(event);
+	pageEvoFinish->GetEventHandler()->ProcessEvent(event);
+}
+
 void OyunWizard::RemovePlayer(Player *player)
 {
 	wxNotifyEvent event(wxEVT_REMOVE_PLAYER, wxID_ANY);
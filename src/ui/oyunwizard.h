@@ -24,8 +24,8 @@
 #include <wx/wizard.h>
 #include <wx/dnd.h>
 
+#include "../game/player.h"
 class Game;
-class Player;
 
 class PlayersPage;
 class TypePage;
@@ -98,6 +98,18 @@ public:
 	    \param player Player of the type to be added to all pages
 	*/
 	void AddPlayer(Player *player);
+	
+	/**
+	    \brief Send a message adding a number of players to all pages
+	    
+	    This function constructs a \c wxEVT_ADD_PLAYERS event and sends
+	    it to all of the wizard pages, so that each can add the whole set
+	    at once.  As soon as the function returns, the players passed to
+	    this function can be deleted.
+	    
+	    \param players Players of the types to be added to all pages
+	*/
+	void AddPlayers(const PlayerPtrArray &players);
 
 	/**
 	    \brief Send a remove-player message to all pages
@@ -222,6 +234,30 @@ BEGIN_DECLARE_EVENT_TYPES()
 	*/
 	DECLARE_EVENT_TYPE(wxEVT_ADD_PLAYER, -1)
 	
+	/**
+	    \var wxEVT_ADD_PLAYERS
+	    \ingroup ui
+	    
+	    \brief Event fired when a number of players are added to the list
+	    
+	    The event itself is a \c wxNotifyEvent, and can be captured
+	    by a class with:
+	    \code
+	    EVT_NOTIFY(wxEVT_ADD_PLAYERS, wxID_ANY, Handler)
+	    \endcode
+	    where Handler has the prototype:
+	    \code
+	    void Handler(wxNotifyEvent &event);
+	    \endcode
+	    The array of players to be added may be recovered with:
+	    \code
+	    const PlayerPtrArray *players = (const PlayerPtrArray *)event.GetClientData();
+	    \endcode
+	    
+	    \see OyunWizard::AddPlayers
+	*/
+	DECLARE_EVENT_TYPE(wxEVT_ADD_PLAYERS, -1)
+	
 	/**
 	    \var wxEVT_REMOVE_PLAYER
 	    \ingroup ui
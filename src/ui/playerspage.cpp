@@ -28,7 +28,9 @@
 #endif
 
 #include "../common/error.h"
+#include "../game/fsabundle.h"
 #include "../game/fsaplayer.h"
+#include "../game/matrixfile.h"
 #include "../game/random.h"
 #include "../game/titfortat.h"
 
@@ -116,8 +118,12 @@ void PlayersPage::OnHelp(wxWizardEvent & WXUNUSED(event))
 
 void PlayersPage::OnDataUpdate(wxNotifyEvent & WXUNUSED(event))
 {
-	// Update the list of players
-	list->Clear();
+	// Update the list of players, all at once (bundles may hold a very
+	// large number of them)
+	wxArrayString displayStrings;
+	void **clientData = new void *[players.size() + 1];
+	
+	displayStrings.Alloc(players.size());
 	for (size_t i = 0 ; i < players.size() ; i++)
 	{
 		Player *player = players[i];
@@ -128,9 +134,18 @@ void PlayersPage::OnDataUpdate(wxNotifyEvent & WXUNUSED(event))
 		displayString += player->GetPlayerAuthor();
 		displayString += wxT(")");
 
-		list->Append(displayString, (void *)i);
+		displayStrings.Add(displayString);
+		clientData[i] = (void *)i;
 	}
 	
+	list->Freeze();
+	list->Clear();
+	if (displayStrings.GetCount())
+		list->Append(displayStrings, clientData);
+	list->Thaw();
+	
+	delete[] clientData;
+	
 	// Update the control status if we're on screen
 	if (IsShownOnScreen())
 	{
@@ -164,6 +179,57 @@ void PlayersPage::AddPlayer(Player *player)
 	parent->Update();
 }
 
+void PlayersPage::AddPlayers(const PlayerPtrArray &newPlayers)
+{
+	if (!newPlayers.GetCount())
+		return;
+	
+	// Add all the players, so that the tournaments only rebuild their
+	// match lists once, and only update the pages once
+	players.Alloc(players.GetCount() + newPlayers.GetCount());
+	for (size_t i = 0 ; i < newPlayers.GetCount() ; i++)
+		players.push_back(newPlayers[i]);
+	
+	parent->AddPlayers(newPlayers);
+	parent->Update();
+}
+
+bool PlayersPage::LoadPlayerFile(const wxString &fileName)
+{
+	if (FSABundle::IsBundleFileName(fileName))
+	{
+		PlayerPtrArray bundlePlayers;
+		
+		if (!FSABundle::Load(fileName, parent->game, bundlePlayers))
+			return false;
+		
+		AddPlayers(bundlePlayers);
+		return true;
+	}
+	
+	if (MatrixFile::IsMatrixFileName(fileName))
+	{
+		PlayerPtrArray matrixPlayers;
+		
+		if (!MatrixFile::Load(fileName, matrixPlayers))
+			return false;
+		
+		AddPlayers(matrixPlayers);
+		return true;
+	}
+	
+	FSAPlayer *player = new FSAPlayer;
+	
+	if (!player->Load(parent->game, fileName))
+	{
+		delete player;
+		return false;
+	}
+	
+	AddPlayer(player);
+	return true;
+}
+
 void PlayersPage::RemovePlayer(size_t playerIndex)
 {
 	if (playerIndex > players.size())
@@ -204,7 +270,10 @@ void PlayersPage::OnAddBuiltinButton(wxCommandEvent & WXUNUSED(event))
 
 void PlayersPage::OnAddFileButton(wxCommandEvent & WXUNUSED(event))
 {
-	wxString wildCardFilter(_("Text files (*.txt)|*.txt"));
+	wxString wildCardFilter(_("All player files (*.txt;*.oyb;*.oym;*.csv)|*.txt;*.oyb;*.oym;*.csv|"
+	                          "Text files (*.txt)|*.txt|"
+	                          "Player bundles (*.oyb)|*.oyb|"
+	                          "Payoff matrices (*.oym;*.csv)|*.oym;*.csv"));
 	wxFileDialog *fileDialog;
 
 	fileDialog = new wxFileDialog(this, _("Select finite script automata..."), 
@@ -222,17 +291,11 @@ void PlayersPage::OnAddFileButton(wxCommandEvent & WXUNUSED(event))
 		{
 			for (size_t i = 0 ; i < numFilenames ; i++)
 			{
-				FSAPlayer *player = new FSAPlayer;
-
-				if (player->Load(parent->game, filenames[i]))
-					AddPlayer(player);
-				else
+				if (!LoadPlayerFile(filenames[i]))
 				{
 					wxString errStr(wxString::Format(_("Could not load player %s.  Error reported:\n%s"), 
 					                filenames[i].c_str(), Error::Get().c_str()));
 					wxMessageBox(errStr, _("Oyun: Error"), wxOK | wxICON_ERROR, this);
-
-					delete player;
 				}
 			}
 		}
@@ -247,17 +310,12 @@ bool PlayersPage::OnFileDrop(const wxArrayString &files)
 	
 	for (size_t i = 0 ; i < files.GetCount() ; i++)
 	{
-		FSAPlayer *player = new FSAPlayer;
-		
-		if (player->Load(parent->game, files[i]))
-			AddPlayer(player);
-		else
+		if (!LoadPlayerFile(files[i]))
 		{
 			wxString errStr(wxString::Format(_("Could not load player %s.  Error reported:\n%s"), 
 			                files[i].c_str(), Error::Get().c_str()));
 			wxMessageBox(errStr, _("Oyun: Error"), wxOK | wxICON_ERROR, this);
 			
-			delete player;
 			ret = false;
 		}
 	}
@@ -58,8 +58,8 @@ public:
 	/**
 	    \brief Add a dropped list of FSA players
 	    
-	    Called from the drag-and-drop code, adds a list of players
-	    to the tournament.
+	    Called from the drag-and-drop code, adds a list of players (FSA
+	    scripts or player bundles) to the tournament.
 	    
 	    \param files The list of filenames
 	    \returns True if the add was entirely successful, false if not
@@ -154,6 +154,29 @@ private:
 	*/
 	void AddPlayer (Player *player);
 	
+	/**
+	    \brief Add a list of players, firing a single data-update event
+	    
+	    Like AddPlayer(), but the other pages are only asked to update
+	    once, after all the players have been added.
+	    
+	    \param newPlayers The players to be added (we take ownership)
+	*/
+	void AddPlayers (const PlayerPtrArray &newPlayers);
+	
+	/**
+	    \brief Load the player or players stored in a file
+	    
+	    Text files are loaded as a single FSA script, \c .oyb files as
+	    a binary player bundle (see \c FSABundle), and \c .oym and
+	    \c .csv files as a payoff matrix (see \c MatrixFile).
+	    
+	    \param fileName The file to be loaded
+	    \returns True if the file was loaded, false otherwise (with the
+	             error available from \c Error::Get)
+	*/
+	bool LoadPlayerFile (const wxString &fileName);
+	
 	/**
 	    \brief Remove a player from the internal list and fire a remove-player
 	           event
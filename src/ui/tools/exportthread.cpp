@@ -0,0 +1,99 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#include <wx/progdlg.h>
+
+#include "../../common/error.h"
+#include "exportthread.h"
+
+// The progress dialog shows this many steps
+static const int progressSteps = 1000;
+
+
+ExportThread::ExportThread(const wxString &newFileName) :
+	wxThread(wxTHREAD_JOINABLE), fileName(newFileName), result(false)
+{
+}
+
+bool ExportThread::Execute(wxWindow *parent)
+{
+	if (Create() != wxTHREAD_NO_ERROR || Run() != wxTHREAD_NO_ERROR)
+	{
+		wxMessageBox(_("Could not start saving the file."), _("Oyun: Error"),
+		             wxOK | wxICON_ERROR, parent);
+		return false;
+	}
+	
+	{
+		wxProgressDialog dialog(_("Oyun: Saving"), _("Saving the file..."), progressSteps, parent,
+		                        wxPD_APP_MODAL | wxPD_CAN_ABORT | wxPD_ELAPSED_TIME);
+		
+		while (IsAlive())
+		{
+			wxMilliSleep(100);
+			
+			size_t total = progress.GetTotal(), done = progress.GetDone();
+			int value = total ? (int)((double)done / total * (progressSteps - 1)) : 0;
+			
+			if (!dialog.Update(value))
+				progress.Cancel();
+		}
+	}
+	
+	Wait();
+	
+	if (!result)
+	{
+		wxString error = Error::Get();
+		if (wxFileExists(fileName))
+			wxRemoveFile(fileName);
+		
+		if (!progress.IsCancelled())
+		{
+			wxString errStr(wxString::Format(_("Could not save the file.  Error reported:\n\n%s"), error.c_str()));
+			wxMessageBox(errStr, _("Oyun: Error"), wxOK | wxICON_ERROR, parent);
+		}
+	}
+	
+	return result;
+}
+
+bool ExportThread::Cancelled()
+{
+	if (!progress.IsCancelled())
+		return false;
+	
+	Error::Set(_("Saving the file was cancelled"));
+	return true;
+}
+
+wxThread::ExitCode ExportThread::Entry()
+{
+	result = Export();
+	return 0;
+}
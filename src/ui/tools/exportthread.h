@@ -0,0 +1,109 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef EXPORTTHREAD_H__
+#define EXPORTTHREAD_H__
+
+#include <wx/thread.h>
+
+#include "../../common/progress.h"
+class wxWindow;
+
+
+/**
+    \class ExportThread
+    \ingroup ui
+    
+    \brief Base class for worker threads which save results to a file
+    
+    The finish pages write their files on one of these, so that large
+    exports neither freeze the interface nor need to be built up in
+    memory first.  Derived classes implement Export(), which should
+    write \c fileName (usually with an \c OutputFile), report its
+    progress in \c progress, and call Cancelled() now and then.
+*/
+class ExportThread : public wxThread
+{
+public:
+	/**
+	    \brief Constructor
+	    \param newFileName The file to be written
+	*/
+	ExportThread(const wxString &newFileName);
+	
+	/**
+	    \brief Run the export, showing a progress dialog
+	    
+	    This starts the thread and shows a progress dialog (with a
+	    cancel button) until it finishes.  If the export fails, the
+	    partly written file is removed, and unless the user cancelled
+	    it, the error is shown in a message box.
+	    
+	    \param parent Parent window for the dialogs
+	    \returns True if the file was saved, false otherwise
+	*/
+	bool Execute(wxWindow *parent);
+
+protected:
+	/**
+	    \brief Write the file
+	    
+	    This function is called on the worker thread.
+	    
+	    \returns True if the file was written, false otherwise (with
+	             the error available from \c Error::Get)
+	*/
+	virtual bool Export() = 0;
+	
+	/**
+	    \brief Check whether the user has cancelled the export
+	    \returns True (and sets an error) if the export was cancelled,
+	             false otherwise
+	*/
+	bool Cancelled();
+	
+	/**
+	    \brief The file to be written
+	*/
+	wxString fileName;
+	
+	/**
+	    \brief Progress of the export, and the means to cancel it
+	*/
+	Progress progress;
+
+private:
+	/**
+	    \brief Thread entry point
+	    \returns Always zero
+	*/
+	virtual ExitCode Entry();
+	
+	/**
+	    \brief The value returned by Export()
+	*/
+	bool result;
+};
+
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,49 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#include "tournamentthread.h"
+
+DEFINE_EVENT_TYPE(wxEVT_TOURNAMENT_DONE)
+
+
+TournamentThread::TournamentThread(wxEvtHandler *newHandler) :
+	wxThread(wxTHREAD_JOINABLE), handler(newHandler)
+{
+}
+
+wxThread::ExitCode TournamentThread::Entry()
+{
+	bool ok = RunTournament();
+	
+	// Let the page know, on the main thread
+	wxCommandEvent event(wxEVT_TOURNAMENT_DONE);
+	event.SetInt(ok ? 1 : 0);
+	wxPostEvent(handler, event);
+	
+	return 0;
+}
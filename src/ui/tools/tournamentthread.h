@@ -0,0 +1,111 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef TOURNAMENTTHREAD_H__
+#define TOURNAMENTTHREAD_H__
+
+#include <wx/thread.h>
+#include <wx/event.h>
+
+#include "../../common/progress.h"
+
+
+/**
+    \class TournamentThread
+    \ingroup ui
+    
+    \brief Base class for worker threads which run a tournament
+    
+    The tournament pages run their tournaments on one of these, so that
+    the interface stays responsive while a long tournament is played.
+    Derived classes implement RunTournament(), passing it the
+    \c progress member.  When it returns, the thread posts a
+    \c wxEVT_TOURNAMENT_DONE event to its handler, with the return
+    value of RunTournament() stored as the event's integer.
+    
+    This is a joinable thread: after the done event arrives (or after
+    cancelling \c progress), the owner must call \c Wait() and then
+    delete the thread.
+*/
+class TournamentThread : public wxThread
+{
+public:
+	/**
+	    \brief Constructor
+	    \param newHandler The event handler to be notified when the
+	                      tournament finishes
+	*/
+	TournamentThread(wxEvtHandler *newHandler);
+	
+	/**
+	    \brief Progress of the tournament, and the means to cancel it
+	*/
+	Progress progress;
+
+protected:
+	/**
+	    \brief Run the tournament
+	    
+	    This function is called on the worker thread.
+	    
+	    \returns True if the tournament ran successfully, false otherwise
+	*/
+	virtual bool RunTournament() = 0;
+
+private:
+	/**
+	    \brief Thread entry point
+	    \returns Always zero
+	*/
+	virtual ExitCode Entry();
+	
+	/**
+	    \brief The event handler to be notified when we finish
+	*/
+	wxEvtHandler *handler;
+};
+
+
+BEGIN_DECLARE_EVENT_TYPES()
+	/**
+	    \var wxEVT_TOURNAMENT_DONE
+	    \ingroup ui
+	    
+	    \brief Event fired when a \c TournamentThread finishes
+	    
+	    The event is a \c wxCommandEvent, whose integer is nonzero if
+	    the tournament ran successfully.  It can be captured by a class
+	    with:
+	    \code
+	    EVT_COMMAND(wxID_ANY, wxEVT_TOURNAMENT_DONE, Handler)
+	    \endcode
+	    where Handler has the prototype:
+	    \code
+	    void Handler(wxCommandEvent &event);
+	    \endcode
+	*/
+	DECLARE_EVENT_TYPE(wxEVT_TOURNAMENT_DONE, -1)
+END_DECLARE_EVENT_TYPES()
+
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,131 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Compiles FSA player scripts into a binary player bundle (.oyb), which
+  Oyun can memory-map and open without parsing any text.
+
+  Usage: fsa2oyb output.oyb input [input ...]
+  
+  Each input may be an FSA script, or a directory, in which case every
+  .txt file within it (and its subdirectories) is compiled.  Scripts
+  which fail to load are reported and left out of the bundle.
+*/
+
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#include <wx/dir.h>
+#include <wx/filename.h>
+
+#include "../../src/common/error.h"
+#include "../../src/game/fsabundle.h"
+#include "../../src/game/fsaplayer.h"
+#include "../../src/game/prisoner.h"
+
+
+class Fsa2OybApp : public wxAppConsole
+{
+public:
+	virtual bool OnInit();
+	virtual int OnRun();
+	
+private:
+	int exitCode;
+};
+
+IMPLEMENT_APP_CONSOLE(Fsa2OybApp);
+
+bool Fsa2OybApp::OnInit()
+{
+	exitCode = 1;
+	return true;
+}
+
+int Fsa2OybApp::OnRun()
+{
+	if (argc < 3)
+	{
+		wxPrintf(wxT("Usage: fsa2oyb output.oyb input [input ...]\n"));
+		return exitCode;
+	}
+	
+	// Collect all of the scripts to compile
+	wxArrayString files;
+	for (int i = 2 ; i < argc ; i++)
+	{
+		wxString input(argv[i]);
+		
+		if (wxDir::Exists(input))
+		{
+			wxArrayString dirFiles;
+			wxDir::GetAllFiles(input, &dirFiles, wxT("*.txt"));
+			dirFiles.Sort();
+			
+			for (size_t j = 0 ; j < dirFiles.GetCount() ; j++)
+				files.Add(dirFiles[j]);
+		}
+		else
+			files.Add(input);
+	}
+	
+	// Compile them
+	PrisonerDilemma game;
+	PlayerPtrArray players;
+	players.Alloc(files.GetCount());
+	
+	size_t failed = 0;
+	for (size_t i = 0 ; i < files.GetCount() ; i++)
+	{
+		FSAPlayer *player = new FSAPlayer;
+		
+		if (player->Load(&game, files[i]))
+			players.Add(player);
+		else
+		{
+			wxPrintf(wxT("%s: %s\n"), files[i].c_str(), Error::Get().c_str());
+			delete player;
+			failed++;
+		}
+	}
+	
+	wxString output(argv[1]);
+	
+	if (FSABundle::Write(output, &game, players))
+	{
+		wxPrintf(wxT("Wrote %d players to %s (%d scripts skipped)\n"), 
+		         (int)players.GetCount(), output.c_str(), (int)failed);
+		if (!failed)
+			exitCode = 0;
+	}
+	else
+		wxPrintf(wxT("%s: %s\n"), output.c_str(), Error::Get().c_str());
+	
+	for (size_t i = 0 ; i < players.GetCount() ; i++)
+		delete players[i];
+	
+	return exitCode;
+}
@@ -0,0 +1,244 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Times the matches of a round-robin played row by row against the
+  same matches in the cache-blocked order of a MatchPlanner, to show
+  the effect of keeping large machines' state tables in the cache.
+
+  Usage: matchbench [--copies N] [--cache BYTES] [--repeat N]
+                    player [player ...]
+  
+  Each player may be an FSA script, a player bundle (.oyb), or a
+  directory, in which case every .txt file within it (and its
+  subdirectories) is loaded.  Every player is entered N times (as
+  separate copies, each with its own state table), so that a roster of
+  large machines such as contrib/players/class/dannyb.txt can be made
+  larger than the cache.  The matches are played on one thread.
+*/
+
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#include <wx/dir.h>
+#include <wx/stopwatch.h>
+
+#include <time.h>
+
+#include "../../src/common/error.h"
+#include "../../src/common/rng.h"
+#include "../../src/game/fsabundle.h"
+#include "../../src/game/fsaplayer.h"
+#include "../../src/game/prisoner.h"
+#include "../../src/tourney/match.h"
+#include "../../src/tourney/matchplanner.h"
+
+
+class MatchBenchApp : public wxAppConsole
+{
+public:
+	virtual bool OnInit();
+	virtual int OnRun();
+	
+private:
+	// Play every match of the plan, returning the time taken in
+	// milliseconds, or -1 on error
+	long Play(const MatchPlanner &planner, unsigned long repeat);
+	
+	PrisonerDilemma game;
+	PlayerPtrArray playersOne, playersTwo;
+	int exitCode;
+};
+
+IMPLEMENT_APP_CONSOLE(MatchBenchApp);
+
+bool MatchBenchApp::OnInit()
+{
+	exitCode = 1;
+	Random::Seed(time(NULL));
+	return true;
+}
+
+long MatchBenchApp::Play(const MatchPlanner &planner, unsigned long repeat)
+{
+	wxStopWatch watch;
+	
+	for (unsigned long r = 0 ; r < repeat ; r++)
+	{
+		for (size_t k = 0 ; k < planner.GetNumJobs() ; k++)
+		{
+			const MatchJob &job = planner.GetJob(k);
+			Match match(playersOne[job.one], playersTwo[job.two], k + 1);
+			match.SetHistoryPolicy(Match::HISTORY_NONE);
+			
+			if (!match.Play(&game, true))
+				return -1;
+		}
+	}
+	
+	return watch.Time();
+}
+
+int MatchBenchApp::OnRun()
+{
+	unsigned long copies = 1, cache = MatchPlanner::defaultCacheSize, repeat = 1;
+	int arg = 1;
+	
+	while (arg < argc && wxString(argv[arg]).StartsWith(wxT("--")))
+	{
+		wxString option(argv[arg]);
+		unsigned long value;
+		
+		if (arg + 1 >= argc || !wxString(argv[arg + 1]).ToULong(&value))
+		{
+			wxPrintf(wxT("matchbench: %s needs a number\n"), option.c_str());
+			return exitCode;
+		}
+		
+		if (option == wxT("--copies") && value)
+			copies = value;
+		else if (option == wxT("--cache") && value)
+			cache = value;
+		else if (option == wxT("--repeat") && value)
+			repeat = value;
+		else
+		{
+			wxPrintf(wxT("matchbench: unknown option %s\n"), option.c_str());
+			return exitCode;
+		}
+		
+		arg += 2;
+	}
+	
+	if (arg >= argc)
+	{
+		wxPrintf(wxT("Usage: matchbench [--copies N] [--cache BYTES] [--repeat N]\n"
+		             "                  player [player ...]\n"));
+		return exitCode;
+	}
+	
+	// Collect all of the player files
+	wxArrayString files;
+	for (int i = arg ; i < argc ; i++)
+	{
+		wxString input(argv[i]);
+		
+		if (wxDir::Exists(input))
+		{
+			wxArrayString dirFiles;
+			wxDir::GetAllFiles(input, &dirFiles, wxT("*.txt"));
+			dirFiles.Sort();
+			
+			for (size_t j = 0 ; j < dirFiles.GetCount() ; j++)
+				files.Add(dirFiles[j]);
+		}
+		else
+			files.Add(input);
+	}
+	
+	// Load them, and make the copies
+	PlayerPtrArray loaded;
+	bool ok = true;
+	
+	for (size_t i = 0 ; i < files.GetCount() && ok ; i++)
+	{
+		if (FSABundle::IsBundleFileName(files[i]))
+			ok = FSABundle::Load(files[i], &game, loaded);
+		else
+		{
+			FSAPlayer *player = new FSAPlayer;
+			loaded.Add(player);
+			ok = player->Load(&game, files[i]);
+		}
+		
+		if (!ok)
+			wxPrintf(wxT("%s: %s\n"), files[i].c_str(), Error::Get().c_str());
+	}
+	
+	if (ok)
+	{
+		for (unsigned long c = 0 ; c < copies ; c++)
+		{
+			for (size_t i = 0 ; i < loaded.GetCount() ; i++)
+			{
+				playersOne.Add(loaded[i]->Clone());
+				playersTwo.Add(loaded[i]->Clone());
+			}
+		}
+		
+		size_t footprint = 0;
+		for (size_t i = 0 ; i < playersOne.GetCount() ; i++)
+			footprint += MatchPlanner::GetFootprint(playersOne[i]);
+		
+		MatchPlanner rows, blocked;
+		rows.SetCacheSize(0);
+		rows.Plan(playersOne);
+		blocked.SetCacheSize(cache);
+		blocked.Plan(playersOne);
+		
+		wxPrintf(wxT("%d players using %d KiB, %d matches, %d groups for a %d KiB cache\n"),
+		         (int)playersOne.GetCount(), (int)(footprint / 1024), (int)rows.GetNumJobs(),
+		         (int)blocked.GetNumGroups(), (int)(cache / 1024));
+		
+		// Play each order twice, alternating, and keep the better time
+		long rowTime = -1, blockedTime = -1;
+		for (int pass = 0 ; pass < 2 && ok ; pass++)
+		{
+			long t = Play(rows, repeat);
+			if (t >= 0 && (rowTime < 0 || t < rowTime))
+				rowTime = t;
+			
+			long u = Play(blocked, repeat);
+			if (u >= 0 && (blockedTime < 0 || u < blockedTime))
+				blockedTime = u;
+			
+			ok = (t >= 0 && u >= 0);
+		}
+		
+		if (!ok)
+			wxPrintf(wxT("matchbench: %s\n"), Error::Get().c_str());
+		else
+		{
+			double matches = (double)rows.GetNumJobs() * repeat;
+			wxPrintf(wxT("Row by row:    %ld ms (%.0f matches/s)\n"), rowTime,
+			         rowTime ? matches * 1000.0 / rowTime : 0.0);
+			wxPrintf(wxT("Cache-blocked: %ld ms (%.0f matches/s)\n"), blockedTime,
+			         blockedTime ? matches * 1000.0 / blockedTime : 0.0);
+		}
+	}
+	
+	for (size_t i = 0 ; i < loaded.GetCount() ; i++)
+		delete loaded[i];
+	for (size_t i = 0 ; i < playersOne.GetCount() ; i++)
+	{
+		delete playersOne[i];
+		delete playersTwo[i];
+	}
+	
+	if (ok)
+		exitCode = 0;
+	return exitCode;
+}
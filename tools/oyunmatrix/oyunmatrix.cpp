@@ -0,0 +1,251 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Computes the payoff matrix of a roster too large to keep in memory,
+  as a directory of tiles on disk (see TiledPayoffMatrix), and writes
+  each player's mean score against the roster, and its share of the
+  population after replicator dynamics, to a CSV file.
+
+  Usage: oyunmatrix [--threads N] [--tile N] [--float] [--generations N]
+                    [--states N [--samples N] [--seed N]]
+                    directory output.csv [player ...]
+  
+  Each player may be an FSA script, a player bundle (.oyb), or a
+  directory, in which case every .txt file within it (and its
+  subdirectories) is loaded.  With --states, every distinct machine
+  with up to that many states is added to the roster as well (see
+  FSAEnumerator); sizes with more than --samples state tables (100000
+  by default) are sampled, using the given seed.  If the directory
+  already holds some of the tiles for the same roster and game, only
+  the missing ones are computed, so an interrupted run can be started
+  again.  Scores are stored in 16 bits, scaled per tile, unless
+  --float is given.
+*/
+
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#include <wx/dir.h>
+#include <wx/filename.h>
+
+#include <time.h>
+
+#include "../../src/common/error.h"
+#include "../../src/common/outputfile.h"
+#include "../../src/common/parallel.h"
+#include "../../src/common/rng.h"
+#include "../../src/game/fsabundle.h"
+#include "../../src/game/fsaenumerator.h"
+#include "../../src/game/fsaplayer.h"
+#include "../../src/game/prisoner.h"
+#include "../../src/tourney/tiledpayoffmatrix.h"
+
+
+class OyunMatrixApp : public wxAppConsole
+{
+public:
+	virtual bool OnInit();
+	virtual int OnRun();
+	
+private:
+	int exitCode;
+};
+
+IMPLEMENT_APP_CONSOLE(OyunMatrixApp);
+
+bool OyunMatrixApp::OnInit()
+{
+	exitCode = 1;
+	Random::Seed(time(NULL));
+	return true;
+}
+
+int OyunMatrixApp::OnRun()
+{
+	TiledPayoffMatrix matrix;
+	FSAEnumerator enumerator;
+	unsigned long generations = 1000, states = 0;
+	int arg = 1;
+	
+	while (arg < argc && wxString(argv[arg]).StartsWith(wxT("--")))
+	{
+		wxString option(argv[arg]);
+		
+		if (option == wxT("--float"))
+		{
+			matrix.SetEncoding(TiledPayoffMatrix::FLOAT32);
+			arg++;
+			continue;
+		}
+		
+		unsigned long value;
+		if (arg + 1 >= argc || !wxString(argv[arg + 1]).ToULong(&value))
+		{
+			wxPrintf(wxT("oyunmatrix: %s needs a number\n"), option.c_str());
+			return exitCode;
+		}
+		
+		if (option == wxT("--threads"))
+			Parallel::SetNumThreads(value);
+		else if (option == wxT("--tile") && value)
+			matrix.SetTileSize(value);
+		else if (option == wxT("--generations"))
+			generations = value;
+		else if (option == wxT("--states"))
+			states = value;
+		else if (option == wxT("--samples"))
+			enumerator.SetNumSamples(value);
+		else if (option == wxT("--seed"))
+			enumerator.SetSeed(value);
+		else
+		{
+			wxPrintf(wxT("oyunmatrix: unknown option %s\n"), option.c_str());
+			return exitCode;
+		}
+		
+		arg += 2;
+	}
+	
+	if (argc - arg < (states ? 2 : 3))
+	{
+		wxPrintf(wxT("Usage: oyunmatrix [--threads N] [--tile N] [--float] [--generations N]\n"
+		             "                  [--states N [--samples N] [--seed N]]\n"
+		             "                  directory output.csv [player ...]\n"));
+		return exitCode;
+	}
+	
+	wxString directory(argv[arg]);
+	wxString output(argv[arg + 1]);
+	
+	// Collect all of the player files
+	wxArrayString files;
+	for (int i = arg + 2 ; i < argc ; i++)
+	{
+		wxString input(argv[i]);
+		
+		if (wxDir::Exists(input))
+		{
+			wxArrayString dirFiles;
+			wxDir::GetAllFiles(input, &dirFiles, wxT("*.txt"));
+			dirFiles.Sort();
+			
+			for (size_t j = 0 ; j < dirFiles.GetCount() ; j++)
+				files.Add(dirFiles[j]);
+		}
+		else
+			files.Add(input);
+	}
+	
+	// Load them
+	PrisonerDilemma game;
+	PlayerPtrArray players;
+	
+	for (size_t i = 0 ; i < files.GetCount() ; i++)
+	{
+		bool ok;
+		
+		if (FSABundle::IsBundleFileName(files[i]))
+			ok = FSABundle::Load(files[i], &game, players);
+		else
+		{
+			FSAPlayer *player = new FSAPlayer;
+			players.Add(player);
+			ok = player->Load(&game, files[i]);
+		}
+		
+		// The tiles already on disk are for a particular roster, so stop
+		if (!ok)
+		{
+			wxPrintf(wxT("%s: %s\n"), files[i].c_str(), Error::Get().c_str());
+			for (size_t j = 0 ; j < players.GetCount() ; j++)
+				delete players[j];
+			return exitCode;
+		}
+	}
+	
+	// Then every machine of up to the given size
+	if (states)
+	{
+		enumerator.SetMaxStates(states);
+		if (!enumerator.Enumerate(&game, players))
+		{
+			wxPrintf(wxT("oyunmatrix: %s\n"), Error::Get().c_str());
+			for (size_t j = 0 ; j < players.GetCount() ; j++)
+				delete players[j];
+			return exitCode;
+		}
+		
+		for (unsigned int k = 1 ; k <= states ; k++)
+			wxPrintf(wxT("%u states: %d distinct machines%s\n"), k, (int)enumerator.GetNumUnique(k),
+			         enumerator.IsSampled(k) ? wxT(" (sampled)") : wxT(""));
+	}
+	
+	std::vector<double> means, fractions;
+	bool ok = matrix.Compute(directory, &game, players) && matrix.GetMeanScores(means) &&
+	          matrix.Evolve(fractions, generations, 1e-8);
+	
+	if (!ok)
+		wxPrintf(wxT("oyunmatrix: %s\n"), Error::Get().c_str());
+	else
+	{
+		OutputFile out;
+		ok = out.Open(output);
+		
+		if (ok)
+		{
+			out.WriteLine(wxString(_("Player Name")) + wxT(",") + _("Player Author") + wxT(",") +
+			              _("Mean Score") + wxT(",") + _("Final Fraction"));
+			
+			for (size_t i = 0 ; i < players.GetCount() ; i++)
+			{
+				out.Write(players[i]->GetPlayerName());
+				out.Write(',');
+				out.Write(players[i]->GetPlayerAuthor());
+				out.Write(',');
+				out.WriteFloat(means[i]);
+				out.Write(',');
+				out.WriteFloat(fractions[i]);
+				out.EndLine();
+			}
+			
+			ok = out.Close();
+		}
+		
+		if (!ok)
+			wxPrintf(wxT("%s: %s\n"), output.c_str(), Error::Get().c_str());
+		else
+			wxPrintf(wxT("Scored %d players in %s, results in %s\n"), (int)players.GetCount(),
+			         directory.c_str(), output.c_str());
+	}
+	
+	for (size_t i = 0 ; i < players.GetCount() ; i++)
+		delete players[i];
+	
+	if (ok)
+		exitCode = 0;
+	return exitCode;
+}
@@ -0,0 +1,179 @@
+/*
+    Copyright (C) 2004-2011 by Charles Pence
+    charles@charlespence.net
+
+    This file is part of Oyun.
+
+    Oyun is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Oyun is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Oyun.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Runs a parameter sweep: the same players in a round-robin tournament
+  at every point of a sweep specification (see Sweep::LoadFromString),
+  with the results written to a single CSV file.
+
+  Usage: oyunsweep [--threads N] spec.txt output.csv player [player ...]
+  
+  Each player may be an FSA script, a player bundle (.oyb), or a
+  directory, in which case every .txt file within it (and its
+  subdirectories) is loaded.  Players are numbered from one, in the
+  order given, for the rosters in the specification.
+*/
+
+#include <wx/wxprec.h>
+#ifdef __BORLANDC__
+#  pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+#  include <wx/wx.h>
+#endif
+
+#include <wx/dir.h>
+#include <wx/filename.h>
+
+#include <time.h>
+
+#include "../../src/common/error.h"
+#include "../../src/common/parallel.h"
+#include "../../src/common/rng.h"
+#include "../../src/game/fsabundle.h"
+#include "../../src/game/fsaplayer.h"
+#include "../../src/game/prisoner.h"
+#include "../../src/tourney/sweep.h"
+
+
+class OyunSweepApp : public wxAppConsole
+{
+public:
+	virtual bool OnInit();
+	virtual int OnRun();
+	
+private:
+	int exitCode;
+};
+
+IMPLEMENT_APP_CONSOLE(OyunSweepApp);
+
+bool OyunSweepApp::OnInit()
+{
+	exitCode = 1;
+	Random::Seed(time(NULL));
+	return true;
+}
+
+int OyunSweepApp::OnRun()
+{
+	int arg = 1;
+	if (argc > 2 && !wxStrcmp(argv[1], wxT("--threads")))
+	{
+		unsigned long threads;
+		if (!wxString(argv[2]).ToULong(&threads))
+		{
+			wxPrintf(wxT("oyunsweep: the number of threads is not a number\n"));
+			return exitCode;
+		}
+		
+		Parallel::SetNumThreads(threads);
+		arg = 3;
+	}
+	
+	if (argc - arg < 3)
+	{
+		wxPrintf(wxT("Usage: oyunsweep [--threads N] spec.txt output.csv player [player ...]\n"));
+		return exitCode;
+	}
+	
+	wxString specName(argv[arg]);
+	wxString output(argv[arg + 1]);
+	
+	// Collect all of the player files
+	wxArrayString files;
+	for (int i = arg + 2 ; i < argc ; i++)
+	{
+		wxString input(argv[i]);
+		
+		if (wxDir::Exists(input))
+		{
+			wxArrayString dirFiles;
+			wxDir::GetAllFiles(input, &dirFiles, wxT("*.txt"));
+			dirFiles.Sort();
+			
+			for (size_t j = 0 ; j < dirFiles.GetCount() ; j++)
+				files.Add(dirFiles[j]);
+		}
+		else
+			files.Add(input);
+	}
+	
+	// Load them
+	PrisonerDilemma game;
+	Sweep sweep(&game);
+	
+	for (size_t i = 0 ; i < files.GetCount() ; i++)
+	{
+		PlayerPtrArray players;
+		bool ok;
+		
+		if (FSABundle::IsBundleFileName(files[i]))
+			ok = FSABundle::Load(files[i], &game, players);
+		else
+		{
+			FSAPlayer *player = new FSAPlayer;
+			players.Add(player);
+			ok = player->Load(&game, files[i]);
+		}
+		
+		if (ok)
+		{
+			for (size_t j = 0 ; j < players.GetCount() ; j++)
+				sweep.AddPlayer(players[j]);
+		}
+		
+		for (size_t j = 0 ; j < players.GetCount() ; j++)
+			delete players[j];
+		
+		// Leaving a player out would renumber the rosters, so stop
+		if (!ok)
+		{
+			wxPrintf(wxT("%s: %s\n"), files[i].c_str(), Error::Get().c_str());
+			return exitCode;
+		}
+	}
+	
+	if (!sweep.Load(specName))
+	{
+		wxPrintf(wxT("%s: %s\n"), specName.c_str(), Error::Get().c_str());
+		return exitCode;
+	}
+	
+	if (!sweep.Run())
+	{
+		wxPrintf(wxT("oyunsweep: %s\n"), Error::Get().c_str());
+		return exitCode;
+	}
+	
+	if (!sweep.Write(output))
+	{
+		wxPrintf(wxT("%s: %s\n"), output.c_str(), Error::Get().c_str());
+		return exitCode;
+	}
+	
+	wxPrintf(wxT("Ran %d points with %d players (%d matches), results in %s\n"),
+	         (int)sweep.GetNumPoints(), (int)sweep.players.GetCount(),
+	         (int)sweep.GetNumMatchesPlayed(), output.c_str());
+	
+	exitCode = 0;
+	return exitCode;
+}